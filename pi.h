@@ -198,7 +198,9 @@ typedef union {
 typedef enum {
     PI_PROT_OK = 0,          // No error, packet is valid
     PI_PROT_BAD_HEADER = 1,  // Invalid packet header
-    PI_PROT_BAD_CRC = 3      // CRC validation failed
+    PI_PROT_BAD_SEQUENCE = 2, // Sequence number and its complement disagree (legacy packets)
+    PI_PROT_BAD_CRC = 3,     // CRC validation failed
+    PI_PROT_CORRECTED = 4    // Valid after repairing a single-bit error
 } PiProtError_t;
 
 #define CRC32_INITIAL 0xFFFFFFFFUL
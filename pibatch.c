@@ -0,0 +1,418 @@
+#define _DEFAULT_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "pibatch.h"
+#include "picap.h"
+#include "piframer.h"
+#include "pipack.h"
+
+#define PI_BATCH_DETECT_SIZE    (1024 * 1024)       // Bytes scanned at a time for the format
+
+/**
+ * @brief A chunk decoded and waiting for its turn to be committed.
+ */
+typedef struct {
+    int done;                   // Decoded, set under the lock
+    char *text;                 // Output of the chunk, NULL if none
+    size_t textLen;             // Bytes of output
+    PiStats_t stats;            // Statistics of the chunk
+} PiBatchChunk_t;
+
+/**
+ * @brief State shared by the workers of a batch decode.
+ */
+typedef struct {
+    const uint8_t *data;        // Raw link bytes
+    size_t len;                 // Number of bytes
+    size_t chunkSize;           // Bytes per chunk
+    size_t chunks;              // Number of chunks
+    size_t window;              // Chunks decoded ahead of the commit, slots in `slots`
+    PiProtoFormat_t format;     // Format of the stream
+    int correct;                // Repair single-bit errors
+    PiOut_t *output;            // Destination of the committed output, NULL for none
+    PiBatchResult_t *result;    // Receives the merged statistics
+    pthread_mutex_t lock;       // Protects the fields below and the `done` flags
+    pthread_cond_t changed;     // Signaled when a chunk is committed or the decode fails
+    size_t next;                // Next chunk to claim
+    size_t committed;           // Chunks committed
+    int committing;             // A thread is committing chunks
+    int error;                  // errno of the first failure, stops the decode
+    PiBatchChunk_t *slots;      // Chunk `k` is decoded into slot `k % window`
+} PiBatch_t;
+
+/**
+ * @brief State of one worker thread.
+ */
+typedef struct {
+    PiBatch_t *batch;           // Shared state
+    pthread_t thread;           // Thread, unused for the calling thread
+    PiFramer_t framer;          // Framer of the chunk being decoded
+    PiStats_t *stats;           // Statistics of the chunk being decoded
+    PiOut_t *out;               // Memory output of the chunk being decoded, NULL for none
+} PiBatchWorker_t;
+
+/**
+ * @brief Framer callback, accounts a packet and formats it into the output of the chunk.
+ */
+static void piBatchPacket(void *context, const PiProt_t *packet) {
+    PiBatchWorker_t *worker = context;
+
+    piStatsPacket(worker->stats, packet, 0);
+    if (worker->out != NULL) {
+        piOutPacket(worker->out, packet, worker->framer.lastResult);
+    }
+}
+
+/**
+ * @brief Framer callback of the format detection, the packets are decoded again by the chunks.
+ */
+static void piBatchIgnore(void *context, const PiProt_t *packet) {
+    (void)context;
+    (void)packet;
+}
+
+/**
+ * @brief Returns the offset of the first valid packet starting in the chunk that begins at
+ * `offset`, the end of the chunk if there is none.
+ */
+static size_t piBatchSync(const PiBatch_t *batch, size_t offset) {
+    const size_t size = piProtoSize(batch->format);
+    const uint16_t header = piProtoHeader(batch->format);
+    size_t end = batch->len - offset > batch->chunkSize ? offset + batch->chunkSize : batch->len;
+
+    while (offset < end) {
+        const uint8_t *next = memchr(batch->data + offset, (uint8_t)(header & 0xff), end - offset);
+        if (next == NULL) {
+            break;
+        }
+        offset = (size_t)(next - batch->data);
+        if (batch->len - offset >= size && piProtoCheck(batch->format, next) == PI_PROT_OK) {
+            return offset;
+        }
+        offset++;
+    }
+    return end;
+}
+
+/**
+ * @brief Decodes chunk `k` into its slot.
+ *
+ * @return 0 on success, the errno of a failed output otherwise.
+ */
+static int piBatchDecodeChunk(PiBatchWorker_t *worker, size_t k) {
+    PiBatch_t *batch = worker->batch;
+    PiBatchChunk_t *chunk = &batch->slots[k % batch->window];
+    size_t first = k == 0 ? 0 : piBatchSync(batch, k * batch->chunkSize);
+    size_t last = k + 1 == batch->chunks ? batch->len : piBatchSync(batch, (k + 1) * batch->chunkSize);
+
+    piStatsInit(&chunk->stats, 0, 0);
+    worker->stats = &chunk->stats;
+    piFramerReset(&worker->framer);
+    piFramerFeed(&worker->framer, batch->data + first, last - first);
+    piFramerFinish(&worker->framer);
+    piStatsFramer(&chunk->stats, &worker->framer);
+
+    chunk->text = NULL;
+    chunk->textLen = 0;
+    if (worker->out != NULL) {
+        chunk->text = piOutTake(worker->out, &chunk->textLen);
+        if (worker->out->error != 0) {
+            return worker->out->error;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Commits the decoded chunks that are next in stream order, called with the lock held.
+ *
+ * The lock is released while the output is written, one thread commits at a time.
+ */
+static void piBatchCommit(PiBatch_t *batch) {
+    if (batch->committing) {
+        return;
+    }
+    batch->committing = 1;
+    while (batch->committed < batch->chunks && batch->slots[batch->committed % batch->window].done) {
+        PiBatchChunk_t *chunk = &batch->slots[batch->committed % batch->window];
+        int failed = 0;
+
+        pthread_mutex_unlock(&batch->lock);
+        if (batch->output != NULL && piOutWriteBytes(batch->output, chunk->text, chunk->textLen) != 0) {
+            failed = batch->output->error != 0 ? batch->output->error : EIO;
+        }
+        free(chunk->text);
+        chunk->text = NULL;
+        piStatsMerge(&batch->result->stats, &chunk->stats);
+        pthread_mutex_lock(&batch->lock);
+
+        chunk->done = 0;
+        batch->committed++;
+        if (failed != 0 && batch->error == 0) {
+            batch->error = failed;
+        }
+        pthread_cond_broadcast(&batch->changed);
+    }
+    batch->committing = 0;
+}
+
+/**
+ * @brief Claims, decodes and commits chunks until there are none left.
+ */
+static void *piBatchWork(void *context) {
+    PiBatchWorker_t *worker = context;
+    PiBatch_t *batch = worker->batch;
+
+    pthread_mutex_lock(&batch->lock);
+    for (;;) {
+        while (batch->error == 0 && batch->next < batch->chunks && batch->next >= batch->committed + batch->window) {
+            pthread_cond_wait(&batch->changed, &batch->lock);
+        }
+        if (batch->error != 0 || batch->next == batch->chunks) {
+            break;
+        }
+        size_t k = batch->next++;
+        pthread_mutex_unlock(&batch->lock);
+
+        int error = piBatchDecodeChunk(worker, k);
+
+        pthread_mutex_lock(&batch->lock);
+        if (error != 0) {
+            free(batch->slots[k % batch->window].text);
+            batch->slots[k % batch->window].text = NULL;
+            if (batch->error == 0) {
+                batch->error = error;
+            }
+            pthread_cond_broadcast(&batch->changed);
+            break;
+        }
+        batch->slots[k % batch->window].done = 1;
+        piBatchCommit(batch);
+    }
+    pthread_mutex_unlock(&batch->lock);
+    return NULL;
+}
+
+/**
+ * @brief Finds the format of the stream from its first valid packet.
+ *
+ * @return The format, `PI_PROTO_AUTO` if the stream holds no valid packet.
+ */
+static PiProtoFormat_t piBatchDetect(const uint8_t *data, size_t len, int correct) {
+    PiFramer_t *framer = malloc(sizeof(PiFramer_t));
+    PiProtoFormat_t format = PI_PROTO_AUTO;
+
+    if (framer == NULL) {
+        return PI_PROTO_AUTO;
+    }
+    piFramerInit(framer, piBatchIgnore, NULL);
+    piFramerSetFormat(framer, PI_PROTO_AUTO);
+    piFramerSetCorrection(framer, correct);
+    for (size_t offset = 0; offset < len && framer->format == PI_PROTO_AUTO; offset += PI_BATCH_DETECT_SIZE) {
+        piFramerFeed(framer, data + offset, len - offset < PI_BATCH_DETECT_SIZE ? len - offset : PI_BATCH_DETECT_SIZE);
+    }
+    format = framer->format;
+    free(framer);
+    return format;
+}
+
+/**
+ * @brief Returns the number of worker threads to run.
+ */
+static unsigned piBatchThreads(unsigned threads, size_t chunks) {
+    if (threads == 0) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = online > 0 ? (unsigned)online : 1;
+    }
+    if (threads > PI_BATCH_MAX_THREADS) {
+        threads = PI_BATCH_MAX_THREADS;
+    }
+    if (threads > chunks) {
+        threads = (unsigned)chunks;
+    }
+    return threads != 0 ? threads : 1;
+}
+
+/**
+ * @brief Decodes a buffer of raw link bytes in parallel.
+ *
+ * @param data Raw link bytes.
+ * @param len Number of bytes.
+ * @param config Options.
+ * @param result Receives the outcome.
+ * @return 0 on success, -1 if a thread or memory could not be obtained or the output failed
+ *         (errno is set).
+ */
+int piBatchDecode(const uint8_t *data, size_t len, const PiBatchConfig_t *config, PiBatchResult_t *result) {
+    PiBatch_t batch = { .data = data, .len = len, .format = config->format, .correct = config->correct,
+                        .output = config->output, .result = result };
+    PiBatchWorker_t *workers;
+    unsigned started = 0;
+    int error = 0;
+
+    memset(result, 0, sizeof(*result));
+    piStatsInit(&result->stats, 0, 0);
+    result->bytes = len;
+    if (batch.format == PI_PROTO_AUTO) {
+        batch.format = piBatchDetect(data, len, config->correct);
+    }
+    result->format = batch.format;
+    if (batch.format == PI_PROTO_AUTO) {
+        // Not a single packet: the detection scanned every byte and skipped them
+        PiStats_t none;
+        result->chunks = 1;
+        result->threads = 1;
+        piStatsInit(&none, 0, 0);
+        atomic_store(&none.skippedBytes, len);
+        piStatsMerge(&result->stats, &none);
+        return 0;
+    }
+
+    batch.chunkSize = config->chunkSize != 0 ? config->chunkSize : PI_BATCH_CHUNK_SIZE;
+    if (batch.chunkSize < PI_BATCH_MIN_CHUNK_SIZE) {
+        batch.chunkSize = PI_BATCH_MIN_CHUNK_SIZE;
+    }
+    if (piProtoDescriptors[batch.format].sequenceBits < 16 || batch.chunkSize > len) {
+        batch.chunkSize = len != 0 ? len : 1;
+    }
+    batch.chunks = (len + batch.chunkSize - 1) / batch.chunkSize;
+    if (batch.chunks == 0) {
+        batch.chunks = 1;
+    }
+    result->chunks = batch.chunks;
+    result->threads = piBatchThreads(config->threads, batch.chunks);
+    batch.window = (size_t)result->threads * PI_BATCH_AHEAD;
+
+    batch.slots = calloc(batch.window, sizeof(PiBatchChunk_t));
+    workers = calloc(result->threads, sizeof(PiBatchWorker_t));
+    if (batch.slots == NULL || workers == NULL) {
+        free(batch.slots);
+        free(workers);
+        errno = ENOMEM;
+        return -1;
+    }
+    for (unsigned t = 0; t < result->threads && error == 0; t++) {
+        PiBatchWorker_t *worker = &workers[t];
+        worker->batch = &batch;
+        piFramerInit(&worker->framer, piBatchPacket, worker);
+        piFramerSetFormat(&worker->framer, batch.format);
+        piFramerSetCorrection(&worker->framer, config->correct);
+        if (config->output != NULL) {
+            worker->out = malloc(sizeof(PiOut_t));
+            if (worker->out == NULL || piOutInit(worker->out, PI_OUT_MEMORY, config->output->format) != 0) {
+                free(worker->out);
+                worker->out = NULL;
+                error = ENOMEM;
+            }
+        }
+    }
+
+    pthread_mutex_init(&batch.lock, NULL);
+    pthread_cond_init(&batch.changed, NULL);
+    batch.error = error;
+
+    // The calling thread is worker 0
+    for (unsigned t = 1; t < result->threads && error == 0; t++) {
+        error = pthread_create(&workers[t].thread, NULL, piBatchWork, &workers[t]);
+        if (error != 0) {
+            pthread_mutex_lock(&batch.lock);
+            batch.error = error;
+            pthread_cond_broadcast(&batch.changed);
+            pthread_mutex_unlock(&batch.lock);
+        } else {
+            started++;
+        }
+    }
+    piBatchWork(&workers[0]);
+    for (unsigned t = 1; t <= started; t++) {
+        pthread_join(workers[t].thread, NULL);
+    }
+    error = batch.error;
+
+    for (unsigned t = 0; t < result->threads; t++) {
+        if (workers[t].out != NULL) {
+            piOutClose(workers[t].out);
+            free(workers[t].out);
+        }
+    }
+    for (size_t s = 0; s < batch.window; s++) {
+        free(batch.slots[s].text);
+    }
+    pthread_cond_destroy(&batch.changed);
+    pthread_mutex_destroy(&batch.lock);
+    free(batch.slots);
+    free(workers);
+    if (error != 0) {
+        errno = error;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Maps a file and decodes it in parallel.
+ *
+ * @param path Path of the file.
+ * @param config Options.
+ * @param result Receives the outcome.
+ * @return 0 on success, -1 on error (errno is set, EINVAL for a compressed capture).
+ */
+int piBatchDecodeFile(const char *path, const PiBatchConfig_t *config, PiBatchResult_t *result) {
+    struct stat st;
+    const uint8_t *map = NULL;
+    size_t mapSize, first = 0, len;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    int status, saved;
+
+    if (fd < 0) {
+        return -1;
+    }
+    if (fstat(fd, &st) != 0) {
+        saved = errno;
+        close(fd);
+        errno = saved;
+        return -1;
+    }
+    mapSize = (size_t)st.st_size;
+    if (mapSize != 0) {
+        map = mmap(NULL, mapSize, PROT_READ, MAP_SHARED, fd, 0);
+        if (map == MAP_FAILED) {
+            saved = errno;
+            close(fd);
+            errno = saved;
+            return -1;
+        }
+        madvise((void *)map, mapSize, MADV_SEQUENTIAL);
+    }
+    close(fd);
+
+    len = mapSize;
+    if (mapSize >= sizeof(uint32_t) && *(const uint32_t *)map == PI_PACK_MAGIC) {
+        munmap((void *)map, mapSize);
+        errno = EINVAL;
+        return -1;
+    }
+    if (mapSize >= sizeof(PiCapHeader_t) && *(const uint32_t *)map == PI_CAP_MAGIC) {
+        const PiCapHeader_t *header = (const PiCapHeader_t *)map;
+        first = sizeof(PiCapHeader_t);
+        len = mapSize - first;
+        if (header->records < len / sizeof(PiProt_t)) {
+            len = (size_t)header->records * sizeof(PiProt_t);
+        }
+    }
+    status = piBatchDecode(map != NULL ? map + first : NULL, len, config, result);
+    saved = errno;
+    if (map != NULL) {
+        munmap((void *)map, mapSize);
+    }
+    errno = saved;
+    return status;
+}
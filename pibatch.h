@@ -0,0 +1,93 @@
+/**
+ * @file pibatch.h
+ * @brief Parallel offline decoding of large captures and raw link recordings.
+ *
+ * The input, a binary capture or any file of raw link bytes, is mapped read-only and split
+ * into chunks of a fixed size. Worker threads claim the chunks in order from a shared
+ * counter, so a slow chunk never holds up the others, and decode each one with their own
+ * framer, statistics and memory output.
+ *
+ * A chunk does not start at its first byte but at its first valid packet: the worker of a
+ * chunk scans for the header of the stream format from the chunk boundary and takes the
+ * first candidate that passes validation, and it decodes up to the first valid packet of the
+ * next chunk. Every byte belongs to exactly one chunk, a packet straddling a boundary is
+ * decoded whole by the chunk it starts in, and the packets found are the ones a single
+ * framer finds over the whole stream. Only a rejected candidate cut by the start of the next
+ * chunk is counted in the skipped bytes instead of as a bad CRC.
+ *
+ * Decoded chunks are committed in stream order: their output is written and their
+ * statistics are merged with `piStatsMerge`, so the result only depends on the chunk size,
+ * never on the number of threads or their scheduling. At most `PI_BATCH_AHEAD` chunks per
+ * thread are decoded ahead of the oldest uncommitted one, which bounds the memory held by
+ * outputs waiting for their turn.
+ *
+ * Formats with sequence numbers narrower than 16 bits are extended from the previous packet,
+ * which a chunk does not have, so they are decoded as a single chunk.
+ */
+
+#ifndef pibatch_h_included
+#define pibatch_h_included
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "pi.h"
+#include "piout.h"
+#include "piproto.h"
+#include "pistats.h"
+
+#define PI_BATCH_CHUNK_SIZE     (4 * 1024 * 1024)   // Default bytes per chunk
+#define PI_BATCH_MIN_CHUNK_SIZE (64 * 1024)         // Smallest chunk accepted
+#define PI_BATCH_MAX_THREADS    64                  // Most worker threads
+#define PI_BATCH_AHEAD          4                   // Chunks per thread decoded ahead of the commit
+
+/**
+ * @struct PiBatchConfig_t
+ * @brief Options of a batch decode.
+ */
+typedef struct {
+    PiProtoFormat_t format;     // Format of the stream, `PI_PROTO_AUTO` to detect it
+    int correct;                // Repair packets with a single-bit error
+    unsigned threads;           // Worker threads, 0 for one per online CPU
+    size_t chunkSize;           // Bytes per chunk, 0 for `PI_BATCH_CHUNK_SIZE`
+    PiOut_t *output;            // Receives the packets in stream order, NULL to only validate
+} PiBatchConfig_t;
+
+/**
+ * @struct PiBatchResult_t
+ * @brief Outcome of a batch decode.
+ */
+typedef struct {
+    uint64_t bytes;             // Bytes of packet data decoded
+    uint64_t chunks;            // Chunks the data was split into
+    unsigned threads;           // Worker threads run
+    PiProtoFormat_t format;     // Format decoded, `PI_PROTO_AUTO` if no packet was found
+    PiStats_t stats;            // Statistics of the whole stream, without host times
+} PiBatchResult_t;
+
+/**
+ * @brief Decodes a buffer of raw link bytes in parallel.
+ *
+ * @param data Raw link bytes.
+ * @param len Number of bytes.
+ * @param config Options.
+ * @param result Receives the outcome.
+ * @return 0 on success, -1 if a thread or memory could not be obtained or the output failed
+ *         (errno is set).
+ */
+int piBatchDecode(const uint8_t *data, size_t len, const PiBatchConfig_t *config, PiBatchResult_t *result);
+
+/**
+ * @brief Maps a file and decodes it in parallel.
+ *
+ * The header of a binary capture is skipped, any other file is decoded as raw link bytes.
+ *
+ * @param path Path of the file.
+ * @param config Options.
+ * @param result Receives the outcome.
+ * @return 0 on success, -1 on error (errno is set, EINVAL for a compressed capture, which
+ *         `piPackReplay` decodes).
+ */
+int piBatchDecodeFile(const char *path, const PiBatchConfig_t *config, PiBatchResult_t *result);
+
+#endif	/* #ifdef pibatch_h_included */
@@ -0,0 +1,2033 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <math.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "pi.h"
+#include "pibatch.h"
+#include "picap.h"
+#include "piconv.h"
+#include "pidecim.h"
+#include "pievent.h"
+#include "pigen.h"
+#include "piproto.h"
+#include "picrc.h"
+#include "pihex.h"
+#include "pimux.h"
+#include "piout.h"
+#include "pipack.h"
+#include "pireactor.h"
+#include "piring.h"
+#include "piserial.h"
+#include "pishm.h"
+#include "pistats.h"
+#include "pitime.h"
+
+/**
+ * @brief Returns monotonic time in nanoseconds.
+ */
+static uint64_t benchNow(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief Fills a buffer with deterministic pseudo-random bytes.
+ */
+static void benchFill(uint8_t *buffer, size_t len, uint32_t seed) {
+    for (size_t i = 0; i < len; i++) {
+        seed = seed * 1103515245u + 12345u;
+        buffer[i] = (uint8_t)(seed >> 16);
+    }
+}
+
+/**
+ * @brief Prints one result line.
+ *
+ * @param stage Name of the measured stage.
+ * @param items Number of processed items (packets or calls).
+ * @param bytes Number of processed bytes.
+ * @param ns Elapsed time in nanoseconds.
+ */
+static void benchReport(const char *stage, uint64_t items, uint64_t bytes, uint64_t ns) {
+    double seconds = ns / 1e9;
+    printf("  %-28s %12.0f items/s %8.2f ns/item %10.1f MB/s\n",
+           stage, items / seconds, (double)ns / items, bytes / seconds / 1e6);
+}
+
+/**
+ * @brief Cross-checks every CRC kernel against piCrc32 and measures its throughput.
+ */
+static int benchCrc(void) {
+    static const size_t sizes[] = { 50, 256, 4096, 65535 };
+    enum { BUFFER_SIZE = 65536 };
+    uint8_t *buffer = malloc(BUFFER_SIZE);
+    volatile uint32_t sink = 0;
+    int failed = 0;
+
+    benchFill(buffer, BUFFER_SIZE, 1);
+    printf("CRC32 (selected kernel: %s)\n", piCrc32KernelName(piCrc32SelectedKernel()));
+
+    for (int k = 0; k < PI_CRC_KERNEL_COUNT; k++) {
+        if (!piCrc32KernelSupported((PiCrcKernel_t)k)) {
+            printf("  %-28s not supported\n", piCrc32KernelName((PiCrcKernel_t)k));
+            continue;
+        }
+        for (size_t len = 0; len <= 1024; len++) {
+            size_t offset = len % 7;
+            if (piCrc32Kernel((PiCrcKernel_t)k, buffer + offset, len) != piCrc32(buffer + offset, (unsigned short)len)) {
+                printf("  %s: mismatch at length %zu\n", piCrc32KernelName((PiCrcKernel_t)k), len);
+                failed = 1;
+                break;
+            }
+        }
+        for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+            size_t len = sizes[s];
+            uint64_t calls = (256ull << 20) / len / 4 + 1;
+            char stage[64];
+            uint64_t start = benchNow();
+            for (uint64_t i = 0; i < calls; i++) {
+                sink += piCrc32Kernel((PiCrcKernel_t)k, buffer, len);
+            }
+            snprintf(stage, sizeof(stage), "%s %zu B", piCrc32KernelName((PiCrcKernel_t)k), len);
+            benchReport(stage, calls, calls * len, benchNow() - start);
+        }
+    }
+    (void)sink;
+    free(buffer);
+    return failed;
+}
+
+/**
+ * @brief Builds an array of packets with random payload, every 16th one has a bad CRC.
+ */
+static PiProt_t *benchMakePackets(size_t count) {
+    PiProt_t *packets = malloc(count * sizeof(PiProt_t));
+    benchFill((uint8_t *)packets, count * sizeof(PiProt_t), 2);
+    for (size_t i = 0; i < count; i++) {
+        packets[i].header = PI_HEADER;
+        packets[i].sequence = (uint16_t)i;
+        packets[i].crc32 = piCrc32((const uint8_t *)&packets[i].sequence, sizeof(PiProt_t) - 6);
+        if (i % 16 == 15) {
+            packets[i].crc32 ^= 1;
+        }
+    }
+    return packets;
+}
+
+/**
+ * @brief Compares per-packet validation with the batched interleaved validation.
+ */
+static int benchValidate(void) {
+    enum { COUNT = 1 << 16, ROUNDS = 64 };
+    PiProt_t *packets = benchMakePackets(COUNT);
+    PiProtError_t *results = malloc(COUNT * sizeof(PiProtError_t));
+    volatile size_t sink = 0;
+    int failed = 0;
+    uint64_t start;
+
+    printf("Validation (%d packets x %d rounds)\n", COUNT, ROUNDS);
+    piCheckProtBuffers(packets, sizeof(PiProt_t), COUNT, results);
+    for (size_t i = 0; i < COUNT; i++) {
+        if (results[i] != piCheckProtBuffer(&packets[i])) {
+            printf("  piCheckProtBuffers: mismatch at packet %zu\n", i);
+            failed = 1;
+            break;
+        }
+    }
+
+    start = benchNow();
+    for (int r = 0; r < ROUNDS; r++) {
+        for (size_t i = 0; i < COUNT; i++) {
+            sink += piCheckProtBuffer(&packets[i]) == PI_PROT_OK;
+        }
+    }
+    benchReport("piCheckProtBuffer", (uint64_t)COUNT * ROUNDS, (uint64_t)COUNT * ROUNDS * sizeof(PiProt_t), benchNow() - start);
+
+    start = benchNow();
+    for (int r = 0; r < ROUNDS; r++) {
+        for (size_t i = 0; i < COUNT; i++) {
+            sink += piCheckProtBufferFast(&packets[i]) == PI_PROT_OK;
+        }
+    }
+    benchReport("piCheckProtBufferFast", (uint64_t)COUNT * ROUNDS, (uint64_t)COUNT * ROUNDS * sizeof(PiProt_t), benchNow() - start);
+
+    start = benchNow();
+    for (int r = 0; r < ROUNDS; r++) {
+        sink += piCheckProtBuffers(packets, sizeof(PiProt_t), COUNT, results);
+    }
+    benchReport("piCheckProtBuffers", (uint64_t)COUNT * ROUNDS, (uint64_t)COUNT * ROUNDS * sizeof(PiProt_t), benchNow() - start);
+
+    (void)sink;
+    free(results);
+    free(packets);
+    return failed;
+}
+
+/**
+ * @brief Cross-checks every conversion kernel against the scalar helpers and measures it.
+ */
+static int benchConvert(void) {
+    enum { COUNT = 4096, ROUNDS = 1024 };
+    PiProt_t *packets = benchMakePackets(COUNT);
+    PiSampleBlock_t reference, block;
+    volatile float sink = 0;
+    int failed = 0;
+
+    printf("Conversion to SoA (%d packets x %d rounds)\n", COUNT, ROUNDS);
+    piSampleBlockAlloc(&reference, COUNT);
+    piSampleBlockAlloc(&block, COUNT);
+    piConvertPacketsKernel(PI_CONV_KERNEL_SCALAR, packets, sizeof(PiProt_t), COUNT, &reference);
+
+    for (int k = 0; k < PI_CONV_KERNEL_COUNT; k++) {
+        if (!piConvertKernelSupported((PiConvKernel_t)k)) {
+            printf("  %-28s not supported\n", piConvertKernelName((PiConvKernel_t)k));
+            continue;
+        }
+        // Odd offset and count exercise the unaligned head and the scalar tail
+        block.count = 0;
+        piConvertPacketsKernel((PiConvKernel_t)k, packets + 1, sizeof(PiProt_t), COUNT - 3, &block);
+        for (int c = 0; c < 3; c++) {
+            failed |= memcmp(block.accl[c], reference.accl[c] + 1, (COUNT - 3) * sizeof(float)) != 0;
+            failed |= memcmp(block.gyro[c], reference.gyro[c] + 1, (COUNT - 3) * sizeof(float)) != 0;
+            failed |= memcmp(block.magn[c], reference.magn[c] + 1, (COUNT - 3) * sizeof(float)) != 0;
+        }
+        failed |= memcmp(block.pressure, reference.pressure + 1, (COUNT - 3) * sizeof(float)) != 0;
+        failed |= memcmp(block.flags, reference.flags + 1, (COUNT - 3) * sizeof(uint16_t)) != 0;
+        failed |= memcmp(block.fault, reference.fault + 1, (COUNT - 3) * sizeof(uint16_t)) != 0;
+        failed |= memcmp(block.sequence, reference.sequence + 1, (COUNT - 3) * sizeof(uint16_t)) != 0;
+        if (failed) {
+            printf("  %s: mismatch with the scalar helpers\n", piConvertKernelName((PiConvKernel_t)k));
+            break;
+        }
+
+        uint64_t start = benchNow();
+        for (int r = 0; r < ROUNDS; r++) {
+            block.count = 0;
+            piConvertPacketsKernel((PiConvKernel_t)k, packets, sizeof(PiProt_t), COUNT, &block);
+            sink += block.pressure[r % COUNT];
+        }
+        benchReport(piConvertKernelName((PiConvKernel_t)k), (uint64_t)COUNT * ROUNDS, (uint64_t)COUNT * ROUNDS * sizeof(PiProt_t), benchNow() - start);
+    }
+    (void)sink;
+    piSampleBlockFree(&block);
+    piSampleBlockFree(&reference);
+    free(packets);
+    return failed;
+}
+
+/**
+ * @brief Lines reported by the streaming hex reader.
+ */
+typedef struct {
+    PiHexError_t errors[4];     // Result of the first lines
+    size_t lens[4];             // Decoded bytes of the first lines
+    uint64_t lines;             // Lines reported
+} BenchHexLines_t;
+
+static void benchHexLine(void *context, uint64_t line, PiHexError_t error, const uint8_t *bytes, size_t len) {
+    BenchHexLines_t *lines = context;
+    (void)bytes;
+    if (line == lines->lines + 1 && line <= 4) {
+        lines->errors[line - 1] = error;
+        lines->lens[line - 1] = len;
+    }
+    lines->lines++;
+}
+
+/**
+ * @brief Checks the errors of the hex decoder: a bad character in the SSE2 part and in the
+ * scalar tail with its position, an odd length, a short destination, and a line of the
+ * streaming reader longer than its limit.
+ *
+ * @param text Line of the first packet, `2 * sizeof(PiProt_t)` digits.
+ * @param packets The packet it encodes.
+ * @return 0 if every error is reported as expected.
+ */
+static int benchHexErrors(const char *text, const PiProt_t *packets) {
+    enum { DIGITS = 2 * sizeof(PiProt_t), LONG = 2 * 4096 + 2 };
+    static const size_t badPositions[] = { 5, 37, DIGITS - 1 };
+    char line[DIGITS];
+    uint8_t bytes[sizeof(PiProt_t)];
+    size_t len, errorPos;
+    PiHexStats_t stats = { 0, 0, 0 };
+    BenchHexLines_t lines = { { PI_HEX_OK }, { 0 }, 0 };
+    char *stream = malloc(LONG + 2 * DIGITS + 3);
+    int pipeFds[2];
+    int failed = 0;
+
+    for (size_t b = 0; b < sizeof(badPositions) / sizeof(badPositions[0]); b++) {
+        size_t pos = badPositions[b];
+        memcpy(line, text, DIGITS);
+        line[pos] = 'g';
+        errorPos = 0;
+        if (piHexDecode(line, DIGITS, bytes, sizeof(bytes), &len, &errorPos) != PI_HEX_BAD_CHAR ||
+            errorPos != pos || len != pos / 2 || memcmp(bytes, packets, len) != 0) {
+            printf("  piHexDecode: bad character at %zu reported at %zu\n", pos, errorPos);
+            failed = 1;
+        }
+    }
+    if (piHexDecode(text, DIGITS - 1, bytes, sizeof(bytes), &len, &errorPos) != PI_HEX_ODD_LENGTH ||
+        len != sizeof(PiProt_t) - 1 || errorPos != DIGITS - 2 || memcmp(bytes, packets, len) != 0) {
+        printf("  piHexDecode: odd length not reported\n");
+        failed = 1;
+    }
+    if (piHexDecode(text, DIGITS, bytes, 40, &len, &errorPos) != PI_HEX_OVERFLOW || len != 40 || errorPos != 80 ||
+        memcmp(bytes, packets, len) != 0) {
+        printf("  piHexDecode: short destination not reported\n");
+        failed = 1;
+    }
+
+    // A good line, a line decoding to more than 4096 bytes, and another good line
+    if (stream == NULL || pipe(pipeFds) != 0) {
+        free(stream);
+        perror("piHexReadStream");
+        return 1;
+    }
+    memcpy(stream, text, DIGITS);
+    stream[DIGITS] = '\n';
+    memset(stream + DIGITS + 1, '0', LONG);
+    stream[DIGITS + 1 + LONG] = '\n';
+    memcpy(stream + DIGITS + 2 + LONG, text, DIGITS);
+    stream[LONG + 2 * DIGITS + 2] = '\n';
+    failed |= write(pipeFds[1], stream, LONG + 2 * DIGITS + 3) != LONG + 2 * DIGITS + 3;
+    close(pipeFds[1]);
+    failed |= piHexReadStream(pipeFds[0], benchHexLine, &lines, &stats) != 0;
+    close(pipeFds[0]);
+    if (lines.lines != 3 || lines.errors[0] != PI_HEX_OK || lines.errors[1] != PI_HEX_OVERFLOW ||
+        lines.errors[2] != PI_HEX_OK || lines.lens[2] != sizeof(PiProt_t) || stats.lines != 2 || stats.badLines != 1) {
+        printf("  piHexReadStream: long line not rejected\n");
+        failed = 1;
+    }
+    free(stream);
+    if (!failed) {
+        printf("  bad characters, odd length, short destination and long lines reported\n");
+    }
+    return failed;
+}
+
+/**
+ * @brief Compares the per-byte strtol decoding used by pistart with piHexDecode.
+ */
+static int benchHex(void) {
+    enum { COUNT = 1 << 14, ROUNDS = 16, LINE = 2 * sizeof(PiProt_t) + 1 };
+    static const char digits[] = "0123456789abcdefABCDEF";
+    PiProt_t *packets = benchMakePackets(COUNT);
+    char *text = malloc((size_t)COUNT * LINE);
+    uint8_t bytes[sizeof(PiProt_t)];
+    volatile uint8_t sink = 0;
+    int failed = 0;
+    uint64_t start;
+
+    printf("Hex decoding (%d packets x %d rounds)\n", COUNT, ROUNDS);
+    for (size_t i = 0; i < COUNT; i++) {
+        const uint8_t *packet = (const uint8_t *)&packets[i];
+        char *line = text + i * LINE;
+        for (size_t j = 0; j < sizeof(PiProt_t); j++) {
+            // Mix upper and lower case digits
+            line[2 * j] = digits[(packet[j] >> 4) + ((packet[j] >> 4) >= 10 && (i + j) % 2 ? 6 : 0)];
+            line[2 * j + 1] = digits[(packet[j] & 15) + ((packet[j] & 15) >= 10 && (i + j) % 3 ? 6 : 0)];
+        }
+        line[LINE - 1] = '\0';
+    }
+
+    for (size_t i = 0; i < COUNT && !failed; i++) {
+        size_t len;
+        failed = piHexDecode(text + i * LINE, LINE - 1, bytes, sizeof(bytes), &len, NULL) != PI_HEX_OK ||
+                 len != sizeof(PiProt_t) || memcmp(bytes, &packets[i], sizeof(PiProt_t)) != 0;
+    }
+    if (failed) {
+        printf("  piHexDecode: mismatch\n");
+    } else if (benchHexErrors(text, packets) != 0) {
+        failed = 1;
+    }
+
+    start = benchNow();
+    for (int r = 0; r < ROUNDS; r++) {
+        for (size_t i = 0; i < COUNT; i++) {
+            const char *line = text + i * LINE;
+            for (size_t j = 0; j < sizeof(PiProt_t); j++) {
+                char byteStr[3] = { line[j * 2], line[j * 2 + 1], '\0' };
+                bytes[j] = (uint8_t)strtol(byteStr, NULL, 16);
+            }
+            sink += bytes[r % sizeof(PiProt_t)];
+        }
+    }
+    benchReport("strtol per byte", (uint64_t)COUNT * ROUNDS, (uint64_t)COUNT * ROUNDS * (LINE - 1), benchNow() - start);
+
+    start = benchNow();
+    for (int r = 0; r < ROUNDS; r++) {
+        for (size_t i = 0; i < COUNT; i++) {
+            size_t len;
+            piHexDecode(text + i * LINE, LINE - 1, bytes, sizeof(bytes), &len, NULL);
+            sink += bytes[r % sizeof(PiProt_t)];
+        }
+    }
+    benchReport("piHexDecode", (uint64_t)COUNT * ROUNDS, (uint64_t)COUNT * ROUNDS * (LINE - 1), benchNow() - start);
+
+    (void)sink;
+    free(text);
+    free(packets);
+    return failed;
+}
+
+#define BENCH_MUX_FIELD(name) { offsetof(PiMux_t, name), sizeof(((PiMux_t *)0)->name) }
+
+/**
+ * @brief Location of every `PiMuxField_t` in the frame, to find the fields a cycle changed.
+ */
+static const struct {
+    uint8_t offset;
+    uint8_t size;
+} benchMuxFields[PI_MUX_FIELD_COUNT] = {
+    [PI_MUX_UPTIME] = BENCH_MUX_FIELD(uptime),
+    [PI_MUX_GIT_SHORT] = BENCH_MUX_FIELD(gitShort),
+    [PI_MUX_BUILD_DATE] = BENCH_MUX_FIELD(buildDate),
+    [PI_MUX_MANUFACTURED_DATE] = BENCH_MUX_FIELD(manufacturedDate),
+    [PI_MUX_VERSION] = BENCH_MUX_FIELD(version),
+    [PI_MUX_HUMAN_SERIAL] = BENCH_MUX_FIELD(humanSerial),
+    [PI_MUX_HW_SERIAL] = BENCH_MUX_FIELD(hwSerial),
+    [PI_MUX_T_INTERNAL] = BENCH_MUX_FIELD(tInternal),
+    [PI_MUX_T_EXTERNAL] = BENCH_MUX_FIELD(tExternal),
+    [PI_MUX_VOLTAGE] = BENCH_MUX_FIELD(voltage),
+    [PI_MUX_CURRENT] = BENCH_MUX_FIELD(current),
+    [PI_MUX_TRIGGERED] = BENCH_MUX_FIELD(triggered),
+    [PI_MUX_PACKET_RATE] = BENCH_MUX_FIELD(packetRate),
+};
+
+/**
+ * @brief Fields reported by the change callback since the last check.
+ */
+typedef struct {
+    uint32_t fired;             // Fields reported
+    uint64_t calls;             // Callbacks fired
+    int repeated;               // A field was reported twice for one cycle
+} BenchMuxChanges_t;
+
+static void benchMuxChanged(void *context, PiMuxField_t field, const PiMux_t *snapshot) {
+    BenchMuxChanges_t *changes = context;
+    (void)snapshot;
+    changes->repeated |= (changes->fired >> field) & 1;
+    changes->fired |= 1u << field;
+    changes->calls++;
+}
+
+/**
+ * @brief Checks the mux reassembler on a generated stream with sequence gaps and measures it.
+ *
+ * Every published snapshot must equal the frame the generator sends, the cycles and the
+ * incomplete ones must match the slots actually sent, and the callbacks must report exactly
+ * the fields that differ from the previous snapshot, once each. The voltage, current and
+ * triggered faults are changed between cycles every 64 cycles so that more than the uptime
+ * and temperature move.
+ */
+static int benchMux(void) {
+    enum { COUNT = 1 << 20, ROUNDS = 16 };
+    PiGenConfig_t config = { .packetRate = 1000, .seed = 11, .hwSerial = 4242, .gapRate = 0.002, .maxGap = 3 };
+    uint16_t *sequences = malloc(COUNT * sizeof(uint16_t));
+    uint32_t *words = malloc(COUNT * sizeof(uint32_t));
+    BenchMuxChanges_t changes = { 0, 0, 0 };
+    PiMuxAssembler_t mux;
+    PiMux_t previous;
+    PiGen_t gen;
+    uint64_t cycle = 0, seen = 0, expectedCycles = 0, expectedIncomplete = 0, start;
+    uint8_t bytes[sizeof(PiProt_t)];
+    int failed = 0;
+
+    printf("Mux reassembly (%d packets x %d rounds)\n", COUNT, ROUNDS);
+    piGenInit(&gen, &config);
+    piMuxInit(&mux, benchMuxChanged, &changes);
+    memset(&previous, 0, sizeof(previous));
+    for (size_t i = 0; i < COUNT && !failed; i++) {
+        if (gen.sequence % PI_MUXFACTOR == 0 && gen.sample / PI_MUXFACTOR % 64 == 63) {
+            gen.mux.voltage += PI_VOLT_SCALE / 10;
+            gen.mux.current += 1;
+            gen.mux.triggered.ui16 ^= 1u << 5;
+        }
+        piGenNext(&gen, bytes);
+        const PiProt_t *packet = (const PiProt_t *)bytes;
+        uint64_t sample = gen.sample - 1;
+
+        // Reference accounting: a cycle is published when all its slots were sent
+        if (sample / PI_MUXFACTOR != cycle) {
+            if (seen == PI_MUXFACTOR) {
+                expectedCycles++;
+            } else if (seen != 0) {
+                expectedIncomplete++;
+            }
+            cycle = sample / PI_MUXFACTOR;
+            seen = 0;
+        }
+        seen++;
+
+        sequences[i] = packet->sequence;
+        words[i] = packet->mux;
+        if (piMuxPush(&mux, packet->sequence, packet->mux)) {
+            uint32_t expected = 0;
+            for (int f = 0; f < PI_MUX_FIELD_COUNT; f++) {
+                if (mux.cycles == 1 || memcmp(gen.mux.ui8 + benchMuxFields[f].offset, previous.ui8 + benchMuxFields[f].offset,
+                                              benchMuxFields[f].size) != 0) {
+                    expected |= 1u << f;
+                }
+            }
+            failed |= memcmp(piMuxSnapshot(&mux), &gen.mux, sizeof(PiMux_t)) != 0;
+            failed |= changes.fired != expected || changes.repeated;
+            previous = gen.mux;
+        } else {
+            failed |= changes.fired != 0;
+        }
+        changes.fired = 0;
+        changes.repeated = 0;
+    }
+    if (seen == PI_MUXFACTOR) {
+        expectedCycles++;
+    }
+    printf("  %llu cycles, %llu incomplete, %llu gaps, %llu callbacks\n", (unsigned long long)mux.cycles,
+           (unsigned long long)mux.incomplete, (unsigned long long)gen.gaps, (unsigned long long)changes.calls);
+    failed |= mux.cycles != expectedCycles || mux.incomplete != expectedIncomplete || gen.gaps == 0 || mux.incomplete == 0;
+    if (failed) {
+        printf("  mux: mismatch with the generated frames (expected %llu cycles, %llu incomplete)\n",
+               (unsigned long long)expectedCycles, (unsigned long long)expectedIncomplete);
+    }
+
+    start = benchNow();
+    for (int r = 0; r < ROUNDS; r++) {
+        piMuxInit(&mux, NULL, NULL);
+        for (size_t i = 0; i < COUNT; i++) {
+            piMuxPush(&mux, sequences[i], words[i]);
+        }
+        failed |= mux.cycles != expectedCycles;
+    }
+    benchReport("piMuxPush", (uint64_t)COUNT * ROUNDS, (uint64_t)COUNT * ROUNDS * sizeof(uint32_t), benchNow() - start);
+
+    free(words);
+    free(sequences);
+    return failed;
+}
+
+/**
+ * @brief State of one simulated device of the reactor benchmark.
+ */
+typedef struct {
+    PiPtyReplay_t replay;
+    PiRing_t ring;
+    int fd;
+    PiGen_t gen;
+    pthread_t consumer;
+    atomic_int stop;
+    uint64_t consumed;
+    uint64_t gaps;
+} BenchDevice_t;
+
+/**
+ * @brief Pty source producing generated packets with consecutive sequence numbers.
+ */
+static size_t benchDeviceSource(void *context, PiProt_t *packet) {
+    BenchDevice_t *device = context;
+    piGenPacket(&device->gen, packet);
+    return sizeof(PiProt_t);
+}
+
+/**
+ * @brief Consumer thread draining the ring of one device in batches.
+ */
+static void *benchDeviceConsumer(void *arg) {
+    BenchDevice_t *device = arg;
+    PiSample_t batch[256];
+    int expected = -1;
+
+    while (!atomic_load(&device->stop)) {
+        size_t count = piRingPop(&device->ring, batch, 256);
+        for (size_t i = 0; i < count; i++) {
+            if (expected >= 0 && batch[i].packet.sequence != (uint16_t)expected) {
+                device->gaps++;
+            }
+            expected = (uint16_t)(batch[i].packet.sequence + 1);
+        }
+        device->consumed += count;
+        if (count < 256) {
+            struct timespec pause = { 0, 1000000 };
+            nanosleep(&pause, NULL);
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Reactor thread, reports its CPU time on exit.
+ */
+typedef struct {
+    PiReactor_t reactor;
+    pthread_t thread;
+    uint64_t cpuNs;
+} BenchReactor_t;
+
+static void *benchReactorThread(void *arg) {
+    BenchReactor_t *bench = arg;
+    struct timespec ts;
+    piReactorRun(&bench->reactor);
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    bench->cpuNs = (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+    return NULL;
+}
+
+/**
+ * @brief Runs simulated 1000 Hz pty devices through a pool of reactors for one second.
+ */
+static int benchReactorRun(unsigned deviceCount, unsigned reactorCount) {
+    BenchDevice_t *devices = calloc(deviceCount, sizeof(BenchDevice_t));
+    BenchReactor_t *reactors = calloc(reactorCount, sizeof(BenchReactor_t));
+    uint64_t sent = 0, consumed = 0, gaps = 0, dropped = 0, cpuNs = 0, jitterNs = 0, start;
+    int failed = 0;
+
+    for (unsigned r = 0; r < reactorCount; r++) {
+        failed |= piReactorInit(&reactors[r].reactor) != 0;
+    }
+    for (unsigned d = 0; d < deviceCount && !failed; d++) {
+        BenchDevice_t *device = &devices[d];
+        PiGenConfig_t config = { .packetRate = 1000, .seed = d + 1, .hwSerial = 1000 + d };
+        piGenInit(&device->gen, &config);
+        failed |= piRingInit(&device->ring, 1024, PI_RING_DROP_OLDEST) != 0;
+        failed |= piPtyReplayStart(&device->replay, 1000, benchDeviceSource, device) != 0;
+        if (failed) {
+            break;
+        }
+        device->fd = open(device->replay.slaveName, O_RDWR | O_NOCTTY);
+        failed |= device->fd < 0 || piSerialConfigure(device->fd, 1000, 0) != 0;
+        failed |= piReactorAdd(&reactors[d % reactorCount].reactor, device->fd, &device->ring, 1000) < 0;
+        pthread_create(&device->consumer, NULL, benchDeviceConsumer, device);
+    }
+    if (failed) {
+        printf("  pty setup failed\n");
+        return 1;
+    }
+
+    start = benchNow();
+    for (unsigned r = 0; r < reactorCount; r++) {
+        pthread_create(&reactors[r].thread, NULL, benchReactorThread, &reactors[r]);
+    }
+    struct timespec second = { 1, 0 };
+    nanosleep(&second, NULL);
+    for (unsigned d = 0; d < deviceCount; d++) {
+        piPtyReplayStop(&devices[d].replay);
+    }
+    for (unsigned r = 0; r < reactorCount; r++) {
+        piReactorStop(&reactors[r].reactor);
+        pthread_join(reactors[r].thread, NULL);
+        piReactorClose(&reactors[r].reactor);
+        cpuNs += reactors[r].cpuNs;
+    }
+    uint64_t elapsed = benchNow() - start;
+    for (unsigned d = 0; d < deviceCount; d++) {
+        BenchDevice_t *device = &devices[d];
+        PiStatsSnapshot_t snapshot;
+        piStatsSnapshot(&reactors[d % reactorCount].reactor.devices[d / reactorCount].stats, &snapshot);
+        uint64_t p99 = piStatsPercentile(&snapshot.jitterNs, 99);
+        jitterNs = p99 > jitterNs ? p99 : jitterNs;
+        atomic_store(&device->stop, 1);
+        pthread_join(device->consumer, NULL);
+        close(device->fd);
+        sent += atomic_load(&device->replay.sent);
+        consumed += device->consumed;
+        gaps += device->gaps;
+        dropped += atomic_load(&device->ring.droppedOldest) + atomic_load(&device->ring.droppedNewest);
+        piRingFree(&device->ring);
+    }
+
+    printf("  %2u devices %u reactor(s): sent %7llu received %7llu gaps %llu dropped %llu, reactor CPU %5.2f%% %7.0f ns/packet, "
+           "jitter p99 < %llu us\n", deviceCount, reactorCount, (unsigned long long)sent, (unsigned long long)consumed,
+           (unsigned long long)gaps, (unsigned long long)dropped,
+           100.0 * cpuNs / elapsed, consumed ? (double)cpuNs / consumed : 0.0, (unsigned long long)(jitterNs + 1) / 1000);
+    free(reactors);
+    free(devices);
+    return 0;
+}
+
+/**
+ * @brief Measures how the reactor scales with the number of devices and reactors.
+ */
+static int benchReactor(void) {
+    static const unsigned configs[][2] = { { 1, 1 }, { 2, 1 }, { 4, 1 }, { 8, 1 }, { 16, 1 }, { 16, 2 }, { 16, 4 } };
+    int failed = 0;
+
+    printf("Reactor with 1000 Hz pty devices (%ld CPUs)\n", sysconf(_SC_NPROCESSORS_ONLN));
+    for (size_t i = 0; i < sizeof(configs) / sizeof(configs[0]) && !failed; i++) {
+        failed |= benchReactorRun(configs[i][0], configs[i][1]);
+    }
+    return failed;
+}
+
+static void benchCountPacket(void *context, const PiProt_t *packet) {
+    (void)packet;
+    (*(uint64_t *)context)++;
+}
+
+/**
+ * @brief Measures writing, seeking and unpaced replay of a binary capture.
+ */
+static int benchCapture(void) {
+    enum { COUNT = 1 << 21, SEEKS = 1 << 16 };
+    static const char path[] = "/tmp/pibench.cap";
+    PiProt_t *packets = benchMakePackets(COUNT);
+    PiCapWriter_t writer;
+    PiCapReader_t reader;
+    PiFramer_t framer;
+    uint64_t delivered = 0, start, checksum = 0;
+    int failed = 0;
+
+    printf("Binary capture (%d packets, %s)\n", COUNT, path);
+    if (piCapCreate(&writer, path, 0, 1000) != 0) {
+        perror(path);
+        free(packets);
+        return 1;
+    }
+    start = benchNow();
+    for (size_t i = 0; i < COUNT && !failed; i++) {
+        failed = piCapAppend(&writer, &packets[i], writer.header->startHostNs + i * 1000000ull) != 0;
+    }
+    failed |= piCapFinish(&writer) != 0;
+    benchReport("piCapAppend", COUNT, (uint64_t)COUNT * sizeof(PiProt_t), benchNow() - start);
+
+    if (failed || piCapOpen(&reader, path) != 0) {
+        perror(path);
+        free(packets);
+        return 1;
+    }
+    failed = reader.count != COUNT || reader.indexMap == NULL ||
+             memcmp(piCapRecord(&reader, 0), packets, (size_t)COUNT * sizeof(PiProt_t)) != 0;
+
+    start = benchNow();
+    for (size_t i = 0; i < SEEKS; i++) {
+        uint64_t sample = (i * 2654435761u) % COUNT;
+        uint64_t record = piCapSeekTime(&reader, reader.header->startHostNs + sample * 1000000ull);
+        failed |= record != sample;
+        checksum += record;
+    }
+    benchReport("piCapSeekTime", SEEKS, 0, benchNow() - start);
+    if (failed) {
+        printf("  capture: mismatch\n");
+    }
+
+    piFramerInit(&framer, benchCountPacket, &delivered);
+    start = benchNow();
+    piCapReplay(&reader, 0, reader.count, 0, &framer);
+    uint64_t elapsed = benchNow() - start;
+    benchReport("piCapReplay (framer)", COUNT, (uint64_t)COUNT * sizeof(PiProt_t), elapsed);
+    printf("  replay at %.0fx real time for 1000 Hz, %llu valid packets\n",
+           (double)COUNT * 1e6 / elapsed, (unsigned long long)delivered);
+    failed |= delivered != COUNT - COUNT / 16;
+
+    (void)checksum;
+    piCapClose(&reader);
+    remove(path);
+    remove("/tmp/pibench.cap.idx");
+    free(packets);
+    return failed;
+}
+
+/**
+ * @brief Packet callback of the sequential reference of `benchBatch`.
+ */
+static void benchBatchPacket(void *context, const PiProt_t *packet) {
+    void **sinks = context;
+    const PiFramer_t *framer = sinks[2];
+    piStatsPacket(sinks[0], packet, 0);
+    piOutPacket(sinks[1], packet, framer->lastResult);
+}
+
+/**
+ * @brief Returns the number of CSV rows with the given validation result.
+ */
+static uint64_t benchCsvResults(const char *text, size_t len, PiProtError_t result) {
+    char field[8];
+    int fieldLen = snprintf(field, sizeof(field), ",%u,", (unsigned)result);
+    uint64_t rows = 0;
+
+    for (const char *line = text, *end = text + len; line < end;) {
+        const char *next = memchr(line, '\n', (size_t)(end - line));
+        const char *comma = memchr(line, ',', (size_t)((next != NULL ? next : end) - line));
+        rows += comma != NULL && (size_t)(end - comma) >= (size_t)fieldLen && memcmp(comma, field, (size_t)fieldLen) == 0;
+        line = next != NULL ? next + 1 : end;
+    }
+    return rows;
+}
+
+/**
+ * @brief Decodes a faulty raw stream with one framer, then in parallel chunks with several
+ * thread counts, and checks that the CSV output and the statistics do not change.
+ */
+static int benchBatch(void) {
+    enum { COUNT = 1 << 19, CHUNK = 64 * 1024 };
+    static const unsigned threadCounts[] = { 1, 2, 4, 8 };
+    PiGenConfig_t config = { .packetRate = 1000, .seed = 21, .hwSerial = 123456, .bitFlipRate = 0.001,
+                             .dropByteRate = 0.001, .truncateRate = 0.001, .badHeaderRate = 0.001,
+                             .gapRate = 0.001, .maxGap = 8 };
+    uint8_t *stream = malloc((size_t)COUNT * sizeof(PiProt_t));
+    PiOut_t *out = malloc(sizeof(PiOut_t));
+    PiFramer_t *framer = malloc(sizeof(PiFramer_t));
+    PiStats_t *stats = malloc(sizeof(PiStats_t));
+    PiStatsSnapshot_t reference, snapshot;
+    PiBatchResult_t *result = malloc(sizeof(PiBatchResult_t));
+    char *expected = NULL, *text;
+    size_t len = 0, expectedLen = 0, textLen;
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    void *sinks[3] = { stats, out, framer };
+    uint64_t start;
+    PiGen_t gen;
+    int failed = 0;
+
+    if (stream == NULL || out == NULL || framer == NULL || stats == NULL || result == NULL ||
+        piOutInit(out, PI_OUT_MEMORY, PI_OUT_CSV) != 0) {
+        printf("  batch: out of memory\n");
+        free(stream);
+        free(out);
+        free(framer);
+        free(stats);
+        free(result);
+        return 1;
+    }
+    piGenInit(&gen, &config);
+    for (size_t i = 0; i < COUNT; i++) {
+        len += piGenNext(&gen, stream + len);
+    }
+    printf("Parallel batch decode (%d faulty packets, %zu bytes, %ld online CPUs)\n", COUNT, len, online);
+
+    // Sequential reference: one framer over the whole stream
+    piStatsInit(stats, 0, 0);
+    piFramerInit(framer, benchBatchPacket, sinks);
+    piFramerSetCorrection(framer, 1);
+    start = benchNow();
+    piFramerFeed(framer, stream, len);
+    piFramerFinish(framer);
+    piStatsFramer(stats, framer);
+    expected = piOutTake(out, &expectedLen);
+    benchReport("framer + csv, sequential", framer->packets, len, benchNow() - start);
+    piStatsSnapshot(stats, &reference);
+    if (benchCsvResults(expected, expectedLen, PI_PROT_CORRECTED) != framer->corrected) {
+        printf("  batch: repaired packets not reported as corrected\n");
+        failed = 1;
+    }
+
+    for (size_t pass = 0; pass < 2 * sizeof(threadCounts) / sizeof(threadCounts[0]) && !failed; pass++) {
+        int format = pass % 2;
+        PiBatchConfig_t batch = { .format = PI_PROTO_MAIN, .correct = 1, .chunkSize = CHUNK,
+                                  .threads = threadCounts[pass / 2], .output = format ? out : NULL };
+        char stage[32];
+
+        start = benchNow();
+        if (piBatchDecode(stream, len, &batch, result) != 0) {
+            perror("piBatchDecode");
+            failed = 1;
+            break;
+        }
+        uint64_t elapsed = benchNow() - start;
+        snprintf(stage, sizeof(stage), "batch %s, %u threads", format ? "+ csv" : "validate", result->threads);
+        benchReport(stage, atomic_load(&result->stats.packets), len, elapsed);
+
+        text = piOutTake(out, &textLen);
+        piStatsSnapshot(&result->stats, &snapshot);
+        failed |= snapshot.packets != reference.packets || snapshot.lost != reference.lost ||
+                  snapshot.gaps != reference.gaps || snapshot.duplicates != reference.duplicates ||
+                  snapshot.reordered != reference.reordered || snapshot.corrected != reference.corrected ||
+                  snapshot.skippedBytes != reference.skippedBytes || snapshot.badCrc > reference.badCrc ||
+                  snapshot.badCrc + result->chunks < reference.badCrc;
+        if (format) {
+            failed |= textLen != expectedLen || memcmp(text, expected, expectedLen) != 0;
+        }
+        if (failed) {
+            printf("  batch: %u threads differ, %llu packets, %llu bad CRC, %llu skipped, %zu bytes of csv\n",
+                   result->threads, (unsigned long long)snapshot.packets, (unsigned long long)snapshot.badCrc,
+                   (unsigned long long)snapshot.skippedBytes, textLen);
+        }
+        free(text);
+    }
+    printf("  %llu packets in %llu chunks, %llu corrected, %llu bad CRC (%llu sequential), same output for every thread count\n",
+           (unsigned long long)reference.packets, (unsigned long long)result->chunks,
+           (unsigned long long)reference.corrected, (unsigned long long)snapshot.badCrc,
+           (unsigned long long)reference.badCrc);
+
+    free(expected);
+    piOutClose(out);
+    free(out);
+    free(framer);
+    free(stats);
+    free(result);
+    free(stream);
+    return failed;
+}
+
+/**
+ * @brief Returns the number of events the status words of a stream produce, record `skip` left out.
+ */
+static size_t benchEventCount(const uint32_t *status, size_t count, size_t skip) {
+    size_t events = 0;
+    uint32_t previous = 0;
+    int started = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        if (i == skip) {
+            continue;
+        }
+        uint32_t changed = started ? status[i] ^ previous : (status[i] & ~PI_EVENT_STATE_MASK) | PI_EVENT_STATE_MASK;
+        events += (changed & PI_EVENT_STATE_MASK) != 0;
+        events += (size_t)__builtin_popcount(changed & ~PI_EVENT_STATE_MASK);
+        previous = status[i];
+        started = 1;
+    }
+    return events;
+}
+
+/**
+ * @brief Cross-checks every event scanner kernel, the scan in pieces and the sidecar file.
+ *
+ * The packets hold runs of state, overrange and fault bits of random lengths, and one
+ * record with a changed status word and a stale CRC that validation must leave out.
+ */
+static int benchEvent(void) {
+    enum { COUNT = 1 << 20, ROUNDS = 8, CORRUPT = COUNT / 2 + 3 };
+    static const char path[] = "/tmp/pibench-event.cap";
+    static const uint8_t bits[] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26 };
+    PiProt_t *packets = benchMakePackets(COUNT);
+    uint32_t *status = malloc(COUNT * sizeof(uint32_t));
+    PiEventScanner_t reference, scanner;
+    uint32_t current = 2, seed = 7;
+    size_t next = 5000;
+    int failed = 0;
+
+    printf("Event scanner (%d packets x %d rounds)\n", COUNT, ROUNDS);
+    for (size_t i = 0; i < COUNT; i++) {
+        if (i == next) {
+            seed = seed * 1103515245u + 12345u;
+            unsigned pick = (seed >> 16) % (sizeof(bits) + 1);
+            if (pick == sizeof(bits)) {
+                current = (current & ~PI_EVENT_STATE_MASK) | ((seed >> 8) & 3);
+            } else {
+                current ^= 1u << bits[pick];
+            }
+            next += 1 + (seed >> 4) % 4096;
+        }
+        status[i] = current;
+        packets[i].data.flags.ui16 = (uint16_t)current;
+        packets[i].data.fault.ui16 = (uint16_t)(current >> PI_EVENT_FAULT_SHIFT);
+        packets[i].crc32 = piCrc32((const uint8_t *)&packets[i].sequence, sizeof(PiProt_t) - 6);
+    }
+    // A flipped bit in the status word of a record in the middle of a run
+    status[CORRUPT] = status[CORRUPT - 1] = status[CORRUPT + 1] = status[CORRUPT - 2];
+    for (size_t i = CORRUPT - 1; i <= CORRUPT + 1; i++) {
+        packets[i].data.flags.ui16 = (uint16_t)status[i];
+        packets[i].data.fault.ui16 = (uint16_t)(status[i] >> PI_EVENT_FAULT_SHIFT);
+        packets[i].crc32 = piCrc32((const uint8_t *)&packets[i].sequence, sizeof(PiProt_t) - 6);
+    }
+    packets[CORRUPT].data.flags.ui16 ^= 1u << 9;
+
+    piEventInit(&reference, 1);
+    failed |= piEventScanKernel(PI_CONV_KERNEL_SCALAR, &reference, packets, sizeof(PiProt_t), COUNT) != 0;
+    failed |= reference.count != benchEventCount(status, COUNT, CORRUPT) || reference.rejected != 1 ||
+              reference.records != COUNT;
+    for (size_t i = 0; i < reference.count && !failed; i++) {
+        const PiEvent_t *event = &reference.events[i];
+        failed |= event->record == CORRUPT || event->sequence != packets[event->record].sequence ||
+                  (event->kind == PI_EVENT_RISE) != (event->kind != PI_EVENT_STATE && (status[event->record] >> event->value & 1));
+    }
+    printf("  %zu events, %llu rejected record\n", reference.count, (unsigned long long)reference.rejected);
+    if (failed) {
+        printf("  scalar: mismatch with the status words\n");
+    }
+
+    for (int k = 0; k < PI_CONV_KERNEL_COUNT && !failed; k++) {
+        if (!piConvertKernelSupported((PiConvKernel_t)k)) {
+            printf("  %-28s not supported\n", piConvertKernelName((PiConvKernel_t)k));
+            continue;
+        }
+        // Pieces of odd sizes exercise the scalar tails and the continuation of the scan
+        piEventInit(&scanner, 1);
+        for (size_t i = 0; i < COUNT; i += 4093) {
+            size_t n = COUNT - i < 4093 ? COUNT - i : 4093;
+            failed |= piEventScanKernel((PiConvKernel_t)k, &scanner, packets + i, sizeof(PiProt_t), n) != 0;
+        }
+        failed |= scanner.count != reference.count || scanner.rejected != reference.rejected ||
+                  memcmp(scanner.events, reference.events, reference.count * sizeof(PiEvent_t)) != 0;
+        piEventFree(&scanner);
+        if (failed) {
+            printf("  %s: mismatch with the scalar kernel\n", piConvertKernelName((PiConvKernel_t)k));
+            break;
+        }
+
+        uint64_t start = benchNow();
+        for (int r = 0; r < ROUNDS; r++) {
+            piEventInit(&scanner, 1);
+            piEventScanKernel((PiConvKernel_t)k, &scanner, packets, sizeof(PiProt_t), COUNT);
+            failed |= scanner.count != reference.count;
+            piEventFree(&scanner);
+        }
+        benchReport(piConvertKernelName((PiConvKernel_t)k), (uint64_t)COUNT * ROUNDS, (uint64_t)COUNT * ROUNDS * sizeof(PiProt_t), benchNow() - start);
+    }
+
+    // Sidecar of the first half, then the second half scanned after loading it
+    piEventInit(&scanner, 1);
+    failed |= piEventScan(&scanner, packets, sizeof(PiProt_t), COUNT / 2) != 0;
+    failed |= piEventSave(&scanner, path, 1) != 0;
+    piEventFree(&scanner);
+    failed |= piEventLoad(&scanner, path, COUNT, 2) == 0 || piEventLoad(&scanner, path, COUNT / 4, 1) == 0;
+    if (piEventLoad(&scanner, path, COUNT, 1) != 0) {
+        perror(path);
+        failed = 1;
+    } else {
+        failed |= scanner.records != COUNT / 2;
+        failed |= piEventScan(&scanner, packets + COUNT / 2, sizeof(PiProt_t), COUNT - COUNT / 2) != 0;
+        failed |= scanner.count != reference.count || scanner.rejected != reference.rejected ||
+                  memcmp(scanner.events, reference.events, reference.count * sizeof(PiEvent_t)) != 0;
+        piEventFree(&scanner);
+    }
+    if (failed) {
+        printf("  event: mismatch\n");
+    }
+
+    remove("/tmp/pibench-event.cap.evt");
+    piEventFree(&reference);
+    free(status);
+    free(packets);
+    return failed;
+}
+
+/**
+ * @brief Round-trips generated packets through the block codec and a compressed capture.
+ *
+ * The stream has the faults that keep the packet length (flipped bits, bad headers and
+ * sequence gaps) so that every kind of exception is exercised, then random packets check
+ * that incompressible data survives too.
+ */
+static int benchPack(void) {
+    enum { COUNT = 1 << 20, ROUNDS = 8, SEEKS = 4096 };
+    static const char path[] = "/tmp/pibench.pack";
+    PiGenConfig_t config = { .packetRate = 1000, .seed = 7, .hwSerial = 123456, .bitFlipRate = 1e-3,
+                             .badHeaderRate = 1e-3, .gapRate = 1e-3, .maxGap = 5 };
+    PiProt_t *packets = malloc(COUNT * sizeof(PiProt_t));
+    PiProt_t *decoded = malloc(COUNT * sizeof(PiProt_t));
+    PiProt_t *random = benchMakePackets(PI_PACK_BLOCK_PACKETS);
+    size_t bound = piPackBound(PI_PACK_BLOCK_PACKETS);
+    uint8_t *encoded = malloc((size_t)(COUNT / PI_PACK_BLOCK_PACKETS) * bound);
+    size_t offsets[COUNT / PI_PACK_BLOCK_PACKETS + 1];
+    PiGen_t gen;
+    PiPackWriter_t writer;
+    PiPackReader_t reader;
+    PiFramer_t framer;
+    uint64_t delivered = 0, start, elapsed;
+    int failed = 0;
+
+    printf("Compressed capture (%d packets)\n", COUNT);
+    piGenInit(&gen, &config);
+    for (size_t i = 0; i < COUNT; i++) {
+        piGenNext(&gen, packets[i].ui8);
+    }
+
+    start = benchNow();
+    for (int r = 0; r < ROUNDS; r++) {
+        offsets[0] = 0;
+        for (size_t b = 0; b < COUNT / PI_PACK_BLOCK_PACKETS; b++) {
+            offsets[b + 1] = offsets[b] + piPackEncode(packets + b * PI_PACK_BLOCK_PACKETS, PI_PACK_BLOCK_PACKETS,
+                                                       b, 0, encoded + offsets[b]);
+        }
+    }
+    benchReport("piPackEncode", (uint64_t)COUNT * ROUNDS, (uint64_t)COUNT * ROUNDS * sizeof(PiProt_t), benchNow() - start);
+    printf("  %zu bytes, %.2f bytes per packet, ratio %.2f\n", offsets[COUNT / PI_PACK_BLOCK_PACKETS],
+           (double)offsets[COUNT / PI_PACK_BLOCK_PACKETS] / COUNT,
+           (double)COUNT * sizeof(PiProt_t) / (double)offsets[COUNT / PI_PACK_BLOCK_PACKETS]);
+
+    start = benchNow();
+    for (int r = 0; r < ROUNDS; r++) {
+        for (size_t b = 0; b < COUNT / PI_PACK_BLOCK_PACKETS; b++) {
+            failed |= piPackDecode((const PiPackBlockHeader_t *)(encoded + offsets[b]),
+                                   decoded + b * PI_PACK_BLOCK_PACKETS) != PI_PACK_BLOCK_PACKETS;
+        }
+    }
+    benchReport("piPackDecode", (uint64_t)COUNT * ROUNDS, (uint64_t)COUNT * ROUNDS * sizeof(PiProt_t), benchNow() - start);
+    if (failed || memcmp(decoded, packets, COUNT * sizeof(PiProt_t)) != 0) {
+        printf("  piPackDecode: generated packets differ\n");
+        failed = 1;
+    }
+
+    size_t size = piPackEncode(random, PI_PACK_BLOCK_PACKETS, 0, 0, encoded);
+    if (size > bound || piPackDecode((const PiPackBlockHeader_t *)encoded, decoded) != PI_PACK_BLOCK_PACKETS ||
+        memcmp(decoded, random, PI_PACK_BLOCK_PACKETS * sizeof(PiProt_t)) != 0) {
+        printf("  piPackDecode: random packets differ\n");
+        failed = 1;
+    }
+    printf("  random packets: %.2f bytes per packet, bound %.2f\n", (double)size / PI_PACK_BLOCK_PACKETS,
+           (double)bound / PI_PACK_BLOCK_PACKETS);
+
+    // A partial last block, as left by a capture that is stopped at any time
+    if (piPackCreate(&writer, path, config.hwSerial, config.packetRate) != 0) {
+        perror(path);
+        failed = 1;
+        goto done;
+    }
+    for (size_t i = 0; i < COUNT - 100 && !failed; i++) {
+        failed = piPackAppend(&writer, &packets[i], writer.header.startHostNs + i * 1000000ull) != 0;
+    }
+    failed |= piPackFinish(&writer) != 0;
+    if (failed || piPackOpen(&reader, path) != 0) {
+        perror(path);
+        failed = 1;
+        goto done;
+    }
+    failed = reader.count != COUNT - 100;
+    for (size_t i = 0; i < SEEKS && !failed; i++) {
+        uint64_t record = (i * 2654435761u) % reader.count;
+        const PiPackBlock_t *block = &reader.blocks[piPackFindBlock(&reader, record)];
+        uint64_t sample = block->header->sample;
+        piPackDecode(block->header, decoded);
+        for (uint64_t r = block->record + 1; r <= record; r++) {
+            sample += (uint16_t)(decoded[r - block->record].sequence - decoded[r - block->record - 1].sequence);
+        }
+        failed |= piPackSeekSample(&reader, sample) != record;
+    }
+    if (failed) {
+        printf("  compressed capture: mismatch\n");
+    }
+
+    piFramerInit(&framer, benchCountPacket, &delivered);
+    start = benchNow();
+    failed |= piPackReplay(&reader, 0, reader.count, 0, &framer) != reader.count;
+    elapsed = benchNow() - start;
+    benchReport("piPackReplay (framer)", reader.count, reader.count * sizeof(PiProt_t), elapsed);
+    printf("  %.2f MB on disk instead of %.2f MB, %llu valid packets\n", (double)reader.mapSize / 1e6,
+           (double)reader.count * sizeof(PiProt_t) / 1e6, (unsigned long long)delivered);
+    for (size_t i = 0; i < COUNT - 100; i++) {
+        delivered -= piCheckProtBuffer(&packets[i]) == PI_PROT_OK;
+    }
+    failed |= delivered != 0;
+    piPackClose(&reader);
+    remove(path);
+
+done:
+    free(encoded);
+    free(random);
+    free(decoded);
+    free(packets);
+    return failed;
+}
+
+typedef struct {
+    PiProt_t *packets;
+    size_t count;
+} BenchFramed_t;
+
+static void benchCollectPacket(void *context, const PiProt_t *packet) {
+    BenchFramed_t *framed = context;
+    framed->packets[framed->count++] = *packet;
+}
+
+/**
+ * @brief Builds the legacy packet carrying the fields of a generated packet.
+ */
+static void benchLegacyPacket(const PiProt_t *packet, uint8_t *out) {
+    uint16_t header = PI_LEGACY_HEADER, status = 0x797F;
+    uint32_t crc;
+
+    memcpy(out, &header, 2);
+    out[2] = (uint8_t)packet->sequence;
+    out[3] = (uint8_t)~packet->sequence;
+    memcpy(out + 4, &packet->mux, 4);
+    memcpy(out + 8, &packet->data.flags, 2);
+    memcpy(out + 10, &status, 2);
+    for (int axis = 0; axis < 3; axis++) {
+        int32_t gyro = packet->data.gyro[axis] / 2, accl = packet->data.accl[axis] / 2;
+        memcpy(out + 12 + 4 * axis, &gyro, 4);
+        memcpy(out + 24 + 4 * axis, &accl, 4);
+    }
+    crc = piCrc32(out, 36);
+    memcpy(out + 36, &crc, 4);
+}
+
+/**
+ * @brief Frames a stream of legacy packets in fixed and auto-detected mode, in chunks of
+ * varying size with garbage in front, and checks the translated packets.
+ */
+static int benchProto(void) {
+    enum { COUNT = 1 << 18, SIZE = 40, JUNK = 23 };
+    PiGenConfig_t config = { .packetRate = 1000, .seed = 11, .hwSerial = 123456 };
+    PiProt_t *packets = malloc((size_t)COUNT * sizeof(PiProt_t));
+    uint8_t *stream = malloc((size_t)COUNT * SIZE + JUNK);
+    BenchFramed_t framed = { malloc((size_t)COUNT * sizeof(PiProt_t)), 0 };
+    PiFramer_t framer;
+    PiGen_t gen;
+    uint64_t start;
+    int failed = 0;
+
+    printf("Packet formats (%d legacy packets)\n", COUNT);
+    piGenInit(&gen, &config);
+    benchFill(stream, JUNK, 5);
+    for (size_t i = 0; i < COUNT; i++) {
+        piGenPacket(&gen, &packets[i]);
+        benchLegacyPacket(&packets[i], stream + JUNK + i * SIZE);
+    }
+
+    for (int mode = 0; mode < 2; mode++) {
+        piFramerInit(&framer, benchCollectPacket, &framed);
+        piFramerSetFormat(&framer, mode == 0 ? PI_PROTO_LEGACY : PI_PROTO_AUTO);
+        framed.count = 0;
+        start = benchNow();
+        for (size_t offset = 0, chunk = 1; offset < (size_t)COUNT * SIZE + JUNK; offset += chunk, chunk = chunk % 97 + 1) {
+            size_t len = (size_t)COUNT * SIZE + JUNK - offset;
+            piFramerFeed(&framer, stream + offset, len < chunk ? len : chunk);
+        }
+        benchReport(mode == 0 ? "legacy framing" : "auto-detected framing", COUNT, (uint64_t)COUNT * SIZE, benchNow() - start);
+
+        failed |= framed.count != COUNT || framer.format != PI_PROTO_LEGACY || framer.badCrc != 0;
+        for (size_t i = 0; i < framed.count && !failed; i++) {
+            const PiProt_t *in = &packets[i], *out = &framed.packets[i];
+            failed |= out->sequence != (uint16_t)(packets[0].sequence % 256 + i) || out->mux != in->mux ||
+                      out->data.flags.ui16 != in->data.flags.ui16 || piCheckProtBuffer(out) != PI_PROT_OK;
+            for (int axis = 0; axis < 3; axis++) {
+                failed |= out->data.gyro[axis] != in->data.gyro[axis] / 2 * 2 || out->data.accl[axis] != in->data.accl[axis] / 2 * 2;
+            }
+        }
+        if (failed) {
+            printf("  %s: mismatch, %zu packets\n", mode == 0 ? "legacy" : "auto", framed.count);
+            break;
+        }
+    }
+
+    free(framed.packets);
+    free(stream);
+    free(packets);
+    return failed;
+}
+
+/**
+ * @brief Checks that every single-bit error of main and legacy packets is repaired and that no
+ * double-bit error is mistaken for one, then frames a stream with a flipped bit in every 16th
+ * packet with and without correction.
+ */
+static int benchCorrect(void) {
+    enum { COUNT = 1 << 18, CHUNK = 4096, SAMPLES = 64, SIZE = sizeof(PiProt_t), LEGACY = 40 };
+    PiGenConfig_t config = { .packetRate = 1000, .seed = 13, .hwSerial = 123456 };
+    PiProt_t *packets = malloc((size_t)COUNT * sizeof(PiProt_t));
+    uint8_t *stream = malloc((size_t)COUNT * SIZE);
+    BenchFramed_t framed = { malloc((size_t)COUNT * sizeof(PiProt_t)), 0 };
+    uint8_t packet[SIZE], legacy[LEGACY], flipped[SIZE];
+    uint64_t repaired = 0, missed = 0, wrong = 0, start;
+    PiFramer_t framer;
+    PiGen_t gen;
+    int failed = 0;
+
+    printf("Single-bit correction (%d packets)\n", COUNT);
+    memset(framed.packets, 0, (size_t)COUNT * sizeof(PiProt_t));
+    piGenInit(&gen, &config);
+    for (size_t i = 0; i < COUNT; i++) {
+        piGenPacket(&gen, &packets[i]);
+    }
+
+    // Every bit of a few packets, header bits of the main format are not covered by the CRC
+    start = benchNow();
+    for (size_t i = 0; i < SAMPLES; i++) {
+        memcpy(packet, &packets[i], SIZE);
+        benchLegacyPacket(&packets[i], legacy);
+        for (size_t bit = 16; bit < SIZE * 8; bit++) {
+            memcpy(flipped, packet, SIZE);
+            flipped[bit / 8] ^= (uint8_t)(1u << (bit % 8));
+            if (piProtoCorrect(PI_PROTO_MAIN, flipped) == PI_PROT_CORRECTED && memcmp(flipped, packet, SIZE) == 0) {
+                repaired++;
+            } else {
+                missed++;
+            }
+        }
+        for (size_t bit = 0; bit < LEGACY * 8; bit++) {
+            memcpy(flipped, legacy, LEGACY);
+            flipped[bit / 8] ^= (uint8_t)(1u << (bit % 8));
+            if (piProtoCorrect(PI_PROTO_LEGACY, flipped) == PI_PROT_CORRECTED && memcmp(flipped, legacy, LEGACY) == 0) {
+                repaired++;
+            } else {
+                missed++;
+            }
+        }
+    }
+    benchReport("single-bit repair", repaired + missed, 0, benchNow() - start);
+
+    // The CRC32 has a Hamming distance of 5 at this length: two flipped bits are never repaired
+    memcpy(packet, &packets[0], SIZE);
+    for (size_t a = 16; a < SIZE * 8; a++) {
+        for (size_t b = a + 1; b < SIZE * 8; b++) {
+            memcpy(flipped, packet, SIZE);
+            flipped[a / 8] ^= (uint8_t)(1u << (a % 8));
+            flipped[b / 8] ^= (uint8_t)(1u << (b % 8));
+            wrong += piProtoCorrect(PI_PROTO_MAIN, flipped) != PI_PROT_BAD_CRC;
+        }
+    }
+    printf("  %llu single-bit errors repaired, %llu missed, %llu double-bit errors repaired\n",
+           (unsigned long long)repaired, (unsigned long long)missed, (unsigned long long)wrong);
+    failed |= missed != 0 || wrong != 0;
+
+    // A payload or CRC bit flipped in every 16th packet
+    for (int pass = 0; pass < 4 && !failed; pass++) {
+        int corrupt = pass >= 2, correct = pass % 2;
+        static const char *const stages[4] = {
+            "clean framing", "clean framing, correcting", "1/16 flipped", "1/16 flipped, correcting"
+        };
+
+        memcpy(stream, packets, (size_t)COUNT * SIZE);
+        for (size_t i = 15; corrupt && i < COUNT; i += 16) {
+            size_t bit = 16 + (i * 7) % ((SIZE - 2) * 8);
+            stream[i * SIZE + bit / 8] ^= (uint8_t)(1u << (bit % 8));
+        }
+        piFramerInit(&framer, benchCollectPacket, &framed);
+        piFramerSetCorrection(&framer, correct);
+        framed.count = 0;
+        start = benchNow();
+        for (size_t offset = 0; offset < (size_t)COUNT * SIZE; offset += CHUNK) {
+            size_t len = (size_t)COUNT * SIZE - offset;
+            piFramerFeed(&framer, stream + offset, len < CHUNK ? len : CHUNK);
+        }
+        benchReport(stages[pass], framer.packets, (uint64_t)COUNT * SIZE, benchNow() - start);
+
+        if (corrupt && !correct) {
+            failed |= framed.count != COUNT - COUNT / 16 || framer.badCrc < COUNT / 16;
+        } else {
+            failed |= framed.count != COUNT || framer.corrected != (corrupt ? COUNT / 16 : 0) ||
+                      memcmp(framed.packets, packets, (size_t)COUNT * SIZE) != 0;
+        }
+        if (failed) {
+            printf("  %s: %zu packets, %llu corrected, %llu bad CRC\n", stages[pass], framed.count,
+                   (unsigned long long)framer.corrected, (unsigned long long)framer.badCrc);
+        }
+    }
+
+    free(framed.packets);
+    free(stream);
+    free(packets);
+    return failed;
+}
+
+enum { BENCH_TIME_DEVICES = 4, BENCH_TIME_RATE = 1000 };
+
+static const double benchTimeDriftPpm[BENCH_TIME_DEVICES] = { 0, 40, -25, 100 };
+static const uint16_t benchTimeFirstSequence[BENCH_TIME_DEVICES] = { 0, 65000, 12345, 40000 };
+
+/**
+ * @brief Returns the host time at which a simulated device sends its k-th sample.
+ */
+static double benchTimeEmitted(uint32_t device, uint64_t k) {
+    return 1e12 + (double)device * 123456 + (double)k * 1e9 / BENCH_TIME_RATE * (1 + benchTimeDriftPpm[device] * 1e-6);
+}
+
+typedef struct {
+    const PiTimeMerge_t *merge;
+    uint64_t released;
+    uint64_t unordered;
+    uint64_t maxLagNs;
+    uint64_t lastNs;
+    uint64_t next[BENCH_TIME_DEVICES];
+    uint64_t broken;
+    uint64_t errorCount;
+    double errorSum[2];
+    double errorSquares[2];
+} BenchTimeMerge_t;
+
+static void benchTimeSample(void *context, const PiTimeSample_t *sample) {
+    BenchTimeMerge_t *check = context;
+    uint32_t device = sample->sample.device;
+    uint64_t lag = check->merge->watermarkNs - sample->time.hostNs;
+    uint64_t k = sample->time.sample - benchTimeFirstSequence[device];
+
+    check->unordered += sample->time.hostNs < check->lastNs;
+    check->lastNs = sample->time.hostNs;
+    check->maxLagNs = lag > check->maxLagNs ? lag : check->maxLagNs;
+    check->broken += (uint16_t)sample->time.sample != sample->sample.packet.sequence ||
+                     (check->next[device] != 0 && sample->time.sample != check->next[device]);
+    check->next[device] = sample->time.sample + 1;
+    check->released++;
+
+    // Read time and stamp against the true emission time, once the fit has settled
+    if (k >= 10 * BENCH_TIME_RATE) {
+        double errors[2] = {
+            (double)sample->sample.hostTimeNs - benchTimeEmitted(device, k),
+            (double)sample->time.hostNs - benchTimeEmitted(device, k)
+        };
+        for (int e = 0; e < 2; e++) {
+            check->errorSum[e] += errors[e];
+            check->errorSquares[e] += errors[e] * errors[e];
+        }
+        check->errorCount++;
+    }
+}
+
+/**
+ * @brief Simulates devices with drifting clocks read in batches, one of them going silent,
+ * and checks the unwrapped counters, the device time, the drift estimates and the order and
+ * latency of the merged stream.
+ */
+static int benchTime(void) {
+    enum { DEVICES = BENCH_TIME_DEVICES, RATE = BENCH_TIME_RATE, SECONDS = 100, SILENT_AFTER = 80 * RATE };
+    static const uint64_t uptimeSamples[DEVICES] = { 3600123, 17, 86400500, 999 };
+    const uint64_t readNs = 4000000, latencyNs = 20000000;
+    size_t counts[DEVICES], next[DEVICES] = { 0 }, total = 0;
+    PiSample_t *samples[DEVICES];
+    const PiSample_t **order;
+    uint64_t seed = 0x9E3779B97F4A7C15ull, start;
+    double jitter[2];
+    BenchTimeMerge_t check = { 0 };
+    PiTimeMerge_t merge;
+    int failed = 0;
+
+    printf("Timebase and merge (%d devices, %d s)\n", DEVICES, SECONDS);
+    if (piTimeMergeInit(&merge, DEVICES, RATE, 4096, latencyNs, benchTimeSample, &check) != 0) {
+        return 1;
+    }
+    check.merge = &merge;
+    for (uint32_t d = 0; d < DEVICES; d++) {
+        PiGenConfig_t config = { .packetRate = RATE, .seed = 21 + d, .firstSequence = benchTimeFirstSequence[d] };
+        PiGen_t gen;
+        uint64_t readTime = (uint64_t)benchTimeEmitted(d, 0);
+
+        counts[d] = d == DEVICES - 1 ? SILENT_AFTER : SECONDS * RATE;
+        samples[d] = malloc(counts[d] * sizeof(PiSample_t));
+        piGenInit(&gen, &config);
+        gen.sample = uptimeSamples[d];
+
+        // Every sample arrives 50 to 650 us after it is sent, reads wake up every 0.5 to 4 ms
+        for (size_t k = 0; k < counts[d]; k++) {
+            seed ^= seed << 13;
+            seed ^= seed >> 7;
+            seed ^= seed << 17;
+            uint64_t arrival = (uint64_t)benchTimeEmitted(d, k) + 50000 + seed % 600000;
+            while (readTime < arrival) {
+                readTime += readNs / 8 + (seed >> 32) % (readNs - readNs / 8);
+                seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+            }
+            samples[d][k].hostTimeNs = readTime;
+            samples[d][k].device = d;
+            piGenPacket(&gen, &samples[d][k].packet);
+        }
+        total += counts[d];
+    }
+
+    // Drain the devices in read order, like a consumer of the reactor rings
+    order = malloc(total * sizeof(*order));
+    for (size_t i = 0; i < total; i++) {
+        int best = -1;
+        for (int d = 0; d < DEVICES; d++) {
+            if (next[d] < counts[d] && (best < 0 || samples[d][next[d]].hostTimeNs < samples[best][next[best]].hostTimeNs)) {
+                best = d;
+            }
+        }
+        order[i] = &samples[best][next[best]++];
+    }
+
+    start = benchNow();
+    for (size_t i = 0; i < total; i++) {
+        piTimeMergePush(&merge, order[i]);
+    }
+    piTimeMergeFlush(&merge);
+    benchReport("stamp and merge", total, 0, benchNow() - start);
+
+    for (int e = 0; e < 2; e++) {
+        double mean = check.errorSum[e] / (double)check.errorCount;
+        jitter[e] = sqrt(check.errorSquares[e] / (double)check.errorCount - mean * mean);
+    }
+    printf("  arrival jitter: read time %.0f us, stamp %.1f us rms; max merge lag %.1f ms, %llu late, %llu forced\n",
+           jitter[0] / 1e3, jitter[1] / 1e3, (double)check.maxLagNs / 1e6,
+           (unsigned long long)merge.late, (unsigned long long)merge.forced);
+    failed |= check.released != total || check.unordered != 0 || check.broken != 0 || merge.late != 0 ||
+              check.maxLagNs > latencyNs + 2 * readNs || jitter[1] * 4 > jitter[0];
+
+    for (int d = 0; d < DEVICES; d++) {
+        const PiTimebase_t *timebase = &merge.timebases[d];
+        int64_t expected = (int64_t)(uptimeSamples[d] + counts[d] - 1) * (1000000000 / RATE);
+        int64_t error = piTimeDeviceNs(timebase, timebase->sample) - expected;
+        double drift = piTimeDriftPpm(timebase);
+
+        printf("  device %d: %llu samples, device time error %+.1f ms, drift %+.2f ppm (actual %+.0f)\n", d,
+               (unsigned long long)(timebase->sample - timebase->firstSample + 1), (double)error / 1e6, drift,
+               benchTimeDriftPpm[d]);
+        failed |= timebase->sample - timebase->firstSample + 1 != counts[d] || !piTimeAnchored(timebase) ||
+                  timebase->reboots != 0 || llabs(error) > PI_MUXFACTOR * (1000000000 / RATE) ||
+                  fabs(drift - benchTimeDriftPpm[d]) > 2;
+    }
+
+    piTimeMergeFree(&merge);
+    free(order);
+    for (int d = 0; d < DEVICES; d++) {
+        free(samples[d]);
+    }
+    return failed;
+}
+
+/**
+ * @brief Pushes a generated stream with injected faults through every stage of the decoder.
+ *
+ * The stream is hex encoded in lines of one link packet each, then decoded, framed in 4 KiB
+ * chunks, validated and converted to SoA samples, each stage timed on its own.
+ */
+static int benchPipeline(void) {
+    enum { COUNT = 1 << 21, CHUNK = 4096 };
+    static const char digits[] = "0123456789abcdef";
+    PiGenConfig_t config = { .packetRate = 1000, .seed = 42, .hwSerial = 123456,
+                             .bitFlipRate = 1e-3, .dropByteRate = 1e-3, .truncateRate = 1e-3,
+                             .badHeaderRate = 1e-3, .gapRate = 1e-3, .maxGap = 8 };
+    PiGen_t gen;
+    uint8_t *stream = malloc((size_t)COUNT * sizeof(PiProt_t));
+    uint8_t *decoded = malloc((size_t)COUNT * sizeof(PiProt_t));
+    uint32_t *lineLen = malloc(COUNT * sizeof(uint32_t));
+    char *text = malloc((size_t)COUNT * (2 * sizeof(PiProt_t) + 1));
+    BenchFramed_t framed = { malloc((size_t)COUNT * sizeof(PiProt_t)), 0 };
+    PiProtError_t *results = malloc(COUNT * sizeof(PiProtError_t));
+    PiSampleBlock_t block;
+    PiFramer_t framer;
+    size_t streamLen = 0, textLen = 0, decodedLen = 0, valid;
+    uint64_t start, total = 0, ns;
+    int failed = 0;
+
+    // Touch the destination buffers so that page faults are not timed
+    memset(decoded, 0, (size_t)COUNT * sizeof(PiProt_t));
+    memset(framed.packets, 0, (size_t)COUNT * sizeof(PiProt_t));
+    piGenInit(&gen, &config);
+    for (size_t i = 0; i < COUNT; i++) {
+        size_t len = piGenNext(&gen, stream + streamLen);
+        for (size_t j = 0; j < len; j++) {
+            text[textLen++] = digits[stream[streamLen + j] >> 4];
+            text[textLen++] = digits[stream[streamLen + j] & 15];
+        }
+        text[textLen++] = '\n';
+        lineLen[i] = (uint32_t)len;
+        streamLen += len;
+    }
+    printf("Decoding pipeline (%d generated packets: %llu bit flips, %llu dropped bytes, %llu truncated, "
+           "%llu bad headers, %llu gaps)\n", COUNT, (unsigned long long)gen.bitFlips,
+           (unsigned long long)gen.droppedBytes, (unsigned long long)gen.truncated,
+           (unsigned long long)gen.badHeaders, (unsigned long long)gen.gaps);
+
+    start = benchNow();
+    for (size_t i = 0, pos = 0; i < COUNT; i++) {
+        size_t len;
+        failed |= piHexDecode(text + pos, 2 * lineLen[i], decoded + decodedLen, sizeof(PiProt_t), &len, NULL) != PI_HEX_OK;
+        decodedLen += len;
+        pos += 2 * lineLen[i] + 1;
+    }
+    ns = benchNow() - start;
+    total += ns;
+    benchReport("hex decode", COUNT, textLen, ns);
+    failed |= decodedLen != streamLen || memcmp(decoded, stream, streamLen) != 0;
+
+    piFramerInit(&framer, benchCollectPacket, &framed);
+    start = benchNow();
+    for (size_t pos = 0; pos < decodedLen; pos += CHUNK) {
+        piFramerFeed(&framer, decoded + pos, decodedLen - pos < CHUNK ? decodedLen - pos : CHUNK);
+    }
+    ns = benchNow() - start;
+    total += ns;
+    benchReport("framing", COUNT, decodedLen, ns);
+
+    start = benchNow();
+    valid = piCheckProtBuffers(framed.packets, sizeof(PiProt_t), framed.count, results);
+    ns = benchNow() - start;
+    total += ns;
+    benchReport("validation", framed.count, framed.count * sizeof(PiProt_t), ns);
+    failed |= valid != framed.count;
+
+    piSampleBlockAlloc(&block, framed.count);
+    piConvertPackets(framed.packets, sizeof(PiProt_t), framed.count, &block);
+    block.count = 0;
+    start = benchNow();
+    piConvertPackets(framed.packets, sizeof(PiProt_t), framed.count, &block);
+    ns = benchNow() - start;
+    total += ns;
+    benchReport("conversion", framed.count, framed.count * sizeof(PiProt_t), ns);
+    benchReport("total", COUNT, streamLen, total);
+
+    // Every clean packet must come out; a corrupted one may also take a clean neighbour with it
+    uint64_t corrupted = gen.bitFlips + gen.droppedBytes + gen.truncated + gen.badHeaders;
+    printf("  %zu of %llu packets recovered, %llu corrupted, %llu bytes skipped\n", framed.count,
+           (unsigned long long)gen.packets, (unsigned long long)corrupted, (unsigned long long)framer.skippedBytes);
+    failed |= framed.count > gen.packets || framed.count + 2 * corrupted < gen.packets;
+    if (failed) {
+        printf("  pipeline: mismatch\n");
+    }
+
+    piSampleBlockFree(&block);
+    free(results);
+    free(framed.packets);
+    free(text);
+    free(lineLen);
+    free(decoded);
+    free(stream);
+    return failed;
+}
+
+/**
+ * @brief Formats packets like `printPacket` did with printf, CRC recomputed for every packet.
+ */
+static void benchPrintfPacket(FILE *stream, const PiProt_t *packet) {
+    PiProtError_t result = piCheckProtBuffer(packet);
+    uint32_t crc32 = piCrc32((const uint8_t *)&packet->sequence, sizeof(PiProt_t) - 4 - 2);
+
+    fprintf(stream, "%d   0x%04X %05d % 10.3f % 10.3f % 10.3f % 10.3f % 10.3f % 10.3f  0x%08X 0x%08X (%d) %s\n",
+            (int)sizeof(PiProt_t), packet->header, packet->sequence,
+            fp1_14_17ToFloat(packet->data.gyro[0]), fp1_14_17ToFloat(packet->data.gyro[1]), fp1_14_17ToFloat(packet->data.gyro[2]),
+            fp1_14_17ToFloat(packet->data.accl[0]), fp1_14_17ToFloat(packet->data.accl[1]), fp1_14_17ToFloat(packet->data.accl[2]),
+            packet->crc32, crc32, (int)result, PiProtErrorToString(result));
+}
+
+/**
+ * @brief Reads a whole temporary file back.
+ */
+static char *benchReadBack(FILE *file, long *size) {
+    fflush(file);
+    *size = ftell(file);
+    char *text = malloc((size_t)*size + 1);
+    rewind(file);
+    *size = (long)fread(text, 1, (size_t)*size, file);
+    return text;
+}
+
+/**
+ * @brief Compares the output writer with the printf path and measures both.
+ */
+static int benchOutput(void) {
+    enum { COUNT = 1 << 18, FLOATS = 1 << 20 };
+    PiProt_t *packets = benchMakePackets(COUNT);
+    PiOut_t *out = malloc(sizeof(PiOut_t));
+    FILE *reference = tmpfile(), *written = tmpfile(), *null = fopen("/dev/null", "w");
+    int nullFd = open("/dev/null", O_WRONLY);
+    char expected[64], actual[64];
+    uint32_t random = 1;
+    long referenceSize, writtenSize;
+    uint64_t start;
+    int failed = 0;
+
+    printf("Packet output (%d packets)\n", COUNT);
+    for (size_t i = 0; i < FLOATS && !failed; i++) {
+        random = random * 1664525u + 1013904223u;
+        float value = fp1_14_17ToFloat((int32_t)random >> (i % 16));
+        unsigned decimals = i % 2 ? 3 : 6;
+        int len = snprintf(expected, sizeof(expected), "% 10.*f", (int)decimals, (double)value);
+        failed = piOutFormatFloat(actual, value, decimals, 10, 1) != (size_t)len || memcmp(expected, actual, (size_t)len) != 0;
+    }
+
+    // Same table rows, bad CRCs included
+    for (size_t i = 0; i < COUNT / 16; i++) {
+        benchPrintfPacket(reference, &packets[i]);
+    }
+    piOutInit(out, fileno(written), PI_OUT_TABLE);
+    for (size_t i = 0; i < COUNT / 16; i++) {
+        piOutPacket(out, &packets[i], piCheckProtBufferFast(&packets[i]));
+    }
+    piOutClose(out);
+    char *referenceText = benchReadBack(reference, &referenceSize);
+    char *writtenText = benchReadBack(written, &writtenSize);
+    failed |= referenceSize != writtenSize || memcmp(referenceText, writtenText, (size_t)referenceSize) != 0;
+    if (failed) {
+        printf("  piOutPacket: mismatch with printf\n");
+    }
+
+    start = benchNow();
+    for (size_t i = 0; i < COUNT; i++) {
+        benchPrintfPacket(null, &packets[i]);
+    }
+    fflush(null);
+    benchReport("printf table", COUNT, (uint64_t)referenceSize * 16, benchNow() - start);
+
+    for (int format = PI_OUT_TABLE; format <= PI_OUT_BINARY; format++) {
+        static const char *const names[] = { "piOut table", "piOut csv", "piOut binary" };
+        piOutInit(out, nullFd, (PiOutFormat_t)format);
+        start = benchNow();
+        for (size_t i = 0; i < COUNT; i++) {
+            // The framer delivers validated packets, the table only needs the result
+            piOutPacket(out, &packets[i], piCheckProtBufferFast(&packets[i]));
+        }
+        piOutFlush(out);
+        benchReport(names[format], COUNT, out->bytes, benchNow() - start);
+        printf("  %-28s %12llu writes\n", "", (unsigned long long)out->writes);
+        piOutClose(out);
+    }
+
+    free(writtenText);
+    free(referenceText);
+    close(nullFd);
+    fclose(null);
+    fclose(written);
+    fclose(reference);
+    free(out);
+    free(packets);
+    return failed;
+}
+
+/**
+ * @brief Measures the link-health accounting and checks it against the generator counters.
+ */
+static int benchStats(void) {
+    enum { COUNT = 1 << 21 };
+    PiGenConfig_t config = { .packetRate = 1000, .seed = 7, .hwSerial = 123456, .gapRate = 1e-3, .maxGap = 64 };
+    PiProt_t *packets = malloc(COUNT * sizeof(PiProt_t));
+    uint64_t *times = malloc(COUNT * sizeof(uint64_t));
+    PiStatsSnapshot_t snapshot;
+    PiStats_t stats;
+    PiGen_t gen;
+    uint64_t start;
+    int failed = 0;
+
+    // Arrival times follow the sample clock with up to 255 us of jitter
+    piGenInit(&gen, &config);
+    for (size_t i = 0; i < COUNT; i++) {
+        piGenNext(&gen, packets[i].ui8);
+        times[i] = (gen.sample - 1) * 1000000ull + (packets[i].data.gyro[2] & 0xFF) * 1000ull;
+    }
+    piStatsInit(&stats, 0, 1000);
+    start = benchNow();
+    for (size_t i = 0; i < COUNT; i++) {
+        piStatsPacket(&stats, &packets[i], times[i]);
+    }
+    uint64_t ns = benchNow() - start;
+    piStatsSnapshot(&stats, &snapshot);
+
+    printf("Link-health statistics (%d packets, %llu gaps)\n", COUNT, (unsigned long long)gen.gaps);
+    benchReport("piStatsPacket", COUNT, (uint64_t)COUNT * sizeof(PiProt_t), ns);
+    if (snapshot.packets != COUNT || snapshot.lost != gen.lost || snapshot.gaps != gen.gaps ||
+        snapshot.duplicates != 0 || snapshot.reordered != 0 || snapshot.jitterNs.max >= 512000) {
+        printf("  MISMATCH: lost %llu/%llu gaps %llu/%llu\n", (unsigned long long)snapshot.lost,
+               (unsigned long long)gen.lost, (unsigned long long)snapshot.gaps, (unsigned long long)gen.gaps);
+        failed = 1;
+    }
+    printf("  ");
+    piStatsPrint(stdout, &snapshot, NULL);
+
+    free(times);
+    free(packets);
+    return failed;
+}
+
+/**
+ * @brief Reads a shared memory ring until it is closed, checking every sample against the packets.
+ *
+ * @return Number of samples that did not match their packet.
+ */
+static uint64_t benchShmRead(PiShmReader_t *reader, const PiProt_t *packets, size_t count) {
+    PiShmSample_t batch[256];
+    uint64_t mismatches = 0;
+
+    for (;;) {
+        size_t got = piShmRead(reader, batch, 256);
+        for (size_t i = 0; i < got; i++) {
+            const PiProt_t *packet = &packets[batch[i].sample % count];
+            mismatches += batch[i].sequence != packet->sequence || batch[i].mux != packet->mux ||
+                          memcmp(&batch[i].data, &packet->data, sizeof(PiMainData_t)) != 0;
+        }
+        if (got == 0) {
+            if (piShmClosed(reader)) {
+                break;
+            }
+            sched_yield();
+        }
+    }
+    return mismatches;
+}
+
+/**
+ * @brief Measures publishing to a shared memory ring and reading it from other processes.
+ */
+static int benchShm(void) {
+    enum { COUNT = 1 << 21, CAPACITY = 1 << 16, READERS = 2 };
+    static const char name[] = "/pibench";
+    PiProt_t *packets = benchMakePackets(COUNT);
+    PiShmSample_t *samples = malloc(CAPACITY * sizeof(PiShmSample_t));
+    PiShmWriter_t writer;
+    PiShmReader_t reader;
+    pid_t children[READERS];
+    int pipes[READERS][2];
+    uint64_t start, ns, mismatches;
+    int failed = 0;
+
+    printf("Shared memory ring (%d samples, %d slots)\n", COUNT, CAPACITY);
+    memset(samples, 0, CAPACITY * sizeof(PiShmSample_t));
+    if (piShmCreate(&writer, name, CAPACITY, 1000) != 0) {
+        perror(name);
+        return 1;
+    }
+    start = benchNow();
+    for (size_t i = 0; i < COUNT; i++) {
+        piShmPublish(&writer, &packets[i], PI_PROT_OK, i);
+    }
+    benchReport("piShmPublish", COUNT, (uint64_t)COUNT * sizeof(PiShmSample_t), benchNow() - start);
+
+    // A late reader backfills the whole history window
+    failed |= piShmOpen(&reader, name, CAPACITY) != 0;
+    start = benchNow();
+    size_t got = failed ? 0 : piShmRead(&reader, samples, CAPACITY);
+    ns = benchNow() - start;
+    benchReport("piShmRead backfill", got, (uint64_t)got * sizeof(PiShmSample_t), ns);
+    mismatches = got != CAPACITY - 1 || samples[0].sample != COUNT - CAPACITY + 1;
+    for (size_t i = 0; i < got; i++) {
+        mismatches += memcmp(&samples[i].data, &packets[samples[i].sample].data, sizeof(PiMainData_t)) != 0;
+    }
+    piShmClose(&reader);
+    piShmDestroy(&writer);
+
+    // The mux snapshot of a generated stream, before and after the first complete cycle
+    if (piShmCreate(&writer, name, CAPACITY, 1000) != 0 || piShmOpen(&reader, name, 0) != 0) {
+        perror(name);
+        failed = 1;
+    } else {
+        PiGenConfig_t config = { .packetRate = 1000, .seed = 5, .hwSerial = 4242 };
+        uint8_t bytes[sizeof(PiProt_t)];
+        PiMux_t mux;
+        PiGen_t gen;
+        int muxFailed = piShmMux(&reader, &mux) != 0;
+
+        piGenInit(&gen, &config);
+        for (size_t i = 0; i < 3 * PI_MUXFACTOR; i++) {
+            piGenNext(&gen, bytes);
+            piShmPublish(&writer, (const PiProt_t *)bytes, PI_PROT_OK, i);
+        }
+        muxFailed |= piShmMux(&reader, &mux) != 1 || memcmp(&mux, &gen.mux, sizeof(PiMux_t)) != 0 ||
+                     mux.hwSerial != config.hwSerial;
+        // A publisher that died in the middle of an update leaves the stamp odd
+        atomic_fetch_add(&writer.header->muxStamp, 1);
+        muxFailed |= piShmMux(&reader, &mux) != 0;
+        printf("  mux snapshot: %s\n", muxFailed ? "MISMATCH" : "matches the generator, half-written update given up");
+        failed |= muxFailed;
+        piShmClose(&reader);
+    }
+    piShmDestroy(&writer);
+
+    // Concurrent readers in their own processes, the publisher is not paced
+    failed |= piShmCreate(&writer, name, CAPACITY, 1000) != 0;
+    for (int r = 0; r < READERS && !failed; r++) {
+        failed |= pipe(pipes[r]) != 0 || piShmOpen(&reader, name, 0) != 0;
+        children[r] = failed ? -1 : fork();
+        if (children[r] == 0) {
+            uint64_t result[3];
+            result[2] = benchShmRead(&reader, packets, COUNT);
+            result[0] = reader.samples;
+            result[1] = reader.overruns;
+            _exit(write(pipes[r][1], result, sizeof(result)) == sizeof(result) ? 0 : 1);
+        }
+        piShmClose(&reader);
+    }
+    start = benchNow();
+    for (size_t i = 0; i < COUNT && !failed; i++) {
+        piShmPublish(&writer, &packets[i], PI_PROT_OK, i);
+    }
+    ns = benchNow() - start;
+    piShmDestroy(&writer);
+    benchReport("piShmPublish with readers", COUNT, (uint64_t)COUNT * sizeof(PiShmSample_t), ns);
+    for (int r = 0; r < READERS && !failed; r++) {
+        uint64_t result[3] = { 0, 0, 1 };
+        int status;
+        failed |= read(pipes[r][0], result, sizeof(result)) != sizeof(result);
+        waitpid(children[r], &status, 0);
+        close(pipes[r][0]);
+        close(pipes[r][1]);
+        printf("  reader %d: %llu samples read, %llu overrun, %llu torn\n", r, (unsigned long long)result[0],
+               (unsigned long long)result[1], (unsigned long long)result[2]);
+        failed |= result[0] + result[1] != COUNT;
+        mismatches += result[2];
+    }
+    if (mismatches != 0) {
+        printf("  MISMATCH: %llu samples differ from their packet\n", (unsigned long long)mismatches);
+        failed = 1;
+    }
+
+    free(samples);
+    free(packets);
+    return failed;
+}
+
+/**
+ * @brief Compares two sample blocks, floats bit for bit.
+ */
+static int benchSameBlocks(const PiSampleBlock_t *a, const PiSampleBlock_t *b) {
+    size_t floats = a->count * sizeof(float), words = a->count * sizeof(uint16_t);
+    int differ = a->count != b->count;
+
+    for (int c = 0; c < 3 && !differ; c++) {
+        differ |= memcmp(a->accl[c], b->accl[c], floats) != 0;
+        differ |= memcmp(a->gyro[c], b->gyro[c], floats) != 0;
+        differ |= memcmp(a->magn[c], b->magn[c], floats) != 0;
+    }
+    return differ || memcmp(a->pressure, b->pressure, floats) != 0 || memcmp(a->sequence, b->sequence, words) != 0 ||
+           memcmp(a->flags, b->flags, words) != 0 || memcmp(a->fault, b->fault, words) != 0;
+}
+
+/**
+ * @brief Returns the RMS of the second half of a decimated channel, after the filter settled.
+ */
+static double benchRms(const float *values, size_t count) {
+    double sum = 0;
+    for (size_t i = count / 2; i < count; i++) {
+        sum += (double)values[i] * values[i];
+    }
+    return sqrt(sum / (double)(count - count / 2));
+}
+
+/**
+ * @brief Cross-checks the decimation kernels, checks the filter response and the flag propagation.
+ */
+static int benchDecimate(void) {
+    enum { COUNT = 1 << 20, FAULT_AT = 5000 };
+    static const unsigned factors[2] = { 4, 10 };
+    PiGenConfig_t config = { .packetRate = 1000, .seed = 3, .hwSerial = 123456 };
+    PiProt_t *packets = malloc(COUNT * sizeof(PiProt_t));
+    PiSampleBlock_t in, reference[2], outputs[2];
+    PiSampleBlock_t *const referenceOut[2] = { &reference[0], &reference[1] };
+    PiSampleBlock_t *const out[2] = { &outputs[0], &outputs[1] };
+    PiDecimator_t dec;
+    PiGen_t gen;
+    int failed = 0;
+
+    piGenInit(&gen, &config);
+    for (size_t i = 0; i < COUNT; i++) {
+        piGenPacket(&gen, &packets[i]);
+    }
+    packets[FAULT_AT].data.fault.xGyroFault = 1;
+    packets[FAULT_AT].data.flags.gyroZOverange = 1;
+    piSampleBlockAlloc(&in, COUNT);
+    piConvertPackets(packets, sizeof(PiProt_t), COUNT, &in);
+    for (int s = 0; s < 2; s++) {
+        piSampleBlockAlloc(&reference[s], COUNT / factors[s]);
+        piSampleBlockAlloc(&outputs[s], COUNT / factors[s]);
+    }
+    printf("Decimation of %d samples to 250 and 100 Hz (%u and %u taps)\n", COUNT, 16 * factors[0], 16 * factors[1]);
+
+    piDecimInit(&dec, factors, 2, 0);
+    piDecimProcessKernel(PI_CONV_KERNEL_SCALAR, &dec, &in, 0, COUNT, referenceOut);
+    piDecimFree(&dec);
+
+    // The fault of one input reaches every output whose filter covers it
+    for (int s = 0; s < 2; s++) {
+        size_t expected = 0, flagged = 0;
+        for (size_t o = 0; o < reference[s].count; o++) {
+            size_t newest = (o + 1) * factors[s] - 1;
+            expected += newest >= FAULT_AT && newest < FAULT_AT + 16 * factors[s];
+            flagged += reference[s].fault[o] == packets[FAULT_AT].data.fault.ui16 &&
+                       reference[s].flags[o] == packets[FAULT_AT].data.flags.ui16;
+        }
+        if (flagged != expected || expected != 16) {
+            printf("  MISMATCH: %zu of %zu outputs flagged at factor %u\n", flagged, expected, factors[s]);
+            failed = 1;
+        }
+    }
+
+    for (int k = 0; k < PI_CONV_KERNEL_COUNT && !failed; k++) {
+        if (!piConvertKernelSupported((PiConvKernel_t)k)) {
+            printf("  %-28s not supported\n", piConvertKernelName((PiConvKernel_t)k));
+            continue;
+        }
+        // Uneven blocks check that the state carries over between calls
+        piDecimInit(&dec, factors, 2, 0);
+        outputs[0].count = outputs[1].count = 0;
+        for (size_t pos = 0, chunk = 1; pos < COUNT; pos += chunk, chunk = chunk * 7 % 997 + 1) {
+            piDecimProcessKernel((PiConvKernel_t)k, &dec, &in, pos, COUNT - pos < chunk ? COUNT - pos : chunk, out);
+        }
+        piDecimFree(&dec);
+        if (benchSameBlocks(&outputs[0], &reference[0]) || benchSameBlocks(&outputs[1], &reference[1])) {
+            printf("  %s: mismatch with the scalar kernel\n", piConvertKernelName((PiConvKernel_t)k));
+            failed = 1;
+            break;
+        }
+
+        piDecimInit(&dec, factors, 2, 0);
+        outputs[0].count = outputs[1].count = 0;
+        uint64_t start = benchNow();
+        piDecimProcessKernel((PiConvKernel_t)k, &dec, &in, 0, COUNT, out);
+        benchReport(piConvertKernelName((PiConvKernel_t)k), COUNT, (uint64_t)COUNT * PI_DECIM_CHANNELS * sizeof(float), benchNow() - start);
+        piDecimFree(&dec);
+    }
+
+    // Gain of the 100 Hz output for tones in its passband and above its Nyquist frequency
+    static const double tones[] = { 0, 10, 20, 30, 60, 70, 150, 420 };
+    printf("  100 Hz output gain:");
+    for (size_t t = 0; t < sizeof(tones) / sizeof(tones[0]) && !failed; t++) {
+        PiSampleBlock_t *const single[1] = { &outputs[1] };
+        const double pi = 3.14159265358979323846;
+        for (size_t i = 0; i < COUNT / 16; i++) {
+            in.accl[0][i] = tones[t] == 0 ? 1.0f : (float)(sqrt(2.0) * sin(2 * pi * tones[t] * i / 1000.0 + 0.3));
+        }
+        piDecimInit(&dec, &factors[1], 1, 0);
+        outputs[1].count = 0;
+        piDecimProcess(&dec, &in, 0, COUNT / 16, single);
+        piDecimFree(&dec);
+        double gain = benchRms(outputs[1].accl[0], outputs[1].count);
+        printf(" %g Hz %.1f dB%s", tones[t], 20 * log10(gain > 1e-12 ? gain : 1e-12), t + 1 < sizeof(tones) / sizeof(tones[0]) ? "," : "\n");
+        // Flat within 0.1 dB up to 20 Hz, everything that would alias at least 60 dB down
+        failed |= tones[t] <= 20 ? fabs(gain - 1) > 0.012 : tones[t] >= 60 && gain > 1e-3;
+    }
+
+    for (int s = 0; s < 2; s++) {
+        piSampleBlockFree(&reference[s]);
+        piSampleBlockFree(&outputs[s]);
+    }
+    piSampleBlockFree(&in);
+    free(packets);
+    return failed;
+}
+
+int main(int argc, char **argv) {
+    const char *only = argc > 1 ? argv[1] : NULL;
+    int failed = 0;
+
+    if (only == NULL || strcmp(only, "crc") == 0) {
+        failed |= benchCrc();
+    }
+    if (only == NULL || strcmp(only, "validate") == 0) {
+        failed |= benchValidate();
+    }
+    if (only == NULL || strcmp(only, "convert") == 0) {
+        failed |= benchConvert();
+    }
+    if (only == NULL || strcmp(only, "hex") == 0) {
+        failed |= benchHex();
+    }
+    if (only == NULL || strcmp(only, "mux") == 0) {
+        failed |= benchMux();
+    }
+    if (only == NULL || strcmp(only, "decimate") == 0) {
+        failed |= benchDecimate();
+    }
+    if (only == NULL || strcmp(only, "output") == 0) {
+        failed |= benchOutput();
+    }
+    if (only == NULL || strcmp(only, "proto") == 0) {
+        failed |= benchProto();
+    }
+    if (only == NULL || strcmp(only, "correct") == 0) {
+        failed |= benchCorrect();
+    }
+    if (only == NULL || strcmp(only, "time") == 0) {
+        failed |= benchTime();
+    }
+    if (only == NULL || strcmp(only, "pipeline") == 0) {
+        failed |= benchPipeline();
+    }
+    if (only == NULL || strcmp(only, "capture") == 0) {
+        failed |= benchCapture();
+    }
+    if (only == NULL || strcmp(only, "pack") == 0) {
+        failed |= benchPack();
+    }
+    if (only == NULL || strcmp(only, "batch") == 0) {
+        failed |= benchBatch();
+    }
+    if (only == NULL || strcmp(only, "event") == 0) {
+        failed |= benchEvent();
+    }
+    if (only == NULL || strcmp(only, "stats") == 0) {
+        failed |= benchStats();
+    }
+    if (only == NULL || strcmp(only, "shm") == 0) {
+        failed |= benchShm();
+    }
+    if (only == NULL || strcmp(only, "reactor") == 0) {
+        failed |= benchReactor();
+    }
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
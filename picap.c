@@ -0,0 +1,458 @@
+#define _DEFAULT_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "picap.h"
+
+#define PI_CAP_HEADER_SIZE  sizeof(PiCapHeader_t)
+
+_Static_assert(sizeof(PiCapHeader_t) == 64, "capture header must be 64 bytes");
+_Static_assert(sizeof(PiProt_t) == 56, "capture records must be 56 bytes");
+
+/**
+ * @brief Returns the path of the sidecar index, to be freed by the caller.
+ */
+static char *piCapIndexPath(const char *path) {
+    size_t len = strlen(path);
+    char *indexPath = malloc(len + sizeof(".idx"));
+    if (indexPath != NULL) {
+        memcpy(indexPath, path, len);
+        memcpy(indexPath + len, ".idx", sizeof(".idx"));
+    }
+    return indexPath;
+}
+
+/**
+ * @brief Returns the time of a clock in nanoseconds.
+ */
+static uint64_t piCapNow(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief Preallocates room for `capacity` records and maps the whole file.
+ */
+static int piCapGrow(PiCapWriter_t *writer, uint64_t capacity) {
+    size_t size = PI_CAP_HEADER_SIZE + (size_t)capacity * sizeof(PiProt_t);
+    int err = posix_fallocate(writer->fd, 0, (off_t)size);
+
+    // Some file systems (e.g. tmpfs on old kernels) do not support fallocate, a sparse file works too.
+    // Other errors (ENOSPC, EFBIG) are reported: a store into a sparse mapping of a full disk raises SIGBUS
+    if (err == EOPNOTSUPP || err == EINVAL) {
+        err = ftruncate(writer->fd, (off_t)size) != 0 ? errno : 0;
+    }
+    if (err != 0) {
+        errno = err;
+        return -1;
+    }
+    uint8_t *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, writer->fd, 0);
+    if (map == MAP_FAILED) {
+        return -1;
+    }
+    if (writer->map != NULL) {
+        munmap(writer->map, writer->mapSize);
+    }
+    writer->map = map;
+    writer->mapSize = size;
+    writer->header = (PiCapHeader_t *)map;
+    writer->capacity = capacity;
+    return 0;
+}
+
+/**
+ * @brief Creates a capture file and its index.
+ *
+ * @param writer Writer state to initialize.
+ * @param path Path of the capture, the index is written to `<path>.idx`.
+ * @param hwSerial Hardware serial number of the device, 0 if not known yet.
+ * @param packetRate Packet rate in Hz.
+ * @return 0 on success, -1 on error (errno is set).
+ */
+int piCapCreate(PiCapWriter_t *writer, const char *path, uint32_t hwSerial, uint16_t packetRate) {
+    char *indexPath = piCapIndexPath(path);
+    int saved;
+
+    memset(writer, 0, sizeof(*writer));
+    writer->indexFd = -1;
+    if (indexPath == NULL) {
+        return -1;
+    }
+    writer->fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (writer->fd >= 0) {
+        writer->indexFd = open(indexPath, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+    }
+    free(indexPath);
+    if (writer->fd < 0 || writer->indexFd < 0 || piCapGrow(writer, PI_CAP_GROW_RECORDS) != 0) {
+        saved = errno;
+        if (writer->fd >= 0) {
+            close(writer->fd);
+        }
+        if (writer->indexFd >= 0) {
+            close(writer->indexFd);
+        }
+        errno = saved;
+        return -1;
+    }
+
+    PiCapHeader_t *header = writer->header;
+    header->magic = PI_CAP_MAGIC;
+    header->version = PI_CAP_VERSION;
+    header->recordSize = sizeof(PiProt_t);
+    header->hwSerial = hwSerial;
+    header->packetRate = packetRate;
+    header->indexInterval = PI_CAP_INDEX_INTERVAL;
+    header->startTimeNs = piCapNow(CLOCK_REALTIME);
+    header->startHostNs = piCapNow(CLOCK_MONOTONIC);
+    header->records = 0;
+    return 0;
+}
+
+/**
+ * @brief Appends one packet to the capture.
+ *
+ * @param writer Writer state.
+ * @param packet Packet to append.
+ * @param hostTimeNs Host time the packet was read (CLOCK_MONOTONIC).
+ * @return 0 on success, -1 if the file could not be grown (errno is set).
+ */
+int piCapAppend(PiCapWriter_t *writer, const PiProt_t *packet, uint64_t hostTimeNs) {
+    if (writer->records == writer->capacity && piCapGrow(writer, writer->capacity + PI_CAP_GROW_RECORDS) != 0) {
+        return -1;
+    }
+
+    // A lost packet advances the absolute sample number by the size of the sequence gap
+    if (writer->records == 0) {
+        writer->sample = packet->sequence;
+    } else {
+        writer->sample += (uint16_t)(packet->sequence - writer->lastSequence);
+    }
+    writer->lastSequence = packet->sequence;
+
+    if (writer->records % PI_CAP_INDEX_INTERVAL == 0) {
+        PiCapIndexEntry_t entry = { writer->sample, hostTimeNs, writer->records };
+        if (write(writer->indexFd, &entry, sizeof(entry)) != (ssize_t)sizeof(entry)) {
+            return -1;
+        }
+    }
+    memcpy(writer->map + PI_CAP_HEADER_SIZE + writer->records * sizeof(PiProt_t), packet, sizeof(PiProt_t));
+    writer->records++;
+    writer->header->records = writer->records;
+    return 0;
+}
+
+/**
+ * @brief Commits the records, truncates the file to its real size and closes it.
+ *
+ * @param writer Writer state.
+ * @return 0 on success, -1 on error (errno is set).
+ */
+int piCapFinish(PiCapWriter_t *writer) {
+    int result = 0;
+
+    writer->header->records = writer->records;
+    munmap(writer->map, writer->mapSize);
+    writer->map = NULL;
+    writer->header = NULL;
+    if (ftruncate(writer->fd, (off_t)(PI_CAP_HEADER_SIZE + writer->records * sizeof(PiProt_t))) != 0) {
+        result = -1;
+    }
+    if (close(writer->fd) != 0 || close(writer->indexFd) != 0) {
+        result = -1;
+    }
+    writer->fd = -1;
+    writer->indexFd = -1;
+    return result;
+}
+
+/**
+ * @brief Rebuilds the sparse index from the records, times are derived from the packet rate.
+ */
+static int piCapRebuildIndex(PiCapReader_t *reader) {
+    uint64_t interval = reader->header->indexInterval;
+    size_t count = (size_t)((reader->count + interval - 1) / interval);
+    PiCapIndexEntry_t *index = malloc((count ? count : 1) * sizeof(PiCapIndexEntry_t));
+    uint64_t sample = 0, first = 0;
+    uint16_t last = 0;
+
+    if (index == NULL) {
+        return -1;
+    }
+    for (uint64_t r = 0; r < reader->count; r++) {
+        uint16_t sequence = reader->records[r].sequence;
+        if (r == 0) {
+            sample = first = sequence;
+        } else {
+            sample += (uint16_t)(sequence - last);
+        }
+        last = sequence;
+        if (r % interval == 0) {
+            PiCapIndexEntry_t *entry = &index[r / interval];
+            entry->sample = sample;
+            entry->hostTimeNs = reader->header->startHostNs + (sample - first) * 1000000000ull / reader->header->packetRate;
+            entry->record = r;
+        }
+    }
+    reader->index = index;
+    reader->indexCount = count;
+    return 0;
+}
+
+/**
+ * @brief Maps the sidecar index if it matches the records.
+ */
+static void piCapMapIndex(PiCapReader_t *reader, const char *path) {
+    char *indexPath = piCapIndexPath(path);
+    uint64_t interval = reader->header->indexInterval;
+    size_t needed = (size_t)((reader->count + interval - 1) / interval);
+    struct stat st;
+    int fd = indexPath != NULL ? open(indexPath, O_RDONLY | O_CLOEXEC) : -1;
+
+    free(indexPath);
+    if (fd < 0) {
+        return;
+    }
+    if (needed != 0 && fstat(fd, &st) == 0 && (size_t)st.st_size / sizeof(PiCapIndexEntry_t) >= needed) {
+        void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (map != MAP_FAILED) {
+            const PiCapIndexEntry_t *index = map;
+            if (index[0].record == 0 && index[needed - 1].record == (needed - 1) * interval) {
+                reader->index = index;
+                reader->indexCount = needed;
+                reader->indexMap = map;
+                reader->indexMapSize = (size_t)st.st_size;
+            } else {
+                munmap(map, (size_t)st.st_size);
+            }
+        }
+    }
+    close(fd);
+}
+
+/**
+ * @brief Maps a capture for reading.
+ *
+ * @param reader Reader state to initialize.
+ * @param path Path of the capture.
+ * @return 0 on success, -1 on error (errno is set, EINVAL for a file that is not a capture).
+ */
+int piCapOpen(PiCapReader_t *reader, const char *path) {
+    struct stat st;
+    int saved;
+
+    memset(reader, 0, sizeof(*reader));
+    reader->fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (reader->fd < 0) {
+        return -1;
+    }
+    if (fstat(reader->fd, &st) != 0) {
+        goto fail;
+    }
+    if ((size_t)st.st_size < PI_CAP_HEADER_SIZE) {
+        errno = EINVAL;
+        goto fail;
+    }
+    reader->mapSize = (size_t)st.st_size;
+    reader->map = mmap(NULL, reader->mapSize, PROT_READ, MAP_SHARED, reader->fd, 0);
+    if (reader->map == MAP_FAILED) {
+        reader->map = NULL;
+        goto fail;
+    }
+    madvise((void *)reader->map, reader->mapSize, MADV_SEQUENTIAL);
+
+    reader->header = (const PiCapHeader_t *)reader->map;
+    if (reader->header->magic != PI_CAP_MAGIC || reader->header->version != PI_CAP_VERSION ||
+        reader->header->recordSize != sizeof(PiProt_t) || reader->header->indexInterval == 0 ||
+        reader->header->packetRate == 0) {
+        errno = EINVAL;
+        goto fail;
+    }
+    reader->records = (const PiProt_t *)(reader->map + PI_CAP_HEADER_SIZE);
+    reader->count = (reader->mapSize - PI_CAP_HEADER_SIZE) / sizeof(PiProt_t);
+    if (reader->header->records < reader->count) {
+        reader->count = reader->header->records;
+    }
+
+    piCapMapIndex(reader, path);
+    if (reader->index == NULL && piCapRebuildIndex(reader) != 0) {
+        goto fail;
+    }
+    return 0;
+
+fail:
+    saved = errno;
+    piCapClose(reader);
+    errno = saved;
+    return -1;
+}
+
+/**
+ * @brief Unmaps a capture.
+ *
+ * @param reader Reader state.
+ */
+void piCapClose(PiCapReader_t *reader) {
+    if (reader->indexMap != NULL) {
+        munmap(reader->indexMap, reader->indexMapSize);
+    } else {
+        free((void *)reader->index);
+    }
+    if (reader->map != NULL) {
+        munmap((void *)reader->map, reader->mapSize);
+    }
+    if (reader->fd >= 0) {
+        close(reader->fd);
+    }
+    memset(reader, 0, sizeof(*reader));
+    reader->fd = -1;
+}
+
+/**
+ * @brief Returns the last index entry whose key is not above `key`, or -1 if there is none.
+ */
+static ptrdiff_t piCapFindEntry(const PiCapReader_t *reader, uint64_t key, int byTime) {
+    size_t low = 0, high = reader->indexCount;
+
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        uint64_t value = byTime ? reader->index[mid].hostTimeNs : reader->index[mid].sample;
+        if (value <= key) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return (ptrdiff_t)low - 1;
+}
+
+/**
+ * @brief Finds the first record of an index interval whose sample number is at least `sample`.
+ *
+ * Within an interval spanning less than 2^16 samples the sample number of a record follows
+ * from its sequence number alone, so the interval is binary searched; otherwise the sequence
+ * numbers are unwrapped one by one.
+ */
+static uint64_t piCapSeekInInterval(const PiCapReader_t *reader, size_t found, uint64_t sample) {
+    const PiCapIndexEntry_t *entry = &reader->index[found];
+    uint64_t end = found + 1 < reader->indexCount ? reader->index[found + 1].record : reader->count;
+    uint16_t base = reader->records[entry->record].sequence;
+
+    if (found + 1 == reader->indexCount || reader->index[found + 1].sample - entry->sample < 0x10000) {
+        uint64_t low = entry->record, high = end;
+        while (low < high) {
+            uint64_t mid = low + (high - low) / 2;
+            if (entry->sample + (uint16_t)(reader->records[mid].sequence - base) < sample) {
+                low = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+        return low;
+    }
+
+    uint64_t current = entry->sample;
+    for (uint64_t r = entry->record; r < end; r++) {
+        if (r != entry->record) {
+            current += (uint16_t)(reader->records[r].sequence - reader->records[r - 1].sequence);
+        }
+        if (current >= sample) {
+            return r;
+        }
+    }
+    return end;
+}
+
+/**
+ * @brief Finds the first record whose absolute sample number is at least `sample`.
+ *
+ * @param reader Reader state.
+ * @param sample Absolute sample number.
+ * @return Record number, `reader->count` if every record is before `sample`.
+ */
+uint64_t piCapSeekSample(const PiCapReader_t *reader, uint64_t sample) {
+    ptrdiff_t found = piCapFindEntry(reader, sample, 0);
+    return found < 0 ? 0 : piCapSeekInInterval(reader, (size_t)found, sample);
+}
+
+/**
+ * @brief Finds the first record read at or after a host time.
+ *
+ * @param reader Reader state.
+ * @param hostTimeNs Host time (CLOCK_MONOTONIC of the capturing host).
+ * @return Record number, `reader->count` if every record is before `hostTimeNs`.
+ */
+uint64_t piCapSeekTime(const PiCapReader_t *reader, uint64_t hostTimeNs) {
+    ptrdiff_t found = piCapFindEntry(reader, hostTimeNs, 1);
+    if (found < 0) {
+        return 0;
+    }
+
+    // The interpolated time of a record reaches hostTimeNs at the first sample past this offset
+    const PiCapIndexEntry_t *entry = &reader->index[found];
+    uint64_t offset = (hostTimeNs - entry->hostTimeNs) * reader->header->packetRate;
+    return piCapSeekInInterval(reader, (size_t)found, entry->sample + (offset + 999999999ull) / 1000000000ull);
+}
+
+/**
+ * @brief Returns the host time of a record, interpolated from the preceding index entry.
+ */
+static uint64_t piCapRecordTime(const PiCapReader_t *reader, uint64_t record) {
+    const PiCapIndexEntry_t *entry = &reader->index[record / reader->header->indexInterval];
+    uint64_t current = entry->sample;
+    for (uint64_t r = entry->record + 1; r <= record; r++) {
+        current += (uint16_t)(reader->records[r].sequence - reader->records[r - 1].sequence);
+    }
+    return entry->hostTimeNs + (current - entry->sample) * 1000000000ull / reader->header->packetRate;
+}
+
+/**
+ * @brief Feeds records to a framer, as fast as possible or paced by the recorded host times.
+ *
+ * @param reader Reader state.
+ * @param first First record to replay.
+ * @param last Record after the last one to replay, clamped to `reader->count`.
+ * @param speed Replay speed relative to real time (2.0 is twice as fast), 0 for no pacing.
+ * @param framer Framer receiving the records.
+ * @return Number of packets delivered by the framer.
+ */
+uint64_t piCapReplay(const PiCapReader_t *reader, uint64_t first, uint64_t last, double speed, PiFramer_t *framer) {
+    uint64_t interval = reader->header->indexInterval;
+    uint64_t before = framer->packets;
+    uint64_t origin = 0, wallStart = 0;
+
+    if (last > reader->count) {
+        last = reader->count;
+    }
+    if (first >= last) {
+        return 0;
+    }
+    if (speed > 0) {
+        origin = piCapRecordTime(reader, first);
+        wallStart = piCapNow(CLOCK_MONOTONIC);
+    }
+
+    for (uint64_t r = first, next; r < last; r = next) {
+        next = (r / interval + 1) * interval;
+        if (next > last) {
+            next = last;
+        }
+        // Chunks after the first start on an index entry, whose host time is exact
+        if (speed > 0 && r != first) {
+            uint64_t recorded = reader->index[r / interval].hostTimeNs;
+            uint64_t due = wallStart + (recorded > origin ? (uint64_t)((double)(recorded - origin) / speed) : 0);
+            struct timespec ts = { .tv_sec = (time_t)(due / 1000000000ull), .tv_nsec = (long)(due % 1000000000ull) };
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+            }
+        }
+        piFramerFeed(framer, (const uint8_t *)(reader->records + r), (size_t)(next - r) * sizeof(PiProt_t));
+    }
+    return framer->packets - before;
+}
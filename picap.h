@@ -0,0 +1,185 @@
+/**
+ * @file picap.h
+ * @brief Memory-mapped binary capture files of IMU protocol packets.
+ *
+ * A capture is a 64-byte header followed by raw 56-byte `PiProt_t` records, exactly as they
+ * arrived on the link. The writer appends records into a preallocated shared mapping, so an
+ * append is a copy into memory; the file grows in large steps and is truncated to its real
+ * size when the capture is finished.
+ *
+ * A sparse index in a sidecar file (`<path>.idx`) holds one entry every
+ * `PI_CAP_INDEX_INTERVAL` records with the absolute sample number (the packet sequence
+ * unwrapped past 16 bits) and the host time of the record. Seeking to a sample or a time is
+ * a binary search of the index followed by a scan of at most one interval. The reader maps the
+ * file read-only and replays records through the same framer as live data without copying.
+ */
+
+#ifndef picap_h_included
+#define picap_h_included
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "pi.h"
+#include "piframer.h"
+
+#define PI_CAP_MAGIC            0x50414350u     // "PCAP" in file byte order
+#define PI_CAP_VERSION          1
+#define PI_CAP_INDEX_INTERVAL   1024            // Records between two index entries
+#define PI_CAP_GROW_RECORDS     (64 * 1024)     // Records preallocated at a time
+
+/**
+ * @struct PiCapHeader_t
+ * @brief Header at the start of a capture file.
+ */
+typedef struct {
+    uint32_t magic;             // PI_CAP_MAGIC
+    uint16_t version;           // PI_CAP_VERSION
+    uint16_t recordSize;        // sizeof(PiProt_t)
+    uint32_t hwSerial;          // Hardware serial number of the device, 0 if unknown
+    uint16_t packetRate;        // Packet rate in Hz
+    uint16_t indexInterval;     // Records between two index entries
+    uint64_t startTimeNs;       // CLOCK_REALTIME time the capture was created
+    uint64_t startHostNs;       // CLOCK_MONOTONIC time the capture was created
+    uint64_t records;           // Records committed
+    uint8_t reserved[24];
+} PiCapHeader_t;
+
+/**
+ * @struct PiCapIndexEntry_t
+ * @brief Sparse index entry, one every `indexInterval` records.
+ */
+typedef struct {
+    uint64_t sample;            // Absolute sample number of the record
+    uint64_t hostTimeNs;        // Host time of the record
+    uint64_t record;            // Record number in the file
+} PiCapIndexEntry_t;
+
+/**
+ * @struct PiCapWriter_t
+ * @brief State of a capture being written.
+ */
+typedef struct {
+    int fd;                     // Capture file
+    int indexFd;                // Sidecar index file
+    uint8_t *map;               // Shared mapping of the preallocated file
+    size_t mapSize;             // Bytes mapped
+    PiCapHeader_t *header;      // Header inside the mapping, `hwSerial` may be updated
+    uint64_t records;           // Records appended
+    uint64_t capacity;          // Records that fit in the mapping
+    uint64_t sample;            // Absolute sample number of the last record
+    uint16_t lastSequence;      // Sequence number of the last record
+} PiCapWriter_t;
+
+/**
+ * @struct PiCapReader_t
+ * @brief State of a capture opened for reading.
+ */
+typedef struct {
+    int fd;                             // Capture file
+    const uint8_t *map;                 // Read-only mapping of the file
+    size_t mapSize;                     // Bytes mapped
+    const PiCapHeader_t *header;        // File header
+    const PiProt_t *records;            // First record
+    uint64_t count;                     // Number of records
+    const PiCapIndexEntry_t *index;     // Sparse index
+    size_t indexCount;                  // Number of index entries
+    void *indexMap;                     // Mapping of the sidecar index, NULL if rebuilt
+    size_t indexMapSize;                // Bytes of the index mapping
+} PiCapReader_t;
+
+/**
+ * @brief Creates a capture file and its index.
+ *
+ * @param writer Writer state to initialize.
+ * @param path Path of the capture, the index is written to `<path>.idx`.
+ * @param hwSerial Hardware serial number of the device, 0 if not known yet.
+ * @param packetRate Packet rate in Hz.
+ * @return 0 on success, -1 on error (errno is set).
+ */
+int piCapCreate(PiCapWriter_t *writer, const char *path, uint32_t hwSerial, uint16_t packetRate);
+
+/**
+ * @brief Appends one packet to the capture.
+ *
+ * @param writer Writer state.
+ * @param packet Packet to append.
+ * @param hostTimeNs Host time the packet was read (CLOCK_MONOTONIC).
+ * @return 0 on success, -1 if the file could not be grown (errno is set).
+ */
+int piCapAppend(PiCapWriter_t *writer, const PiProt_t *packet, uint64_t hostTimeNs);
+
+/**
+ * @brief Commits the records, truncates the file to its real size and closes it.
+ *
+ * @param writer Writer state.
+ * @return 0 on success, -1 on error (errno is set).
+ */
+int piCapFinish(PiCapWriter_t *writer);
+
+/**
+ * @brief Maps a capture for reading.
+ *
+ * Uses the sidecar index when it is present and consistent, otherwise rebuilds the index in
+ * memory from the records, deriving the host times from the packet rate.
+ *
+ * @param reader Reader state to initialize.
+ * @param path Path of the capture.
+ * @return 0 on success, -1 on error (errno is set, EINVAL for a file that is not a capture).
+ */
+int piCapOpen(PiCapReader_t *reader, const char *path);
+
+/**
+ * @brief Unmaps a capture.
+ *
+ * @param reader Reader state.
+ */
+void piCapClose(PiCapReader_t *reader);
+
+/**
+ * @brief Returns a record of a capture, pointing into the mapping.
+ *
+ * @param reader Reader state.
+ * @param record Record number, less than `reader->count`.
+ * @return Pointer to the record.
+ */
+static inline const PiProt_t *piCapRecord(const PiCapReader_t *reader, uint64_t record) {
+    return reader->records + record;
+}
+
+/**
+ * @brief Finds the first record whose absolute sample number is at least `sample`.
+ *
+ * @param reader Reader state.
+ * @param sample Absolute sample number.
+ * @return Record number, `reader->count` if every record is before `sample`.
+ */
+uint64_t piCapSeekSample(const PiCapReader_t *reader, uint64_t sample);
+
+/**
+ * @brief Finds the first record read at or after a host time.
+ *
+ * Times between index entries are interpolated from the sample numbers and the packet rate.
+ *
+ * @param reader Reader state.
+ * @param hostTimeNs Host time (CLOCK_MONOTONIC of the capturing host).
+ * @return Record number, `reader->count` if every record is before `hostTimeNs`.
+ */
+uint64_t piCapSeekTime(const PiCapReader_t *reader, uint64_t hostTimeNs);
+
+/**
+ * @brief Feeds records to a framer, as fast as possible or paced by the recorded host times.
+ *
+ * The records are passed to `piFramerFeed` straight from the mapping in chunks of one index
+ * interval, so they take the same decode path as data read from a device.
+ *
+ * @param reader Reader state.
+ * @param first First record to replay.
+ * @param last Record after the last one to replay, clamped to `reader->count`.
+ * @param speed Replay speed relative to real time (2.0 is twice as fast), 0 for no pacing.
+ * @param framer Framer receiving the records.
+ * @return Number of packets delivered by the framer.
+ */
+uint64_t piCapReplay(const PiCapReader_t *reader, uint64_t first, uint64_t last, double speed, PiFramer_t *framer);
+
+#endif	/* #ifdef picap_h_included */
@@ -0,0 +1,350 @@
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define PI_CONV_HAVE_X86 1
+#include <immintrin.h>
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define PI_CONV_HAVE_NEON 1
+#include <arm_neon.h>
+#endif
+
+#include "piconv.h"
+
+#define PI_CONV_ALIGN   64
+#define PI_CONV_DATA    offsetof(PiProt_t, data.accl)   // First of the 10 converted 32-bit words
+
+/**
+ * @brief Conversion kernel, converts `count` packets into the block starting at index `at`.
+ */
+typedef void (*PiConvFunc_t)(const uint8_t *src, size_t stride, size_t count, PiSampleBlock_t *block, size_t at);
+
+/**
+ * @brief Allocates the arrays of a sample block.
+ *
+ * @param block Block to initialize.
+ * @param capacity Number of samples per array.
+ * @return 0 on success, -1 if the memory could not be allocated.
+ */
+int piSampleBlockAlloc(PiSampleBlock_t *block, size_t capacity) {
+    size_t padded = (capacity + 31) & ~(size_t)31;
+    size_t floats = padded * sizeof(float);
+    size_t words = padded * sizeof(uint16_t);
+    size_t size = (10 * floats + 3 * words + PI_CONV_ALIGN - 1) & ~(size_t)(PI_CONV_ALIGN - 1);
+    uint8_t *storage = aligned_alloc(PI_CONV_ALIGN, size ? size : PI_CONV_ALIGN);
+
+    memset(block, 0, sizeof(*block));
+    if (storage == NULL) {
+        return -1;
+    }
+    block->storage = storage;
+    block->capacity = capacity;
+    for (int k = 0; k < 3; k++) {
+        block->accl[k] = (float *)(storage + (0 + k) * floats);
+        block->gyro[k] = (float *)(storage + (3 + k) * floats);
+        block->magn[k] = (float *)(storage + (6 + k) * floats);
+    }
+    block->pressure = (float *)(storage + 9 * floats);
+    block->sequence = (uint16_t *)(storage + 10 * floats);
+    block->flags = (uint16_t *)(storage + 10 * floats + words);
+    block->fault = (uint16_t *)(storage + 10 * floats + 2 * words);
+    return 0;
+}
+
+/**
+ * @brief Releases the arrays of a sample block.
+ *
+ * @param block Block to release.
+ */
+void piSampleBlockFree(PiSampleBlock_t *block) {
+    free(block->storage);
+    memset(block, 0, sizeof(*block));
+}
+
+/**
+ * @brief Copies the integer fields (sequence, flags, fault) of a range of packets.
+ */
+static void piConvertWords(const uint8_t *src, size_t stride, size_t count, PiSampleBlock_t *block, size_t at) {
+    for (size_t i = 0; i < count; i++) {
+        const PiProt_t *packet = (const PiProt_t *)(src + i * stride);
+        block->sequence[at + i] = packet->sequence;
+        block->flags[at + i] = packet->data.flags.ui16;
+        block->fault[at + i] = packet->data.fault.ui16;
+    }
+}
+
+static void piConvertScalar(const uint8_t *src, size_t stride, size_t count, PiSampleBlock_t *block, size_t at) {
+    for (size_t i = 0; i < count; i++) {
+        const PiMainData_t *data = &((const PiProt_t *)(src + i * stride))->data;
+        for (int k = 0; k < 3; k++) {
+            block->accl[k][at + i] = fp1_14_17ToFloat(data->accl[k]);
+            block->gyro[k][at + i] = fp1_14_17ToFloat(data->gyro[k]);
+            block->magn[k][at + i] = fp1_10_21ToFloat(data->magn[k]);
+        }
+        block->pressure[at + i] = fp17_15ToFloat(data->pressure);
+    }
+    piConvertWords(src, stride, count, block, at);
+}
+
+#ifdef PI_CONV_HAVE_X86
+/**
+ * @brief Converts unsigned 32-bit integers to float with a single rounding, like a scalar cast.
+ *
+ * Both 16-bit halves convert exactly, so the final addition is the only rounding step.
+ */
+__attribute__((target("sse2")))
+static inline __m128 piConvU32ToPs(__m128i v) {
+    __m128 hi = _mm_cvtepi32_ps(_mm_srli_epi32(v, 16));
+    __m128 lo = _mm_cvtepi32_ps(_mm_and_si128(v, _mm_set1_epi32(0xffff)));
+    return _mm_add_ps(_mm_mul_ps(hi, _mm_set1_ps(65536.0f)), lo);
+}
+
+__attribute__((target("sse2")))
+static void piConvertSse2(const uint8_t *src, size_t stride, size_t count, PiSampleBlock_t *block, size_t at) {
+    const __m128 scaleGyro = _mm_set1_ps(1.0f / PI_GYRO_SCALE);
+    const __m128 scaleAccl = _mm_set1_ps(1.0f / PI_ACCL_SCALE);
+    const __m128 scaleMagn = _mm_set1_ps(1.0f / PI_MAGN_SCALE);
+    const __m128 scalePres = _mm_set1_ps(1.0f / PI_PRES_SCALE);
+    size_t i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        __m128 r[3][4];
+        for (int p = 0; p < 4; p++) {
+            const uint8_t *words = src + (i + p) * stride + PI_CONV_DATA;
+            r[0][p] = _mm_loadu_ps((const float *)(words + 0));
+            r[1][p] = _mm_loadu_ps((const float *)(words + 16));
+            r[2][p] = _mm_loadu_ps((const float *)(words + 32));
+        }
+        // Rows hold the words of one packet, after the transpose they hold one channel
+        _MM_TRANSPOSE4_PS(r[0][0], r[0][1], r[0][2], r[0][3]);
+        _MM_TRANSPOSE4_PS(r[1][0], r[1][1], r[1][2], r[1][3]);
+        _MM_TRANSPOSE4_PS(r[2][0], r[2][1], r[2][2], r[2][3]);
+
+        size_t o = at + i;
+        _mm_storeu_ps(block->accl[0] + o, _mm_mul_ps(_mm_cvtepi32_ps(_mm_castps_si128(r[0][0])), scaleAccl));
+        _mm_storeu_ps(block->accl[1] + o, _mm_mul_ps(_mm_cvtepi32_ps(_mm_castps_si128(r[0][1])), scaleAccl));
+        _mm_storeu_ps(block->accl[2] + o, _mm_mul_ps(_mm_cvtepi32_ps(_mm_castps_si128(r[0][2])), scaleAccl));
+        _mm_storeu_ps(block->gyro[0] + o, _mm_mul_ps(_mm_cvtepi32_ps(_mm_castps_si128(r[0][3])), scaleGyro));
+        _mm_storeu_ps(block->gyro[1] + o, _mm_mul_ps(_mm_cvtepi32_ps(_mm_castps_si128(r[1][0])), scaleGyro));
+        _mm_storeu_ps(block->gyro[2] + o, _mm_mul_ps(_mm_cvtepi32_ps(_mm_castps_si128(r[1][1])), scaleGyro));
+        _mm_storeu_ps(block->magn[0] + o, _mm_mul_ps(_mm_cvtepi32_ps(_mm_castps_si128(r[1][2])), scaleMagn));
+        _mm_storeu_ps(block->magn[1] + o, _mm_mul_ps(_mm_cvtepi32_ps(_mm_castps_si128(r[1][3])), scaleMagn));
+        _mm_storeu_ps(block->magn[2] + o, _mm_mul_ps(_mm_cvtepi32_ps(_mm_castps_si128(r[2][0])), scaleMagn));
+        _mm_storeu_ps(block->pressure + o, _mm_mul_ps(piConvU32ToPs(_mm_castps_si128(r[2][1])), scalePres));
+    }
+    piConvertScalar(src + i * stride, stride, count - i, block, at + i);
+    piConvertWords(src, stride, i, block, at);
+}
+
+__attribute__((target("avx2")))
+static inline __m256 piConvU32ToPs256(__m256i v) {
+    __m256 hi = _mm256_cvtepi32_ps(_mm256_srli_epi32(v, 16));
+    __m256 lo = _mm256_cvtepi32_ps(_mm256_and_si256(v, _mm256_set1_epi32(0xffff)));
+    return _mm256_add_ps(_mm256_mul_ps(hi, _mm256_set1_ps(65536.0f)), lo);
+}
+
+/**
+ * @brief Transposes four rows in each 128-bit lane.
+ */
+#define PI_CONV_TRANSPOSE4_256(r0, r1, r2, r3) do { \
+        __m256 t0 = _mm256_unpacklo_ps(r0, r1); \
+        __m256 t1 = _mm256_unpackhi_ps(r0, r1); \
+        __m256 t2 = _mm256_unpacklo_ps(r2, r3); \
+        __m256 t3 = _mm256_unpackhi_ps(r2, r3); \
+        r0 = _mm256_shuffle_ps(t0, t2, 0x44); \
+        r1 = _mm256_shuffle_ps(t0, t2, 0xee); \
+        r2 = _mm256_shuffle_ps(t1, t3, 0x44); \
+        r3 = _mm256_shuffle_ps(t1, t3, 0xee); \
+    } while (0)
+
+__attribute__((target("avx2")))
+static void piConvertAvx2(const uint8_t *src, size_t stride, size_t count, PiSampleBlock_t *block, size_t at) {
+    const __m256 scaleGyro = _mm256_set1_ps(1.0f / PI_GYRO_SCALE);
+    const __m256 scaleAccl = _mm256_set1_ps(1.0f / PI_ACCL_SCALE);
+    const __m256 scaleMagn = _mm256_set1_ps(1.0f / PI_MAGN_SCALE);
+    const __m256 scalePres = _mm256_set1_ps(1.0f / PI_PRES_SCALE);
+    size_t i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        __m256 r[3][4];
+        // Low lane holds packets 0..3, high lane packets 4..7
+        for (int p = 0; p < 4; p++) {
+            const uint8_t *lo = src + (i + p) * stride + PI_CONV_DATA;
+            const uint8_t *hi = src + (i + p + 4) * stride + PI_CONV_DATA;
+            for (int w = 0; w < 3; w++) {
+                r[w][p] = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps((const float *)(lo + 16 * w))),
+                                               _mm_loadu_ps((const float *)(hi + 16 * w)), 1);
+            }
+        }
+        PI_CONV_TRANSPOSE4_256(r[0][0], r[0][1], r[0][2], r[0][3]);
+        PI_CONV_TRANSPOSE4_256(r[1][0], r[1][1], r[1][2], r[1][3]);
+        PI_CONV_TRANSPOSE4_256(r[2][0], r[2][1], r[2][2], r[2][3]);
+
+        size_t o = at + i;
+        _mm256_storeu_ps(block->accl[0] + o, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_castps_si256(r[0][0])), scaleAccl));
+        _mm256_storeu_ps(block->accl[1] + o, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_castps_si256(r[0][1])), scaleAccl));
+        _mm256_storeu_ps(block->accl[2] + o, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_castps_si256(r[0][2])), scaleAccl));
+        _mm256_storeu_ps(block->gyro[0] + o, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_castps_si256(r[0][3])), scaleGyro));
+        _mm256_storeu_ps(block->gyro[1] + o, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_castps_si256(r[1][0])), scaleGyro));
+        _mm256_storeu_ps(block->gyro[2] + o, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_castps_si256(r[1][1])), scaleGyro));
+        _mm256_storeu_ps(block->magn[0] + o, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_castps_si256(r[1][2])), scaleMagn));
+        _mm256_storeu_ps(block->magn[1] + o, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_castps_si256(r[1][3])), scaleMagn));
+        _mm256_storeu_ps(block->magn[2] + o, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_castps_si256(r[2][0])), scaleMagn));
+        _mm256_storeu_ps(block->pressure + o, _mm256_mul_ps(piConvU32ToPs256(_mm256_castps_si256(r[2][1])), scalePres));
+    }
+    piConvertSse2(src + i * stride, stride, count - i, block, at + i);
+    piConvertWords(src, stride, i, block, at);
+}
+#endif
+
+#ifdef PI_CONV_HAVE_NEON
+static void piConvertNeon(const uint8_t *src, size_t stride, size_t count, PiSampleBlock_t *block, size_t at) {
+    const float32x4_t scaleGyro = vdupq_n_f32(1.0f / PI_GYRO_SCALE);
+    const float32x4_t scaleAccl = vdupq_n_f32(1.0f / PI_ACCL_SCALE);
+    const float32x4_t scaleMagn = vdupq_n_f32(1.0f / PI_MAGN_SCALE);
+    const float32x4_t scalePres = vdupq_n_f32(1.0f / PI_PRES_SCALE);
+    size_t i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        uint32x4_t c[12];
+        for (int w = 0; w < 3; w++) {
+            uint32x4_t r[4];
+            for (int p = 0; p < 4; p++) {
+                r[p] = vreinterpretq_u32_u8(vld1q_u8(src + (i + p) * stride + PI_CONV_DATA + 16 * w));
+            }
+            uint32x4x2_t t01 = vtrnq_u32(r[0], r[1]);
+            uint32x4x2_t t23 = vtrnq_u32(r[2], r[3]);
+            c[4 * w + 0] = vcombine_u32(vget_low_u32(t01.val[0]), vget_low_u32(t23.val[0]));
+            c[4 * w + 1] = vcombine_u32(vget_low_u32(t01.val[1]), vget_low_u32(t23.val[1]));
+            c[4 * w + 2] = vcombine_u32(vget_high_u32(t01.val[0]), vget_high_u32(t23.val[0]));
+            c[4 * w + 3] = vcombine_u32(vget_high_u32(t01.val[1]), vget_high_u32(t23.val[1]));
+        }
+
+        size_t o = at + i;
+        for (int k = 0; k < 3; k++) {
+            vst1q_f32(block->accl[k] + o, vmulq_f32(vcvtq_f32_s32(vreinterpretq_s32_u32(c[0 + k])), scaleAccl));
+            vst1q_f32(block->gyro[k] + o, vmulq_f32(vcvtq_f32_s32(vreinterpretq_s32_u32(c[3 + k])), scaleGyro));
+            vst1q_f32(block->magn[k] + o, vmulq_f32(vcvtq_f32_s32(vreinterpretq_s32_u32(c[6 + k])), scaleMagn));
+        }
+        vst1q_f32(block->pressure + o, vmulq_f32(vcvtq_f32_u32(c[9]), scalePres));
+    }
+    piConvertScalar(src + i * stride, stride, count - i, block, at + i);
+    piConvertWords(src, stride, i, block, at);
+}
+#endif
+
+static const PiConvFunc_t piConvKernels[PI_CONV_KERNEL_COUNT] = {
+    [PI_CONV_KERNEL_SCALAR] = piConvertScalar,
+#ifdef PI_CONV_HAVE_X86
+    [PI_CONV_KERNEL_SSE2] = piConvertSse2,
+    [PI_CONV_KERNEL_AVX2] = piConvertAvx2,
+#endif
+#ifdef PI_CONV_HAVE_NEON
+    [PI_CONV_KERNEL_NEON] = piConvertNeon,
+#endif
+};
+
+/**
+ * @brief Checks whether a kernel can run on this CPU.
+ *
+ * @param kernel Kernel to check.
+ * @return Non-zero if the kernel is supported.
+ */
+int piConvertKernelSupported(PiConvKernel_t kernel) {
+    if ((unsigned)kernel >= PI_CONV_KERNEL_COUNT || piConvKernels[kernel] == NULL) {
+        return 0;
+    }
+#ifdef PI_CONV_HAVE_X86
+    __builtin_cpu_init();
+    if (kernel == PI_CONV_KERNEL_SSE2) {
+        return __builtin_cpu_supports("sse2");
+    }
+    if (kernel == PI_CONV_KERNEL_AVX2) {
+        return __builtin_cpu_supports("avx2");
+    }
+#endif
+    return 1;
+}
+
+/**
+ * @brief Returns the fastest kernel supported by this CPU.
+ *
+ * The kernel is selected on the first call and kept afterwards.
+ *
+ * @return Kernel to use.
+ */
+PiConvKernel_t piConvertBestKernel(void) {
+    static _Atomic(PiConvKernel_t) selected = PI_CONV_KERNEL_COUNT;
+    PiConvKernel_t kernel = atomic_load_explicit(&selected, memory_order_relaxed);
+
+    if (kernel == PI_CONV_KERNEL_COUNT) {
+        kernel = PI_CONV_KERNEL_SCALAR;
+        if (piConvertKernelSupported(PI_CONV_KERNEL_AVX2)) {
+            kernel = PI_CONV_KERNEL_AVX2;
+        } else if (piConvertKernelSupported(PI_CONV_KERNEL_SSE2)) {
+            kernel = PI_CONV_KERNEL_SSE2;
+        } else if (piConvertKernelSupported(PI_CONV_KERNEL_NEON)) {
+            kernel = PI_CONV_KERNEL_NEON;
+        }
+        atomic_store_explicit(&selected, kernel, memory_order_relaxed);
+    }
+    return kernel;
+}
+
+/**
+ * @brief Converts packets with the given kernel.
+ *
+ * @param kernel Kernel to use.
+ * @param packets Pointer to the first packet.
+ * @param stride Distance in bytes between consecutive packets.
+ * @param count Number of packets.
+ * @param block Destination block, samples are stored from index `block->count`.
+ * @return Number of converted packets.
+ */
+size_t piConvertPacketsKernel(PiConvKernel_t kernel, const void *packets, size_t stride, size_t count, PiSampleBlock_t *block) {
+    size_t room = block->capacity - block->count;
+    if (count > room) {
+        count = room;
+    }
+    piConvKernels[kernel]((const uint8_t *)packets, stride, count, block, block->count);
+    block->count += count;
+    return count;
+}
+
+/**
+ * @brief Converts validated packets and appends them to a sample block.
+ *
+ * @param packets Pointer to the first packet.
+ * @param stride Distance in bytes between consecutive packets, `sizeof(PiProt_t)` for an array.
+ * @param count Number of packets.
+ * @param block Destination block, samples are stored from index `block->count`.
+ * @return Number of converted packets, limited by the free space in the block.
+ */
+size_t piConvertPackets(const void *packets, size_t stride, size_t count, PiSampleBlock_t *block) {
+    return piConvertPacketsKernel(piConvertBestKernel(), packets, stride, count, block);
+}
+
+/**
+ * @brief Returns a short name of a kernel.
+ *
+ * @param kernel Kernel.
+ * @return Kernel name.
+ */
+const char *piConvertKernelName(PiConvKernel_t kernel) {
+    switch (kernel) {
+        case PI_CONV_KERNEL_SCALAR:
+            return "scalar";
+        case PI_CONV_KERNEL_SSE2:
+            return "sse2";
+        case PI_CONV_KERNEL_AVX2:
+            return "avx2";
+        case PI_CONV_KERNEL_NEON:
+            return "neon";
+        case PI_CONV_KERNEL_COUNT:
+            break;
+    }
+    return "unknown";
+}
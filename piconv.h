@@ -0,0 +1,121 @@
+/**
+ * @file piconv.h
+ * @brief Block conversion of IMU protocol packets into structure-of-arrays float samples.
+ *
+ * Converts the packed fixed-point sensor values of a block of packets into contiguous float
+ * arrays per axis, as expected by the fusion code. The conversion uses AVX2, SSE2 or NEON
+ * kernels when available and a scalar fallback built on `fp1_14_17ToFloat`, `fp1_10_21ToFloat`
+ * and `fp17_15ToFloat`. All kernels are bit-exact with these helpers.
+ */
+
+#ifndef piconv_h_included
+#define piconv_h_included
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "pi.h"
+
+/**
+ * @struct PiSampleBlock_t
+ * @brief Structure-of-arrays block of converted samples.
+ */
+typedef struct {
+    size_t    capacity;      // Number of samples every array can hold
+    size_t    count;         // Number of samples stored
+    float    *accl[3];       // Accelerometer X, Y, Z
+    float    *gyro[3];       // Gyroscope X, Y, Z
+    float    *magn[3];       // Magnetometer X, Y, Z
+    float    *pressure;      // Pressure
+    uint16_t *sequence;      // Packet sequence numbers
+    uint16_t *flags;         // Raw PiFlags_t words
+    uint16_t *fault;         // Raw PiFault_t words
+    void     *storage;       // Single allocation backing all arrays
+} PiSampleBlock_t;
+
+/**
+ * @enum PiConvKernel_t
+ * @brief Available conversion implementations.
+ */
+typedef enum {
+    PI_CONV_KERNEL_SCALAR = 0,  // Per-field helpers from pi.h
+    PI_CONV_KERNEL_SSE2,        // 4 packets per step, x86 only
+    PI_CONV_KERNEL_AVX2,        // 8 packets per step, x86 only
+    PI_CONV_KERNEL_NEON,        // 4 packets per step, ARM only
+    PI_CONV_KERNEL_COUNT
+} PiConvKernel_t;
+
+/**
+ * @brief Allocates the arrays of a sample block.
+ *
+ * All arrays are 64-byte aligned and come from a single allocation.
+ *
+ * @param block Block to initialize.
+ * @param capacity Number of samples per array.
+ * @return 0 on success, -1 if the memory could not be allocated.
+ */
+int piSampleBlockAlloc(PiSampleBlock_t *block, size_t capacity);
+
+/**
+ * @brief Releases the arrays of a sample block.
+ *
+ * @param block Block to release.
+ */
+void piSampleBlockFree(PiSampleBlock_t *block);
+
+/**
+ * @brief Converts validated packets and appends them to a sample block.
+ *
+ * Uses the fastest kernel supported by the CPU. Packets are not validated; pass only packets
+ * accepted by `piCheckProtBuffer` or the framer.
+ *
+ * @param packets Pointer to the first packet.
+ * @param stride Distance in bytes between consecutive packets, `sizeof(PiProt_t)` for an array.
+ * @param count Number of packets.
+ * @param block Destination block, samples are stored from index `block->count`.
+ * @return Number of converted packets, limited by the free space in the block.
+ */
+size_t piConvertPackets(const void *packets, size_t stride, size_t count, PiSampleBlock_t *block);
+
+/**
+ * @brief Converts packets with the given kernel.
+ *
+ * Intended for benchmarking and cross-checking. The kernel must be supported,
+ * see `piConvertKernelSupported`.
+ *
+ * @param kernel Kernel to use.
+ * @param packets Pointer to the first packet.
+ * @param stride Distance in bytes between consecutive packets.
+ * @param count Number of packets.
+ * @param block Destination block, samples are stored from index `block->count`.
+ * @return Number of converted packets.
+ */
+size_t piConvertPacketsKernel(PiConvKernel_t kernel, const void *packets, size_t stride, size_t count, PiSampleBlock_t *block);
+
+/**
+ * @brief Checks whether a kernel can run on this CPU.
+ *
+ * @param kernel Kernel to check.
+ * @return Non-zero if the kernel is supported.
+ */
+int piConvertKernelSupported(PiConvKernel_t kernel);
+
+/**
+ * @brief Returns the fastest kernel supported by this CPU.
+ *
+ * AVX2, then SSE2, then NEON, then scalar. The choice is made once and shared by every
+ * module with per-kernel implementations.
+ *
+ * @return Kernel to use.
+ */
+PiConvKernel_t piConvertBestKernel(void);
+
+/**
+ * @brief Returns a short name of a kernel.
+ *
+ * @param kernel Kernel.
+ * @return Kernel name.
+ */
+const char *piConvertKernelName(PiConvKernel_t kernel);
+
+#endif	/* #ifdef piconv_h_included */
@@ -0,0 +1,462 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define PI_CRC_HAVE_CLMUL 1
+#include <immintrin.h>
+#endif
+
+#include "picrc.h"
+
+/**
+ * @brief Kernel updating a raw (not inverted) CRC32 state.
+ */
+typedef uint32_t (*PiCrcUpdate_t)(uint32_t crc, const uint8_t *buff, size_t len);
+
+/**
+ * @brief Slice-by-N lookup tables, table 0 is the classic byte-wise table.
+ */
+static uint32_t piCrcTables[16][256];
+static pthread_once_t piCrcTablesOnce = PTHREAD_ONCE_INIT;
+
+static uint32_t piCrc32Resolve(uint32_t crc, const uint8_t *buff, size_t len);
+static _Atomic(PiCrcUpdate_t) piCrcUpdate = piCrc32Resolve;
+static PiCrcKernel_t piCrcSelected = PI_CRC_KERNEL_TABLE;
+
+/**
+ * @brief Generates the slice-by-16 tables from CRC32_POLYNOM.
+ */
+static void piCrcInitTables(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (int j = 0; j < 8; j++) {
+            crc = (crc & 1) ? (crc >> 1) ^ CRC32_POLYNOM : crc >> 1;
+        }
+        piCrcTables[0][i] = crc;
+    }
+    for (int k = 1; k < 16; k++) {
+        for (int i = 0; i < 256; i++) {
+            uint32_t prev = piCrcTables[k - 1][i];
+            piCrcTables[k][i] = (prev >> 8) ^ piCrcTables[0][prev & 0xff];
+        }
+    }
+}
+
+/**
+ * @brief Loads a little-endian 32-bit word from an unaligned address.
+ */
+static inline uint32_t piCrcLoad32(const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap32(v);
+#endif
+    return v;
+}
+
+static uint32_t piCrc32UpdateTable(uint32_t crc, const uint8_t *buff, size_t len) {
+    const uint32_t (*t)[256] = (const uint32_t (*)[256])piCrcTables;
+    while (len--) {
+        crc = t[0][(crc ^ *buff++) & 0xff] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+static uint32_t piCrc32UpdateSlice8(uint32_t crc, const uint8_t *buff, size_t len) {
+    const uint32_t (*t)[256] = (const uint32_t (*)[256])piCrcTables;
+    while (len >= 8) {
+        uint32_t one = piCrcLoad32(buff) ^ crc;
+        uint32_t two = piCrcLoad32(buff + 4);
+        crc = t[7][one & 0xff] ^ t[6][(one >> 8) & 0xff] ^ t[5][(one >> 16) & 0xff] ^ t[4][one >> 24] ^
+              t[3][two & 0xff] ^ t[2][(two >> 8) & 0xff] ^ t[1][(two >> 16) & 0xff] ^ t[0][two >> 24];
+        buff += 8;
+        len -= 8;
+    }
+    return piCrc32UpdateTable(crc, buff, len);
+}
+
+static uint32_t piCrc32UpdateSlice16(uint32_t crc, const uint8_t *buff, size_t len) {
+    const uint32_t (*t)[256] = (const uint32_t (*)[256])piCrcTables;
+    while (len >= 16) {
+        uint32_t one = piCrcLoad32(buff) ^ crc;
+        uint32_t two = piCrcLoad32(buff + 4);
+        uint32_t three = piCrcLoad32(buff + 8);
+        uint32_t four = piCrcLoad32(buff + 12);
+        crc = t[15][one & 0xff] ^ t[14][(one >> 8) & 0xff] ^ t[13][(one >> 16) & 0xff] ^ t[12][one >> 24] ^
+              t[11][two & 0xff] ^ t[10][(two >> 8) & 0xff] ^ t[9][(two >> 16) & 0xff] ^ t[8][two >> 24] ^
+              t[7][three & 0xff] ^ t[6][(three >> 8) & 0xff] ^ t[5][(three >> 16) & 0xff] ^ t[4][three >> 24] ^
+              t[3][four & 0xff] ^ t[2][(four >> 8) & 0xff] ^ t[1][(four >> 16) & 0xff] ^ t[0][four >> 24];
+        buff += 16;
+        len -= 16;
+    }
+    return piCrc32UpdateSlice8(crc, buff, len);
+}
+
+#ifdef PI_CRC_HAVE_CLMUL
+/**
+ * @brief Folds 64-byte blocks with carry-less multiplication and Barrett-reduces the result.
+ *
+ * Bit-reflected constants for polynomial 0x04C11DB7 from Intel's "Fast CRC Computation for
+ * Generic Polynomials Using PCLMULQDQ Instruction". Requires `len >= 64` and a multiple of 16.
+ */
+__attribute__((target("pclmul,sse4.1")))
+static uint32_t piCrc32FoldClmul(uint32_t crc, const uint8_t *buff, size_t len) {
+    static const uint64_t k1k2[2] __attribute__((aligned(16))) = { 0x0154442bd4, 0x01c6e41596 };
+    static const uint64_t k3k4[2] __attribute__((aligned(16))) = { 0x01751997d0, 0x00ccaa009e };
+    static const uint64_t k5k0[2] __attribute__((aligned(16))) = { 0x0163cd6124, 0x0000000000 };
+    static const uint64_t poly[2] __attribute__((aligned(16))) = { 0x01db710641, 0x01f7011641 };
+    __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8, y5, y6, y7, y8;
+
+    x1 = _mm_loadu_si128((const __m128i *)(buff + 0x00));
+    x2 = _mm_loadu_si128((const __m128i *)(buff + 0x10));
+    x3 = _mm_loadu_si128((const __m128i *)(buff + 0x20));
+    x4 = _mm_loadu_si128((const __m128i *)(buff + 0x30));
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int)crc));
+    x0 = _mm_load_si128((const __m128i *)k1k2);
+    buff += 64;
+    len -= 64;
+
+    // Fold four 128-bit lanes in parallel
+    while (len >= 64) {
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+        x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+        x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+        y5 = _mm_loadu_si128((const __m128i *)(buff + 0x00));
+        y6 = _mm_loadu_si128((const __m128i *)(buff + 0x10));
+        y7 = _mm_loadu_si128((const __m128i *)(buff + 0x20));
+        y8 = _mm_loadu_si128((const __m128i *)(buff + 0x30));
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), y5);
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), y6);
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), y7);
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), y8);
+        buff += 64;
+        len -= 64;
+    }
+
+    // Fold the four lanes into one
+    x0 = _mm_load_si128((const __m128i *)k3k4);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+    // Single 16-byte folds
+    while (len >= 16) {
+        x2 = _mm_loadu_si128((const __m128i *)buff);
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+        buff += 16;
+        len -= 16;
+    }
+
+    // Fold 128 bits to 64 bits
+    x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+    x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+    x1 = _mm_srli_si128(x1, 8);
+    x1 = _mm_xor_si128(x1, x2);
+    x0 = _mm_loadl_epi64((const __m128i *)k5k0);
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, x3);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    // Barrett reduction to 32 bits
+    x0 = _mm_load_si128((const __m128i *)poly);
+    x2 = _mm_and_si128(x1, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+    x2 = _mm_and_si128(x2, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    return (uint32_t)_mm_extract_epi32(x1, 1);
+}
+
+static uint32_t piCrc32UpdateClmul(uint32_t crc, const uint8_t *buff, size_t len) {
+    if (len >= 64) {
+        size_t folded = len & ~(size_t)15;
+        crc = piCrc32FoldClmul(crc, buff, folded);
+        buff += folded;
+        len -= folded;
+    }
+    return piCrc32UpdateSlice8(crc, buff, len);
+}
+#endif
+
+static const PiCrcUpdate_t piCrcKernels[PI_CRC_KERNEL_COUNT] = {
+    [PI_CRC_KERNEL_TABLE] = piCrc32UpdateTable,
+    [PI_CRC_KERNEL_SLICE8] = piCrc32UpdateSlice8,
+    [PI_CRC_KERNEL_SLICE16] = piCrc32UpdateSlice16,
+#ifdef PI_CRC_HAVE_CLMUL
+    [PI_CRC_KERNEL_CLMUL] = piCrc32UpdateClmul,
+#endif
+};
+
+/**
+ * @brief Checks whether a kernel can run on this CPU.
+ *
+ * @param kernel Kernel to check.
+ * @return Non-zero if the kernel is supported.
+ */
+int piCrc32KernelSupported(PiCrcKernel_t kernel) {
+    if ((unsigned)kernel >= PI_CRC_KERNEL_COUNT || piCrcKernels[kernel] == NULL) {
+        return 0;
+    }
+#ifdef PI_CRC_HAVE_CLMUL
+    if (kernel == PI_CRC_KERNEL_CLMUL) {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1");
+    }
+#endif
+    return 1;
+}
+
+/**
+ * @brief Builds the tables and selects the kernel on the first call of `piCrc32Fast`.
+ *
+ * The CLMUL kernel only pays off for long buffers, short tails go through slice-by-8,
+ * which is also the best table kernel for the 50-byte protocol payload.
+ */
+static void piCrcSelect(void) {
+    piCrcInitTables();
+    piCrcSelected = piCrc32KernelSupported(PI_CRC_KERNEL_CLMUL) ? PI_CRC_KERNEL_CLMUL : PI_CRC_KERNEL_SLICE8;
+    atomic_store_explicit(&piCrcUpdate, piCrcKernels[piCrcSelected], memory_order_release);
+}
+
+static uint32_t piCrc32Resolve(uint32_t crc, const uint8_t *buff, size_t len) {
+    pthread_once(&piCrcTablesOnce, piCrcSelect);
+    return piCrcKernels[piCrcSelected](crc, buff, len);
+}
+
+/**
+ * @brief Calculates CRC32 checksum of a buffer with the fastest kernel available.
+ *
+ * @param buff Pointer to the buffer.
+ * @param len Length of the buffer in bytes.
+ * @return The computed CRC32 checksum, identical to `piCrc32`.
+ */
+uint32_t piCrc32Fast(const uint8_t *buff, size_t len) {
+    PiCrcUpdate_t update = atomic_load_explicit(&piCrcUpdate, memory_order_acquire);
+    return update(CRC32_INITIAL, buff, len) ^ CRC32_INITIAL;
+}
+
+/**
+ * @brief Calculates CRC32 checksum of a buffer with the given kernel.
+ *
+ * @param kernel Kernel to use.
+ * @param buff Pointer to the buffer.
+ * @param len Length of the buffer in bytes.
+ * @return The computed CRC32 checksum.
+ */
+uint32_t piCrc32Kernel(PiCrcKernel_t kernel, const uint8_t *buff, size_t len) {
+    pthread_once(&piCrcTablesOnce, piCrcSelect);
+    return piCrcKernels[kernel](CRC32_INITIAL, buff, len) ^ CRC32_INITIAL;
+}
+
+/**
+ * @brief Returns the kernel used by `piCrc32Fast`.
+ *
+ * @return The selected kernel.
+ */
+PiCrcKernel_t piCrc32SelectedKernel(void) {
+    pthread_once(&piCrcTablesOnce, piCrcSelect);
+    return piCrcSelected;
+}
+
+/**
+ * @brief One slice-by-8 step of a CRC32 chain over 8 payload bytes.
+ */
+static inline uint32_t piCrcStep8(const uint32_t (*t)[256], uint32_t crc, const uint8_t *p) {
+    uint32_t one = piCrcLoad32(p) ^ crc;
+    uint32_t two = piCrcLoad32(p + 4);
+    return t[7][one & 0xff] ^ t[6][(one >> 8) & 0xff] ^ t[5][(one >> 16) & 0xff] ^ t[4][one >> 24] ^
+           t[3][two & 0xff] ^ t[2][(two >> 8) & 0xff] ^ t[1][(two >> 16) & 0xff] ^ t[0][two >> 24];
+}
+
+/**
+ * @brief One byte-wise step of a CRC32 chain.
+ */
+static inline uint32_t piCrcStep1(const uint32_t (*t)[256], uint32_t crc, uint8_t b) {
+    return t[0][(crc ^ b) & 0xff] ^ (crc >> 8);
+}
+
+/**
+ * @brief Validates the header and stored CRC of one packet given its computed CRC.
+ */
+static inline PiProtError_t piCrcResult(const uint8_t *packet, uint32_t crc) {
+    const PiProt_t *prot = (const PiProt_t *)packet;
+    if (PI_HEADER != prot->header) {
+        return PI_PROT_BAD_HEADER;
+    }
+    return (uint32_t)(crc ^ CRC32_INITIAL) == prot->crc32 ? PI_PROT_OK : PI_PROT_BAD_CRC;
+}
+
+/**
+ * @brief Validates a block of IMU protocol packets.
+ *
+ * @param packets Pointer to the first packet.
+ * @param stride Distance in bytes between consecutive packets, `sizeof(PiProt_t)` for an array.
+ * @param count Number of packets.
+ * @param results Array of `count` entries receiving the result of every packet.
+ * @return Number of valid packets.
+ */
+size_t piCheckProtBuffers(const void *packets, size_t stride, size_t count, PiProtError_t *results) {
+    enum {
+        PAYLOAD_OFFSET = offsetof(PiProt_t, sequence),
+        PAYLOAD_SIZE = sizeof(PiProt_t) - sizeof(uint32_t) - sizeof(uint16_t),
+        PAYLOAD_WORDS = PAYLOAD_SIZE / 8
+    };
+    const uint32_t (*t)[256] = (const uint32_t (*)[256])piCrcTables;
+    const uint8_t *p = (const uint8_t *)packets;
+    size_t valid = 0;
+    size_t i = 0;
+
+    pthread_once(&piCrcTablesOnce, piCrcSelect);
+
+    // Four independent CRC chains in flight
+    for (; i + 4 <= count; i += 4) {
+        const uint8_t *p0 = p + (i + 0) * stride + PAYLOAD_OFFSET;
+        const uint8_t *p1 = p + (i + 1) * stride + PAYLOAD_OFFSET;
+        const uint8_t *p2 = p + (i + 2) * stride + PAYLOAD_OFFSET;
+        const uint8_t *p3 = p + (i + 3) * stride + PAYLOAD_OFFSET;
+        uint32_t c0 = CRC32_INITIAL, c1 = CRC32_INITIAL, c2 = CRC32_INITIAL, c3 = CRC32_INITIAL;
+        size_t j;
+
+        for (j = 0; j < PAYLOAD_WORDS * 8; j += 8) {
+            c0 = piCrcStep8(t, c0, p0 + j);
+            c1 = piCrcStep8(t, c1, p1 + j);
+            c2 = piCrcStep8(t, c2, p2 + j);
+            c3 = piCrcStep8(t, c3, p3 + j);
+        }
+        for (; j < PAYLOAD_SIZE; j++) {
+            c0 = piCrcStep1(t, c0, p0[j]);
+            c1 = piCrcStep1(t, c1, p1[j]);
+            c2 = piCrcStep1(t, c2, p2[j]);
+            c3 = piCrcStep1(t, c3, p3[j]);
+        }
+        results[i + 0] = piCrcResult(p0 - PAYLOAD_OFFSET, c0);
+        results[i + 1] = piCrcResult(p1 - PAYLOAD_OFFSET, c1);
+        results[i + 2] = piCrcResult(p2 - PAYLOAD_OFFSET, c2);
+        results[i + 3] = piCrcResult(p3 - PAYLOAD_OFFSET, c3);
+        valid += (results[i + 0] == PI_PROT_OK) + (results[i + 1] == PI_PROT_OK) +
+                 (results[i + 2] == PI_PROT_OK) + (results[i + 3] == PI_PROT_OK);
+    }
+    for (; i < count; i++) {
+        const uint8_t *packet = p + i * stride;
+        uint32_t crc = piCrc32UpdateSlice8(CRC32_INITIAL, packet + PAYLOAD_OFFSET, PAYLOAD_SIZE);
+        results[i] = piCrcResult(packet, crc);
+        valid += results[i] == PI_PROT_OK;
+    }
+    return valid;
+}
+
+/**
+ * @brief Returns a short name of a kernel.
+ *
+ * @param kernel Kernel.
+ * @return Kernel name.
+ */
+const char *piCrc32KernelName(PiCrcKernel_t kernel) {
+    switch (kernel) {
+        case PI_CRC_KERNEL_TABLE:
+            return "table";
+        case PI_CRC_KERNEL_SLICE8:
+            return "slice-by-8";
+        case PI_CRC_KERNEL_SLICE16:
+            return "slice-by-16";
+        case PI_CRC_KERNEL_CLMUL:
+            return "pclmulqdq";
+        case PI_CRC_KERNEL_COUNT:
+            break;
+    }
+    return "unknown";
+}
+
+#define PI_CRC_SYNDROME_BITS    10      // log2 of the syndrome table size
+
+/**
+ * @brief Syndrome of a single-bit error at every distance from the end of the message.
+ *
+ * Open addressing on the syndrome, `distance` holds the distance + 1, 0 for a free slot and
+ * UINT16_MAX for a syndrome shared by two distances.
+ */
+static struct {
+    uint32_t syndrome;
+    uint16_t distance;
+} piCrcSyndromes[1u << PI_CRC_SYNDROME_BITS];
+static pthread_once_t piCrcSyndromesOnce = PTHREAD_ONCE_INIT;
+
+static inline uint32_t piCrcSyndromeSlot(uint32_t syndrome) {
+    return (uint32_t)(syndrome * 0x9E3779B1u) >> (32 - PI_CRC_SYNDROME_BITS);
+}
+
+/**
+ * @brief Fills the syndrome table.
+ *
+ * The CRC is linear, so flipping a bit changes it by the CRC of the error alone, whatever
+ * the message, its initial value and final XOR. With a zero initial state the error bit
+ * gives `CRC32_POLYNOM`, and every further bit shifted in afterwards advances it one step:
+ * the syndrome only depends on the distance of the bit from the end of the message.
+ */
+static void piCrcInitSyndromes(void) {
+    uint32_t syndrome = CRC32_POLYNOM;
+
+    for (uint16_t distance = 0; distance < PI_CRC_CORRECT_MAX * 8; distance++) {
+        uint32_t slot = piCrcSyndromeSlot(syndrome);
+        while (piCrcSyndromes[slot].distance != 0 && piCrcSyndromes[slot].syndrome != syndrome) {
+            slot = (slot + 1) & ((1u << PI_CRC_SYNDROME_BITS) - 1);
+        }
+        piCrcSyndromes[slot].distance = piCrcSyndromes[slot].distance == 0 ? distance + 1 : UINT16_MAX;
+        piCrcSyndromes[slot].syndrome = syndrome;
+        syndrome = (syndrome & 1) ? (syndrome >> 1) ^ CRC32_POLYNOM : syndrome >> 1;
+    }
+}
+
+/**
+ * @brief Repairs a single-bit error in a message protected by a CRC32.
+ *
+ * @param buff Message covered by the CRC, repaired in place.
+ * @param len Length of the message, at most `PI_CRC_CORRECT_MAX` bytes.
+ * @param crc In/out stored CRC32, repaired if the error is in it.
+ * @return 1 if one bit was flipped, 0 if the CRC already matched, -1 if the error is not a
+ *         single-bit one.
+ */
+int piCrc32Correct(uint8_t *buff, size_t len, uint32_t *crc) {
+    uint32_t syndrome = piCrc32Fast(buff, len) ^ *crc;
+    uint32_t slot;
+
+    if (syndrome == 0) {
+        return 0;
+    }
+    // A flipped bit of the stored CRC is the only error with a single-bit syndrome
+    if ((syndrome & (syndrome - 1)) == 0) {
+        *crc ^= syndrome;
+        return 1;
+    }
+    pthread_once(&piCrcSyndromesOnce, piCrcInitSyndromes);
+    slot = piCrcSyndromeSlot(syndrome);
+    while (piCrcSyndromes[slot].distance != 0) {
+        if (piCrcSyndromes[slot].syndrome == syndrome) {
+            size_t distance = piCrcSyndromes[slot].distance - 1u;
+            if (piCrcSyndromes[slot].distance == UINT16_MAX || distance >= len * 8) {
+                return -1;
+            }
+            buff[len - 1 - distance / 8] ^= (uint8_t)(0x80 >> (distance % 8));
+            return 1;
+        }
+        slot = (slot + 1) & ((1u << PI_CRC_SYNDROME_BITS) - 1);
+    }
+    return -1;
+}
@@ -0,0 +1,135 @@
+/**
+ * @file picrc.h
+ * @brief Accelerated CRC32 kernels for the IMU protocol.
+ *
+ * Provides slice-by-8, slice-by-16 and carry-less multiply (PCLMULQDQ) implementations of the
+ * reflected 0xEDB88320 CRC32 used by `piCrc32`. All kernels produce results bit-identical to
+ * `piCrc32`. `piCrc32Fast` dispatches to the best kernel supported by the CPU; the choice is
+ * made once, on the first call, from CPUID. The byte-wise table loop is the fallback.
+ *
+ * `piCrc32Correct` locates a single-bit error from the CRC syndrome with one lookup in a table
+ * built on its first call.
+ */
+
+#ifndef picrc_h_included
+#define picrc_h_included
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "pi.h"
+
+#define PI_CRC_CORRECT_MAX  50      // Longest message whose single-bit errors can be located
+
+/**
+ * @enum PiCrcKernel_t
+ * @brief Available CRC32 implementations.
+ */
+typedef enum {
+    PI_CRC_KERNEL_TABLE = 0,    // Byte-at-a-time lookup, same as piCrc32
+    PI_CRC_KERNEL_SLICE8,       // Slice-by-8 lookup
+    PI_CRC_KERNEL_SLICE16,      // Slice-by-16 lookup
+    PI_CRC_KERNEL_CLMUL,        // PCLMULQDQ folding, x86 only
+    PI_CRC_KERNEL_COUNT
+} PiCrcKernel_t;
+
+/**
+ * @brief Calculates CRC32 checksum of a buffer with the fastest kernel available.
+ *
+ * @param buff Pointer to the buffer.
+ * @param len Length of the buffer in bytes.
+ * @return The computed CRC32 checksum, identical to `piCrc32`.
+ */
+uint32_t piCrc32Fast(const uint8_t *buff, size_t len);
+
+/**
+ * @brief Calculates CRC32 checksum of a buffer with the given kernel.
+ *
+ * Intended for benchmarking and cross-checking. The kernel must be supported,
+ * see `piCrc32KernelSupported`.
+ *
+ * @param kernel Kernel to use.
+ * @param buff Pointer to the buffer.
+ * @param len Length of the buffer in bytes.
+ * @return The computed CRC32 checksum.
+ */
+uint32_t piCrc32Kernel(PiCrcKernel_t kernel, const uint8_t *buff, size_t len);
+
+/**
+ * @brief Checks whether a kernel can run on this CPU.
+ *
+ * @param kernel Kernel to check.
+ * @return Non-zero if the kernel is supported.
+ */
+int piCrc32KernelSupported(PiCrcKernel_t kernel);
+
+/**
+ * @brief Returns the kernel used by `piCrc32Fast`.
+ *
+ * @return The selected kernel.
+ */
+PiCrcKernel_t piCrc32SelectedKernel(void);
+
+/**
+ * @brief Returns a short name of a kernel.
+ *
+ * @param kernel Kernel.
+ * @return Kernel name.
+ */
+const char *piCrc32KernelName(PiCrcKernel_t kernel);
+
+/**
+ * @brief Validates an IMU protocol packet using `piCrc32Fast`.
+ *
+ * Same checks and results as `piCheckProtBuffer`.
+ *
+ * @param buffer Pointer to the packet buffer.
+ * @return PiProtError_t Result of the validation.
+ */
+static inline PiProtError_t piCheckProtBufferFast(const void * buffer) {
+    const PiProt_t* prot = (const PiProt_t*)buffer;
+
+    if (PI_HEADER != prot->header) {
+        return PI_PROT_BAD_HEADER;
+    }
+
+    // CRC32 is calculated over all parts except header and crc32
+    if (piCrc32Fast((const uint8_t*)&prot->sequence, sizeof(PiProt_t) - sizeof(uint32_t) - sizeof(prot->header)) != prot->crc32) {
+        return PI_PROT_BAD_CRC;
+    }
+    return PI_PROT_OK;
+}
+
+/**
+ * @brief Validates a block of IMU protocol packets.
+ *
+ * Packets are validated in groups of four whose CRC32 chains are computed interleaved, so
+ * that independent table lookups overlap instead of waiting on a single dependency chain.
+ * Results are identical to calling `piCheckProtBuffer` on every packet.
+ *
+ * @param packets Pointer to the first packet.
+ * @param stride Distance in bytes between consecutive packets, `sizeof(PiProt_t)` for an array.
+ * @param count Number of packets.
+ * @param results Array of `count` entries receiving the result of every packet.
+ * @return Number of valid packets.
+ */
+size_t piCheckProtBuffers(const void *packets, size_t stride, size_t count, PiProtError_t *results);
+
+/**
+ * @brief Repairs a single-bit error in a message protected by a CRC32.
+ *
+ * The syndrome, the CRC of the message XOR the stored one, identifies the position of any
+ * single-bit error in a message of up to `PI_CRC_CORRECT_MAX` bytes or in the stored CRC.
+ * The CRC32 has a Hamming distance of 5 at these lengths, so errors of two or three bits are
+ * rejected rather than mistaken for a single-bit one; wider errors are mistaken about once in
+ * ten million.
+ *
+ * @param buff Message covered by the CRC, repaired in place.
+ * @param len Length of the message, at most `PI_CRC_CORRECT_MAX` bytes.
+ * @param crc In/out stored CRC32, repaired if the error is in it.
+ * @return 1 if one bit was flipped, 0 if the CRC already matched, -1 if the error is not a
+ *         single-bit one.
+ */
+int piCrc32Correct(uint8_t *buff, size_t len, uint32_t *crc);
+
+#endif	/* #ifdef picrc_h_included */
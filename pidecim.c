@@ -0,0 +1,331 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define PI_DECIM_HAVE_X86 1
+#include <immintrin.h>
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define PI_DECIM_HAVE_NEON 1
+#include <arm_neon.h>
+#endif
+
+#include "pidecim.h"
+
+#define PI_DECIM_ALIGN      64
+#define PI_DECIM_STATE      0x0007u     // State field of PiFlags_t, taken from the newest input
+#define PI_DECIM_OVERRANGE  0x1FF8u     // Overrange bits of PiFlags_t, OR-propagated
+
+/**
+ * @brief Filter kernel, computes the 16 columns of the dot product of `taps` rows and coefficients.
+ */
+typedef void (*PiDecimDotFunc_t)(const float *rows, const float *coefficients, unsigned taps, float *out);
+
+/**
+ * @brief Rounds a size up to the allocation alignment.
+ */
+static size_t piDecimAlign(size_t size) {
+    return (size + PI_DECIM_ALIGN - 1) & ~(size_t)(PI_DECIM_ALIGN - 1);
+}
+
+/**
+ * @brief Designs a Blackman-windowed sinc low-pass filter with unity gain at DC.
+ */
+static void piDecimDesign(float *coefficients, unsigned taps, unsigned factor) {
+    const double pi = 3.14159265358979323846;
+    const double cutoff = 0.4 / factor;     // Cycles per input sample
+    const double center = (taps - 1) / 2.0;
+    double sum = 0;
+    double *h = malloc(taps * sizeof(double));
+
+    for (unsigned n = 0; n < taps; n++) {
+        double x = n - center;
+        double sinc = x == 0 ? 2 * cutoff : sin(2 * pi * cutoff * x) / (pi * x);
+        double phase = taps > 1 ? 2 * pi * n / (taps - 1) : 0;
+        h[n] = sinc * (0.42 - 0.5 * cos(phase) + 0.08 * cos(2 * phase));
+        sum += h[n];
+    }
+    for (unsigned n = 0; n < taps; n++) {
+        coefficients[n] = (float)(h[n] / sum);
+    }
+    free(h);
+}
+
+/**
+ * @brief Designs the filters and allocates the state of a decimator.
+ *
+ * @param dec Decimator to initialize.
+ * @param factors Decimation factor of every output, at least 2.
+ * @param count Number of outputs, at most `PI_DECIM_MAX_OUTPUTS`.
+ * @param taps Filter length of every output, 0 for 16 taps per unit of factor.
+ * @return 0 on success, -1 on invalid factors or if the memory could not be allocated.
+ */
+int piDecimInit(PiDecimator_t *dec, const unsigned *factors, size_t count, unsigned taps) {
+    size_t coefficientsSize = 0, size;
+    uint8_t *storage;
+
+    memset(dec, 0, sizeof(*dec));
+    if (count == 0 || count > PI_DECIM_MAX_OUTPUTS) {
+        return -1;
+    }
+    for (size_t s = 0; s < count; s++) {
+        PiDecimStage_t *stage = &dec->stages[s];
+        if (factors[s] < 2) {
+            return -1;
+        }
+        stage->factor = factors[s];
+        stage->taps = taps != 0 ? taps : 16 * factors[s];
+        if (stage->taps > PI_DECIM_MAX_TAPS) {
+            stage->taps = PI_DECIM_MAX_TAPS;
+        }
+        stage->design = stage->taps;
+        stage->taps = (stage->taps + 3) & ~3u;
+        if (stage->taps > dec->history) {
+            dec->history = stage->taps;
+        }
+        coefficientsSize += piDecimAlign(stage->taps * sizeof(float));
+    }
+    dec->count = (unsigned)count;
+
+    // Every row is stored twice, so the newest `history` rows are always contiguous
+    size = coefficientsSize + piDecimAlign(2 * dec->history * PI_DECIM_ROW * sizeof(float)) +
+           2 * piDecimAlign(2 * dec->history * sizeof(uint16_t));
+    storage = aligned_alloc(PI_DECIM_ALIGN, size);
+    if (storage == NULL) {
+        return -1;
+    }
+    memset(storage, 0, size);
+    dec->storage = storage;
+    for (size_t s = 0; s < count; s++) {
+        PiDecimStage_t *stage = &dec->stages[s];
+        stage->coefficients = (float *)storage;
+        piDecimDesign(stage->coefficients + stage->taps - stage->design, stage->design, stage->factor);
+        storage += piDecimAlign(stage->taps * sizeof(float));
+    }
+    dec->rows = (float *)storage;
+    storage += piDecimAlign(2 * dec->history * PI_DECIM_ROW * sizeof(float));
+    dec->flags = (uint16_t *)storage;
+    storage += piDecimAlign(2 * dec->history * sizeof(uint16_t));
+    dec->fault = (uint16_t *)storage;
+    return 0;
+}
+
+/**
+ * @brief Releases the state of a decimator.
+ *
+ * @param dec Decimator to release.
+ */
+void piDecimFree(PiDecimator_t *dec) {
+    free(dec->storage);
+    memset(dec, 0, sizeof(*dec));
+}
+
+/*
+ * Every kernel sums the taps in four interleaved partial sums (taps 0, 4, 8... in the first,
+ * 1, 5, 9... in the second) combined as (s0 + s1) + (s2 + s3) at the end. The vector kernels
+ * hide the latency of the additions and all kernels give the same bits. Filters are padded
+ * on their oldest side with zero coefficients to a multiple of 4 taps.
+ */
+static void piDecimDotScalar(const float *rows, const float *coefficients, unsigned taps, float *out) {
+    for (int c = 0; c < PI_DECIM_CHANNELS; c++) {
+        float sum[4] = { 0, 0, 0, 0 };
+        for (unsigned k = 0; k < taps; k += 4) {
+            for (int j = 0; j < 4; j++) {
+                sum[j] += coefficients[k + j] * rows[(k + j) * PI_DECIM_ROW + c];
+            }
+        }
+        out[c] = (sum[0] + sum[1]) + (sum[2] + sum[3]);
+    }
+}
+
+#ifdef PI_DECIM_HAVE_X86
+__attribute__((target("sse2")))
+static void piDecimDotSse2(const float *rows, const float *coefficients, unsigned taps, float *out) {
+    __m128 sum[4][3];
+
+    // The padding columns 12..15 are never read
+    for (int j = 0; j < 4; j++) {
+        sum[j][0] = sum[j][1] = sum[j][2] = _mm_setzero_ps();
+    }
+    for (unsigned k = 0; k < taps; k += 4) {
+        for (int j = 0; j < 4; j++) {
+            const float *row = rows + (k + j) * PI_DECIM_ROW;
+            __m128 h = _mm_set1_ps(coefficients[k + j]);
+            sum[j][0] = _mm_add_ps(sum[j][0], _mm_mul_ps(h, _mm_load_ps(row)));
+            sum[j][1] = _mm_add_ps(sum[j][1], _mm_mul_ps(h, _mm_load_ps(row + 4)));
+            sum[j][2] = _mm_add_ps(sum[j][2], _mm_mul_ps(h, _mm_load_ps(row + 8)));
+        }
+    }
+    for (int v = 0; v < 3; v++) {
+        _mm_storeu_ps(out + 4 * v, _mm_add_ps(_mm_add_ps(sum[0][v], sum[1][v]), _mm_add_ps(sum[2][v], sum[3][v])));
+    }
+}
+
+__attribute__((target("avx2")))
+static void piDecimDotAvx2(const float *rows, const float *coefficients, unsigned taps, float *out) {
+    __m256 sum[4][2];
+
+    for (int j = 0; j < 4; j++) {
+        sum[j][0] = sum[j][1] = _mm256_setzero_ps();
+    }
+    for (unsigned k = 0; k < taps; k += 4) {
+        for (int j = 0; j < 4; j++) {
+            const float *row = rows + (k + j) * PI_DECIM_ROW;
+            __m256 h = _mm256_broadcast_ss(&coefficients[k + j]);
+            sum[j][0] = _mm256_add_ps(sum[j][0], _mm256_mul_ps(h, _mm256_load_ps(row)));
+            sum[j][1] = _mm256_add_ps(sum[j][1], _mm256_mul_ps(h, _mm256_load_ps(row + 8)));
+        }
+    }
+    for (int v = 0; v < 2; v++) {
+        _mm256_storeu_ps(out + 8 * v, _mm256_add_ps(_mm256_add_ps(sum[0][v], sum[1][v]), _mm256_add_ps(sum[2][v], sum[3][v])));
+    }
+}
+#endif
+
+#ifdef PI_DECIM_HAVE_NEON
+static void piDecimDotNeon(const float *rows, const float *coefficients, unsigned taps, float *out) {
+    float32x4_t sum[4][3];
+
+    for (int j = 0; j < 4; j++) {
+        sum[j][0] = sum[j][1] = sum[j][2] = vdupq_n_f32(0);
+    }
+    // Separate multiply and add, a fused multiply-add would not match the scalar kernel
+    for (unsigned k = 0; k < taps; k += 4) {
+        for (int j = 0; j < 4; j++) {
+            const float *row = rows + (k + j) * PI_DECIM_ROW;
+            float32x4_t h = vdupq_n_f32(coefficients[k + j]);
+            sum[j][0] = vaddq_f32(sum[j][0], vmulq_f32(h, vld1q_f32(row)));
+            sum[j][1] = vaddq_f32(sum[j][1], vmulq_f32(h, vld1q_f32(row + 4)));
+            sum[j][2] = vaddq_f32(sum[j][2], vmulq_f32(h, vld1q_f32(row + 8)));
+        }
+    }
+    for (int v = 0; v < 3; v++) {
+        vst1q_f32(out + 4 * v, vaddq_f32(vaddq_f32(sum[0][v], sum[1][v]), vaddq_f32(sum[2][v], sum[3][v])));
+    }
+}
+#endif
+
+static const PiDecimDotFunc_t piDecimKernels[PI_CONV_KERNEL_COUNT] = {
+    [PI_CONV_KERNEL_SCALAR] = piDecimDotScalar,
+#ifdef PI_DECIM_HAVE_X86
+    [PI_CONV_KERNEL_SSE2] = piDecimDotSse2,
+    [PI_CONV_KERNEL_AVX2] = piDecimDotAvx2,
+#endif
+#ifdef PI_DECIM_HAVE_NEON
+    [PI_CONV_KERNEL_NEON] = piDecimDotNeon,
+#endif
+};
+
+/**
+ * @brief Stores input sample `i` of a block as the newest history row.
+ */
+static void piDecimPush(PiDecimator_t *dec, const PiSampleBlock_t *in, size_t i) {
+    unsigned history = dec->history;
+    float row[PI_DECIM_ROW] = { 0 };
+
+    for (int k = 0; k < 3; k++) {
+        row[0 + k] = in->accl[k][i];
+        row[3 + k] = in->gyro[k][i];
+        row[6 + k] = in->magn[k][i];
+    }
+    row[9] = in->pressure[i];
+
+    if (dec->inputs == 0) {
+        // Start from a history filled with the first sample instead of a step from zero
+        for (unsigned r = 0; r < 2 * history; r++) {
+            memcpy(dec->rows + r * PI_DECIM_ROW, row, sizeof(row));
+            dec->flags[r] = 0;
+            dec->fault[r] = 0;
+        }
+        dec->position = history - 1;
+    }
+    dec->position = dec->position + 1 == history ? 0 : dec->position + 1;
+    memcpy(dec->rows + dec->position * PI_DECIM_ROW, row, sizeof(row));
+    memcpy(dec->rows + (dec->position + history) * PI_DECIM_ROW, row, sizeof(row));
+    dec->flags[dec->position] = dec->flags[dec->position + history] = in->flags[i];
+    dec->fault[dec->position] = dec->fault[dec->position + history] = in->fault[i];
+    dec->inputs++;
+}
+
+/**
+ * @brief Computes the output sample of a stage from the newest history rows.
+ */
+static void piDecimOutput(PiDecimDotFunc_t dot, PiDecimator_t *dec, PiDecimStage_t *stage, uint16_t sequence, PiSampleBlock_t *out) {
+    unsigned first = dec->position + dec->history + 1 - stage->taps;
+    uint16_t flags = 0, fault = 0;
+    float sum[PI_DECIM_ROW];
+    size_t o = out->count;
+
+    dot(dec->rows + first * PI_DECIM_ROW, stage->coefficients, stage->taps, sum);
+    for (int k = 0; k < 3; k++) {
+        out->accl[k][o] = sum[0 + k];
+        out->gyro[k][o] = sum[3 + k];
+        out->magn[k][o] = sum[6 + k];
+    }
+    out->pressure[o] = sum[9];
+
+    // Only the inputs under the designed taps carry into the output, not the zero padding
+    for (unsigned r = first + stage->taps - stage->design; r < first + stage->taps; r++) {
+        flags |= dec->flags[r];
+        fault |= dec->fault[r];
+    }
+    out->sequence[o] = sequence;
+    out->flags[o] = (uint16_t)((flags & PI_DECIM_OVERRANGE) | (dec->flags[dec->position] & PI_DECIM_STATE));
+    out->fault[o] = fault;
+    out->count = o + 1;
+    stage->outputs++;
+}
+
+/**
+ * @brief Filters samples with the given kernel.
+ *
+ * @param kernel Kernel to use.
+ * @param dec Decimator state.
+ * @param in Input block.
+ * @param first Index of the first input sample.
+ * @param count Number of input samples.
+ * @param out Output block of every output rate.
+ * @return Number of input samples consumed.
+ */
+size_t piDecimProcessKernel(PiConvKernel_t kernel, PiDecimator_t *dec, const PiSampleBlock_t *in, size_t first, size_t count,
+                            PiSampleBlock_t *const *out) {
+    PiDecimDotFunc_t dot = piDecimKernels[kernel];
+    size_t i;
+
+    for (i = 0; i < count; i++) {
+        unsigned s;
+        for (s = 0; s < dec->count; s++) {
+            if (dec->stages[s].phase + 1 == dec->stages[s].factor && out[s]->count == out[s]->capacity) {
+                break;
+            }
+        }
+        if (s < dec->count) {
+            break;
+        }
+
+        piDecimPush(dec, in, first + i);
+        for (s = 0; s < dec->count; s++) {
+            PiDecimStage_t *stage = &dec->stages[s];
+            if (++stage->phase == stage->factor) {
+                stage->phase = 0;
+                piDecimOutput(dot, dec, stage, in->sequence[first + i], out[s]);
+            }
+        }
+    }
+    return i;
+}
+
+/**
+ * @brief Filters a range of samples and appends the decimated samples to the output blocks.
+ *
+ * @param dec Decimator state.
+ * @param in Input block.
+ * @param first Index of the first input sample.
+ * @param count Number of input samples.
+ * @param out Output block of every output rate, in the order of `factors`.
+ * @return Number of input samples consumed.
+ */
+size_t piDecimProcess(PiDecimator_t *dec, const PiSampleBlock_t *in, size_t first, size_t count, PiSampleBlock_t *const *out) {
+    return piDecimProcessKernel(piConvertBestKernel(), dec, in, first, count, out);
+}
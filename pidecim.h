@@ -0,0 +1,114 @@
+/**
+ * @file pidecim.h
+ * @brief Streaming anti-aliased decimation of converted samples to lower rates.
+ *
+ * A decimator runs one windowed-sinc FIR low-pass filter per output rate over the ten float
+ * channels of a `PiSampleBlock_t` (accl, gyro, magn, pressure) and keeps one output sample
+ * every `factor` inputs; only the kept outputs are computed. All outputs share one history of
+ * the input, stored interleaved with the ten channels of a sample padded to 16 floats, so the
+ * filter of every output runs vectorized across the channels (AVX2, SSE2 or NEON, with a
+ * bit-exact scalar fallback). The state persists between calls, blocks of any size can be
+ * fed.
+ *
+ * The fault word of an output sample is the OR of the fault words of all inputs under its
+ * filter, and so are the overrange bits of its flags word; the state field of the flags is
+ * the one of the newest input. The sequence number is the one of the newest input, the
+ * filter delays the signal by (taps - 1) / 2 inputs.
+ */
+
+#ifndef pidecim_h_included
+#define pidecim_h_included
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "piconv.h"
+
+#define PI_DECIM_MAX_OUTPUTS    4       // Output rates per decimator
+#define PI_DECIM_MAX_TAPS       512     // Longest filter
+#define PI_DECIM_CHANNELS       10      // Float channels of a sample block
+#define PI_DECIM_ROW            16      // Floats per interleaved history row
+
+/**
+ * @struct PiDecimStage_t
+ * @brief Filter and output state of one output rate.
+ */
+typedef struct {
+    unsigned factor;            // Inputs per output sample
+    unsigned design;            // Filter length as designed
+    unsigned taps;              // Filter length padded with zero taps to a multiple of 4
+    unsigned phase;             // Inputs since the last output
+    float *coefficients;        // Filter taps, oldest input first
+    uint64_t outputs;           // Output samples produced
+} PiDecimStage_t;
+
+/**
+ * @struct PiDecimator_t
+ * @brief Decimator state.
+ */
+typedef struct {
+    unsigned count;                                 // Output rates
+    PiDecimStage_t stages[PI_DECIM_MAX_OUTPUTS];    // Filter of every output rate
+    unsigned history;                               // Rows kept, the longest filter
+    unsigned position;                              // Row of the newest input
+    float *rows;                                    // 2 * history interleaved rows
+    uint16_t *flags;                                // 2 * history flags words
+    uint16_t *fault;                                // 2 * history fault words
+    uint64_t inputs;                                // Input samples consumed
+    void *storage;                                  // Single allocation backing all arrays
+} PiDecimator_t;
+
+/**
+ * @brief Designs the filters and allocates the state of a decimator.
+ *
+ * Every filter is a Blackman-windowed sinc with its cutoff at 0.4 times the output rate and
+ * unity gain at DC.
+ *
+ * @param dec Decimator to initialize.
+ * @param factors Decimation factor of every output, at least 2.
+ * @param count Number of outputs, at most `PI_DECIM_MAX_OUTPUTS`.
+ * @param taps Filter length of every output, 0 for 16 taps per unit of factor.
+ * @return 0 on success, -1 on invalid factors or if the memory could not be allocated.
+ */
+int piDecimInit(PiDecimator_t *dec, const unsigned *factors, size_t count, unsigned taps);
+
+/**
+ * @brief Releases the state of a decimator.
+ *
+ * @param dec Decimator to release.
+ */
+void piDecimFree(PiDecimator_t *dec);
+
+/**
+ * @brief Filters a range of samples and appends the decimated samples to the output blocks.
+ *
+ * Uses the fastest kernel supported by the CPU. Stops before an input that would produce
+ * an output for a full block.
+ *
+ * @param dec Decimator state.
+ * @param in Input block.
+ * @param first Index of the first input sample.
+ * @param count Number of input samples.
+ * @param out Output block of every output rate, in the order of `factors`.
+ * @return Number of input samples consumed.
+ */
+size_t piDecimProcess(PiDecimator_t *dec, const PiSampleBlock_t *in, size_t first, size_t count, PiSampleBlock_t *const *out);
+
+/**
+ * @brief Filters samples with the given kernel.
+ *
+ * Intended for benchmarking and cross-checking. The kernel must be supported,
+ * see `piConvertKernelSupported`.
+ *
+ * @param kernel Kernel to use.
+ * @param dec Decimator state.
+ * @param in Input block.
+ * @param first Index of the first input sample.
+ * @param count Number of input samples.
+ * @param out Output block of every output rate.
+ * @return Number of input samples consumed.
+ */
+size_t piDecimProcessKernel(PiConvKernel_t kernel, PiDecimator_t *dec, const PiSampleBlock_t *in, size_t first, size_t count,
+                            PiSampleBlock_t *const *out);
+
+#endif	/* #ifdef pidecim_h_included */
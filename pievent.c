@@ -0,0 +1,418 @@
+#define _DEFAULT_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define PI_EVENT_HAVE_X86 1
+#include <immintrin.h>
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define PI_EVENT_HAVE_NEON 1
+#include <arm_neon.h>
+#endif
+
+#include "picrc.h"
+#include "pievent.h"
+
+#define PI_EVENT_STATUS         4       // Offset of the status word in a packet
+#define PI_EVENT_MIN_CAPACITY   256     // Events allocated on the first growth
+
+/**
+ * @brief Skip kernel, returns the number of leading packets whose status word equals `status`.
+ */
+typedef size_t (*PiEventSkipFunc_t)(const uint8_t *src, size_t stride, size_t count, uint32_t status);
+
+static const char *const piEventBitNames[32] = {
+    [3] = "gyroXOverange",
+    [4] = "gyroYOverange",
+    [5] = "gyroZOverange",
+    [6] = "acclXOverange",
+    [7] = "acclYOverange",
+    [8] = "acclZOverange",
+    [9] = "magnetometerXOverange",
+    [10] = "magnetometerYOverange",
+    [11] = "magnetometerZOverange",
+    [12] = "pressureOverange",
+    [PI_EVENT_FAULT_SHIFT + 0] = "fault",
+    [PI_EVENT_FAULT_SHIFT + 1] = "xAcclFault",
+    [PI_EVENT_FAULT_SHIFT + 2] = "xGyroFault",
+    [PI_EVENT_FAULT_SHIFT + 3] = "xMagnFault",
+    [PI_EVENT_FAULT_SHIFT + 4] = "pressureFault",
+    [PI_EVENT_FAULT_SHIFT + 5] = "undervoltage",
+    [PI_EVENT_FAULT_SHIFT + 6] = "overvoltage",
+    [PI_EVENT_FAULT_SHIFT + 7] = "undertemperature",
+    [PI_EVENT_FAULT_SHIFT + 8] = "overtemperature",
+    [PI_EVENT_FAULT_SHIFT + 9] = "firmwareCRCError",
+    [PI_EVENT_FAULT_SHIFT + 10] = "configCRCError",
+};
+
+/**
+ * @brief Returns the path of the sidecar event file, to be freed by the caller.
+ */
+static char *piEventPath(const char *path) {
+    size_t len = strlen(path);
+    char *eventPath = malloc(len + sizeof(".evt"));
+    if (eventPath != NULL) {
+        memcpy(eventPath, path, len);
+        memcpy(eventPath + len, ".evt", sizeof(".evt"));
+    }
+    return eventPath;
+}
+
+static size_t piEventSkipScalar(const uint8_t *src, size_t stride, size_t count, uint32_t status) {
+    size_t i = 0;
+    while (i < count && piEventStatus((const PiProt_t *)(src + i * stride)) == status) {
+        i++;
+    }
+    return i;
+}
+
+#ifdef PI_EVENT_HAVE_X86
+__attribute__((target("sse2")))
+static size_t piEventSkipSse2(const uint8_t *src, size_t stride, size_t count, uint32_t status) {
+    const __m128i match = _mm_set1_epi32((int)status);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        // Load 16 bytes from the status word of every packet and keep their first 32-bit lane
+        const uint8_t *p = src + i * stride + PI_EVENT_STATUS;
+        __m128i ab = _mm_unpacklo_epi32(_mm_loadu_si128((const __m128i *)p), _mm_loadu_si128((const __m128i *)(p + stride)));
+        __m128i cd = _mm_unpacklo_epi32(_mm_loadu_si128((const __m128i *)(p + 2 * stride)),
+                                        _mm_loadu_si128((const __m128i *)(p + 3 * stride)));
+        int mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(_mm_unpacklo_epi64(ab, cd), match)));
+        if (mask != 0xF) {
+            return i + (size_t)__builtin_ctz(~mask);
+        }
+    }
+    return i + piEventSkipScalar(src + i * stride, stride, count - i, status);
+}
+
+__attribute__((target("avx2")))
+static size_t piEventSkipAvx2(const uint8_t *src, size_t stride, size_t count, uint32_t status) {
+    const __m256i match = _mm256_set1_epi32((int)status);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        // Packets 0-3 go to the low lane and 4-7 to the high lane, the unpacks keep them in order
+        const uint8_t *lo = src + i * stride + PI_EVENT_STATUS;
+        const uint8_t *hi = lo + 4 * stride;
+        __m256i r[4];
+        for (unsigned p = 0; p < 4; p++) {
+            r[p] = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)(lo + p * stride))),
+                                           _mm_loadu_si128((const __m128i *)(hi + p * stride)), 1);
+        }
+        __m256i words = _mm256_unpacklo_epi64(_mm256_unpacklo_epi32(r[0], r[1]), _mm256_unpacklo_epi32(r[2], r[3]));
+        int mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(words, match)));
+        if (mask != 0xFF) {
+            return i + (size_t)__builtin_ctz(~mask);
+        }
+    }
+    return i + piEventSkipSse2(src + i * stride, stride, count - i, status);
+}
+#endif
+
+#ifdef PI_EVENT_HAVE_NEON
+static size_t piEventSkipNeon(const uint8_t *src, size_t stride, size_t count, uint32_t status) {
+    const uint32x4_t match = vdupq_n_u32(status);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const uint8_t *p = src + i * stride + PI_EVENT_STATUS;
+        uint32x4_t ab = vzipq_u32(vreinterpretq_u32_u8(vld1q_u8(p)), vreinterpretq_u32_u8(vld1q_u8(p + stride))).val[0];
+        uint32x4_t cd = vzipq_u32(vreinterpretq_u32_u8(vld1q_u8(p + 2 * stride)),
+                                  vreinterpretq_u32_u8(vld1q_u8(p + 3 * stride))).val[0];
+        uint32x4_t eq = vceqq_u32(vcombine_u32(vget_low_u32(ab), vget_low_u32(cd)), match);
+        uint32x2_t all = vand_u32(vget_low_u32(eq), vget_high_u32(eq));
+        if ((vget_lane_u32(all, 0) & vget_lane_u32(all, 1)) != UINT32_MAX) {
+            return i + piEventSkipScalar(p - PI_EVENT_STATUS, stride, 4, status);
+        }
+    }
+    return i + piEventSkipScalar(src + i * stride, stride, count - i, status);
+}
+#endif
+
+static const PiEventSkipFunc_t piEventKernels[PI_CONV_KERNEL_COUNT] = {
+    [PI_CONV_KERNEL_SCALAR] = piEventSkipScalar,
+#ifdef PI_EVENT_HAVE_X86
+    [PI_CONV_KERNEL_SSE2] = piEventSkipSse2,
+    [PI_CONV_KERNEL_AVX2] = piEventSkipAvx2,
+#endif
+#ifdef PI_EVENT_HAVE_NEON
+    [PI_CONV_KERNEL_NEON] = piEventSkipNeon,
+#endif
+};
+
+/**
+ * @brief Appends an event, returns -1 if it could not be stored.
+ */
+static int piEventAppend(PiEventScanner_t *scanner, uint64_t record, uint64_t since, uint16_t sequence, uint8_t kind, uint8_t value) {
+    if (scanner->count == scanner->capacity) {
+        size_t capacity = scanner->capacity != 0 ? 2 * scanner->capacity : PI_EVENT_MIN_CAPACITY;
+        PiEvent_t *events = realloc(scanner->events, capacity * sizeof(PiEvent_t));
+        if (events == NULL) {
+            return -1;
+        }
+        scanner->events = events;
+        scanner->capacity = capacity;
+    }
+    PiEvent_t *event = &scanner->events[scanner->count++];
+    event->record = record;
+    event->run = record - since > UINT32_MAX ? UINT32_MAX : (uint32_t)(record - since);
+    event->sequence = sequence;
+    event->kind = kind;
+    event->value = value;
+    return 0;
+}
+
+/**
+ * @brief Turns the status word of an accepted record into events and makes it current.
+ */
+static int piEventChange(PiEventScanner_t *scanner, uint64_t record, uint16_t sequence, uint32_t status) {
+    int result = 0;
+    uint32_t changed;
+    if (!scanner->started) {
+        // First record: its state and the bits already set, with runs of 0
+        result |= piEventAppend(scanner, record, record, sequence, PI_EVENT_STATE,
+                                (uint8_t)(PI_EVENT_STATE_UNKNOWN << 4 | (status & PI_EVENT_STATE_MASK)));
+        scanner->stateSince = record;
+        for (unsigned bit = 0; bit < 32; bit++) {
+            scanner->since[bit] = record;
+        }
+        changed = status & ~PI_EVENT_STATE_MASK;
+        scanner->started = 1;
+    } else {
+        changed = status ^ scanner->status;
+        if (changed & PI_EVENT_STATE_MASK) {
+            result |= piEventAppend(scanner, record, scanner->stateSince, sequence, PI_EVENT_STATE,
+                                    (uint8_t)((scanner->status & PI_EVENT_STATE_MASK) << 4 | (status & PI_EVENT_STATE_MASK)));
+            scanner->stateSince = record;
+        }
+        changed &= ~PI_EVENT_STATE_MASK;
+    }
+    while (changed != 0) {
+        unsigned bit = (unsigned)__builtin_ctz(changed);
+        changed &= changed - 1;
+        result |= piEventAppend(scanner, record, scanner->since[bit], sequence,
+                                (status >> bit & 1) ? PI_EVENT_RISE : PI_EVENT_FALL, (uint8_t)bit);
+        scanner->since[bit] = record;
+    }
+    scanner->status = status;
+    return result;
+}
+
+/**
+ * @brief Initializes a scanner.
+ *
+ * @param scanner Scanner to initialize.
+ * @param validate Non-zero to check the CRC of the records bringing a change.
+ */
+void piEventInit(PiEventScanner_t *scanner, int validate) {
+    memset(scanner, 0, sizeof(*scanner));
+    scanner->validate = validate != 0;
+}
+
+/**
+ * @brief Releases the events of a scanner.
+ *
+ * @param scanner Scanner state.
+ */
+void piEventFree(PiEventScanner_t *scanner) {
+    free(scanner->events);
+    scanner->events = NULL;
+    scanner->count = 0;
+    scanner->capacity = 0;
+}
+
+/**
+ * @brief Scans packets with the given kernel.
+ *
+ * Only the packets the kernel finds different from the current status word are looked at
+ * one by one.
+ *
+ * @param kernel Kernel to use.
+ * @param scanner Scanner state.
+ * @param packets Pointer to the first packet.
+ * @param stride Distance in bytes between consecutive packets.
+ * @param count Number of packets.
+ * @return 0 on success, -1 if the events could not be stored.
+ */
+int piEventScanKernel(PiConvKernel_t kernel, PiEventScanner_t *scanner, const void *packets, size_t stride, size_t count) {
+    PiEventSkipFunc_t skip = piEventKernels[kernel];
+    const uint8_t *src = packets;
+    int result = 0;
+    size_t i = 0;
+    while (i < count) {
+        if (scanner->started) {
+            i += skip(src + i * stride, stride, count - i, scanner->status);
+            if (i == count) {
+                break;
+            }
+        }
+        const PiProt_t *packet = (const PiProt_t *)(src + i * stride);
+        if (scanner->validate && piCheckProtBufferFast(packet) != PI_PROT_OK) {
+            scanner->rejected++;
+        } else {
+            result |= piEventChange(scanner, scanner->records + i, packet->sequence, piEventStatus(packet));
+        }
+        i++;
+    }
+    scanner->records += count;
+    if (result != 0) {
+        errno = ENOMEM;
+    }
+    return result;
+}
+
+/**
+ * @brief Scans packets of the current format and appends their events.
+ *
+ * @param scanner Scanner state.
+ * @param packets Pointer to the first packet.
+ * @param stride Distance in bytes between consecutive packets.
+ * @param count Number of packets.
+ * @return 0 on success, -1 if the events could not be stored.
+ */
+int piEventScan(PiEventScanner_t *scanner, const void *packets, size_t stride, size_t count) {
+    return piEventScanKernel(piConvertBestKernel(), scanner, packets, stride, count);
+}
+
+/**
+ * @brief Returns the name of a bit of the status word.
+ *
+ * @param bit Bit, 0 to 31.
+ * @return Field name, NULL for the state field and for reserved bits.
+ */
+const char *piEventBitName(unsigned bit) {
+    return bit < 32 ? piEventBitNames[bit] : NULL;
+}
+
+/**
+ * @brief Returns the name of a state.
+ *
+ * @param state Value of the state field, or `PI_EVENT_STATE_UNKNOWN`.
+ * @return State name.
+ */
+const char *piEventStateName(unsigned state) {
+    static const char *const names[] = { "ready", "prepare", "warmup", "fault", "state 4", "state 5", "state 6", "state 7" };
+    if (state == PI_EVENT_STATE_UNKNOWN) {
+        return "unknown";
+    }
+    return state < sizeof(names) / sizeof(names[0]) ? names[state] : "invalid";
+}
+
+/**
+ * @brief Writes the events and the scanner state to the sidecar file of a capture.
+ *
+ * The file is written under a temporary name and renamed, so a reader never sees a partial one.
+ *
+ * @param scanner Scanner state.
+ * @param path Path of the capture, the events are written to `<path>.evt`.
+ * @param startTimeNs Creation time in the header of the capture.
+ * @return 0 on success, -1 on error (errno is set).
+ */
+int piEventSave(const PiEventScanner_t *scanner, const char *path, uint64_t startTimeNs) {
+    char *eventPath = piEventPath(path);
+    if (eventPath == NULL) {
+        return -1;
+    }
+    size_t len = strlen(eventPath);
+    char *tmpPath = malloc(len + sizeof(".tmp"));
+    if (tmpPath == NULL) {
+        free(eventPath);
+        return -1;
+    }
+    memcpy(tmpPath, eventPath, len);
+    memcpy(tmpPath + len, ".tmp", sizeof(".tmp"));
+
+    PiEventFileHeader_t header;
+    memset(&header, 0, sizeof(header));
+    header.magic = PI_EVENT_MAGIC;
+    header.version = PI_EVENT_VERSION;
+    header.eventSize = sizeof(PiEvent_t);
+    header.startTimeNs = startTimeNs;
+    header.records = scanner->records;
+    header.count = scanner->count;
+    header.rejected = scanner->rejected;
+    header.stateSince = scanner->stateSince;
+    header.status = scanner->status;
+    header.started = scanner->started;
+    header.validate = scanner->validate;
+    memcpy(header.since, scanner->since, sizeof(header.since));
+
+    int result = -1;
+    int fd = open(tmpPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd >= 0) {
+        size_t eventBytes = scanner->count * sizeof(PiEvent_t);
+        int written = write(fd, &header, sizeof(header)) == (ssize_t)sizeof(header) &&
+                      (eventBytes == 0 || write(fd, scanner->events, eventBytes) == (ssize_t)eventBytes);
+        if (close(fd) == 0 && written && rename(tmpPath, eventPath) == 0) {
+            result = 0;
+        } else {
+            int err = errno;
+            unlink(tmpPath);
+            errno = err;
+        }
+    }
+    free(tmpPath);
+    free(eventPath);
+    return result;
+}
+
+/**
+ * @brief Loads the events and the scanner state from the sidecar file of a capture.
+ *
+ * @param scanner Scanner to initialize, to be released with `piEventFree`.
+ * @param path Path of the capture.
+ * @param records Records of the capture.
+ * @param startTimeNs Creation time in the header of the capture.
+ * @return 0 on success, -1 if the sidecar is missing or does not match (errno is set).
+ */
+int piEventLoad(PiEventScanner_t *scanner, const char *path, uint64_t records, uint64_t startTimeNs) {
+    piEventInit(scanner, 0);
+    char *eventPath = piEventPath(path);
+    if (eventPath == NULL) {
+        return -1;
+    }
+    int fd = open(eventPath, O_RDONLY);
+    free(eventPath);
+    if (fd < 0) {
+        return -1;
+    }
+
+    PiEventFileHeader_t header;
+    ssize_t got = read(fd, &header, sizeof(header));
+    if (got != (ssize_t)sizeof(header) || header.magic != PI_EVENT_MAGIC || header.version != PI_EVENT_VERSION ||
+        header.eventSize != sizeof(PiEvent_t) || header.startTimeNs != startTimeNs || header.records > records ||
+        header.count > 32 * header.records) {
+        close(fd);
+        errno = EINVAL;
+        return -1;
+    }
+    if (header.count != 0) {
+        size_t eventBytes = (size_t)header.count * sizeof(PiEvent_t);
+        scanner->events = malloc(eventBytes);
+        if (scanner->events == NULL) {
+            close(fd);
+            return -1;
+        }
+        scanner->capacity = (size_t)header.count;
+        if (read(fd, scanner->events, eventBytes) != (ssize_t)eventBytes) {
+            piEventFree(scanner);
+            close(fd);
+            errno = EINVAL;
+            return -1;
+        }
+    }
+    close(fd);
+    scanner->count = (size_t)header.count;
+    scanner->records = header.records;
+    scanner->rejected = header.rejected;
+    scanner->stateSince = header.stateSince;
+    scanner->status = header.status;
+    scanner->started = header.started;
+    scanner->validate = header.validate;
+    memcpy(scanner->since, header.since, sizeof(scanner->since));
+    return 0;
+}
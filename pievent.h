@@ -0,0 +1,199 @@
+/**
+ * @file pievent.h
+ * @brief Extraction of state transitions and fault/overrange edges from packet streams.
+ *
+ * The status word of a packet is its `PiFlags_t` word in the low 16 bits and its `PiFault_t`
+ * word in the high 16 bits. The scanner walks packets in bulk and only looks closer at the
+ * ones whose status word differs from the previous packet: the SIMD kernels compare the
+ * status words of 4 (SSE2, NEON) or 8 (AVX2) packets at a time against the current one, so
+ * a long recording where nothing happens costs one compare per group of packets.
+ *
+ * Every change becomes a compact `PiEvent_t`: a transition of the 3-bit state field, or the
+ * rising or falling edge of any other bit, with the record where it happened and the run
+ * length of the previous value in records. The first packet reports its state and the bits
+ * already set. With validation enabled, a packet bringing a change is checked first and
+ * ignored if it fails, so a corrupted record of a capture does not create a pair of edges.
+ *
+ * The event list of a capture can be kept in a sidecar file (`<path>.evt`) together with
+ * the scanner state, so a capture that grew only has its new records scanned.
+ */
+
+#ifndef pievent_h_included
+#define pievent_h_included
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "pi.h"
+#include "piconv.h"
+
+#define PI_EVENT_MAGIC          0x54564550u     // "PEVT" in file byte order
+#define PI_EVENT_VERSION        1
+#define PI_EVENT_STATE_MASK     0x00000007u     // State field of the status word
+#define PI_EVENT_STATE_UNKNOWN  0xF             // Previous state of the first packet
+#define PI_EVENT_FAULT_SHIFT    16              // Position of the `PiFault_t` word in the status word
+
+/**
+ * @enum PiEventKind_t
+ * @brief Kinds of events.
+ */
+typedef enum {
+    PI_EVENT_STATE = 0,         // The state field changed
+    PI_EVENT_RISE,              // A bit was set
+    PI_EVENT_FALL               // A bit was cleared
+} PiEventKind_t;
+
+/**
+ * @struct PiEvent_t
+ * @brief One change of the status word.
+ */
+typedef struct {
+    uint64_t record;            // Record of the packet bringing the change, counted from the start of the scan
+    uint32_t run;               // Records the previous value lasted, saturated
+    uint16_t sequence;          // Sequence number of the packet
+    uint8_t kind;               // PiEventKind_t
+    uint8_t value;              // Bit of the status word, or the new state and the previous one above it
+} PiEvent_t;
+
+/**
+ * @struct PiEventScanner_t
+ * @brief Scanner state and events found.
+ */
+typedef struct {
+    PiEvent_t *events;          // Events, in record order
+    size_t count;               // Number of events
+    size_t capacity;            // Events allocated
+    uint64_t records;           // Records scanned
+    uint64_t rejected;          // Records with a change that failed validation
+    uint64_t stateSince;        // Record of the last state transition
+    uint64_t since[32];         // Record of the last edge of every bit
+    uint32_t status;            // Status word of the last accepted record
+    uint8_t started;            // A record was accepted
+    uint8_t validate;           // Validate the records bringing a change
+} PiEventScanner_t;
+
+/**
+ * @struct PiEventFileHeader_t
+ * @brief Header of a sidecar event file, followed by the events.
+ */
+typedef struct {
+    uint32_t magic;             // PI_EVENT_MAGIC
+    uint16_t version;           // PI_EVENT_VERSION
+    uint16_t eventSize;         // sizeof(PiEvent_t)
+    uint64_t startTimeNs;       // Creation time of the capture, tells a sidecar of an older capture apart
+    uint64_t records;           // Records of the capture scanned
+    uint64_t count;             // Events that follow
+    uint64_t rejected;          // Scanner state, restored on loading
+    uint64_t stateSince;
+    uint32_t status;
+    uint8_t started;
+    uint8_t validate;
+    uint8_t reserved[2];
+    uint64_t since[32];
+} PiEventFileHeader_t;
+
+/**
+ * @brief Returns the new state of a `PI_EVENT_STATE` event.
+ */
+static inline unsigned piEventState(const PiEvent_t *event) {
+    return event->value & 0x0F;
+}
+
+/**
+ * @brief Returns the previous state of a `PI_EVENT_STATE` event, `PI_EVENT_STATE_UNKNOWN` for the first packet.
+ */
+static inline unsigned piEventPreviousState(const PiEvent_t *event) {
+    return event->value >> 4;
+}
+
+/**
+ * @brief Returns the status word of a packet.
+ */
+static inline uint32_t piEventStatus(const PiProt_t *packet) {
+    return packet->data.flags.ui16 | (uint32_t)packet->data.fault.ui16 << PI_EVENT_FAULT_SHIFT;
+}
+
+/**
+ * @brief Initializes a scanner.
+ *
+ * @param scanner Scanner to initialize.
+ * @param validate Non-zero to check the CRC of the records bringing a change, for captures
+ *                 that may hold rejected packets.
+ */
+void piEventInit(PiEventScanner_t *scanner, int validate);
+
+/**
+ * @brief Releases the events of a scanner.
+ *
+ * @param scanner Scanner state.
+ */
+void piEventFree(PiEventScanner_t *scanner);
+
+/**
+ * @brief Scans packets of the current format and appends their events.
+ *
+ * Uses the fastest kernel supported by the CPU. The packets continue the records scanned
+ * before, so a stream can be scanned in pieces of any size.
+ *
+ * @param scanner Scanner state.
+ * @param packets Pointer to the first packet.
+ * @param stride Distance in bytes between consecutive packets, `sizeof(PiProt_t)` for an array.
+ * @param count Number of packets.
+ * @return 0 on success, -1 if the events could not be stored (the scan is complete but events are missing).
+ */
+int piEventScan(PiEventScanner_t *scanner, const void *packets, size_t stride, size_t count);
+
+/**
+ * @brief Scans packets with the given kernel.
+ *
+ * Intended for benchmarking and cross-checking. The kernel must be supported,
+ * see `piConvertKernelSupported`.
+ *
+ * @param kernel Kernel to use.
+ * @param scanner Scanner state.
+ * @param packets Pointer to the first packet.
+ * @param stride Distance in bytes between consecutive packets.
+ * @param count Number of packets.
+ * @return 0 on success, -1 if the events could not be stored.
+ */
+int piEventScanKernel(PiConvKernel_t kernel, PiEventScanner_t *scanner, const void *packets, size_t stride, size_t count);
+
+/**
+ * @brief Returns the name of a bit of the status word.
+ *
+ * @param bit Bit, 0 to 31.
+ * @return Field name, NULL for the state field and for reserved bits.
+ */
+const char *piEventBitName(unsigned bit);
+
+/**
+ * @brief Returns the name of a state.
+ *
+ * @param state Value of the state field, or `PI_EVENT_STATE_UNKNOWN`.
+ * @return "ready", "prepare", "warmup", "fault", "state N" for the other values of the field, "unknown", or "invalid".
+ */
+const char *piEventStateName(unsigned state);
+
+/**
+ * @brief Writes the events and the scanner state to the sidecar file of a capture.
+ *
+ * @param scanner Scanner state.
+ * @param path Path of the capture, the events are written to `<path>.evt`.
+ * @param startTimeNs Creation time in the header of the capture.
+ * @return 0 on success, -1 on error (errno is set).
+ */
+int piEventSave(const PiEventScanner_t *scanner, const char *path, uint64_t startTimeNs);
+
+/**
+ * @brief Loads the events and the scanner state from the sidecar file of a capture.
+ *
+ * @param scanner Scanner to initialize, to be released with `piEventFree`.
+ * @param path Path of the capture.
+ * @param records Records of the capture; a sidecar covering more records belongs to another capture.
+ * @param startTimeNs Creation time in the header of the capture.
+ * @return 0 on success, the scan continues after `scanner->records`; -1 if the sidecar is
+ *         missing or does not match (errno is set, EINVAL for a mismatch).
+ */
+int piEventLoad(PiEventScanner_t *scanner, const char *path, uint64_t records, uint64_t startTimeNs);
+
+#endif	/* #ifdef pievent_h_included */
@@ -0,0 +1,313 @@
+#include <string.h>
+
+#include "picrc.h"
+#include "piframer.h"
+
+#define PI_HEADER_LO(format)    (uint8_t)(piProtoHeader(format) & 0xff)
+#define PI_HEADER_HI(format)    (uint8_t)(piProtoHeader(format) >> 8)
+
+/**
+ * @brief Initializes the framer.
+ *
+ * @param framer Framer to initialize.
+ * @param callback Function called for every valid packet.
+ * @param context User context passed to the callback.
+ */
+void piFramerInit(PiFramer_t *framer, PiFramerCallback_t callback, void *context) {
+    framer->callback = callback;
+    framer->context = context;
+    framer->mode = PI_PROTO_MAIN;
+    framer->correct = 0;
+    piFramerReset(framer);
+}
+
+/**
+ * @brief Selects the packet format of the stream.
+ *
+ * @param framer Framer state.
+ * @param format Format to decode, `PI_PROTO_AUTO` to lock onto the first valid packet of any format.
+ */
+void piFramerSetFormat(PiFramer_t *framer, PiProtoFormat_t format) {
+    framer->mode = format;
+    framer->format = format;
+    framer->pendingLen = 0;
+}
+
+/**
+ * @brief Enables or disables the repair of packets with a single-bit error.
+ *
+ * @param framer Framer state.
+ * @param enable Non-zero to repair packets.
+ */
+void piFramerSetCorrection(PiFramer_t *framer, int enable) {
+    framer->correct = enable != 0;
+}
+
+/**
+ * @brief Drops any partially received packet and clears the counters.
+ *
+ * @param framer Framer to reset.
+ */
+void piFramerReset(PiFramer_t *framer) {
+    framer->packets = 0;
+    framer->corrected = 0;
+    framer->badCrc = 0;
+    framer->skippedBytes = 0;
+    framer->lastResult = PI_PROT_OK;
+    framer->pendingLen = 0;
+    framer->format = framer->mode;
+    framer->sequence = 0;
+}
+
+/**
+ * @brief Passes a valid packet to the callback, translated into a `PiProt_t` if needed.
+ */
+static inline __attribute__((always_inline)) void piFramerDeliver(PiFramer_t *framer, const uint8_t *packet,
+                                                                  PiProtoFormat_t format, PiProtError_t result) {
+    framer->packets++;
+    framer->lastResult = result;
+    if (piProtoCanonical(format)) {
+        framer->callback(framer->context, (const PiProt_t *)packet);
+    } else {
+        piProtoDecode(format, packet, &framer->sequence, &framer->decoded);
+        framer->callback(framer->context, &framer->decoded);
+    }
+}
+
+/**
+ * @brief Delivers a repaired copy of a rejected candidate if correction is enabled and a
+ * single-bit error explains the failure.
+ *
+ * @return 1 if the packet was delivered, 0 if it stays rejected.
+ */
+static inline __attribute__((always_inline)) int piFramerCorrect(PiFramer_t *framer, const uint8_t *packet, PiProtoFormat_t format) {
+    if (!framer->correct) {
+        return 0;
+    }
+    memcpy(framer->repaired, packet, piProtoSize(format));
+    if (piProtoCorrect(format, framer->repaired) != PI_PROT_CORRECTED) {
+        return 0;
+    }
+    framer->corrected++;
+    piFramerDeliver(framer, framer->repaired, format, PI_PROT_CORRECTED);
+    return 1;
+}
+
+/**
+ * @brief Discards the pending bytes before the next header candidate at or after `from`.
+ *
+ * Keeps the invariant that the pending buffer always starts with the first header byte
+ * and, when it holds two bytes or more, with the complete header.
+ *
+ * @param framer Framer state.
+ * @param from First pending byte that may start the next candidate.
+ * @param format Format of the stream.
+ */
+static inline __attribute__((always_inline)) void piFramerDropPending(PiFramer_t *framer, size_t from, PiProtoFormat_t format) {
+    while (from < framer->pendingLen) {
+        const uint8_t *next = memchr(framer->pending + from, PI_HEADER_LO(format), framer->pendingLen - from);
+        if (next == NULL) {
+            break;
+        }
+        size_t offset = (size_t)(next - framer->pending);
+        if (offset + 1 < framer->pendingLen && next[1] != PI_HEADER_HI(format)) {
+            from = offset + 1;
+            continue;
+        }
+        framer->skippedBytes += offset;
+        framer->pendingLen -= offset;
+        memmove(framer->pending, next, framer->pendingLen);
+        return;
+    }
+    framer->skippedBytes += framer->pendingLen;
+    framer->pendingLen = 0;
+}
+
+/**
+ * @brief Completes the packet held in the pending buffer with bytes from the new chunk.
+ *
+ * Bytes taken from the chunk are consumed (the chunk pointer and length are advanced)
+ * whether they end up in a valid packet or are skipped during resynchronization.
+ *
+ * @param framer Framer state.
+ * @param data In/out pointer to the unconsumed part of the chunk.
+ * @param len In/out number of unconsumed bytes.
+ * @param format Format of the stream.
+ * @return Number of packets delivered (0 or 1).
+ */
+static inline __attribute__((always_inline)) size_t piFramerDrainPending(PiFramer_t *framer, const uint8_t **data, size_t *len,
+                                                                         PiProtoFormat_t format) {
+    const size_t size = piProtoSize(format);
+
+    while (framer->pendingLen != 0) {
+        size_t take = size - framer->pendingLen;
+        if (take > *len) {
+            take = *len;
+        }
+        memcpy(framer->pending + framer->pendingLen, *data, take);
+        framer->pendingLen += take;
+        *data += take;
+        *len -= take;
+
+        if (framer->pendingLen >= 2 && framer->pending[1] != PI_HEADER_HI(format)) {
+            piFramerDropPending(framer, 1, format);
+            continue;
+        }
+        if (framer->pendingLen < size) {
+            return 0;
+        }
+        if (piProtoCheck(format, framer->pending) == PI_PROT_OK) {
+            piFramerDeliver(framer, framer->pending, format, PI_PROT_OK);
+            framer->pendingLen = 0;
+            return 1;
+        }
+        if (piFramerCorrect(framer, framer->pending, format)) {
+            framer->pendingLen = 0;
+            return 1;
+        }
+        framer->badCrc++;
+        piFramerDropPending(framer, 1, format);
+    }
+    return 0;
+}
+
+/**
+ * @brief Feeds a chunk of a stream of one format, specialized for every format.
+ */
+static inline __attribute__((always_inline)) size_t piFramerFeedFormat(PiFramer_t *framer, const uint8_t *data, size_t len,
+                                                                       PiProtoFormat_t format) {
+    const size_t size = piProtoSize(format);
+    size_t delivered = piFramerDrainPending(framer, &data, &len, format);
+    const uint8_t *p = data;
+    const uint8_t *end = data + len;
+
+    while ((size_t)(end - p) >= size) {
+        if (p[0] == PI_HEADER_LO(format) && p[1] == PI_HEADER_HI(format)) {
+            if (piProtoCheck(format, p) == PI_PROT_OK) {
+                delivered++;
+                piFramerDeliver(framer, p, format, PI_PROT_OK);
+                p += size;
+                continue;
+            }
+            if (piFramerCorrect(framer, p, format)) {
+                delivered++;
+                p += size;
+                continue;
+            }
+            framer->badCrc++;
+        }
+        const uint8_t *next = memchr(p + 1, PI_HEADER_LO(format), (size_t)(end - p - 1));
+        if (next == NULL) {
+            next = end;
+        }
+        framer->skippedBytes += (size_t)(next - p);
+        p = next;
+    }
+
+    // Keep the tail that may start a packet completed by the next chunk
+    if (p < end) {
+        size_t tail = (size_t)(end - p);
+        memcpy(framer->pending, p, tail);
+        framer->pendingLen = tail;
+        piFramerDropPending(framer, 0, format);
+    }
+    return delivered;
+}
+
+#define PI_FRAMER_FEED(Name, NAME, ...) \
+    static size_t piFramerFeed##Name(PiFramer_t *framer, const uint8_t *data, size_t len) { \
+        return piFramerFeedFormat(framer, data, len, PI_PROTO_##NAME); \
+    }
+
+PI_PROTO_FORMATS(PI_FRAMER_FEED)
+
+#define PI_FRAMER_FEED_ENTRY(Name, NAME, ...) [PI_PROTO_##NAME] = piFramerFeed##Name,
+
+static size_t (*const piFramerFeeds[PI_PROTO_COUNT])(PiFramer_t *, const uint8_t *, size_t) = {
+    PI_PROTO_FORMATS(PI_FRAMER_FEED_ENTRY)
+};
+
+/**
+ * @brief Returns the format of a valid packet starting at `p`, `PI_PROTO_AUTO` if there is none.
+ */
+static PiProtoFormat_t piFramerDetect(const uint8_t *p, size_t available) {
+#define PI_FRAMER_DETECT(Name, NAME, HEADER, SIZE, ...) \
+    if (available >= (SIZE) && PI_PROTO_LOAD(uint16_t, p, 0) == (HEADER) && piProtoCheck##Name(p) == PI_PROT_OK) { \
+        return PI_PROTO_##NAME; \
+    }
+    PI_PROTO_FORMATS(PI_FRAMER_DETECT)
+#undef PI_FRAMER_DETECT
+    return PI_PROTO_AUTO;
+}
+
+/**
+ * @brief Looks for the first valid packet of any format, then locks onto its format.
+ *
+ * The stream goes through a window of `PI_FRAMER_WINDOW` bytes in the pending buffer so
+ * that packets split across chunks are found too. A position is dropped once a packet of
+ * every format would fit after it.
+ */
+static size_t piFramerFeedAuto(PiFramer_t *framer, const uint8_t *data, size_t len) {
+    while (len != 0) {
+        size_t take = PI_FRAMER_WINDOW - framer->pendingLen;
+        size_t i;
+        if (take > len) {
+            take = len;
+        }
+        memcpy(framer->pending + framer->pendingLen, data, take);
+        framer->pendingLen += take;
+        data += take;
+        len -= take;
+
+        for (i = 0; i < framer->pendingLen; i++) {
+            PiProtoFormat_t format = piFramerDetect(framer->pending + i, framer->pendingLen - i);
+            if (format != PI_PROTO_AUTO) {
+                uint8_t rest[PI_FRAMER_WINDOW];
+                size_t after = i + piProtoSize(format);
+                size_t restLen = framer->pendingLen - after;
+
+                framer->skippedBytes += i;
+                framer->format = format;
+                memcpy(rest, framer->pending + after, restLen);
+                piFramerDeliver(framer, framer->pending + i, format, PI_PROT_OK);
+                framer->pendingLen = 0;
+                return 1 + piFramerFeeds[format](framer, rest, restLen) + piFramerFeeds[format](framer, data, len);
+            }
+            if (framer->pendingLen - i < PI_PROTO_MAX_SIZE) {
+                break;
+            }
+        }
+        framer->skippedBytes += i;
+        framer->pendingLen -= i;
+        memmove(framer->pending, framer->pending + i, framer->pendingLen);
+    }
+    return 0;
+}
+
+/**
+ * @brief Feeds a chunk of raw bytes into the framer.
+ *
+ * The chunk may start and end anywhere in the stream. Bytes of an incomplete packet at the end
+ * of the chunk are kept and completed by the next call.
+ *
+ * @param framer Framer state.
+ * @param data Raw bytes received from the link.
+ * @param len Number of bytes in `data`.
+ * @return Number of valid packets delivered to the callback.
+ */
+size_t piFramerFeed(PiFramer_t *framer, const uint8_t *data, size_t len) {
+    if (framer->format == PI_PROTO_AUTO) {
+        return piFramerFeedAuto(framer, data, len);
+    }
+    return piFramerFeeds[framer->format](framer, data, len);
+}
+
+/**
+ * @brief Ends the stream: the bytes of an incomplete packet are dropped and counted as skipped.
+ *
+ * @param framer Framer state.
+ */
+void piFramerFinish(PiFramer_t *framer) {
+    framer->skippedBytes += framer->pendingLen;
+    framer->pendingLen = 0;
+}
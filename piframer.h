@@ -0,0 +1,125 @@
+/**
+ * @file piframer.h
+ * @brief Incremental byte-stream framer for IMU protocol packets.
+ *
+ * The framer accepts raw chunks of any size as they come from the serial link, scans them
+ * for the `PI_HEADER` marker, validates every candidate packet with `piCheckProtBufferFast`
+ * and hands valid packets to a callback. Packets that lie completely inside a chunk are passed
+ * as pointers into that chunk (zero-copy); only packets split across two chunks are assembled
+ * in a small internal buffer.
+ * On a bad CRC the framer moves forward one byte and resynchronizes on the next header, unless
+ * correction is enabled and the candidate becomes valid by flipping the one bit its CRC
+ * syndrome points at; the repaired copy is then delivered. Valid packets never reach the
+ * correction code.
+ *
+ * The stream is in the current packet format unless another one of `piproto.h` is selected;
+ * the feed loop is instantiated once per format, so the format is looked at once per chunk,
+ * not per packet. Packets of other formats are translated into a `PiProt_t` before they are
+ * passed to the callback. In auto mode the framer scans for a valid packet of any format and
+ * then locks onto that format.
+ */
+
+#ifndef piframer_h_included
+#define piframer_h_included
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "pi.h"
+#include "piproto.h"
+
+#define PI_FRAMER_WINDOW    (2 * PI_PROTO_MAX_SIZE)     // Bytes scanned at a time before a format is locked
+
+/**
+ * @brief Callback receiving every valid packet found by the framer.
+ *
+ * The packet pointer refers either to the chunk passed to `piFramerFeed` or to the framer's
+ * internal buffer, and is valid only until the callback returns. The framer's `lastResult`
+ * tells whether the packet was repaired.
+ *
+ * @param context User context given to `piFramerInit`.
+ * @param packet Pointer to the validated packet (not necessarily aligned).
+ */
+typedef void (*PiFramerCallback_t)(void *context, const PiProt_t *packet);
+
+/**
+ * @struct PiFramer_t
+ * @brief State of the incremental framer.
+ */
+typedef struct {
+    PiFramerCallback_t callback;            // Packet consumer
+    void *context;                          // Consumer context
+    uint64_t packets;                       // Valid packets delivered, corrected ones included
+    uint64_t corrected;                     // Packets delivered after repairing a single-bit error
+    uint64_t badCrc;                        // Candidates with header but bad CRC or sequence check
+    uint64_t skippedBytes;                  // Bytes dropped while resynchronizing
+    PiProtError_t lastResult;               // Packet being delivered: PI_PROT_OK, or PI_PROT_CORRECTED once repaired
+    PiProtoFormat_t mode;                   // Format selected, PI_PROTO_AUTO to detect it
+    PiProtoFormat_t format;                 // Format decoded, PI_PROTO_AUTO until one is found
+    uint16_t sequence;                      // Last sequence number, extends shorter ones
+    uint8_t correct;                        // Repair single-bit errors instead of dropping the packet
+    uint8_t repaired[PI_PROTO_MAX_SIZE];    // Last packet repaired
+    PiProt_t decoded;                       // Last packet translated from another format
+    size_t pendingLen;                      // Bytes held in `pending`
+    uint8_t pending[PI_FRAMER_WINDOW];      // Start of a packet split across chunks
+} PiFramer_t;
+
+/**
+ * @brief Initializes the framer.
+ *
+ * @param framer Framer to initialize.
+ * @param callback Function called for every valid packet.
+ * @param context User context passed to the callback.
+ */
+void piFramerInit(PiFramer_t *framer, PiFramerCallback_t callback, void *context);
+
+/**
+ * @brief Selects the packet format of the stream.
+ *
+ * The default is `PI_PROTO_MAIN`. Drops any partially received packet.
+ *
+ * @param framer Framer state.
+ * @param format Format to decode, `PI_PROTO_AUTO` to lock onto the first valid packet of any format.
+ */
+void piFramerSetFormat(PiFramer_t *framer, PiProtoFormat_t format);
+
+/**
+ * @brief Enables or disables the repair of packets with a single-bit error.
+ *
+ * Disabled by default. Repaired packets are counted in `corrected` as well as in `packets`.
+ *
+ * @param framer Framer state.
+ * @param enable Non-zero to repair packets.
+ */
+void piFramerSetCorrection(PiFramer_t *framer, int enable);
+
+/**
+ * @brief Drops any partially received packet and clears the counters.
+ *
+ * A framer in auto mode looks for the format again.
+ *
+ * @param framer Framer to reset.
+ */
+void piFramerReset(PiFramer_t *framer);
+
+/**
+ * @brief Feeds a chunk of raw bytes into the framer.
+ *
+ * The chunk may start and end anywhere in the stream. Bytes of an incomplete packet at the end
+ * of the chunk are kept and completed by the next call.
+ *
+ * @param framer Framer state.
+ * @param data Raw bytes received from the link.
+ * @param len Number of bytes in `data`.
+ * @return Number of valid packets delivered to the callback.
+ */
+size_t piFramerFeed(PiFramer_t *framer, const uint8_t *data, size_t len);
+
+/**
+ * @brief Ends the stream: the bytes of an incomplete packet are dropped and counted as skipped.
+ *
+ * @param framer Framer state.
+ */
+void piFramerFinish(PiFramer_t *framer);
+
+#endif	/* #ifdef piframer_h_included */
@@ -0,0 +1,186 @@
+#include <string.h>
+
+#include "picrc.h"
+#include "pigen.h"
+
+enum {
+    PI_GEN_BIT_FLIP = 0,
+    PI_GEN_DROP_BYTE,
+    PI_GEN_TRUNCATE,
+    PI_GEN_BAD_HEADER,
+    PI_GEN_GAP
+};
+
+/**
+ * @brief Returns the next 64-bit pseudo-random number (xorshift64*).
+ */
+static uint64_t piGenRandom(PiGen_t *gen) {
+    gen->random ^= gen->random >> 12;
+    gen->random ^= gen->random << 25;
+    gen->random ^= gen->random >> 27;
+    return gen->random * 0x2545F4914F6CDD1Dull;
+}
+
+/**
+ * @brief Draws whether a fault is injected into the current packet.
+ */
+static int piGenFault(PiGen_t *gen, int fault) {
+    return gen->thresholds[fault] != 0 && (uint32_t)(piGenRandom(gen) >> 32) < gen->thresholds[fault];
+}
+
+/**
+ * @brief Returns a random value in [-amplitude, amplitude].
+ */
+static int32_t piGenNoise(PiGen_t *gen, int32_t amplitude) {
+    return (int32_t)(piGenRandom(gen) % (2 * (uint64_t)amplitude + 1)) - amplitude;
+}
+
+/**
+ * @brief Triangle wave of the given period in samples and amplitude.
+ */
+static int32_t piGenWave(uint64_t sample, uint64_t period, int32_t amplitude) {
+    int64_t phase = (int64_t)(sample % period);
+    int64_t rise = phase < (int64_t)period / 2 ? phase : (int64_t)period - phase;
+    return (int32_t)(amplitude * (4 * rise - (int64_t)period) / (int64_t)period);
+}
+
+/**
+ * @brief Initializes a generator.
+ *
+ * @param gen Generator to initialize.
+ * @param config Settings, copied into the generator.
+ */
+void piGenInit(PiGen_t *gen, const PiGenConfig_t *config) {
+    const double rates[5] = { config->bitFlipRate, config->dropByteRate, config->truncateRate,
+                              config->badHeaderRate, config->gapRate };
+
+    memset(gen, 0, sizeof(*gen));
+    gen->config = *config;
+    if (gen->config.packetRate == 0) {
+        gen->config.packetRate = 1000;
+    }
+    if (gen->config.maxGap == 0) {
+        gen->config.maxGap = 1;
+    }
+    for (int i = 0; i < 5; i++) {
+        double rate = rates[i] < 0 ? 0 : rates[i] > 1 ? 1 : rates[i];
+        gen->thresholds[i] = (uint32_t)(rate * 4294967295.0);
+    }
+    gen->random = config->seed != 0 ? config->seed : 0x9E3779B97F4A7C15ull;
+    gen->sequence = config->firstSequence;
+
+    PiMux_t *mux = &gen->mux;
+    mux->gitShort = 0x1a2b3c4d;
+    mux->buildDate.year = 24;
+    mux->buildDate.mon = 5;
+    mux->buildDate.day = 17;
+    mux->manufacturedDate.year = 24;
+    mux->manufacturedDate.mon = 6;
+    mux->manufacturedDate.day = 3;
+    mux->version.major = 1;
+    mux->version.minor = 2;
+    mux->version.build = 34;
+    mux->humanSerial = (uint16_t)(config->hwSerial % 10000);
+    mux->hwSerial = config->hwSerial;
+    mux->tExternal = 24 * PI_TEMP_SCALE;
+    mux->voltage = 12 * PI_VOLT_SCALE;
+    mux->current = PI_AMPR_SCALE * 15 / 100;
+    mux->packetRate = gen->config.packetRate;
+}
+
+/**
+ * @brief Builds the next valid packet, without fault injection.
+ *
+ * @param gen Generator state.
+ * @param packet Receives the packet.
+ */
+void piGenPacket(PiGen_t *gen, PiProt_t *packet) {
+    uint64_t sample = gen->sample;
+    uint64_t rate = gen->config.packetRate;
+    unsigned slot = gen->sequence % PI_MUXFACTOR;
+
+    // The slowly changing mux fields are refreshed once per cycle
+    if (slot == 0) {
+        gen->mux.uptime = (uint32_t)(sample / rate);
+        gen->mux.tInternal = (int16_t)(35 * PI_TEMP_SCALE + (sample / rate / 10) % 64);
+    }
+
+    memset(packet, 0, sizeof(*packet));
+    packet->header = PI_HEADER;
+    packet->sequence = gen->sequence;
+    packet->data.accl[0] = piGenWave(sample, 2 * rate, PI_ACCL_SCALE / 20) + piGenNoise(gen, PI_ACCL_SCALE / 100);
+    packet->data.accl[1] = piGenWave(sample, 3 * rate, PI_ACCL_SCALE / 30) + piGenNoise(gen, PI_ACCL_SCALE / 100);
+    packet->data.accl[2] = (int32_t)(PI_ACCL_SCALE * 9.80665) + piGenNoise(gen, PI_ACCL_SCALE / 100);
+    packet->data.gyro[0] = piGenWave(sample, 5 * rate, PI_GYRO_SCALE / 50) + piGenNoise(gen, PI_GYRO_SCALE / 500);
+    packet->data.gyro[1] = piGenWave(sample, 7 * rate, PI_GYRO_SCALE / 50) + piGenNoise(gen, PI_GYRO_SCALE / 500);
+    packet->data.gyro[2] = piGenNoise(gen, PI_GYRO_SCALE / 500);
+    packet->data.magn[0] = PI_MAGN_SCALE / 5 + piGenNoise(gen, PI_MAGN_SCALE / 1000);
+    packet->data.magn[1] = PI_MAGN_SCALE / 20 + piGenNoise(gen, PI_MAGN_SCALE / 1000);
+    packet->data.magn[2] = -PI_MAGN_SCALE * 2 / 5 + piGenNoise(gen, PI_MAGN_SCALE / 1000);
+    packet->data.pressure = (uint32_t)(1013.25 * PI_PRES_SCALE) + (uint32_t)piGenWave(sample, 60 * rate, PI_PRES_SCALE / 2);
+    packet->mux = gen->mux.ui32[slot];
+    packet->crc32 = piCrc32Fast((const uint8_t *)&packet->sequence, sizeof(PiProt_t) - sizeof(uint32_t) - sizeof(uint16_t));
+
+    gen->sample++;
+    gen->sequence++;
+    gen->packets++;
+}
+
+/**
+ * @brief Produces the bytes of the next packet as sent on the link, faults included.
+ *
+ * @param gen Generator state.
+ * @param out Receives up to `sizeof(PiProt_t)` bytes.
+ * @return Number of bytes written to `out`.
+ */
+size_t piGenNext(PiGen_t *gen, uint8_t *out) {
+    PiProt_t packet;
+    size_t len = sizeof(PiProt_t);
+
+    if (piGenFault(gen, PI_GEN_GAP)) {
+        uint16_t lost = (uint16_t)(1 + piGenRandom(gen) % gen->config.maxGap);
+        gen->sample += lost;
+        gen->sequence += lost;
+        gen->gaps++;
+        gen->lost += lost;
+    }
+    piGenPacket(gen, &packet);
+
+    if (piGenFault(gen, PI_GEN_BAD_HEADER)) {
+        packet.header ^= (uint16_t)(1 + piGenRandom(gen) % 0xFFFF);
+        gen->badHeaders++;
+    }
+    if (piGenFault(gen, PI_GEN_BIT_FLIP)) {
+        unsigned bit = (unsigned)(piGenRandom(gen) % (8 * sizeof(PiProt_t)));
+        packet.ui8[bit / 8] ^= (uint8_t)(1u << (bit % 8));
+        gen->bitFlips++;
+    }
+    memcpy(out, &packet, sizeof(packet));
+    if (piGenFault(gen, PI_GEN_DROP_BYTE)) {
+        size_t pos = (size_t)(piGenRandom(gen) % len);
+        memmove(out + pos, out + pos + 1, len - pos - 1);
+        len--;
+        gen->droppedBytes++;
+    }
+    if (piGenFault(gen, PI_GEN_TRUNCATE)) {
+        len = (size_t)(1 + piGenRandom(gen) % (len - 1));
+        gen->truncated++;
+    }
+    return len;
+}
+
+/**
+ * @brief Fills a buffer with the link byte stream, packet after packet.
+ *
+ * @param gen Generator state.
+ * @param buffer Destination buffer.
+ * @param size Size of the buffer.
+ * @return Number of bytes written.
+ */
+size_t piGenFill(PiGen_t *gen, uint8_t *buffer, size_t size) {
+    size_t used = 0;
+    while (size - used >= sizeof(PiProt_t)) {
+        used += piGenNext(gen, buffer + used);
+    }
+    return used;
+}
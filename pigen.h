@@ -0,0 +1,98 @@
+/**
+ * @file pigen.h
+ * @brief Synthetic generator of IMU protocol packet streams.
+ *
+ * The generator produces the byte stream a device would send at a given packet rate: valid
+ * `PiProt_t` packets with consecutive 16-bit sequence numbers that wrap around, plausible
+ * sensor values (gravity on Z, slow oscillations and noise), the `PiMux_t` metadata frame
+ * spread over `PI_MUXFACTOR` packets with a running uptime, and a correct CRC32.
+ *
+ * Link faults can be injected with per-packet probabilities: flipped bits, dropped bytes,
+ * truncated packets, corrupted headers and sequence gaps. Every injected fault is counted so
+ * that the numbers reported by a decoder can be checked against them. The generator is
+ * deterministic for a given seed.
+ */
+
+#ifndef pigen_h_included
+#define pigen_h_included
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "pi.h"
+
+/**
+ * @struct PiGenConfig_t
+ * @brief Generator settings. Fault rates are probabilities per packet, 0 disables a fault.
+ */
+typedef struct {
+    uint16_t packetRate;        // Packet rate in Hz: 250, 500 or 1000
+    uint16_t firstSequence;     // Sequence number of the first packet
+    uint32_t seed;              // Seed of the pseudo-random generator, 0 selects a fixed seed
+    uint32_t hwSerial;          // Hardware serial number reported in the mux frame
+    double bitFlipRate;         // A random bit of the packet is inverted
+    double dropByteRate;        // A random byte of the packet is not sent
+    double truncateRate;        // Only a random prefix of the packet is sent
+    double badHeaderRate;       // The header is replaced by a wrong value
+    double gapRate;             // 1 to `maxGap` packets before this one are lost
+    uint16_t maxGap;            // Longest sequence gap, 1 if 0
+} PiGenConfig_t;
+
+/**
+ * @struct PiGen_t
+ * @brief Generator state and counters of the injected faults.
+ */
+typedef struct {
+    PiGenConfig_t config;
+    uint32_t thresholds[5];     // Fault rates scaled to 32-bit random numbers
+    uint64_t random;            // xorshift64 state
+    uint64_t sample;            // Absolute sample number of the next packet
+    uint16_t sequence;          // Sequence number of the next packet
+    PiMux_t mux;                // Metadata frame being sent
+    uint64_t packets;           // Packets generated, lost ones excluded
+    uint64_t bitFlips;          // Packets with a flipped bit
+    uint64_t droppedBytes;      // Packets with a dropped byte
+    uint64_t truncated;         // Truncated packets
+    uint64_t badHeaders;        // Packets with a corrupted header
+    uint64_t gaps;              // Sequence gaps
+    uint64_t lost;              // Packets lost in sequence gaps
+} PiGen_t;
+
+/**
+ * @brief Initializes a generator.
+ *
+ * @param gen Generator to initialize.
+ * @param config Settings, copied into the generator.
+ */
+void piGenInit(PiGen_t *gen, const PiGenConfig_t *config);
+
+/**
+ * @brief Builds the next valid packet, without fault injection.
+ *
+ * @param gen Generator state.
+ * @param packet Receives the packet.
+ */
+void piGenPacket(PiGen_t *gen, PiProt_t *packet);
+
+/**
+ * @brief Produces the bytes of the next packet as sent on the link, faults included.
+ *
+ * @param gen Generator state.
+ * @param out Receives up to `sizeof(PiProt_t)` bytes.
+ * @return Number of bytes written to `out`.
+ */
+size_t piGenNext(PiGen_t *gen, uint8_t *out);
+
+/**
+ * @brief Fills a buffer with the link byte stream, packet after packet.
+ *
+ * Stops when less than `sizeof(PiProt_t)` bytes are left.
+ *
+ * @param gen Generator state.
+ * @param buffer Destination buffer.
+ * @param size Size of the buffer.
+ * @return Number of bytes written.
+ */
+size_t piGenFill(PiGen_t *gen, uint8_t *buffer, size_t size);
+
+#endif	/* #ifdef pigen_h_included */
@@ -0,0 +1,256 @@
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define PI_HEX_HAVE_SSE2 1
+#include <immintrin.h>
+#endif
+
+#include "pihex.h"
+
+#define PI_HEX_BLOCK_SIZE   (1 << 20)   // Read size of the streaming reader
+#define PI_HEX_LINE_BYTES   4096        // Longest decoded line of the streaming reader
+
+/**
+ * @brief Returns the value of a hexadecimal digit or -1 for any other character.
+ */
+static inline int piHexNibble(uint8_t c) {
+    if ((uint8_t)(c - '0') < 10) {
+        return c - '0';
+    }
+    c |= 0x20;
+    if ((uint8_t)(c - 'a') < 6) {
+        return c - 'a' + 10;
+    }
+    return -1;
+}
+
+#ifdef PI_HEX_HAVE_SSE2
+/**
+ * @brief Converts 16 characters into 16 nibble values.
+ *
+ * @param v Characters.
+ * @param valid Receives a bit mask of valid characters.
+ * @return Nibble values, one per byte lane.
+ */
+__attribute__((target("sse2")))
+static inline __m128i piHexNibbles(__m128i v, unsigned *valid) {
+    const __m128i nine = _mm_set1_epi8(9);
+    const __m128i five = _mm_set1_epi8(5);
+    __m128i digit = _mm_sub_epi8(v, _mm_set1_epi8('0'));
+    __m128i alpha = _mm_sub_epi8(_mm_or_si128(v, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+    __m128i isDigit = _mm_cmpeq_epi8(_mm_min_epu8(digit, nine), digit);
+    __m128i isAlpha = _mm_cmpeq_epi8(_mm_min_epu8(alpha, five), alpha);
+    __m128i value = _mm_or_si128(_mm_and_si128(isDigit, digit),
+                                 _mm_and_si128(isAlpha, _mm_add_epi8(alpha, _mm_set1_epi8(10))));
+    *valid = (unsigned)_mm_movemask_epi8(_mm_or_si128(isDigit, isAlpha));
+    return value;
+}
+
+/**
+ * @brief Decodes 32 characters per step into 16 bytes, and a last block of 16 characters.
+ *
+ * @return Number of bytes decoded, stops before the first block that contains
+ *         an invalid character.
+ */
+__attribute__((target("sse2")))
+static size_t piHexDecodeSse2(const char *hex, size_t pairs, uint8_t *bytes) {
+    const __m128i lowByte = _mm_set1_epi16(0x00ff);
+    size_t i = 0;
+
+    for (; i + 16 <= pairs; i += 16) {
+        unsigned valid0, valid1;
+        __m128i n0 = piHexNibbles(_mm_loadu_si128((const __m128i *)(hex + 2 * i)), &valid0);
+        __m128i n1 = piHexNibbles(_mm_loadu_si128((const __m128i *)(hex + 2 * i + 16)), &valid1);
+        if ((valid0 & valid1) != 0xffff) {
+            break;
+        }
+        // Every 16-bit lane holds (high nibble, low nibble), merge them into one byte
+        __m128i b0 = _mm_and_si128(_mm_or_si128(_mm_slli_epi16(n0, 4), _mm_srli_epi16(n0, 8)), lowByte);
+        __m128i b1 = _mm_and_si128(_mm_or_si128(_mm_slli_epi16(n1, 4), _mm_srli_epi16(n1, 8)), lowByte);
+        _mm_storeu_si128((__m128i *)(bytes + i), _mm_packus_epi16(b0, b1));
+    }
+    if (i + 8 <= pairs) {
+        unsigned valid;
+        __m128i n = piHexNibbles(_mm_loadu_si128((const __m128i *)(hex + 2 * i)), &valid);
+        if (valid == 0xffff) {
+            __m128i b = _mm_and_si128(_mm_or_si128(_mm_slli_epi16(n, 4), _mm_srli_epi16(n, 8)), lowByte);
+            _mm_storel_epi64((__m128i *)(bytes + i), _mm_packus_epi16(b, b));
+            i += 8;
+        }
+    }
+    return i;
+}
+#endif
+
+/**
+ * @brief Decodes hexadecimal text into bytes.
+ *
+ * @param hex Hexadecimal characters, not necessarily zero-terminated.
+ * @param hexLen Number of characters in `hex`.
+ * @param bytes Destination buffer.
+ * @param bytesSize Size of the destination buffer.
+ * @param bytesLen Receives the number of decoded bytes.
+ * @param errorPos Receives the position of the offending character on error, may be NULL.
+ * @return PI_HEX_OK or the error found.
+ */
+PiHexError_t piHexDecode(const char *hex, size_t hexLen, uint8_t *bytes, size_t bytesSize, size_t *bytesLen, size_t *errorPos) {
+    PiHexError_t result = PI_HEX_OK;
+    size_t pairs = hexLen / 2;
+    size_t i = 0;
+
+    if (pairs > bytesSize) {
+        pairs = bytesSize;
+        result = PI_HEX_OVERFLOW;
+    } else if (hexLen % 2) {
+        result = PI_HEX_ODD_LENGTH;
+    }
+
+#ifdef PI_HEX_HAVE_SSE2
+    i = piHexDecodeSse2(hex, pairs, bytes);
+#endif
+    for (; i < pairs; i++) {
+        int hi = piHexNibble((uint8_t)hex[2 * i]);
+        int lo = piHexNibble((uint8_t)hex[2 * i + 1]);
+        if ((hi | lo) < 0) {
+            *bytesLen = i;
+            if (errorPos != NULL) {
+                *errorPos = 2 * i + (hi >= 0);
+            }
+            return PI_HEX_BAD_CHAR;
+        }
+        bytes[i] = (uint8_t)(hi << 4 | lo);
+    }
+
+    *bytesLen = pairs;
+    if (errorPos != NULL && result != PI_HEX_OK) {
+        *errorPos = 2 * pairs;
+    }
+    return result;
+}
+
+/**
+ * @brief Trims and decodes one line of a hex log and reports it to the callback.
+ */
+static void piHexLine(const char *start, const char *end, uint64_t line, uint8_t *bytes,
+                      PiHexLineCallback_t callback, void *context, PiHexStats_t *stats) {
+    size_t len;
+    PiHexError_t error;
+
+    while (start < end && (*start == ' ' || *start == '\t')) {
+        start++;
+    }
+    while (end > start && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r')) {
+        end--;
+    }
+    if (start == end || *start == '#' || (end - start >= 2 && start[0] == '/' && start[1] == '/')) {
+        return;
+    }
+
+    error = piHexDecode(start, (size_t)(end - start), bytes, PI_HEX_LINE_BYTES, &len, NULL);
+    if (stats != NULL) {
+        if (error == PI_HEX_OK) {
+            stats->lines++;
+            stats->bytes += len;
+        } else {
+            stats->badLines++;
+        }
+    }
+    callback(context, line, error, bytes, len);
+}
+
+/**
+ * @brief Reads a line-oriented hex log and decodes it line by line.
+ *
+ * @param fd File descriptor to read from, e.g. an opened file or STDIN_FILENO.
+ * @param callback Function called for every line.
+ * @param context User context passed to the callback.
+ * @param stats Counters to update, may be NULL.
+ * @return 0 at end of input, -1 on read error (errno is set).
+ */
+int piHexReadStream(int fd, PiHexLineCallback_t callback, void *context, PiHexStats_t *stats) {
+    char *block = malloc(PI_HEX_BLOCK_SIZE);
+    uint8_t *bytes = malloc(PI_HEX_LINE_BYTES);
+    size_t filled = 0;
+    uint64_t line = 0;
+    int discarding = 0;
+    int result = 0;
+
+    if (block == NULL || bytes == NULL) {
+        free(block);
+        free(bytes);
+        errno = ENOMEM;
+        return -1;
+    }
+
+    for (;;) {
+        ssize_t got = read(fd, block + filled, PI_HEX_BLOCK_SIZE - filled);
+        if (got < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            result = -1;
+            break;
+        }
+        if (got == 0) {
+            // Last line without a terminating newline
+            if (filled != 0 && !discarding) {
+                piHexLine(block, block + filled, ++line, bytes, callback, context, stats);
+            }
+            break;
+        }
+        filled += (size_t)got;
+
+        char *start = block;
+        char *end = block + filled;
+        char *newline;
+        while ((newline = memchr(start, '\n', (size_t)(end - start))) != NULL) {
+            if (discarding) {
+                discarding = 0;
+            } else {
+                piHexLine(start, newline, ++line, bytes, callback, context, stats);
+            }
+            start = newline + 1;
+        }
+        filled = (size_t)(end - start);
+        if (filled == PI_HEX_BLOCK_SIZE) {
+            // A line longer than the whole block cannot be a packet
+            if (!discarding) {
+                if (stats != NULL) {
+                    stats->badLines++;
+                }
+                callback(context, ++line, PI_HEX_OVERFLOW, bytes, 0);
+            }
+            discarding = 1;
+            filled = 0;
+        } else {
+            memmove(block, start, filled);
+        }
+    }
+
+    free(bytes);
+    free(block);
+    return result;
+}
+
+/**
+ * @brief Converts a PiHexError_t error code to its string representation.
+ *
+ * @param error The PiHexError_t error code.
+ * @return A string that describes the error.
+ */
+const char *PiHexErrorToString(PiHexError_t error) {
+    switch (error) {
+        case PI_HEX_OK:
+            return "OK.";
+        case PI_HEX_BAD_CHAR:
+            return "Invalid hexadecimal character!";
+        case PI_HEX_ODD_LENGTH:
+            return "Odd number of hexadecimal digits!";
+        case PI_HEX_OVERFLOW:
+            return "Destination buffer too small!";
+    }
+    return "Unknown error.";
+}
@@ -0,0 +1,86 @@
+/**
+ * @file pihex.h
+ * @brief Fast hexadecimal decoding of packet logs.
+ *
+ * Decodes hexadecimal text into bytes with an SSE2 kernel (32 characters per step) and a
+ * table-driven scalar fallback, validating every character and the destination size.
+ * A streaming reader decodes line-oriented hex logs (one packet per line) from a file
+ * descriptor in large blocks and hands every decoded line to a callback.
+ */
+
+#ifndef pihex_h_included
+#define pihex_h_included
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @enum PiHexError_t
+ * @brief Defines error codes of the hexadecimal decoder.
+ */
+typedef enum {
+    PI_HEX_OK = 0,           // Input decoded
+    PI_HEX_BAD_CHAR = 1,     // Non-hexadecimal character
+    PI_HEX_ODD_LENGTH = 2,   // Odd number of hexadecimal digits
+    PI_HEX_OVERFLOW = 3      // Destination buffer too small
+} PiHexError_t;
+
+/**
+ * @brief Decodes hexadecimal text into bytes.
+ *
+ * Decoding stops at the first error; the bytes decoded before it are kept.
+ *
+ * @param hex Hexadecimal characters, not necessarily zero-terminated.
+ * @param hexLen Number of characters in `hex`.
+ * @param bytes Destination buffer.
+ * @param bytesSize Size of the destination buffer.
+ * @param bytesLen Receives the number of decoded bytes.
+ * @param errorPos Receives the position of the offending character on error, may be NULL.
+ * @return PI_HEX_OK or the error found.
+ */
+PiHexError_t piHexDecode(const char *hex, size_t hexLen, uint8_t *bytes, size_t bytesSize, size_t *bytesLen, size_t *errorPos);
+
+/**
+ * @brief Callback receiving every non-empty line of a hex log.
+ *
+ * @param context User context passed to `piHexReadStream`.
+ * @param line Line number, starting at 1.
+ * @param error Decoding result of the line.
+ * @param bytes Decoded bytes, valid until the callback returns.
+ * @param len Number of decoded bytes.
+ */
+typedef void (*PiHexLineCallback_t)(void *context, uint64_t line, PiHexError_t error, const uint8_t *bytes, size_t len);
+
+/**
+ * @struct PiHexStats_t
+ * @brief Counters of the streaming reader.
+ */
+typedef struct {
+    uint64_t lines;          // Lines decoded without error
+    uint64_t badLines;       // Lines with a decoding error
+    uint64_t bytes;          // Bytes decoded from good lines
+} PiHexStats_t;
+
+/**
+ * @brief Reads a line-oriented hex log and decodes it line by line.
+ *
+ * The input is read in large blocks. Empty lines and lines starting with `#` or `//`
+ * are skipped, surrounding white space and `\r` are ignored.
+ *
+ * @param fd File descriptor to read from, e.g. an opened file or STDIN_FILENO.
+ * @param callback Function called for every line.
+ * @param context User context passed to the callback.
+ * @param stats Counters to update, may be NULL.
+ * @return 0 at end of input, -1 on read error (errno is set).
+ */
+int piHexReadStream(int fd, PiHexLineCallback_t callback, void *context, PiHexStats_t *stats);
+
+/**
+ * @brief Converts a PiHexError_t error code to its string representation.
+ *
+ * @param error The PiHexError_t error code.
+ * @return A string that describes the error.
+ */
+const char *PiHexErrorToString(PiHexError_t error);
+
+#endif	/* #ifdef pihex_h_included */
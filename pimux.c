@@ -0,0 +1,147 @@
+#include <stddef.h>
+#include <string.h>
+
+#include "pimux.h"
+
+#define PI_MUX_FULL     (~(uint64_t)0)
+#define PI_MUX_FIELD(name) { #name, offsetof(PiMux_t, name), sizeof(((PiMux_t *)0)->name) }
+
+/**
+ * @brief Location of a field inside the mux frame.
+ */
+static const struct {
+    const char *name;
+    uint8_t offset;
+    uint8_t size;
+} piMuxFields[PI_MUX_FIELD_COUNT] = {
+    [PI_MUX_UPTIME] = PI_MUX_FIELD(uptime),
+    [PI_MUX_GIT_SHORT] = PI_MUX_FIELD(gitShort),
+    [PI_MUX_BUILD_DATE] = PI_MUX_FIELD(buildDate),
+    [PI_MUX_MANUFACTURED_DATE] = PI_MUX_FIELD(manufacturedDate),
+    [PI_MUX_VERSION] = PI_MUX_FIELD(version),
+    [PI_MUX_HUMAN_SERIAL] = PI_MUX_FIELD(humanSerial),
+    [PI_MUX_HW_SERIAL] = PI_MUX_FIELD(hwSerial),
+    [PI_MUX_T_INTERNAL] = PI_MUX_FIELD(tInternal),
+    [PI_MUX_T_EXTERNAL] = PI_MUX_FIELD(tExternal),
+    [PI_MUX_VOLTAGE] = PI_MUX_FIELD(voltage),
+    [PI_MUX_CURRENT] = PI_MUX_FIELD(current),
+    [PI_MUX_TRIGGERED] = PI_MUX_FIELD(triggered),
+    [PI_MUX_PACKET_RATE] = PI_MUX_FIELD(packetRate),
+};
+
+/**
+ * @brief Initializes the reassembler.
+ *
+ * @param mux Reassembler to initialize.
+ * @param onChange Function called for every changed field, may be NULL.
+ * @param context User context passed to the callback.
+ */
+void piMuxInit(PiMuxAssembler_t *mux, PiMuxChangeCallback_t onChange, void *context) {
+    memset(mux, 0, sizeof(*mux));
+    mux->onChange = onChange;
+    mux->context = context;
+}
+
+/**
+ * @brief Returns the mask of slots from `first` to `last` inclusive, wrapping at the end of the frame.
+ */
+static uint64_t piMuxSlotRange(unsigned first, unsigned last) {
+    uint64_t upToLast = last == PI_MUXFACTOR - 1 ? PI_MUX_FULL : ((uint64_t)1 << (last + 1)) - 1;
+    uint64_t fromFirst = PI_MUX_FULL << first;
+    return first <= last ? upToLast & fromFirst : upToLast | fromFirst;
+}
+
+/**
+ * @brief Publishes the current cycle and fires the callbacks of the changed fields.
+ */
+static void piMuxPublish(PiMuxAssembler_t *mux) {
+    uint32_t changed = 0;
+
+    for (int f = 0; f < PI_MUX_FIELD_COUNT; f++) {
+        unsigned offset = piMuxFields[f].offset;
+        uint64_t slot = (uint64_t)1 << (offset / sizeof(uint32_t));
+        if (mux->cycles == 0 ||
+            ((mux->dirty & slot) && memcmp(mux->words.ui8 + offset, mux->snapshot.ui8 + offset, piMuxFields[f].size) != 0)) {
+            changed |= 1u << f;
+        }
+    }
+
+    // Only the slots that differ have to be copied
+    for (uint64_t dirty = mux->dirty; dirty != 0; dirty &= dirty - 1) {
+        int slot = __builtin_ctzll(dirty);
+        mux->snapshot.ui32[slot] = mux->words.ui32[slot];
+    }
+    mux->cycles++;
+
+    if (mux->onChange != NULL) {
+        for (; changed != 0; changed &= changed - 1) {
+            mux->onChange(mux->context, (PiMuxField_t)__builtin_ctz(changed), &mux->snapshot);
+        }
+    }
+}
+
+/**
+ * @brief Stores the mux word of a packet.
+ *
+ * @param mux Reassembler state.
+ * @param sequence Sequence number of the packet.
+ * @param word The packet's `mux` word.
+ * @return 1 if the word completed a cycle and a new snapshot was published, 0 otherwise.
+ */
+int piMuxPush(PiMuxAssembler_t *mux, uint16_t sequence, uint32_t word) {
+    unsigned slot = sequence & (PI_MUXFACTOR - 1);
+    uint64_t bit = (uint64_t)1 << slot;
+
+    if (mux->started) {
+        uint16_t gap = (uint16_t)(sequence - mux->lastSequence);
+        if (gap >= PI_MUXFACTOR || ((sequence ^ mux->lastSequence) & ~(PI_MUXFACTOR - 1)) != 0) {
+            // A new cycle starts, whatever was left of the previous one is incomplete
+            if (mux->fresh != 0) {
+                mux->incomplete++;
+            }
+            mux->fresh = 0;
+            mux->dirty = 0;
+        } else if (gap > 1) {
+            // Slots of the dropped packets are stale
+            uint64_t stale = piMuxSlotRange((mux->lastSequence + 1) & (PI_MUXFACTOR - 1), (sequence - 1) & (PI_MUXFACTOR - 1));
+            mux->fresh &= ~stale;
+        }
+    }
+    mux->started = 1;
+    mux->lastSequence = sequence;
+
+    if (word != mux->snapshot.ui32[slot]) {
+        mux->dirty |= bit;
+    } else {
+        mux->dirty &= ~bit;
+    }
+    mux->words.ui32[slot] = word;
+    mux->fresh |= bit;
+
+    if (slot == PI_MUXFACTOR - 1) {
+        if (mux->fresh != PI_MUX_FULL) {
+            mux->incomplete++;
+            mux->fresh = 0;
+            mux->dirty = 0;
+            return 0;
+        }
+        piMuxPublish(mux);
+        mux->fresh = 0;
+        mux->dirty = 0;
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Returns the name of a field.
+ *
+ * @param field Field.
+ * @return Field name as in `PiMux_t`.
+ */
+const char *piMuxFieldName(PiMuxField_t field) {
+    if ((unsigned)field >= PI_MUX_FIELD_COUNT) {
+        return "unknown";
+    }
+    return piMuxFields[field].name;
+}
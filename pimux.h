@@ -0,0 +1,103 @@
+/**
+ * @file pimux.h
+ * @brief Incremental reassembly of the multiplexed device metadata (`PiMux_t`).
+ *
+ * Every packet carries one 32-bit word of the 64-word `PiMux_t` frame; the slot of the word is
+ * given by the packet sequence number modulo `PI_MUXFACTOR`. The reassembler stores each word
+ * in O(1), tracks which slots of the current cycle are fresh, marks slots of dropped packets as
+ * stale and publishes a consistent snapshot whenever a complete cycle has been received.
+ * Change callbacks fire only for the fields whose value differs from the previous snapshot.
+ */
+
+#ifndef pimux_h_included
+#define pimux_h_included
+
+#include <stdint.h>
+
+#include "pi.h"
+
+/**
+ * @enum PiMuxField_t
+ * @brief Fields of `PiMux_t` reported by change callbacks.
+ */
+typedef enum {
+    PI_MUX_UPTIME = 0,
+    PI_MUX_GIT_SHORT,
+    PI_MUX_BUILD_DATE,
+    PI_MUX_MANUFACTURED_DATE,
+    PI_MUX_VERSION,
+    PI_MUX_HUMAN_SERIAL,
+    PI_MUX_HW_SERIAL,
+    PI_MUX_T_INTERNAL,
+    PI_MUX_T_EXTERNAL,
+    PI_MUX_VOLTAGE,
+    PI_MUX_CURRENT,
+    PI_MUX_TRIGGERED,
+    PI_MUX_PACKET_RATE,
+    PI_MUX_FIELD_COUNT
+} PiMuxField_t;
+
+/**
+ * @brief Callback fired for every field that changed when a new snapshot is published.
+ *
+ * @param context User context given to `piMuxInit`.
+ * @param field The changed field.
+ * @param snapshot The new snapshot.
+ */
+typedef void (*PiMuxChangeCallback_t)(void *context, PiMuxField_t field, const PiMux_t *snapshot);
+
+/**
+ * @struct PiMuxAssembler_t
+ * @brief State of the reassembler of one device.
+ */
+typedef struct {
+    PiMux_t words;                  // Words of the current cycle
+    PiMux_t snapshot;               // Last complete cycle
+    uint64_t fresh;                 // Slots received in the current cycle
+    uint64_t dirty;                 // Slots of the current cycle that differ from the snapshot
+    uint64_t cycles;                // Snapshots published
+    uint64_t incomplete;            // Cycles discarded because of missing slots
+    uint16_t lastSequence;          // Sequence number of the last packet
+    uint8_t started;                // A packet was received
+    PiMuxChangeCallback_t onChange; // Change callback, may be NULL
+    void *context;                  // Callback context
+} PiMuxAssembler_t;
+
+/**
+ * @brief Initializes the reassembler.
+ *
+ * @param mux Reassembler to initialize.
+ * @param onChange Function called for every changed field, may be NULL.
+ * @param context User context passed to the callback.
+ */
+void piMuxInit(PiMuxAssembler_t *mux, PiMuxChangeCallback_t onChange, void *context);
+
+/**
+ * @brief Stores the mux word of a packet.
+ *
+ * @param mux Reassembler state.
+ * @param sequence Sequence number of the packet.
+ * @param word The packet's `mux` word.
+ * @return 1 if the word completed a cycle and a new snapshot was published, 0 otherwise.
+ */
+int piMuxPush(PiMuxAssembler_t *mux, uint16_t sequence, uint32_t word);
+
+/**
+ * @brief Returns the last published snapshot.
+ *
+ * @param mux Reassembler state.
+ * @return The snapshot, or NULL before the first complete cycle.
+ */
+static inline const PiMux_t *piMuxSnapshot(const PiMuxAssembler_t *mux) {
+    return mux->cycles ? &mux->snapshot : (const PiMux_t *)0;
+}
+
+/**
+ * @brief Returns the name of a field.
+ *
+ * @param field Field.
+ * @return Field name as in `PiMux_t`.
+ */
+const char *piMuxFieldName(PiMuxField_t field);
+
+#endif	/* #ifdef pimux_h_included */
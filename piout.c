@@ -0,0 +1,565 @@
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "picrc.h"
+#include "piout.h"
+
+#define PI_OUT_LINE_MAX     1024                                        // Longest formatted line
+#define PI_OUT_BLOCK_SIZE   (PI_OUT_BUFFER_SIZE / sizeof(PiProt_t))     // Packets per binary block
+
+static const char piOutDigits[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+static const uint32_t piOutPow10[] = { 1, 10, 100, 1000, 10000, 100000, 1000000 };
+
+/**
+ * @brief Writes the decimal digits of a value, returns their number.
+ */
+static size_t piOutUnsigned(char *text, uint64_t value) {
+    char digits[20];
+    size_t len = 0;
+
+    while (value >= 100) {
+        unsigned pair = (unsigned)(value % 100) * 2;
+        value /= 100;
+        digits[19 - len++] = piOutDigits[pair + 1];
+        digits[19 - len++] = piOutDigits[pair];
+    }
+    if (value >= 10) {
+        digits[19 - len++] = piOutDigits[value * 2 + 1];
+        digits[19 - len++] = piOutDigits[value * 2];
+    } else {
+        digits[19 - len++] = (char)('0' + value);
+    }
+    memcpy(text, digits + 20 - len, len);
+    return len;
+}
+
+/**
+ * @brief Writes a value as `width` decimal digits with leading zeros, like "%0*u".
+ */
+static size_t piOutZeroPadded(char *text, uint64_t value, unsigned width) {
+    char digits[20];
+    size_t len = piOutUnsigned(digits, value);
+    size_t pad = len < width ? width - len : 0;
+
+    memset(text, '0', pad);
+    memcpy(text + pad, digits, len);
+    return pad + len;
+}
+
+/**
+ * @brief Writes a value as `width` upper-case hexadecimal digits, like "%0*X".
+ */
+static size_t piOutHex(char *text, uint32_t value, unsigned width) {
+    static const char hex[] = "0123456789ABCDEF";
+    for (unsigned i = 0; i < width; i++) {
+        text[width - 1 - i] = hex[(value >> (4 * i)) & 15];
+    }
+    return width;
+}
+
+/**
+ * @brief Splits scaled units into integer and fractional parts with constant divisors.
+ */
+static uint64_t piOutSplit(uint64_t units, unsigned decimals, uint32_t *fraction) {
+    switch (decimals) {
+        case 1:
+            *fraction = (uint32_t)(units % 10);
+            return units / 10;
+        case 2:
+            *fraction = (uint32_t)(units % 100);
+            return units / 100;
+        case 3:
+            *fraction = (uint32_t)(units % 1000);
+            return units / 1000;
+        case 4:
+            *fraction = (uint32_t)(units % 10000);
+            return units / 10000;
+        case 5:
+            *fraction = (uint32_t)(units % 100000);
+            return units / 100000;
+        case 6:
+            *fraction = (uint32_t)(units % 1000000);
+            return units / 1000000;
+    }
+    *fraction = 0;
+    return units;
+}
+
+/**
+ * @brief Formats a float like printf("%*.*f"), optionally with the ' ' flag.
+ *
+ * @param text Destination, at least `width + 48` bytes.
+ * @param value Value to format.
+ * @param decimals Digits after the decimal point, at most 6.
+ * @param width Minimum field width, padded with spaces on the left.
+ * @param spaceSign Non-zero to print a space in front of non-negative values.
+ * @return Number of characters written.
+ */
+size_t piOutFormatFloat(char *text, float value, unsigned decimals, unsigned width, int spaceSign) {
+    char digits[64];
+    size_t start = 32;
+
+    // A float has 24 significant bits and 10^6 needs 14 more, so the scaled value is exact
+    double scaled = (double)value * piOutPow10[decimals];
+    double magnitude = scaled < 0 ? -scaled : scaled;
+    if (!(magnitude < 9007199254740992.0) || width > 24) {
+        int written = snprintf(text, width + 48, spaceSign ? "% *.*f" : "%*.*f", (int)width, (int)decimals, (double)value);
+        return written < 0 ? 0 : (size_t)written;
+    }
+
+    // printf rounds the exact binary value to nearest, ties to even
+    uint64_t units = (uint64_t)magnitude;
+    double remainder = magnitude - (double)units;
+    if (remainder > 0.5 || (remainder == 0.5 && (units & 1))) {
+        units++;
+    }
+
+    // Digits are written backwards, right-aligned at offset 32, over a background of spaces
+    uint32_t fraction;
+    uint64_t integer = piOutSplit(units, decimals, &fraction);
+    memset(digits, ' ', 32);
+    for (unsigned i = 0; i < decimals; i++) {
+        digits[--start] = (char)('0' + fraction % 10);
+        fraction /= 10;
+    }
+    if (decimals != 0) {
+        digits[--start] = '.';
+    }
+    while (integer >= 100) {
+        unsigned pair = (unsigned)(integer % 100) * 2;
+        integer /= 100;
+        digits[--start] = piOutDigits[pair + 1];
+        digits[--start] = piOutDigits[pair];
+    }
+    if (integer >= 10) {
+        digits[--start] = piOutDigits[integer * 2 + 1];
+        digits[--start] = piOutDigits[integer * 2];
+    } else {
+        digits[--start] = (char)('0' + integer);
+    }
+    if (signbit(value)) {
+        digits[--start] = '-';
+    } else if (spaceSign) {
+        digits[--start] = ' ';
+    }
+
+    // Copy a fixed 32 bytes, the caller's buffer has room for them
+    if (32 - start < width) {
+        start = 32 - width;
+    }
+    memcpy(text, digits + start, 32);
+    return 32 - start;
+}
+
+/**
+ * @brief Initializes an output.
+ *
+ * @param out Output to initialize.
+ * @param fd Destination file descriptor, not closed by `piOutClose`, or `PI_OUT_MEMORY`.
+ * @param format Selected sink.
+ * @return 0 on success, -1 if the memory could not be allocated.
+ */
+int piOutInit(PiOut_t *out, int fd, PiOutFormat_t format) {
+    out->fd = fd;
+    out->format = format;
+    out->len = 0;
+    out->packets = 0;
+    out->bytes = 0;
+    out->writes = 0;
+    out->error = 0;
+    out->memory = NULL;
+    out->memoryLen = 0;
+    out->memoryCapacity = 0;
+    memset(&out->block, 0, sizeof(out->block));
+    if (format == PI_OUT_BINARY) {
+        return piSampleBlockAlloc(&out->block, PI_OUT_BLOCK_SIZE);
+    }
+    return 0;
+}
+
+/**
+ * @brief Appends a list of buffers to the memory of a `PI_OUT_MEMORY` output.
+ */
+static int piOutWriteMemory(PiOut_t *out, const struct iovec *iov, int count) {
+    size_t len = 0;
+
+    for (int i = 0; i < count; i++) {
+        len += iov[i].iov_len;
+    }
+    if (out->memoryLen + len > out->memoryCapacity) {
+        size_t capacity = out->memoryCapacity ? out->memoryCapacity : PI_OUT_BUFFER_SIZE;
+        while (capacity < out->memoryLen + len) {
+            capacity *= 2;
+        }
+        char *memory = realloc(out->memory, capacity);
+        if (memory == NULL) {
+            if (out->error == 0) {
+                out->error = ENOMEM;
+            }
+            errno = ENOMEM;
+            return -1;
+        }
+        out->memory = memory;
+        out->memoryCapacity = capacity;
+    }
+    for (int i = 0; i < count; i++) {
+        memcpy(out->memory + out->memoryLen, iov[i].iov_base, iov[i].iov_len);
+        out->memoryLen += iov[i].iov_len;
+    }
+    out->writes++;
+    out->bytes += len;
+    return 0;
+}
+
+/**
+ * @brief Writes a list of buffers completely, retrying after partial writes.
+ */
+static int piOutWrite(PiOut_t *out, struct iovec *iov, int count) {
+    if (out->fd == PI_OUT_MEMORY) {
+        return piOutWriteMemory(out, iov, count);
+    }
+    while (count > 0) {
+        ssize_t put = writev(out->fd, iov, count);
+        if (put < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (out->error == 0) {
+                out->error = errno;
+            }
+            return -1;
+        }
+        out->writes++;
+        out->bytes += (uint64_t)put;
+        while (count > 0 && (size_t)put >= iov->iov_len) {
+            put -= (ssize_t)iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = (char *)iov->iov_base + put;
+            iov->iov_len -= (size_t)put;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Converts the staged packets and writes them as one binary block.
+ */
+static int piOutFlushBinary(PiOut_t *out) {
+    PiSampleBlock_t *block = &out->block;
+    PiOutBlockHeader_t header = { PI_OUT_BLOCK_MAGIC, 0 };
+    struct iovec iov[14];
+    int n = 0;
+
+    block->count = 0;
+    piConvertPackets(out->buffer, sizeof(PiProt_t), out->len, block);
+    header.count = (uint32_t)block->count;
+
+    iov[n++] = (struct iovec){ &header, sizeof(header) };
+    for (int axis = 0; axis < 3; axis++) {
+        iov[n++] = (struct iovec){ block->accl[axis], block->count * sizeof(float) };
+    }
+    for (int axis = 0; axis < 3; axis++) {
+        iov[n++] = (struct iovec){ block->gyro[axis], block->count * sizeof(float) };
+    }
+    for (int axis = 0; axis < 3; axis++) {
+        iov[n++] = (struct iovec){ block->magn[axis], block->count * sizeof(float) };
+    }
+    iov[n++] = (struct iovec){ block->pressure, block->count * sizeof(float) };
+    iov[n++] = (struct iovec){ block->sequence, block->count * sizeof(uint16_t) };
+    iov[n++] = (struct iovec){ block->flags, block->count * sizeof(uint16_t) };
+    iov[n++] = (struct iovec){ block->fault, block->count * sizeof(uint16_t) };
+    return piOutWrite(out, iov, n);
+}
+
+/**
+ * @brief Writes everything buffered with one write() call.
+ *
+ * @param out Output state.
+ * @return 0 on success, -1 on a write error (errno is set).
+ */
+int piOutFlush(PiOut_t *out) {
+    int result = 0;
+
+    if (out->len == 0) {
+        return 0;
+    }
+    if (out->format == PI_OUT_BINARY) {
+        result = piOutFlushBinary(out);
+    } else {
+        struct iovec iov = { out->buffer, out->len };
+        result = piOutWrite(out, &iov, 1);
+    }
+    // A failed write drops the batch, the output keeps going with the next one
+    out->len = 0;
+    return result;
+}
+
+/**
+ * @brief Makes room for one more line or packet.
+ */
+static int piOutReserve(PiOut_t *out, size_t size) {
+    if (out->len + size > sizeof(out->buffer)) {
+        return piOutFlush(out);
+    }
+    return 0;
+}
+
+/**
+ * @brief Writes the column header of the table or CSV sink, nothing for the binary sink.
+ *
+ * @param out Output state.
+ * @return 0 on success, -1 on a write error.
+ */
+int piOutHeader(PiOut_t *out) {
+    static const char table[] =
+        "Size Header Sequencer GyroX      GyroY      GyroZ      AcclX      AcclY"
+        "      AcclZ    CRC32      Check      Validation result\n";
+    static const char csv[] =
+        "sequence,result,flags,fault,gyro_x,gyro_y,gyro_z,accl_x,accl_y,accl_z,"
+        "magn_x,magn_y,magn_z,pressure,mux\n";
+    const char *text = out->format == PI_OUT_TABLE ? table : out->format == PI_OUT_CSV ? csv : "";
+    size_t len = strlen(text);
+
+    if (piOutReserve(out, len) != 0) {
+        return -1;
+    }
+    memcpy(out->buffer + out->len, text, len);
+    out->len += len;
+    return 0;
+}
+
+/**
+ * @brief Formats one packet as a row of the `printPacket` table.
+ */
+static size_t piOutTableRow(char *text, const PiProt_t *packet, PiProtError_t result, size_t size, uint32_t check) {
+    const char *message = PiProtErrorToString(result);
+    char *p = text;
+
+    p += piOutUnsigned(p, size);
+    memcpy(p, "   0x", 5);
+    p += 5;
+    p += piOutHex(p, packet->header, 4);
+    *p++ = ' ';
+    p += piOutZeroPadded(p, packet->sequence, 5);
+    for (int axis = 0; axis < 3; axis++) {
+        *p++ = ' ';
+        p += piOutFormatFloat(p, fp1_14_17ToFloat(packet->data.gyro[axis]), 3, 10, 1);
+    }
+    for (int axis = 0; axis < 3; axis++) {
+        *p++ = ' ';
+        p += piOutFormatFloat(p, fp1_14_17ToFloat(packet->data.accl[axis]), 3, 10, 1);
+    }
+    memcpy(p, "  0x", 4);
+    p += 4;
+    p += piOutHex(p, packet->crc32, 8);
+    memcpy(p, " 0x", 3);
+    p += 3;
+    p += piOutHex(p, check, 8);
+    memcpy(p, " (", 2);
+    p += 2;
+    p += piOutUnsigned(p, (uint64_t)result);
+    memcpy(p, ") ", 2);
+    p += 2;
+    memcpy(p, message, strlen(message));
+    p += strlen(message);
+    *p++ = '\n';
+    return (size_t)(p - text);
+}
+
+/**
+ * @brief Formats one packet as a CSV line.
+ */
+static size_t piOutCsvRow(char *text, const PiProt_t *packet, PiProtError_t result) {
+    char *p = text;
+
+    p += piOutUnsigned(p, packet->sequence);
+    *p++ = ',';
+    p += piOutUnsigned(p, (uint64_t)result);
+    *p++ = ',';
+    p += piOutUnsigned(p, packet->data.flags.ui16);
+    *p++ = ',';
+    p += piOutUnsigned(p, packet->data.fault.ui16);
+    for (int axis = 0; axis < 3; axis++) {
+        *p++ = ',';
+        p += piOutFormatFloat(p, fp1_14_17ToFloat(packet->data.gyro[axis]), 6, 0, 0);
+    }
+    for (int axis = 0; axis < 3; axis++) {
+        *p++ = ',';
+        p += piOutFormatFloat(p, fp1_14_17ToFloat(packet->data.accl[axis]), 6, 0, 0);
+    }
+    for (int axis = 0; axis < 3; axis++) {
+        *p++ = ',';
+        p += piOutFormatFloat(p, fp1_10_21ToFloat(packet->data.magn[axis]), 6, 0, 0);
+    }
+    *p++ = ',';
+    p += piOutFormatFloat(p, fp17_15ToFloat(packet->data.pressure), 5, 0, 0);
+    *p++ = ',';
+    p += piOutUnsigned(p, packet->mux);
+    *p++ = '\n';
+    return (size_t)(p - text);
+}
+
+/**
+ * @brief Formats one packet, with the length and computed CRC shown in the table.
+ */
+static int piOutRow(PiOut_t *out, const PiProt_t *packet, PiProtError_t result, size_t size, const uint32_t *check) {
+    if (out->format == PI_OUT_BINARY) {
+        if (result != PI_PROT_OK && result != PI_PROT_CORRECTED) {
+            return 0;
+        }
+        if (out->len == PI_OUT_BLOCK_SIZE && piOutFlush(out) != 0) {
+            return -1;
+        }
+        memcpy(out->buffer + out->len * sizeof(PiProt_t), packet, sizeof(PiProt_t));
+        out->len++;
+        out->packets++;
+        return 0;
+    }
+
+    if (piOutReserve(out, PI_OUT_LINE_MAX) != 0) {
+        return -1;
+    }
+    if (out->format == PI_OUT_TABLE) {
+        uint32_t crc = packet->crc32;
+        if (check != NULL) {
+            crc = *check;
+        } else if (result != PI_PROT_OK) {
+            crc = piCrc32Fast((const uint8_t *)&packet->sequence, sizeof(PiProt_t) - sizeof(uint32_t) - sizeof(uint16_t));
+        }
+        out->len += piOutTableRow(out->buffer + out->len, packet, result, size, crc);
+    } else {
+        out->len += piOutCsvRow(out->buffer + out->len, packet, result);
+    }
+    out->packets++;
+    return 0;
+}
+
+/**
+ * @brief Formats one packet.
+ *
+ * @param out Output state.
+ * @param packet Packet to write.
+ * @param result Validation result of the packet.
+ * @return 0 on success, -1 on a write error.
+ */
+int piOutPacket(PiOut_t *out, const PiProt_t *packet, PiProtError_t result) {
+    return piOutRow(out, packet, result, sizeof(PiProt_t), NULL);
+}
+
+/**
+ * @brief Formats a packet translated from another format.
+ *
+ * @param out Output state.
+ * @param packet Packet translated into the current format.
+ * @param result Validation result of the original packet.
+ * @param size Length of the original packet.
+ * @param check CRC computed over the original packet.
+ * @return 0 on success, -1 on a write error.
+ */
+int piOutTranslatedPacket(PiOut_t *out, const PiProt_t *packet, PiProtError_t result, size_t size, uint32_t check) {
+    return piOutRow(out, packet, result, size, &check);
+}
+
+/**
+ * @brief Flushes a `PI_OUT_MEMORY` output and takes the bytes it holds.
+ *
+ * @param out Output state.
+ * @param len Receives the number of bytes.
+ * @return The bytes, to be released with free(), NULL if there are none.
+ */
+char *piOutTake(PiOut_t *out, size_t *len) {
+    char *memory;
+
+    piOutFlush(out);
+    memory = out->memory;
+    *len = out->memoryLen;
+    out->memory = NULL;
+    out->memoryLen = 0;
+    out->memoryCapacity = 0;
+    return memory;
+}
+
+/**
+ * @brief Writes bytes formatted by another output of the same format, after the buffered ones.
+ *
+ * @param out Output state.
+ * @param bytes Bytes taken from another output with `piOutTake`.
+ * @param len Number of bytes.
+ * @return 0 on success, -1 on a write error.
+ */
+int piOutWriteBytes(PiOut_t *out, const void *bytes, size_t len) {
+    struct iovec iov = { (void *)bytes, len };
+
+    if (piOutFlush(out) != 0) {
+        return -1;
+    }
+    return len != 0 ? piOutWrite(out, &iov, 1) : 0;
+}
+
+/**
+ * @brief Flushes the output and releases its memory.
+ *
+ * @param out Output state.
+ * @return 0 on success, -1 if the final flush failed.
+ */
+int piOutClose(PiOut_t *out) {
+    int result = piOutFlush(out);
+    piSampleBlockFree(&out->block);
+    free(out->memory);
+    out->memory = NULL;
+    out->memoryLen = 0;
+    out->memoryCapacity = 0;
+    return result;
+}
+
+/**
+ * @brief Parses an output format name.
+ *
+ * @param name "table", "csv" or "binary".
+ * @param format Receives the format.
+ * @return 0 on success, -1 for an unknown name.
+ */
+int piOutFormatFromName(const char *name, PiOutFormat_t *format) {
+    static const char *const names[] = { "table", "csv", "binary" };
+    for (int i = 0; i < 3; i++) {
+        if (strcmp(name, names[i]) == 0) {
+            *format = (PiOutFormat_t)i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Converts an ImuProtError_t error code to its corresponding string representation.
+ *
+ * @param error The ImuProtError_t error code.
+ * @return A string that describes the error.
+ */
+const char* PiProtErrorToString(PiProtError_t error) {
+    switch (error) {
+        case PI_PROT_OK:
+            return "OK.";
+        case PI_PROT_BAD_HEADER:
+            return "Invalid header!";
+        case PI_PROT_BAD_SEQUENCE:
+            return "Sequence check failed!";
+        case PI_PROT_BAD_CRC:
+            return "CRC validation failed!";
+        case PI_PROT_CORRECTED:
+            return "Corrected single-bit error.";
+    }
+	return "Unknown error.";
+}
@@ -0,0 +1,187 @@
+/**
+ * @file piout.h
+ * @brief Buffered packet output without stdio.
+ *
+ * Packets are formatted into one large reusable buffer that is written with a single write()
+ * per flush. Three sinks are available: the human-readable table printed by `printPacket`,
+ * CSV with one line per packet, and a binary structure-of-arrays dump. The float formatter
+ * relies on the values being exact binary fractions and produces the same text as printf.
+ *
+ * A binary dump is a sequence of blocks, each a `PiOutBlockHeader_t` followed by `count`
+ * floats of every axis (accl X, Y, Z, gyro X, Y, Z, magn X, Y, Z, pressure) and `count`
+ * 16-bit words of sequence, flags and fault, all little-endian.
+ */
+
+#ifndef piout_h_included
+#define piout_h_included
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "pi.h"
+#include "piconv.h"
+
+#define PI_OUT_BUFFER_SIZE  (256 * 1024)
+#define PI_OUT_BLOCK_MAGIC  0x42534950u     // "PISB" in file byte order
+#define PI_OUT_MEMORY       (-1)            // File descriptor of an output kept in memory
+
+/**
+ * @enum PiOutFormat_t
+ * @brief Output sinks.
+ */
+typedef enum {
+    PI_OUT_TABLE = 0,   // Columns of `printPacket`
+    PI_OUT_CSV,         // Comma-separated values with a header line
+    PI_OUT_BINARY       // Structure-of-arrays blocks
+} PiOutFormat_t;
+
+/**
+ * @struct PiOutBlockHeader_t
+ * @brief Header of a block of the binary dump.
+ */
+typedef struct {
+    uint32_t magic;     // PI_OUT_BLOCK_MAGIC
+    uint32_t count;     // Samples in the block
+} PiOutBlockHeader_t;
+
+/**
+ * @struct PiOut_t
+ * @brief Output state.
+ */
+typedef struct {
+    int fd;                             // Destination file descriptor
+    PiOutFormat_t format;               // Selected sink
+    size_t len;                         // Bytes (or binary packets) held in the buffer
+    uint64_t packets;                   // Packets written
+    uint64_t bytes;                     // Bytes written
+    uint64_t writes;                    // write() calls
+    int error;                          // errno of the first failed write, 0 if none
+    PiSampleBlock_t block;              // Conversion block of the binary sink
+    char *memory;                       // Bytes flushed by a `PI_OUT_MEMORY` output
+    size_t memoryLen;                   // Bytes held in `memory`
+    size_t memoryCapacity;              // Bytes allocated for `memory`
+    char buffer[PI_OUT_BUFFER_SIZE];    // Text, or packets waiting for conversion
+} PiOut_t;
+
+/**
+ * @brief Initializes an output.
+ *
+ * With `PI_OUT_MEMORY` as file descriptor the flushed bytes are kept in memory until they
+ * are taken with `piOutTake`, so that several outputs can be formatted concurrently and
+ * written in order.
+ *
+ * @param out Output to initialize.
+ * @param fd Destination file descriptor, not closed by `piOutClose`, or `PI_OUT_MEMORY`.
+ * @param format Selected sink.
+ * @return 0 on success, -1 if the memory could not be allocated.
+ */
+int piOutInit(PiOut_t *out, int fd, PiOutFormat_t format);
+
+/**
+ * @brief Writes the column header of the table or CSV sink, nothing for the binary sink.
+ *
+ * @param out Output state.
+ * @return 0 on success, -1 on a write error.
+ */
+int piOutHeader(PiOut_t *out);
+
+/**
+ * @brief Formats one packet.
+ *
+ * The CRC column of the table shows the CRC computed over the packet. For a packet that
+ * passed validation it equals the transmitted CRC, so it is recomputed only when `result`
+ * is not `PI_PROT_OK`. The binary sink stores valid packets only.
+ *
+ * @param out Output state.
+ * @param packet Packet to write.
+ * @param result Validation result of the packet.
+ * @return 0 on success, -1 on a write error.
+ */
+int piOutPacket(PiOut_t *out, const PiProt_t *packet, PiProtError_t result);
+
+/**
+ * @brief Formats a packet translated from another format.
+ *
+ * Same as `piOutPacket`, but the header, length and CRC columns of the table describe the
+ * packet as it arrived, so that valid and rejected packets show their own CRC next to the
+ * transmitted one.
+ *
+ * @param out Output state.
+ * @param packet Packet translated into the current format, with the transmitted header and CRC.
+ * @param result Validation result of the original packet.
+ * @param size Length of the original packet.
+ * @param check CRC computed over the bytes of the original packet it covers.
+ * @return 0 on success, -1 on a write error.
+ */
+int piOutTranslatedPacket(PiOut_t *out, const PiProt_t *packet, PiProtError_t result, size_t size, uint32_t check);
+
+/**
+ * @brief Writes everything buffered with one write() call.
+ *
+ * @param out Output state.
+ * @return 0 on success, -1 on a write error (errno is set).
+ */
+int piOutFlush(PiOut_t *out);
+
+/**
+ * @brief Flushes a `PI_OUT_MEMORY` output and takes the bytes it holds.
+ *
+ * The output starts over with an empty memory and keeps its format.
+ *
+ * @param out Output state.
+ * @param len Receives the number of bytes.
+ * @return The bytes, to be released with free(), NULL if there are none.
+ */
+char *piOutTake(PiOut_t *out, size_t *len);
+
+/**
+ * @brief Writes bytes formatted by another output of the same format, after the buffered ones.
+ *
+ * @param out Output state.
+ * @param bytes Bytes taken from another output with `piOutTake`.
+ * @param len Number of bytes.
+ * @return 0 on success, -1 on a write error.
+ */
+int piOutWriteBytes(PiOut_t *out, const void *bytes, size_t len);
+
+/**
+ * @brief Flushes the output and releases its memory.
+ *
+ * @param out Output state.
+ * @return 0 on success, -1 if the final flush failed.
+ */
+int piOutClose(PiOut_t *out);
+
+/**
+ * @brief Formats a float like printf("%*.*f"), optionally with the ' ' flag.
+ *
+ * Exact for every float whose scaled value fits in 53 bits, which covers all fixed-point
+ * sensor values; other values are passed to snprintf. No terminating zero is written.
+ *
+ * @param text Destination, at least `width + 48` bytes.
+ * @param value Value to format.
+ * @param decimals Digits after the decimal point, at most 6.
+ * @param width Minimum field width, padded with spaces on the left.
+ * @param spaceSign Non-zero to print a space in front of non-negative values.
+ * @return Number of characters written.
+ */
+size_t piOutFormatFloat(char *text, float value, unsigned decimals, unsigned width, int spaceSign);
+
+/**
+ * @brief Parses an output format name.
+ *
+ * @param name "table", "csv" or "binary".
+ * @param format Receives the format.
+ * @return 0 on success, -1 for an unknown name.
+ */
+int piOutFormatFromName(const char *name, PiOutFormat_t *format);
+
+/**
+ * @brief Converts a PiProtError_t error code to its string representation.
+ *
+ * @param error The PiProtError_t error code.
+ * @return A string describing the error.
+ */
+const char *PiProtErrorToString(PiProtError_t error);
+
+#endif	/* #ifdef piout_h_included */
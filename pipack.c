@@ -0,0 +1,725 @@
+#define _DEFAULT_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "picrc.h"
+#include "pipack.h"
+
+_Static_assert(sizeof(PiPackHeader_t) == 32, "compressed capture header must be 32 bytes");
+_Static_assert(sizeof(PiPackBlockHeader_t) == 24, "block header must be 24 bytes");
+_Static_assert(PI_PACK_BLOCK_PACKETS <= 0x10000, "exception indexes are 16 bits");
+
+/**
+ * @struct PiPackException_t
+ * @brief Original header and CRC of a packet that does not validate.
+ */
+typedef struct __attribute__((packed)) {
+    uint16_t index;             // Packet in the block
+    uint16_t header;
+    uint32_t crc32;
+} PiPackException_t;
+
+/**
+ * @brief Kinds of value streams.
+ */
+typedef enum {
+    PI_PACK_GAP,                // Sequence number gap
+    PI_PACK_DELTA16,            // Zigzag difference of a 16-bit field
+    PI_PACK_DELTA32,            // Zigzag difference of a 32-bit field
+    PI_PACK_CHANGE              // Mux word XOR the previous one of the same slot
+} PiPackKind_t;
+
+/**
+ * @brief Field and encoding of every stream, in block order.
+ */
+static const struct {
+    uint8_t kind;
+    uint8_t offset;
+} piPackStreams[PI_PACK_STREAMS] = {
+    { PI_PACK_GAP, offsetof(PiProt_t, sequence) },
+    { PI_PACK_DELTA16, offsetof(PiProt_t, data.flags) },
+    { PI_PACK_DELTA16, offsetof(PiProt_t, data.fault) },
+    { PI_PACK_DELTA32, offsetof(PiProt_t, data.accl[0]) },
+    { PI_PACK_DELTA32, offsetof(PiProt_t, data.accl[1]) },
+    { PI_PACK_DELTA32, offsetof(PiProt_t, data.accl[2]) },
+    { PI_PACK_DELTA32, offsetof(PiProt_t, data.gyro[0]) },
+    { PI_PACK_DELTA32, offsetof(PiProt_t, data.gyro[1]) },
+    { PI_PACK_DELTA32, offsetof(PiProt_t, data.gyro[2]) },
+    { PI_PACK_DELTA32, offsetof(PiProt_t, data.magn[0]) },
+    { PI_PACK_DELTA32, offsetof(PiProt_t, data.magn[1]) },
+    { PI_PACK_DELTA32, offsetof(PiProt_t, data.magn[2]) },
+    { PI_PACK_DELTA32, offsetof(PiProt_t, data.pressure) },
+    { PI_PACK_CHANGE, offsetof(PiProt_t, mux) },
+};
+
+static inline uint32_t piPackZigzag(int32_t value) {
+    return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static inline int32_t piPackUnzigzag(uint32_t value) {
+    return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+static inline uint32_t piPackLoad16(const PiProt_t *packet, unsigned offset) {
+    uint16_t value;
+    memcpy(&value, (const uint8_t *)packet + offset, sizeof(value));
+    return value;
+}
+
+static inline uint32_t piPackLoad32(const PiProt_t *packet, unsigned offset) {
+    uint32_t value;
+    memcpy(&value, (const uint8_t *)packet + offset, sizeof(value));
+    return value;
+}
+
+static inline void piPackStore16(PiProt_t *packet, unsigned offset, uint32_t value) {
+    uint16_t narrow = (uint16_t)value;
+    memcpy((uint8_t *)packet + offset, &narrow, sizeof(narrow));
+}
+
+static inline void piPackStore32(PiProt_t *packet, unsigned offset, uint32_t value) {
+    memcpy((uint8_t *)packet + offset, &value, sizeof(value));
+}
+
+/**
+ * @brief Returns the bytes of a stream of `values` values.
+ */
+static size_t piPackStreamBound(size_t values) {
+    return (values + PI_PACK_GROUP - 1) / PI_PACK_GROUP * (1 + PI_PACK_GROUP * sizeof(uint32_t));
+}
+
+/**
+ * @brief Returns the largest encoded size of a block.
+ *
+ * @param count Packets in the block, at most `PI_PACK_BLOCK_PACKETS`.
+ * @return Bytes, block header included.
+ */
+size_t piPackBound(size_t count) {
+    size_t values = count ? count - 1 : 0;
+    return sizeof(PiPackBlockHeader_t) + sizeof(PiProt_t) + PI_PACK_STREAMS * piPackStreamBound(values) +
+           values * sizeof(PiPackException_t) + 2 * PI_PACK_PADDING;
+}
+
+/**
+ * @brief Computes the values of a stream, from the second packet of the block on.
+ */
+static void piPackValues(const PiProt_t *packets, size_t count, unsigned stream, uint32_t *values) {
+    unsigned offset = piPackStreams[stream].offset;
+
+    switch (piPackStreams[stream].kind) {
+        case PI_PACK_GAP:
+            for (size_t i = 1; i < count; i++) {
+                values[i - 1] = (uint16_t)(packets[i].sequence - packets[i - 1].sequence - 1);
+            }
+            break;
+        case PI_PACK_DELTA16:
+            for (size_t i = 1; i < count; i++) {
+                int16_t delta = (int16_t)(piPackLoad16(&packets[i], offset) - piPackLoad16(&packets[i - 1], offset));
+                values[i - 1] = piPackZigzag(delta);
+            }
+            break;
+        case PI_PACK_DELTA32:
+            for (size_t i = 1; i < count; i++) {
+                uint32_t delta = piPackLoad32(&packets[i], offset) - piPackLoad32(&packets[i - 1], offset);
+                values[i - 1] = piPackZigzag((int32_t)delta);
+            }
+            break;
+        case PI_PACK_CHANGE: {
+            uint32_t last[PI_MUXFACTOR] = { 0 };
+            last[packets[0].sequence % PI_MUXFACTOR] = packets[0].mux;
+            for (size_t i = 1; i < count; i++) {
+                unsigned slot = packets[i].sequence % PI_MUXFACTOR;
+                values[i - 1] = packets[i].mux ^ last[slot];
+                last[slot] = packets[i].mux;
+            }
+            break;
+        }
+    }
+}
+
+/**
+ * @brief Bit-packs a stream in groups, the last group padded with zero values.
+ *
+ * @return Bytes written.
+ */
+static size_t piPackStream(uint32_t *values, size_t count, uint8_t *out) {
+    uint8_t *start = out;
+
+    for (size_t g = 0; g < count; g += PI_PACK_GROUP) {
+        uint32_t any = 0;
+        unsigned width, bits = 0;
+        uint64_t acc = 0;
+
+        for (size_t j = count; j < g + PI_PACK_GROUP; j++) {
+            values[j] = 0;
+        }
+        for (size_t j = 0; j < PI_PACK_GROUP; j++) {
+            any |= values[g + j];
+        }
+        width = any ? 32 - (unsigned)__builtin_clz(any) : 0;
+        *out++ = (uint8_t)width;
+        if (width == 0) {
+            continue;
+        }
+        for (size_t j = 0; j < PI_PACK_GROUP; j++) {
+            acc |= (uint64_t)values[g + j] << bits;
+            bits += width;
+            if (bits >= 32) {
+                uint32_t word = (uint32_t)acc;
+                memcpy(out, &word, sizeof(word));
+                out += sizeof(word);
+                acc >>= 32;
+                bits -= 32;
+            }
+        }
+    }
+    return (size_t)(out - start);
+}
+
+/**
+ * @brief Encodes a block of packets.
+ *
+ * @param packets Packets of the block, exactly as captured.
+ * @param count Number of packets, 1 to `PI_PACK_BLOCK_PACKETS`.
+ * @param sample Absolute sample number of the first packet.
+ * @param hostTimeNs Host time of the first packet.
+ * @param out Receives the block, at least `piPackBound(count)` bytes.
+ * @return Bytes written, block header included.
+ */
+size_t piPackEncode(const PiProt_t *packets, size_t count, uint64_t sample, uint64_t hostTimeNs, uint8_t *out) {
+    uint32_t values[PI_PACK_BLOCK_PACKETS + PI_PACK_GROUP];
+    PiProtError_t results[PI_PACK_BLOCK_PACKETS];
+    PiPackBlockHeader_t header = { 0, (uint16_t)count, 0, sample, hostTimeNs };
+    uint8_t *p = out + sizeof(header);
+
+    memcpy(p, &packets[0], sizeof(PiProt_t));
+    p += sizeof(PiProt_t);
+    for (unsigned s = 0; s < PI_PACK_STREAMS; s++) {
+        piPackValues(packets, count, s, values);
+        p += piPackStream(values, count - 1, p);
+    }
+
+    piCheckProtBuffers(packets + 1, sizeof(PiProt_t), count - 1, results);
+    for (size_t i = 1; i < count; i++) {
+        if (results[i - 1] != PI_PROT_OK) {
+            PiPackException_t exception = { (uint16_t)i, packets[i].header, packets[i].crc32 };
+            memcpy(p, &exception, sizeof(exception));
+            p += sizeof(exception);
+            header.exceptions++;
+        }
+    }
+
+    // Group decoding loads 8 bytes at a time, and the next block header stays aligned
+    size_t size = (size_t)(p - out) + PI_PACK_PADDING;
+    size = (size + 7) & ~(size_t)7;
+    memset(p, 0, size - (size_t)(p - out));
+    header.size = (uint32_t)(size - sizeof(header));
+    memcpy(out, &header, sizeof(header));
+    return size;
+}
+
+/**
+ * @brief Unpacks one group of values of a given width.
+ *
+ * Inlined with a constant width, every shift and mask is a constant.
+ */
+static inline __attribute__((always_inline)) void piPackUnpackWidth(const uint8_t *in, unsigned width, uint32_t *values) {
+    const uint64_t mask = (1ull << width) - 1;
+
+    for (unsigned j = 0; j < PI_PACK_GROUP; j++) {
+        unsigned bit = j * width;
+        uint64_t word;
+        memcpy(&word, in + bit / 8, sizeof(word));
+        values[j] = (uint32_t)((word >> (bit % 8)) & mask);
+    }
+}
+
+#define PI_PACK_UNPACK(w) \
+    static void piPackUnpack##w(const uint8_t *in, uint32_t *values) { piPackUnpackWidth(in, w, values); }
+#define PI_PACK_WIDTHS(X) \
+    X(1) X(2) X(3) X(4) X(5) X(6) X(7) X(8) X(9) X(10) X(11) X(12) X(13) X(14) X(15) X(16) \
+    X(17) X(18) X(19) X(20) X(21) X(22) X(23) X(24) X(25) X(26) X(27) X(28) X(29) X(30) X(31) X(32)
+
+PI_PACK_WIDTHS(PI_PACK_UNPACK)
+
+static void piPackUnpack0(const uint8_t *in, uint32_t *values) {
+    (void)in;
+    memset(values, 0, PI_PACK_GROUP * sizeof(uint32_t));
+}
+
+#define PI_PACK_UNPACK_ENTRY(w) piPackUnpack##w,
+
+static void (*const piPackUnpack[33])(const uint8_t *, uint32_t *) = {
+    piPackUnpack0, PI_PACK_WIDTHS(PI_PACK_UNPACK_ENTRY)
+};
+
+/**
+ * @brief Unpacks a stream of `count` values.
+ *
+ * @return Pointer past the stream, NULL if it overruns `end` or has an invalid width.
+ */
+static const uint8_t *piPackUnstream(const uint8_t *in, const uint8_t *end, size_t count, uint32_t *values) {
+    for (size_t g = 0; g < count; g += PI_PACK_GROUP) {
+        unsigned width;
+        if (in >= end || (width = *in++) > 32 || (size_t)(end - in) < width * sizeof(uint32_t)) {
+            return NULL;
+        }
+        piPackUnpack[width](in, values + g);
+        in += width * sizeof(uint32_t);
+    }
+    return in;
+}
+
+/**
+ * @brief Rebuilds the field of a stream in every packet after the first one.
+ */
+static void piPackApply(PiProt_t *packets, size_t count, unsigned stream, const uint32_t *values) {
+    unsigned offset = piPackStreams[stream].offset;
+
+    switch (piPackStreams[stream].kind) {
+        case PI_PACK_GAP: {
+            uint16_t sequence = packets[0].sequence;
+            for (size_t i = 1; i < count; i++) {
+                sequence = (uint16_t)(sequence + 1 + values[i - 1]);
+                packets[i].sequence = sequence;
+            }
+            break;
+        }
+        case PI_PACK_DELTA16: {
+            uint32_t value = piPackLoad16(&packets[0], offset);
+            for (size_t i = 1; i < count; i++) {
+                value += (uint32_t)piPackUnzigzag(values[i - 1]);
+                piPackStore16(&packets[i], offset, value);
+            }
+            break;
+        }
+        case PI_PACK_DELTA32: {
+            uint32_t value = piPackLoad32(&packets[0], offset);
+            for (size_t i = 1; i < count; i++) {
+                value += (uint32_t)piPackUnzigzag(values[i - 1]);
+                piPackStore32(&packets[i], offset, value);
+            }
+            break;
+        }
+        case PI_PACK_CHANGE: {
+            uint32_t last[PI_MUXFACTOR] = { 0 };
+            last[packets[0].sequence % PI_MUXFACTOR] = packets[0].mux;
+            for (size_t i = 1; i < count; i++) {
+                unsigned slot = packets[i].sequence % PI_MUXFACTOR;
+                last[slot] ^= values[i - 1];
+                packets[i].mux = last[slot];
+            }
+            break;
+        }
+    }
+}
+
+/**
+ * @brief Decodes a block of packets.
+ *
+ * @param block Block header, followed by its encoded packets.
+ * @param packets Receives the packets, at least `block->count` entries.
+ * @return Number of packets decoded, 0 if the block is corrupted.
+ */
+size_t piPackDecode(const PiPackBlockHeader_t *block, PiProt_t *packets) {
+    uint32_t values[PI_PACK_BLOCK_PACKETS + PI_PACK_GROUP];
+    const uint8_t *in = (const uint8_t *)(block + 1);
+    const uint8_t *end;
+    size_t count = block->count;
+
+    if (count == 0 || count > PI_PACK_BLOCK_PACKETS || block->size < sizeof(PiProt_t) + PI_PACK_PADDING) {
+        return 0;
+    }
+    end = in + block->size - PI_PACK_PADDING;
+    memcpy(&packets[0], in, sizeof(PiProt_t));
+    in += sizeof(PiProt_t);
+    for (unsigned s = 0; s < PI_PACK_STREAMS; s++) {
+        in = piPackUnstream(in, end, count - 1, values);
+        if (in == NULL) {
+            return 0;
+        }
+        piPackApply(packets, count, s, values);
+    }
+
+    for (size_t i = 1; i < count; i++) {
+        packets[i].header = PI_HEADER;
+        packets[i].crc32 = piCrc32Fast((const uint8_t *)&packets[i].sequence, sizeof(PiProt_t) - sizeof(uint32_t) - sizeof(uint16_t));
+    }
+    if ((size_t)(end - in) < block->exceptions * sizeof(PiPackException_t)) {
+        return 0;
+    }
+    for (unsigned e = 0; e < block->exceptions; e++, in += sizeof(PiPackException_t)) {
+        PiPackException_t exception;
+        memcpy(&exception, in, sizeof(exception));
+        if (exception.index == 0 || exception.index >= count) {
+            return 0;
+        }
+        packets[exception.index].header = exception.header;
+        packets[exception.index].crc32 = exception.crc32;
+    }
+    return count;
+}
+
+/**
+ * @brief Returns the time of a clock in nanoseconds.
+ */
+static uint64_t piPackNow(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief Writes a whole buffer at an offset, retrying short writes.
+ */
+static int piPackWrite(int fd, const void *buffer, size_t len, off_t offset) {
+    const uint8_t *p = buffer;
+
+    while (len > 0) {
+        ssize_t written = pwrite(fd, p, len, offset);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        p += written;
+        len -= (size_t)written;
+        offset += written;
+    }
+    return 0;
+}
+
+/**
+ * @brief Encodes and writes the pending packets as one block.
+ */
+static int piPackFlush(PiPackWriter_t *writer) {
+    size_t size;
+
+    if (writer->count == 0) {
+        return 0;
+    }
+    size = piPackEncode(writer->pending, writer->count, writer->blockSample, writer->blockTimeNs, writer->buffer);
+    if (piPackWrite(writer->fd, writer->buffer, size, (off_t)writer->bytes) != 0) {
+        return -1;
+    }
+    writer->bytes += size;
+    writer->count = 0;
+    return 0;
+}
+
+/**
+ * @brief Creates a compressed capture.
+ *
+ * @param writer Writer state to initialize.
+ * @param path Path of the capture.
+ * @param hwSerial Hardware serial number of the device, 0 if not known yet.
+ * @param packetRate Packet rate in Hz.
+ * @return 0 on success, -1 on error (errno is set).
+ */
+int piPackCreate(PiPackWriter_t *writer, const char *path, uint32_t hwSerial, uint16_t packetRate) {
+    int saved;
+
+    memset(writer, 0, sizeof(*writer));
+    writer->pending = malloc(PI_PACK_BLOCK_PACKETS * sizeof(PiProt_t));
+    writer->buffer = malloc(piPackBound(PI_PACK_BLOCK_PACKETS));
+    writer->fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (writer->pending == NULL || writer->buffer == NULL || writer->fd < 0) {
+        goto fail;
+    }
+
+    writer->header.magic = PI_PACK_MAGIC;
+    writer->header.version = PI_PACK_VERSION;
+    writer->header.blockPackets = PI_PACK_BLOCK_PACKETS;
+    writer->header.hwSerial = hwSerial;
+    writer->header.packetRate = packetRate;
+    writer->header.startTimeNs = piPackNow(CLOCK_REALTIME);
+    writer->header.startHostNs = piPackNow(CLOCK_MONOTONIC);
+    if (piPackWrite(writer->fd, &writer->header, sizeof(writer->header), 0) != 0) {
+        goto fail;
+    }
+    writer->bytes = sizeof(writer->header);
+    return 0;
+
+fail:
+    saved = errno;
+    if (writer->fd >= 0) {
+        close(writer->fd);
+    }
+    free(writer->pending);
+    free(writer->buffer);
+    memset(writer, 0, sizeof(*writer));
+    writer->fd = -1;
+    errno = saved;
+    return -1;
+}
+
+/**
+ * @brief Appends one packet to the capture.
+ *
+ * @param writer Writer state.
+ * @param packet Packet to append.
+ * @param hostTimeNs Host time the packet was read (CLOCK_MONOTONIC).
+ * @return 0 on success, -1 if a block could not be written (errno is set).
+ */
+int piPackAppend(PiPackWriter_t *writer, const PiProt_t *packet, uint64_t hostTimeNs) {
+    // A lost packet advances the absolute sample number by the size of the sequence gap
+    if (writer->records == 0) {
+        writer->sample = packet->sequence;
+    } else {
+        writer->sample += (uint16_t)(packet->sequence - writer->lastSequence);
+    }
+    writer->lastSequence = packet->sequence;
+
+    if (writer->count == 0) {
+        writer->blockSample = writer->sample;
+        writer->blockTimeNs = hostTimeNs;
+    }
+    writer->pending[writer->count++] = *packet;
+    writer->records++;
+    return writer->count == PI_PACK_BLOCK_PACKETS ? piPackFlush(writer) : 0;
+}
+
+/**
+ * @brief Writes the last block, the final file header, and closes the capture.
+ *
+ * @param writer Writer state.
+ * @return 0 on success, -1 on error (errno is set).
+ */
+int piPackFinish(PiPackWriter_t *writer) {
+    int result = 0;
+
+    if (piPackFlush(writer) != 0 || piPackWrite(writer->fd, &writer->header, sizeof(writer->header), 0) != 0) {
+        result = -1;
+    }
+    if (close(writer->fd) != 0) {
+        result = -1;
+    }
+    free(writer->pending);
+    free(writer->buffer);
+    writer->pending = NULL;
+    writer->buffer = NULL;
+    writer->fd = -1;
+    return result;
+}
+
+/**
+ * @brief Maps a compressed capture for reading.
+ *
+ * @param reader Reader state to initialize.
+ * @param path Path of the capture.
+ * @return 0 on success, -1 on error (errno is set, EINVAL for a file that is not a compressed capture).
+ */
+int piPackOpen(PiPackReader_t *reader, const char *path) {
+    struct stat st;
+    size_t capacity = 0;
+    int saved;
+
+    memset(reader, 0, sizeof(*reader));
+    reader->fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (reader->fd < 0) {
+        return -1;
+    }
+    if (fstat(reader->fd, &st) != 0) {
+        goto fail;
+    }
+    if ((size_t)st.st_size < sizeof(PiPackHeader_t)) {
+        errno = EINVAL;
+        goto fail;
+    }
+    reader->mapSize = (size_t)st.st_size;
+    reader->map = mmap(NULL, reader->mapSize, PROT_READ, MAP_SHARED, reader->fd, 0);
+    if (reader->map == MAP_FAILED) {
+        reader->map = NULL;
+        goto fail;
+    }
+    madvise((void *)reader->map, reader->mapSize, MADV_SEQUENTIAL);
+
+    reader->header = (const PiPackHeader_t *)reader->map;
+    if (reader->header->magic != PI_PACK_MAGIC || reader->header->version != PI_PACK_VERSION ||
+        reader->header->blockPackets != PI_PACK_BLOCK_PACKETS || reader->header->packetRate == 0) {
+        errno = EINVAL;
+        goto fail;
+    }
+
+    for (size_t offset = sizeof(PiPackHeader_t); reader->mapSize - offset >= sizeof(PiPackBlockHeader_t);) {
+        const PiPackBlockHeader_t *block = (const PiPackBlockHeader_t *)(reader->map + offset);
+        if (block->count == 0 || block->count > PI_PACK_BLOCK_PACKETS || block->size % 8 != 0 ||
+            block->size > reader->mapSize - offset - sizeof(PiPackBlockHeader_t)) {
+            break;
+        }
+        if (reader->blockCount == capacity) {
+            capacity = capacity ? 2 * capacity : 64;
+            PiPackBlock_t *blocks = realloc(reader->blocks, capacity * sizeof(PiPackBlock_t));
+            if (blocks == NULL) {
+                goto fail;
+            }
+            reader->blocks = blocks;
+        }
+        reader->blocks[reader->blockCount].header = block;
+        reader->blocks[reader->blockCount].record = reader->count;
+        reader->blockCount++;
+        reader->count += block->count;
+        offset += sizeof(PiPackBlockHeader_t) + block->size;
+    }
+    return 0;
+
+fail:
+    saved = errno;
+    piPackClose(reader);
+    errno = saved;
+    return -1;
+}
+
+/**
+ * @brief Unmaps a compressed capture.
+ *
+ * @param reader Reader state.
+ */
+void piPackClose(PiPackReader_t *reader) {
+    free(reader->blocks);
+    if (reader->map != NULL) {
+        munmap((void *)reader->map, reader->mapSize);
+    }
+    if (reader->fd >= 0) {
+        close(reader->fd);
+    }
+    memset(reader, 0, sizeof(*reader));
+    reader->fd = -1;
+}
+
+/**
+ * @brief Finds the block holding a record.
+ *
+ * @param reader Reader state.
+ * @param record Record number, less than `reader->count`.
+ * @return Index of the block in `reader->blocks`.
+ */
+size_t piPackFindBlock(const PiPackReader_t *reader, uint64_t record) {
+    size_t low = 0, high = reader->blockCount;
+
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (reader->blocks[mid].record <= record) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low - 1;
+}
+
+/**
+ * @brief Finds the first record whose absolute sample number is at least `sample`.
+ *
+ * @param reader Reader state.
+ * @param sample Absolute sample number.
+ * @return Record number, `reader->count` if every record is before `sample`.
+ */
+uint64_t piPackSeekSample(const PiPackReader_t *reader, uint64_t sample) {
+    size_t low = 0, high = reader->blockCount;
+    PiProt_t *packets;
+
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (reader->blocks[mid].header->sample <= sample) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    if (low == 0) {
+        return 0;
+    }
+
+    // Only the sequence numbers of the block are needed, but decoding it whole is simpler
+    const PiPackBlock_t *block = &reader->blocks[low - 1];
+    uint64_t end = block->record + block->header->count;
+    uint64_t current = block->header->sample;
+    packets = malloc(PI_PACK_BLOCK_PACKETS * sizeof(PiProt_t));
+    if (packets == NULL || piPackDecode(block->header, packets) == 0) {
+        free(packets);
+        return end;
+    }
+    for (size_t i = 0; i < block->header->count; i++) {
+        if (i != 0) {
+            current += (uint16_t)(packets[i].sequence - packets[i - 1].sequence);
+        }
+        if (current >= sample) {
+            free(packets);
+            return block->record + i;
+        }
+    }
+    free(packets);
+    return end;
+}
+
+/**
+ * @brief Decodes records and feeds them to a framer, as fast as possible or paced by the
+ * recorded host times.
+ *
+ * @param reader Reader state.
+ * @param first First record to replay.
+ * @param last Record after the last one to replay, clamped to `reader->count`.
+ * @param speed Replay speed relative to real time (2.0 is twice as fast), 0 for no pacing.
+ * @param framer Framer receiving the records.
+ * @return Number of packets delivered by the framer, 0 if a block is corrupted.
+ */
+uint64_t piPackReplay(const PiPackReader_t *reader, uint64_t first, uint64_t last, double speed, PiFramer_t *framer) {
+    uint64_t origin = 0, wallStart = 0;
+    PiProt_t *packets;
+
+    if (last > reader->count) {
+        last = reader->count;
+    }
+    if (first >= last) {
+        return last;
+    }
+    packets = malloc(PI_PACK_BLOCK_PACKETS * sizeof(PiProt_t));
+    if (packets == NULL) {
+        return first;
+    }
+
+    for (size_t b = piPackFindBlock(reader, first); b < reader->blockCount && reader->blocks[b].record < last; b++) {
+        const PiPackBlock_t *block = &reader->blocks[b];
+        size_t begin = first > block->record ? (size_t)(first - block->record) : 0;
+        size_t end = block->header->count;
+
+        if (block->record + end > last) {
+            end = (size_t)(last - block->record);
+        }
+        if (piPackDecode(block->header, packets) == 0) {
+            free(packets);
+            errno = EINVAL;
+            return block->record + begin;
+        }
+        if (speed > 0) {
+            uint64_t recorded = block->header->hostTimeNs;
+            if (wallStart == 0) {
+                // The first record is timed from its sample number, later blocks start on exact host times
+                uint64_t sample = block->header->sample;
+                for (size_t i = 1; i <= begin; i++) {
+                    sample += (uint16_t)(packets[i].sequence - packets[i - 1].sequence);
+                }
+                origin = recorded + (sample - block->header->sample) * 1000000000ull / reader->header->packetRate;
+                wallStart = piPackNow(CLOCK_MONOTONIC);
+            } else {
+                uint64_t due = wallStart + (recorded > origin ? (uint64_t)((double)(recorded - origin) / speed) : 0);
+                struct timespec ts = { .tv_sec = (time_t)(due / 1000000000ull), .tv_nsec = (long)(due % 1000000000ull) };
+                while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+                }
+            }
+        }
+        piFramerFeed(framer, (const uint8_t *)(packets + begin), (end - begin) * sizeof(PiProt_t));
+    }
+    free(packets);
+    return last;
+}
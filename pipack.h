@@ -0,0 +1,225 @@
+/**
+ * @file pipack.h
+ * @brief Lossless compressed capture files of IMU protocol packets.
+ *
+ * Packets are compressed in self-contained blocks of up to `PI_PACK_BLOCK_PACKETS`. The
+ * first packet of a block is stored as is; every field of the following packets is turned
+ * into one stream of 32-bit values:
+ *
+ * - the sequence number as the gap to the previous one (0 for consecutive packets),
+ * - the flags, the fault word and the ten sensor channels as the zigzag-encoded difference to
+ *   the previous packet, so that small changes of either sign become small values,
+ * - the mux word as the bits changed since the previous cycle, i.e. XOR the last mux word
+ *   seen in the same slot (`sequence % PI_MUXFACTOR`).
+ *
+ * Every stream is bit-packed in groups of `PI_PACK_GROUP` values sharing the width of the
+ * largest one, a byte followed by 4 bytes per bit of width. Groups decode with fixed shifts
+ * and masks and no branch per value. The CRC is not stored: it is recomputed on decoding, and
+ * packets whose header is not `PI_HEADER` or whose CRC does not match are listed as
+ * exceptions with their original header and CRC, so every packet decodes to the exact bytes
+ * that were captured.
+ *
+ * A compressed capture is a 32-byte file header followed by the blocks, each with a header
+ * holding its length, the absolute sample number and the host time of its first packet. The
+ * reader maps the file and walks the block headers, which double as the seek index.
+ */
+
+#ifndef pipack_h_included
+#define pipack_h_included
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "pi.h"
+#include "piframer.h"
+
+#define PI_PACK_MAGIC           0x4B415050u     // "PPAK" in file byte order
+#define PI_PACK_VERSION         1
+#define PI_PACK_BLOCK_PACKETS   1024            // Packets per block
+#define PI_PACK_GROUP           32              // Values bit-packed with the same width
+#define PI_PACK_STREAMS         14              // Value streams of a block
+#define PI_PACK_PADDING         8               // Least zero bytes ending a block, padded to 8-byte multiples
+
+/**
+ * @struct PiPackHeader_t
+ * @brief Header at the start of a compressed capture.
+ */
+typedef struct {
+    uint32_t magic;             // PI_PACK_MAGIC
+    uint16_t version;           // PI_PACK_VERSION
+    uint16_t blockPackets;      // PI_PACK_BLOCK_PACKETS
+    uint32_t hwSerial;          // Hardware serial number of the device, 0 if unknown
+    uint16_t packetRate;        // Packet rate in Hz
+    uint16_t reserved;
+    uint64_t startTimeNs;       // CLOCK_REALTIME time the capture was created
+    uint64_t startHostNs;       // CLOCK_MONOTONIC time the capture was created
+} PiPackHeader_t;
+
+/**
+ * @struct PiPackBlockHeader_t
+ * @brief Header of a block, followed by `size` bytes of encoded packets.
+ */
+typedef struct {
+    uint32_t size;              // Bytes of the block after this header
+    uint16_t count;             // Packets in the block
+    uint16_t exceptions;        // Packets with a wrong header or CRC
+    uint64_t sample;            // Absolute sample number of the first packet
+    uint64_t hostTimeNs;        // Host time of the first packet
+} PiPackBlockHeader_t;
+
+/**
+ * @struct PiPackBlock_t
+ * @brief Position of a block in a mapped capture.
+ */
+typedef struct {
+    const PiPackBlockHeader_t *header;  // Block header inside the mapping
+    uint64_t record;                    // Record number of the first packet
+} PiPackBlock_t;
+
+/**
+ * @struct PiPackWriter_t
+ * @brief State of a compressed capture being written.
+ */
+typedef struct {
+    int fd;                     // Capture file
+    PiPackHeader_t header;      // File header, `hwSerial` may be updated until finished
+    PiProt_t *pending;          // Packets of the block being filled
+    size_t count;               // Packets pending
+    uint8_t *buffer;            // Encoded block
+    uint64_t blockSample;       // Absolute sample number of the first pending packet
+    uint64_t blockTimeNs;       // Host time of the first pending packet
+    uint64_t records;           // Packets appended
+    uint64_t bytes;             // Bytes written, file header included
+    uint64_t sample;            // Absolute sample number of the last packet
+    uint16_t lastSequence;      // Sequence number of the last packet
+} PiPackWriter_t;
+
+/**
+ * @struct PiPackReader_t
+ * @brief State of a compressed capture opened for reading.
+ */
+typedef struct {
+    int fd;                             // Capture file
+    const uint8_t *map;                 // Read-only mapping of the file
+    size_t mapSize;                     // Bytes mapped
+    const PiPackHeader_t *header;       // File header
+    PiPackBlock_t *blocks;              // Every block, in file order
+    size_t blockCount;                  // Number of blocks
+    uint64_t count;                     // Number of records
+} PiPackReader_t;
+
+/**
+ * @brief Returns the largest encoded size of a block.
+ *
+ * @param count Packets in the block, at most `PI_PACK_BLOCK_PACKETS`.
+ * @return Bytes, block header included.
+ */
+size_t piPackBound(size_t count);
+
+/**
+ * @brief Encodes a block of packets.
+ *
+ * @param packets Packets of the block, exactly as captured.
+ * @param count Number of packets, 1 to `PI_PACK_BLOCK_PACKETS`.
+ * @param sample Absolute sample number of the first packet.
+ * @param hostTimeNs Host time of the first packet.
+ * @param out Receives the block, at least `piPackBound(count)` bytes.
+ * @return Bytes written, block header included.
+ */
+size_t piPackEncode(const PiProt_t *packets, size_t count, uint64_t sample, uint64_t hostTimeNs, uint8_t *out);
+
+/**
+ * @brief Decodes a block of packets.
+ *
+ * @param block Block header, followed by its encoded packets.
+ * @param packets Receives the packets, at least `block->count` entries.
+ * @return Number of packets decoded, 0 if the block is corrupted.
+ */
+size_t piPackDecode(const PiPackBlockHeader_t *block, PiProt_t *packets);
+
+/**
+ * @brief Creates a compressed capture.
+ *
+ * @param writer Writer state to initialize.
+ * @param path Path of the capture.
+ * @param hwSerial Hardware serial number of the device, 0 if not known yet.
+ * @param packetRate Packet rate in Hz.
+ * @return 0 on success, -1 on error (errno is set).
+ */
+int piPackCreate(PiPackWriter_t *writer, const char *path, uint32_t hwSerial, uint16_t packetRate);
+
+/**
+ * @brief Appends one packet to the capture.
+ *
+ * Packets are buffered and written a block at a time.
+ *
+ * @param writer Writer state.
+ * @param packet Packet to append.
+ * @param hostTimeNs Host time the packet was read (CLOCK_MONOTONIC).
+ * @return 0 on success, -1 if a block could not be written (errno is set).
+ */
+int piPackAppend(PiPackWriter_t *writer, const PiProt_t *packet, uint64_t hostTimeNs);
+
+/**
+ * @brief Writes the last block, the final file header, and closes the capture.
+ *
+ * @param writer Writer state.
+ * @return 0 on success, -1 on error (errno is set).
+ */
+int piPackFinish(PiPackWriter_t *writer);
+
+/**
+ * @brief Maps a compressed capture for reading.
+ *
+ * A truncated last block, as left by a writer that did not finish, is ignored.
+ *
+ * @param reader Reader state to initialize.
+ * @param path Path of the capture.
+ * @return 0 on success, -1 on error (errno is set, EINVAL for a file that is not a compressed capture).
+ */
+int piPackOpen(PiPackReader_t *reader, const char *path);
+
+/**
+ * @brief Unmaps a compressed capture.
+ *
+ * @param reader Reader state.
+ */
+void piPackClose(PiPackReader_t *reader);
+
+/**
+ * @brief Finds the block holding a record.
+ *
+ * @param reader Reader state.
+ * @param record Record number, less than `reader->count`.
+ * @return Index of the block in `reader->blocks`.
+ */
+size_t piPackFindBlock(const PiPackReader_t *reader, uint64_t record);
+
+/**
+ * @brief Finds the first record whose absolute sample number is at least `sample`.
+ *
+ * @param reader Reader state.
+ * @param sample Absolute sample number.
+ * @return Record number, `reader->count` if every record is before `sample`.
+ */
+uint64_t piPackSeekSample(const PiPackReader_t *reader, uint64_t sample);
+
+/**
+ * @brief Decodes records and feeds them to a framer, as fast as possible or paced by the
+ * recorded host times.
+ *
+ * Every block is decoded into a buffer and passed to `piFramerFeed`, so the records take the
+ * same decode path as data read from a device.
+ *
+ * @param reader Reader state.
+ * @param first First record to replay.
+ * @param last Record after the last one to replay, clamped to `reader->count`.
+ * @param speed Replay speed relative to real time (2.0 is twice as fast), 0 for no pacing.
+ * @param framer Framer receiving the records.
+ * @return Record after the last one fed to the framer: `last` once the whole range is
+ *         replayed, the first record of a corrupted block where the replay stopped (errno is
+ *         EINVAL) or `first` if no memory was available (errno is ENOMEM).
+ */
+uint64_t piPackReplay(const PiPackReader_t *reader, uint64_t first, uint64_t last, double speed, PiFramer_t *framer);
+
+#endif	/* #ifdef pipack_h_included */
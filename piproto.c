@@ -0,0 +1,66 @@
+#include <string.h>
+#include <strings.h>
+
+#include "piproto.h"
+
+_Static_assert(sizeof(PiProt_t) == PI_PROTO_MAX_SIZE, "PI_PROTO_MAX_SIZE is the longest packet");
+
+#define PI_PROTO_DESCRIPTOR(Name, NAME, HEADER, SIZE, CRC_FIRST, CRC_END, CRC_OFFSET, SEQ_OFFSET, SEQ_BITS, SEQ_CHECK) \
+    [PI_PROTO_##NAME] = { #Name, (HEADER), (SIZE), (CRC_FIRST), (CRC_END), (CRC_OFFSET), (SEQ_BITS) },
+
+const PiProtoDescriptor_t piProtoDescriptors[PI_PROTO_COUNT] = {
+    PI_PROTO_FORMATS(PI_PROTO_DESCRIPTOR)
+};
+
+#define PI_PROTO_SIZE_CHECK(Name, NAME, HEADER, SIZE, CRC_FIRST, CRC_END, CRC_OFFSET, ...) \
+    _Static_assert((SIZE) <= PI_PROTO_MAX_SIZE && (CRC_END) <= (CRC_OFFSET) && (CRC_OFFSET) + 4 <= (SIZE) && \
+                   (CRC_END) - (CRC_FIRST) <= PI_CRC_CORRECT_MAX, \
+                   #Name " descriptor is inconsistent");
+
+PI_PROTO_FORMATS(PI_PROTO_SIZE_CHECK)
+
+/**
+ * @brief Finds the format of a complete packet from its length and header.
+ *
+ * @param packet First byte of the packet.
+ * @param size Length of the packet.
+ * @return Format whose length matches, and whose header too if several have that length;
+ *         `PI_PROTO_AUTO` if no format has that length.
+ */
+PiProtoFormat_t piProtoDetect(const uint8_t *packet, size_t size) {
+    PiProtoFormat_t found = PI_PROTO_AUTO;
+
+    for (int f = 0; f < PI_PROTO_COUNT; f++) {
+        if (piProtoDescriptors[f].size != size) {
+            continue;
+        }
+        if (PI_PROTO_LOAD(uint16_t, packet, 0) == piProtoDescriptors[f].header) {
+            return (PiProtoFormat_t)f;
+        }
+        if (found == PI_PROTO_AUTO) {
+            found = (PiProtoFormat_t)f;
+        }
+    }
+    return found;
+}
+
+/**
+ * @brief Parses a format name.
+ *
+ * @param name "main", "legacy" or "auto".
+ * @param format Receives the format.
+ * @return 0 on success, -1 for an unknown name.
+ */
+int piProtoFromName(const char *name, PiProtoFormat_t *format) {
+    if (strcmp(name, "auto") == 0) {
+        *format = PI_PROTO_AUTO;
+        return 0;
+    }
+    for (int f = 0; f < PI_PROTO_COUNT; f++) {
+        if (strcasecmp(name, piProtoDescriptors[f].name) == 0) {
+            *format = (PiProtoFormat_t)f;
+            return 0;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,291 @@
+/**
+ * @file piproto.h
+ * @brief Descriptors of the packet formats spoken by the IMU devices.
+ *
+ * Every format is described once in `PI_PROTO_FORMATS`: its header, its length, the bytes
+ * covered by its CRC32, where its sequence number is and how wide it is, and a list of its
+ * fields with their offset, type and the shift that brings their scale to the one of
+ * `PiProt_t`. The X-macros expand each descriptor into its own inline check and decode
+ * functions in which every offset, length and shift is a constant, so a caller that knows
+ * the format at compile time (the framer instantiates one feed loop per format) runs code
+ * without any branch on the format.
+ *
+ * A packet with a single-bit error in the bytes covered by its CRC or in the CRC itself can be
+ * repaired with `piProtoCorrect`, which locates the bit from the CRC syndrome.
+ *
+ * Packets of every format are decoded into a `PiProt_t` with `PI_HEADER`, a 16-bit sequence
+ * number and a CRC32 computed like the device does, so the rest of the decoder only ever
+ * sees the current format.
+ *
+ * - `Main`: the current 56-byte packet, `PiProt_t` itself.
+ * - `Legacy`: the 40-byte packet of older firmware. Header bytes 74 95, an 8-bit sequence
+ *   number followed by its complement, the mux word, the flags, a status word that is not
+ *   carried over, gyroscope and accelerometer X, Y, Z at a scale of 2^16, and a CRC32 over
+ *   the 36 bytes before it, header included. There is no magnetometer or pressure.
+ */
+
+#ifndef piproto_h_included
+#define piproto_h_included
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "pi.h"
+#include "picrc.h"
+
+#define PI_LEGACY_HEADER    0x9574      // Bytes 74 95 on the link
+#define PI_PROTO_MAX_SIZE   56          // Longest packet of any format
+
+/**
+ * Packet formats: X(Name, NAME, header, size, crcFirst, crcEnd, crcOffset, sequenceOffset,
+ * sequenceBits, sequenceCheck). The CRC32 covers bytes [crcFirst, crcEnd) and is stored at
+ * crcOffset; with sequenceCheck the byte after an 8-bit sequence number is its complement.
+ */
+#define PI_PROTO_FORMATS(X) \
+    X(Main,   MAIN,   PI_HEADER,        56, 2, 52, 52, 2, 16, 0) \
+    X(Legacy, LEGACY, PI_LEGACY_HEADER, 40, 0, 36, 36, 2, 8,  1)
+
+/**
+ * Fields of every format besides header, sequence and CRC: F(member of PiProt_t, offset, type, shift).
+ */
+#define PI_PROTO_FIELDS_Main(F) \
+    F(data.flags.ui16, 4, uint16_t, 0) \
+    F(data.fault.ui16, 6, uint16_t, 0) \
+    F(data.accl[0], 8, int32_t, 0) \
+    F(data.accl[1], 12, int32_t, 0) \
+    F(data.accl[2], 16, int32_t, 0) \
+    F(data.gyro[0], 20, int32_t, 0) \
+    F(data.gyro[1], 24, int32_t, 0) \
+    F(data.gyro[2], 28, int32_t, 0) \
+    F(data.magn[0], 32, int32_t, 0) \
+    F(data.magn[1], 36, int32_t, 0) \
+    F(data.magn[2], 40, int32_t, 0) \
+    F(data.pressure, 44, uint32_t, 0) \
+    F(mux, 48, uint32_t, 0)
+
+#define PI_PROTO_FIELDS_Legacy(F) \
+    F(mux, 4, uint32_t, 0) \
+    F(data.flags.ui16, 8, uint16_t, 0) \
+    F(data.gyro[0], 12, int32_t, 1) \
+    F(data.gyro[1], 16, int32_t, 1) \
+    F(data.gyro[2], 20, int32_t, 1) \
+    F(data.accl[0], 24, int32_t, 1) \
+    F(data.accl[1], 28, int32_t, 1) \
+    F(data.accl[2], 32, int32_t, 1)
+
+/**
+ * @enum PiProtoFormat_t
+ * @brief Packet formats, `PI_PROTO_AUTO` locks onto the first one found in the stream.
+ */
+typedef enum {
+#define PI_PROTO_ENUM(Name, NAME, ...) PI_PROTO_##NAME,
+    PI_PROTO_FORMATS(PI_PROTO_ENUM)
+#undef PI_PROTO_ENUM
+    PI_PROTO_COUNT,
+    PI_PROTO_AUTO = PI_PROTO_COUNT
+} PiProtoFormat_t;
+
+/**
+ * @struct PiProtoDescriptor_t
+ * @brief Descriptor of a format, for code that looks formats up at run time.
+ */
+typedef struct {
+    const char *name;           // Name, as accepted by `piProtoFromName` in any case
+    uint16_t header;            // First two bytes, little-endian
+    uint16_t size;              // Packet length in bytes
+    uint8_t crcFirst;           // First byte covered by the CRC32
+    uint8_t crcEnd;             // Byte after the last one covered by the CRC32
+    uint8_t crcOffset;          // Offset of the stored CRC32
+    uint8_t sequenceBits;       // Width of the sequence number
+} PiProtoDescriptor_t;
+
+extern const PiProtoDescriptor_t piProtoDescriptors[PI_PROTO_COUNT];
+
+#define PI_PROTO_LOAD(type, packet, offset) \
+    __extension__({ type piProtoValue_; memcpy(&piProtoValue_, (packet) + (offset), sizeof(type)); piProtoValue_; })
+
+#define PI_PROTO_DECODE_FIELD(member, offset, type, shift) \
+    out->member = (type)((uint32_t)PI_PROTO_LOAD(type, packet, offset) << (shift));
+
+/**
+ * Generates, for every format:
+ * - `piProtoCheck<Name>(packet)`: validates the header, the sequence complement and the CRC32;
+ * - `piProtoDecode<Name>(packet, sequence, out)`: translates the packet into a `PiProt_t`,
+ *   `sequence` carries the last 16-bit sequence number to extend shorter ones;
+ * - `piProtoCorrect<Name>(packet)`: repairs a single-bit error, the packet is only changed
+ *   when the repaired one passes every check.
+ */
+#define PI_PROTO_FUNCTIONS(Name, NAME, HEADER, SIZE, CRC_FIRST, CRC_END, CRC_OFFSET, SEQ_OFFSET, SEQ_BITS, SEQ_CHECK) \
+static inline PiProtError_t piProtoCheck##Name(const uint8_t *packet) { \
+    if (PI_PROTO_LOAD(uint16_t, packet, 0) != (HEADER)) { \
+        return PI_PROT_BAD_HEADER; \
+    } \
+    if ((SEQ_CHECK) && (uint8_t)(packet[SEQ_OFFSET] ^ packet[(SEQ_OFFSET) + 1]) != 0xFF) { \
+        return PI_PROT_BAD_SEQUENCE; \
+    } \
+    if (piCrc32Fast(packet + (CRC_FIRST), (CRC_END) - (CRC_FIRST)) != PI_PROTO_LOAD(uint32_t, packet, CRC_OFFSET)) { \
+        return PI_PROT_BAD_CRC; \
+    } \
+    return PI_PROT_OK; \
+} \
+static inline void piProtoDecode##Name(const uint8_t *packet, uint16_t *sequence, PiProt_t *out) { \
+    if ((SEQ_BITS) == 16) { \
+        *sequence = PI_PROTO_LOAD(uint16_t, packet, SEQ_OFFSET); \
+    } else { \
+        *sequence = (uint16_t)(*sequence + (uint8_t)(packet[SEQ_OFFSET] - (uint8_t)*sequence)); \
+    } \
+    if ((SIZE) == sizeof(PiProt_t) && (CRC_OFFSET) == offsetof(PiProt_t, crc32) && (SEQ_BITS) == 16) { \
+        memcpy(out, packet, sizeof(PiProt_t)); \
+        out->header = PI_HEADER; \
+        return; \
+    } \
+    memset(out, 0, sizeof(*out)); \
+    out->header = PI_HEADER; \
+    out->sequence = *sequence; \
+    PI_PROTO_FIELDS_##Name(PI_PROTO_DECODE_FIELD) \
+    out->crc32 = piCrc32Fast((const uint8_t *)&out->sequence, sizeof(PiProt_t) - sizeof(uint32_t) - sizeof(uint16_t)); \
+} \
+static inline PiProtError_t piProtoCorrect##Name(uint8_t *packet) { \
+    PiProtError_t result = piProtoCheck##Name(packet); \
+    uint8_t repaired[SIZE]; \
+    uint32_t crc; \
+    if (result == PI_PROT_OK) { \
+        return result; \
+    } \
+    memcpy(repaired, packet, (SIZE)); \
+    crc = PI_PROTO_LOAD(uint32_t, repaired, CRC_OFFSET); \
+    if (piCrc32Correct(repaired + (CRC_FIRST), (CRC_END) - (CRC_FIRST), &crc) <= 0) { \
+        return result; \
+    } \
+    memcpy(repaired + (CRC_OFFSET), &crc, sizeof(crc)); \
+    if (piProtoCheck##Name(repaired) != PI_PROT_OK) { \
+        return result; \
+    } \
+    memcpy(packet, repaired, (SIZE)); \
+    return PI_PROT_CORRECTED; \
+}
+
+PI_PROTO_FORMATS(PI_PROTO_FUNCTIONS)
+
+/**
+ * @brief Returns the packet length of a format.
+ *
+ * Folds to a constant when the format is a constant.
+ */
+static inline size_t piProtoSize(PiProtoFormat_t format) {
+    switch (format) {
+#define PI_PROTO_SIZE_CASE(Name, NAME, HEADER, SIZE, ...) case PI_PROTO_##NAME: return (SIZE);
+        PI_PROTO_FORMATS(PI_PROTO_SIZE_CASE)
+#undef PI_PROTO_SIZE_CASE
+        default:
+            return 0;
+    }
+}
+
+/**
+ * @brief Returns the header of a format.
+ */
+static inline uint16_t piProtoHeader(PiProtoFormat_t format) {
+    switch (format) {
+#define PI_PROTO_HEADER_CASE(Name, NAME, HEADER, ...) case PI_PROTO_##NAME: return (HEADER);
+        PI_PROTO_FORMATS(PI_PROTO_HEADER_CASE)
+#undef PI_PROTO_HEADER_CASE
+        default:
+            return 0;
+    }
+}
+
+/**
+ * @brief Tells whether packets of a format are laid out exactly like `PiProt_t`.
+ *
+ * Such packets need no translation and can be passed on in place.
+ */
+static inline int piProtoCanonical(PiProtoFormat_t format) {
+    switch (format) {
+#define PI_PROTO_CANONICAL_CASE(Name, NAME, HEADER, SIZE, CRC_FIRST, CRC_END, CRC_OFFSET, SEQ_OFFSET, SEQ_BITS, SEQ_CHECK) \
+        case PI_PROTO_##NAME: \
+            return (HEADER) == PI_HEADER && (SIZE) == sizeof(PiProt_t) && (CRC_FIRST) == offsetof(PiProt_t, sequence) && \
+                   (CRC_OFFSET) == offsetof(PiProt_t, crc32) && (SEQ_BITS) == 16 && !(SEQ_CHECK);
+        PI_PROTO_FORMATS(PI_PROTO_CANONICAL_CASE)
+#undef PI_PROTO_CANONICAL_CASE
+        default:
+            return 0;
+    }
+}
+
+/**
+ * @brief Validates a packet of a format.
+ *
+ * @param format Format of the packet.
+ * @param packet First byte of the packet, `piProtoSize(format)` bytes.
+ * @return Result of the validation.
+ */
+static inline PiProtError_t piProtoCheck(PiProtoFormat_t format, const uint8_t *packet) {
+    switch (format) {
+#define PI_PROTO_CHECK_CASE(Name, NAME, ...) case PI_PROTO_##NAME: return piProtoCheck##Name(packet);
+        PI_PROTO_FORMATS(PI_PROTO_CHECK_CASE)
+#undef PI_PROTO_CHECK_CASE
+        default:
+            return PI_PROT_BAD_HEADER;
+    }
+}
+
+/**
+ * @brief Translates a packet of a format into a `PiProt_t`.
+ *
+ * @param format Format of the packet.
+ * @param packet First byte of the packet.
+ * @param sequence In/out last 16-bit sequence number, extends shorter sequence numbers.
+ * @param out Receives the packet.
+ */
+static inline void piProtoDecode(PiProtoFormat_t format, const uint8_t *packet, uint16_t *sequence, PiProt_t *out) {
+    switch (format) {
+#define PI_PROTO_DECODE_CASE(Name, NAME, ...) case PI_PROTO_##NAME: piProtoDecode##Name(packet, sequence, out); break;
+        PI_PROTO_FORMATS(PI_PROTO_DECODE_CASE)
+#undef PI_PROTO_DECODE_CASE
+        default:
+            break;
+    }
+}
+
+/**
+ * @brief Validates a packet of a format and repairs a single-bit error.
+ *
+ * Only errors in the bytes covered by the CRC or in the CRC itself can be located: a flipped
+ * header bit of the current format, which the CRC does not cover, is not repaired.
+ *
+ * @param format Format of the packet.
+ * @param packet First byte of the packet, `piProtoSize(format)` bytes, repaired in place.
+ * @return `PI_PROT_CORRECTED` if one bit was flipped, otherwise the result of `piProtoCheck`.
+ */
+static inline PiProtError_t piProtoCorrect(PiProtoFormat_t format, uint8_t *packet) {
+    switch (format) {
+#define PI_PROTO_CORRECT_CASE(Name, NAME, ...) case PI_PROTO_##NAME: return piProtoCorrect##Name(packet);
+        PI_PROTO_FORMATS(PI_PROTO_CORRECT_CASE)
+#undef PI_PROTO_CORRECT_CASE
+        default:
+            return PI_PROT_BAD_HEADER;
+    }
+}
+
+/**
+ * @brief Finds the format of a complete packet from its length and header.
+ *
+ * @param packet First byte of the packet.
+ * @param size Length of the packet.
+ * @return Format whose length matches, and whose header too if several have that length;
+ *         `PI_PROTO_AUTO` if no format has that length.
+ */
+PiProtoFormat_t piProtoDetect(const uint8_t *packet, size_t size);
+
+/**
+ * @brief Parses a format name.
+ *
+ * @param name "main", "legacy" or "auto".
+ * @param format Receives the format.
+ * @return 0 on success, -1 for an unknown name.
+ */
+int piProtoFromName(const char *name, PiProtoFormat_t *format);
+
+#endif	/* #ifdef piproto_h_included */
@@ -0,0 +1,178 @@
+#define _DEFAULT_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#include "pireactor.h"
+#include "piserial.h"
+
+/**
+ * @brief Framer callback, pushes a validated packet into the ring of its device.
+ */
+static void piReactorPacket(void *context, const PiProt_t *packet) {
+    PiReactorDevice_t *device = context;
+    PiSample_t sample;
+
+    sample.hostTimeNs = device->readTimeNs;
+    sample.device = device->index;
+    sample.packet = *packet;
+    piStatsPacket(&device->stats, packet, device->readTimeNs);
+    piRingPush(device->ring, &sample);
+}
+
+/**
+ * @brief Creates the epoll instance of a reactor.
+ *
+ * @param reactor Reactor to initialize.
+ * @return 0 on success, -1 on error (errno is set).
+ */
+int piReactorInit(PiReactor_t *reactor) {
+    reactor->count = 0;
+    atomic_init(&reactor->stop, 0);
+    reactor->epfd = epoll_create1(EPOLL_CLOEXEC);
+    return reactor->epfd < 0 ? -1 : 0;
+}
+
+/**
+ * @brief Adds a device to the reactor.
+ *
+ * @param reactor Reactor state.
+ * @param fd Device file descriptor.
+ * @param ring Ring receiving the samples of the device.
+ * @param packetRate Nominal packet rate of the device in Hz, 0 if unknown.
+ * @return Index of the device, or -1 on error (errno is set).
+ */
+int piReactorAdd(PiReactor_t *reactor, int fd, PiRing_t *ring, uint16_t packetRate) {
+    PiReactorDevice_t *device;
+    struct epoll_event event;
+    int flags = fcntl(fd, F_GETFL);
+
+    if (reactor->count == PI_REACTOR_MAX_DEVICES) {
+        errno = ENOSPC;
+        return -1;
+    }
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) != 0) {
+        return -1;
+    }
+
+    device = &reactor->devices[reactor->count];
+    memset(device, 0, sizeof(*device));
+    device->reactor = reactor;
+    device->fd = fd;
+    device->index = reactor->count;
+    device->ring = ring;
+    piFramerInit(&device->framer, piReactorPacket, device);
+    piStatsInit(&device->stats, device->index, packetRate);
+
+    event.events = EPOLLIN;
+    event.data.ptr = device;
+    if (epoll_ctl(reactor->epfd, EPOLL_CTL_ADD, fd, &event) != 0) {
+        return -1;
+    }
+    return (int)reactor->count++;
+}
+
+/**
+ * @brief Reads a ready device until it has no more data.
+ *
+ * @return Number of packets decoded, -1 on error.
+ */
+static int piReactorDrain(PiReactor_t *reactor, PiReactorDevice_t *device, uint32_t events) {
+    int delivered = 0;
+
+    for (;;) {
+        ssize_t got = read(device->fd, reactor->buffer, sizeof(reactor->buffer));
+        if (got > 0) {
+            device->readTimeNs = piSerialNow();
+            device->reads++;
+            device->bytes += (uint64_t)got;
+            delivered += (int)piFramerFeed(&device->framer, reactor->buffer, (size_t)got);
+            piStatsFramer(&device->stats, &device->framer);
+            if ((size_t)got < sizeof(reactor->buffer)) {
+                break;
+            }
+            continue;
+        }
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            if (!(events & EPOLLHUP)) {
+                break;
+            }
+        } else if (got < 0 && errno != EIO) {
+            return -1;
+        }
+        // End of file, or hang-up of a pty master: stop watching the device
+        device->hungUp = 1;
+        epoll_ctl(reactor->epfd, EPOLL_CTL_DEL, device->fd, NULL);
+        break;
+    }
+    return delivered;
+}
+
+/**
+ * @brief Waits for ready devices once and decodes everything they have.
+ *
+ * @param reactor Reactor state.
+ * @param timeoutMs epoll timeout in milliseconds, -1 to wait forever.
+ * @return Number of packets decoded, -1 on error (errno is set).
+ */
+int piReactorRunOnce(PiReactor_t *reactor, int timeoutMs) {
+    struct epoll_event events[PI_REACTOR_MAX_DEVICES];
+    int delivered = 0;
+    int ready = epoll_wait(reactor->epfd, events, PI_REACTOR_MAX_DEVICES, timeoutMs);
+
+    if (ready < 0) {
+        return errno == EINTR ? 0 : -1;
+    }
+    for (int i = 0; i < ready; i++) {
+        int got = piReactorDrain(reactor, events[i].data.ptr, events[i].events);
+        if (got < 0) {
+            return -1;
+        }
+        delivered += got;
+    }
+    return delivered;
+}
+
+/**
+ * @brief Runs the reactor until `piReactorStop` is called.
+ *
+ * The stop flag is checked at least every 100 ms.
+ *
+ * @param reactor Reactor state.
+ * @return 0 when stopped, -1 on error (errno is set).
+ */
+int piReactorRun(PiReactor_t *reactor) {
+    while (!atomic_load_explicit(&reactor->stop, memory_order_relaxed)) {
+        if (piReactorRunOnce(reactor, 100) < 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Asks the reactor to return from `piReactorRun`, callable from any thread.
+ *
+ * @param reactor Reactor state.
+ */
+void piReactorStop(PiReactor_t *reactor) {
+    atomic_store(&reactor->stop, 1);
+}
+
+/**
+ * @brief Closes the epoll instance. Device descriptors are left open.
+ *
+ * @param reactor Reactor state.
+ */
+void piReactorClose(PiReactor_t *reactor) {
+    if (reactor->epfd >= 0) {
+        close(reactor->epfd);
+        reactor->epfd = -1;
+    }
+}
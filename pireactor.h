@@ -0,0 +1,110 @@
+/**
+ * @file pireactor.h
+ * @brief Single-threaded epoll reactor decoding several IMU devices.
+ *
+ * One reactor owns the file descriptors of several devices, reads every ready descriptor
+ * in large chunks, frames and validates the packets and pushes them, timestamped, into a
+ * per-device SPSC ring. Consumer threads drain the rings in batches, so a stalled consumer
+ * never blocks the reading of the serial ports; it only fills its own ring, where the
+ * overflow policy of the ring decides which samples are dropped. Several reactors, each run
+ * by its own thread, form a pool when one core is not enough.
+ */
+
+#ifndef pireactor_h_included
+#define pireactor_h_included
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "piframer.h"
+#include "piring.h"
+#include "pistats.h"
+
+#define PI_REACTOR_MAX_DEVICES  32
+#define PI_REACTOR_BUFFER_SIZE  (64 * 1024)
+
+struct PiReactor;
+
+/**
+ * @struct PiReactorDevice_t
+ * @brief A device served by a reactor.
+ */
+typedef struct {
+    struct PiReactor *reactor;  // Owning reactor
+    int fd;                     // Device file descriptor, non-blocking
+    uint32_t index;             // Index of the device in the reactor
+    PiRing_t *ring;             // Destination of the decoded samples
+    uint64_t readTimeNs;        // CLOCK_MONOTONIC time of the chunk being decoded
+    uint64_t reads;             // Successful read() calls
+    uint64_t bytes;             // Bytes read
+    int hungUp;                 // Set when the device was closed by the other side
+    PiFramer_t framer;          // Decoder of the device stream
+    PiStats_t stats;            // Link health, readable from any thread
+} PiReactorDevice_t;
+
+/**
+ * @struct PiReactor_t
+ * @brief Reactor state.
+ */
+typedef struct PiReactor {
+    int epfd;                                           // epoll instance
+    uint32_t count;                                     // Number of devices
+    atomic_int stop;                                    // Set by piReactorStop
+    PiReactorDevice_t devices[PI_REACTOR_MAX_DEVICES];  // Served devices
+    uint8_t buffer[PI_REACTOR_BUFFER_SIZE];             // Read buffer shared by all devices
+} PiReactor_t;
+
+/**
+ * @brief Creates the epoll instance of a reactor.
+ *
+ * @param reactor Reactor to initialize.
+ * @return 0 on success, -1 on error (errno is set).
+ */
+int piReactorInit(PiReactor_t *reactor);
+
+/**
+ * @brief Adds a device to the reactor.
+ *
+ * The descriptor must already be configured (see `piSerialConfigure`); it is switched to
+ * non-blocking mode. The reactor does not take ownership of the descriptor or the ring.
+ *
+ * @param reactor Reactor state.
+ * @param fd Device file descriptor.
+ * @param ring Ring receiving the samples of the device.
+ * @param packetRate Nominal packet rate of the device in Hz, 0 if unknown.
+ * @return Index of the device, or -1 on error (errno is set).
+ */
+int piReactorAdd(PiReactor_t *reactor, int fd, PiRing_t *ring, uint16_t packetRate);
+
+/**
+ * @brief Waits for ready devices once and decodes everything they have.
+ *
+ * @param reactor Reactor state.
+ * @param timeoutMs epoll timeout in milliseconds, -1 to wait forever.
+ * @return Number of packets decoded, -1 on error (errno is set).
+ */
+int piReactorRunOnce(PiReactor_t *reactor, int timeoutMs);
+
+/**
+ * @brief Runs the reactor until `piReactorStop` is called.
+ *
+ * @param reactor Reactor state.
+ * @return 0 when stopped, -1 on error (errno is set).
+ */
+int piReactorRun(PiReactor_t *reactor);
+
+/**
+ * @brief Asks the reactor to return from `piReactorRun`, callable from any thread.
+ *
+ * @param reactor Reactor state.
+ */
+void piReactorStop(PiReactor_t *reactor);
+
+/**
+ * @brief Closes the epoll instance. Device descriptors are left open.
+ *
+ * @param reactor Reactor state.
+ */
+void piReactorClose(PiReactor_t *reactor);
+
+#endif	/* #ifdef pireactor_h_included */
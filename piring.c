@@ -0,0 +1,107 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "piring.h"
+
+/**
+ * @brief Allocates a ring.
+ *
+ * @param ring Ring to initialize.
+ * @param capacity Number of samples, rounded up to a power of two.
+ * @param policy Overflow policy.
+ * @return 0 on success, -1 if the memory could not be allocated.
+ */
+int piRingInit(PiRing_t *ring, size_t capacity, PiRingPolicy_t policy) {
+    size_t size = 2;
+    while (size < capacity) {
+        size <<= 1;
+    }
+    ring->slots = aligned_alloc(64, size * sizeof(PiSample_t));
+    if (ring->slots == NULL) {
+        return -1;
+    }
+    ring->mask = size - 1;
+    ring->policy = policy;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->droppedNewest, 0);
+    atomic_init(&ring->droppedOldest, 0);
+    return 0;
+}
+
+/**
+ * @brief Releases the memory of a ring.
+ *
+ * @param ring Ring to release.
+ */
+void piRingFree(PiRing_t *ring) {
+    free(ring->slots);
+    ring->slots = NULL;
+}
+
+/**
+ * @brief Appends a sample, called by the producer only.
+ *
+ * With PI_RING_DROP_OLDEST the producer moves the head forward itself. The consumer detects
+ * this when committing its batch and copies again, so it never returns an overwritten sample.
+ *
+ * @param ring Ring state.
+ * @param sample Sample to append.
+ * @return 1 if the sample was stored, 0 if it was dropped (PI_RING_DROP_NEWEST).
+ */
+int piRingPush(PiRing_t *ring, const PiSample_t *sample) {
+    unsigned long long tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    unsigned long long head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+    while (tail - head > ring->mask) {
+        if (ring->policy == PI_RING_DROP_NEWEST) {
+            atomic_store_explicit(&ring->droppedNewest,
+                atomic_load_explicit(&ring->droppedNewest, memory_order_relaxed) + 1, memory_order_relaxed);
+            return 0;
+        }
+        if (atomic_compare_exchange_weak_explicit(&ring->head, &head, head + 1,
+                                                  memory_order_acq_rel, memory_order_acquire)) {
+            atomic_store_explicit(&ring->droppedOldest,
+                atomic_load_explicit(&ring->droppedOldest, memory_order_relaxed) + 1, memory_order_relaxed);
+            break;
+        }
+    }
+
+    ring->slots[tail & ring->mask] = *sample;
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+    return 1;
+}
+
+/**
+ * @brief Removes up to `max` samples, called by the consumer only.
+ *
+ * @param ring Ring state.
+ * @param samples Destination array.
+ * @param max Capacity of the destination array.
+ * @return Number of samples copied.
+ */
+size_t piRingPop(PiRing_t *ring, PiSample_t *samples, size_t max) {
+    unsigned long long head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+    for (;;) {
+        unsigned long long tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+        size_t count = (size_t)(tail - head);
+        if (count > max) {
+            count = max;
+        }
+        if (count == 0) {
+            return 0;
+        }
+
+        size_t first = (size_t)(head & ring->mask);
+        size_t part = count < ring->mask + 1 - first ? count : ring->mask + 1 - first;
+        memcpy(samples, ring->slots + first, part * sizeof(PiSample_t));
+        memcpy(samples + part, ring->slots, (count - part) * sizeof(PiSample_t));
+
+        // Fails only if the producer dropped the oldest samples meanwhile, the copy may be torn
+        if (atomic_compare_exchange_strong_explicit(&ring->head, &head, head + count,
+                                                    memory_order_acq_rel, memory_order_acquire)) {
+            return count;
+        }
+    }
+}
@@ -0,0 +1,89 @@
+/**
+ * @file piring.h
+ * @brief Lock-free single-producer/single-consumer ring of decoded samples.
+ *
+ * The ring decouples the thread decoding a device from the thread consuming its samples.
+ * The producer never blocks: when the ring is full it either drops the new sample or
+ * overwrites the oldest one, depending on the overflow policy, and counts every drop.
+ * The consumer drains samples in batches.
+ */
+
+#ifndef piring_h_included
+#define piring_h_included
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "pi.h"
+
+/**
+ * @struct PiSample_t
+ * @brief A validated packet with the time it was read and the device it came from.
+ */
+typedef struct {
+    uint64_t hostTimeNs;     // CLOCK_MONOTONIC time of the read that completed the packet
+    uint32_t device;         // Index of the device
+    PiProt_t packet;         // Validated packet
+} PiSample_t;
+
+/**
+ * @enum PiRingPolicy_t
+ * @brief What to do with a new sample when the ring is full.
+ */
+typedef enum {
+    PI_RING_DROP_NEWEST = 0, // Discard the new sample
+    PI_RING_DROP_OLDEST = 1  // Overwrite the oldest unread sample
+} PiRingPolicy_t;
+
+/**
+ * @struct PiRing_t
+ * @brief SPSC ring state. Head and tail live on separate cache lines.
+ */
+typedef struct {
+    _Alignas(64) atomic_ullong head;        // Next sample to read
+    _Alignas(64) atomic_ullong tail;        // Next sample to write
+    atomic_ullong droppedNewest;            // Samples discarded by PI_RING_DROP_NEWEST
+    atomic_ullong droppedOldest;            // Samples overwritten by PI_RING_DROP_OLDEST
+    _Alignas(64) size_t mask;               // Capacity - 1
+    PiRingPolicy_t policy;                  // Overflow policy
+    PiSample_t *slots;                      // Sample storage
+} PiRing_t;
+
+/**
+ * @brief Allocates a ring.
+ *
+ * @param ring Ring to initialize.
+ * @param capacity Number of samples, rounded up to a power of two.
+ * @param policy Overflow policy.
+ * @return 0 on success, -1 if the memory could not be allocated.
+ */
+int piRingInit(PiRing_t *ring, size_t capacity, PiRingPolicy_t policy);
+
+/**
+ * @brief Releases the memory of a ring.
+ *
+ * @param ring Ring to release.
+ */
+void piRingFree(PiRing_t *ring);
+
+/**
+ * @brief Appends a sample, called by the producer only.
+ *
+ * @param ring Ring state.
+ * @param sample Sample to append.
+ * @return 1 if the sample was stored, 0 if it was dropped (PI_RING_DROP_NEWEST).
+ */
+int piRingPush(PiRing_t *ring, const PiSample_t *sample);
+
+/**
+ * @brief Removes up to `max` samples, called by the consumer only.
+ *
+ * @param ring Ring state.
+ * @param samples Destination array.
+ * @param max Capacity of the destination array.
+ * @return Number of samples copied.
+ */
+size_t piRingPop(PiRing_t *ring, PiSample_t *samples, size_t max);
+
+#endif	/* #ifdef piring_h_included */
@@ -0,0 +1,305 @@
+#define _DEFAULT_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pty.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/serial.h>
+#endif
+
+#include "piserial.h"
+
+/**
+ * @brief Returns CLOCK_MONOTONIC time in nanoseconds.
+ *
+ * @return Current time.
+ */
+uint64_t piSerialNow(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief Returns the baud rate matching a packet rate.
+ *
+ * @param packetRate Packet rate in Hz: 250, 500 or 1000.
+ * @return Baud rate in bps, or 0 for an unsupported packet rate.
+ */
+uint32_t piSerialBaudRate(uint16_t packetRate) {
+    switch (packetRate) {
+        case 250:
+            return 230400;
+        case 500:
+            return 460800;
+        case 1000:
+            return 921600;
+    }
+    return 0;
+}
+
+/**
+ * @brief Returns the termios speed constant of a packet rate.
+ */
+static speed_t piSerialSpeed(uint16_t packetRate) {
+    switch (packetRate) {
+        case 250:
+            return B230400;
+        case 500:
+            return B460800;
+        case 1000:
+            return B921600;
+    }
+    return B0;
+}
+
+/**
+ * @brief Configures a tty for the IMU link.
+ *
+ * @param fd File descriptor of the tty.
+ * @param packetRate Packet rate in Hz.
+ * @param flags Combination of `PI_SERIAL_*` flags.
+ * @return 0 on success, -1 on error (errno is set).
+ */
+int piSerialConfigure(int fd, uint16_t packetRate, int flags) {
+    struct termios tio;
+    speed_t speed = piSerialSpeed(packetRate);
+
+    if (speed == B0) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (tcgetattr(fd, &tio) != 0) {
+        return -1;
+    }
+    cfmakeraw(&tio);
+    tio.c_cflag &= ~(CSTOPB | CRTSCTS);
+    tio.c_cflag |= CLOCAL | CREAD;
+    tio.c_iflag &= ~(IXON | IXOFF | IXANY);
+    // The port is non-blocking, VMIN only sets when poll() reports it readable, and only
+    // while VTIME is 0: with an inter-byte timer n_tty wakes up on the first byte
+    tio.c_cc[VMIN] = (flags & PI_SERIAL_LOW_LATENCY) ? 1 : sizeof(PiProt_t);
+    tio.c_cc[VTIME] = 0;
+    if (cfsetispeed(&tio, speed) != 0 || cfsetospeed(&tio, speed) != 0) {
+        return -1;
+    }
+    if (tcsetattr(fd, TCSANOW, &tio) != 0) {
+        return -1;
+    }
+
+#if defined(__linux__) && defined(ASYNC_LOW_LATENCY)
+    if (flags & PI_SERIAL_LOW_LATENCY) {
+        // Not every driver (e.g. a pty) supports it, the port works either way
+        struct serial_struct serial;
+        if (ioctl(fd, TIOCGSERIAL, &serial) == 0) {
+            serial.flags |= ASYNC_LOW_LATENCY;
+            ioctl(fd, TIOCSSERIAL, &serial);
+        }
+    }
+#endif
+    tcflush(fd, TCIFLUSH);
+    return 0;
+}
+
+/**
+ * @brief Opens and configures a serial port.
+ *
+ * @param port Port state to initialize.
+ * @param path Path of the tty.
+ * @param packetRate Packet rate in Hz.
+ * @param flags Combination of `PI_SERIAL_*` flags.
+ * @param callback Function called for every valid packet.
+ * @param context User context passed to the callback.
+ * @return 0 on success, -1 on error (errno is set).
+ */
+int piSerialOpen(PiSerial_t *port, const char *path, uint16_t packetRate, int flags, PiFramerCallback_t callback, void *context) {
+    port->fd = open(path, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if (port->fd < 0) {
+        return -1;
+    }
+    if (piSerialConfigure(port->fd, packetRate, flags) != 0) {
+        int saved = errno;
+        close(port->fd);
+        port->fd = -1;
+        errno = saved;
+        return -1;
+    }
+    port->packetRate = packetRate;
+    port->readTimeNs = 0;
+    port->reads = 0;
+    port->bytes = 0;
+    piFramerInit(&port->framer, callback, context);
+    return 0;
+}
+
+/**
+ * @brief Reads everything available on the port and decodes it.
+ *
+ * @param port Port state.
+ * @param timeoutMs Poll timeout in milliseconds, -1 to wait forever.
+ * @return Number of packets delivered, 0 on timeout, -1 on error (errno is set).
+ */
+int piSerialPoll(PiSerial_t *port, int timeoutMs) {
+    struct pollfd pfd = { .fd = port->fd, .events = POLLIN };
+    int delivered = 0;
+    int ready = poll(&pfd, 1, timeoutMs);
+
+    if (ready <= 0) {
+        return ready < 0 && errno == EINTR ? 0 : ready;
+    }
+    if (pfd.revents & (POLLERR | POLLNVAL)) {
+        errno = EIO;
+        return -1;
+    }
+
+    for (;;) {
+        ssize_t got = read(port->fd, port->buffer, sizeof(port->buffer));
+        if (got < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            return -1;
+        }
+        if (got == 0) {
+            if (pfd.revents & POLLHUP) {
+                errno = EIO;
+                return -1;
+            }
+            break;
+        }
+        port->readTimeNs = piSerialNow();
+        port->reads++;
+        port->bytes += (uint64_t)got;
+        delivered += (int)piFramerFeed(&port->framer, port->buffer, (size_t)got);
+        if ((size_t)got < sizeof(port->buffer)) {
+            break;
+        }
+    }
+    return delivered;
+}
+
+/**
+ * @brief Closes the port.
+ *
+ * @param port Port state.
+ */
+void piSerialClose(PiSerial_t *port) {
+    if (port->fd >= 0) {
+        close(port->fd);
+        port->fd = -1;
+    }
+}
+
+/**
+ * @brief Writes a whole buffer to the non-blocking pty master, waiting while it is full.
+ *
+ * @return 0 on success, -1 if the replay was stopped or the write failed.
+ */
+static int piPtyWrite(PiPtyReplay_t *replay, const uint8_t *data, size_t len) {
+    while (len != 0) {
+        ssize_t put = write(replay->master, data, len);
+        if (put > 0) {
+            data += put;
+            len -= (size_t)put;
+            continue;
+        }
+        if (put < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            return -1;
+        }
+        struct pollfd pfd = { .fd = replay->master, .events = POLLOUT };
+        poll(&pfd, 1, 100);
+        if (atomic_load(&replay->stop)) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Replay thread, writes one packet every 1/packetRate seconds.
+ */
+static void *piPtyReplayThread(void *arg) {
+    PiPtyReplay_t *replay = arg;
+    uint64_t period = 1000000000ull / replay->packetRate;
+    uint64_t due = piSerialNow();
+    PiProt_t packet;
+
+    while (!atomic_load(&replay->stop)) {
+        size_t len = replay->source(replay->context, &packet);
+        if (len == 0 || piPtyWrite(replay, packet.ui8, len) != 0) {
+            break;
+        }
+        atomic_fetch_add(&replay->sent, 1);
+
+        due += period;
+        struct timespec ts = { .tv_sec = (time_t)(due / 1000000000ull), .tv_nsec = (long)(due % 1000000000ull) };
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Opens a pty pair and starts writing packets to it at the given rate.
+ *
+ * @param replay Replay state to initialize.
+ * @param packetRate Packet rate in Hz.
+ * @param source Function producing the packets.
+ * @param context User context passed to the source.
+ * @return 0 on success, -1 on error (errno is set).
+ */
+int piPtyReplayStart(PiPtyReplay_t *replay, uint16_t packetRate, PiPtySource_t source, void *context) {
+    struct termios tio;
+    int err;
+
+    if (piSerialBaudRate(packetRate) == 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    memset(&tio, 0, sizeof(tio));
+    cfmakeraw(&tio);
+    cfsetspeed(&tio, piSerialSpeed(packetRate));
+    if (openpty(&replay->master, &replay->slave, NULL, &tio, NULL) != 0) {
+        return -1;
+    }
+    if (ttyname_r(replay->slave, replay->slaveName, sizeof(replay->slaveName)) != 0) {
+        replay->slaveName[0] = '\0';
+    }
+    fcntl(replay->master, F_SETFL, fcntl(replay->master, F_GETFL) | O_NONBLOCK);
+
+    replay->packetRate = packetRate;
+    replay->source = source;
+    replay->context = context;
+    atomic_init(&replay->stop, 0);
+    atomic_init(&replay->sent, 0);
+    err = pthread_create(&replay->thread, NULL, piPtyReplayThread, replay);
+    if (err != 0) {
+        close(replay->master);
+        close(replay->slave);
+        errno = err;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Stops the replay thread and closes the pty pair.
+ *
+ * @param replay Replay state.
+ */
+void piPtyReplayStop(PiPtyReplay_t *replay) {
+    atomic_store(&replay->stop, 1);
+    pthread_join(replay->thread, NULL);
+    close(replay->master);
+    close(replay->slave);
+}
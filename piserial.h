@@ -0,0 +1,149 @@
+/**
+ * @file piserial.h
+ * @brief Serial-port ingest of IMU protocol packets.
+ *
+ * Opens a tty, configures raw mode with the baud rate matching the packet rate (250 Hz at
+ * 230400, 500 Hz at 460800 and 1000 Hz at 921600 bps), reads it with poll() in large
+ * non-blocking chunks and feeds the chunks to the framer without copying. The host time of
+ * every read is recorded before the chunk is decoded.
+ *
+ * A pseudo-terminal replay stands in for a device: it opens a pty pair and writes packets
+ * to it at the real packet rate, so the ingest path can be exercised without hardware.
+ */
+
+#ifndef piserial_h_included
+#define piserial_h_included
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "pi.h"
+#include "piframer.h"
+
+#define PI_SERIAL_LOW_LATENCY   0x01    // Wake up on every byte and request ASYNC_LOW_LATENCY
+
+#define PI_SERIAL_BUFFER_SIZE   (64 * 1024)
+
+/**
+ * @struct PiSerial_t
+ * @brief State of an opened serial port.
+ */
+typedef struct {
+    int fd;                             // Port file descriptor
+    uint16_t packetRate;                // Configured packet rate
+    uint64_t readTimeNs;                // CLOCK_MONOTONIC time of the chunk being decoded
+    uint64_t reads;                     // Successful read() calls
+    uint64_t bytes;                     // Bytes read
+    PiFramer_t framer;                  // Decoder fed with every chunk
+    uint8_t buffer[PI_SERIAL_BUFFER_SIZE];
+} PiSerial_t;
+
+/**
+ * @brief Returns the baud rate matching a packet rate.
+ *
+ * @param packetRate Packet rate in Hz: 250, 500 or 1000.
+ * @return Baud rate in bps, or 0 for an unsupported packet rate.
+ */
+uint32_t piSerialBaudRate(uint16_t packetRate);
+
+/**
+ * @brief Configures a tty for the IMU link.
+ *
+ * Sets raw 8N1 mode without flow control and the baud rate matching the packet rate. With
+ * `PI_SERIAL_LOW_LATENCY` poll() reports the port readable on every byte (VMIN=1) and the
+ * driver is asked for ASYNC_LOW_LATENCY where available; otherwise it only does once a whole
+ * packet is buffered (VMIN=56, VTIME=0), so a reader wakes up once per packet rather than
+ * once per byte. Reads stay non-blocking in both modes.
+ *
+ * @param fd File descriptor of the tty.
+ * @param packetRate Packet rate in Hz.
+ * @param flags Combination of `PI_SERIAL_*` flags.
+ * @return 0 on success, -1 on error (errno is set).
+ */
+int piSerialConfigure(int fd, uint16_t packetRate, int flags);
+
+/**
+ * @brief Opens and configures a serial port.
+ *
+ * @param port Port state to initialize.
+ * @param path Path of the tty.
+ * @param packetRate Packet rate in Hz.
+ * @param flags Combination of `PI_SERIAL_*` flags.
+ * @param callback Function called for every valid packet.
+ * @param context User context passed to the callback.
+ * @return 0 on success, -1 on error (errno is set).
+ */
+int piSerialOpen(PiSerial_t *port, const char *path, uint16_t packetRate, int flags, PiFramerCallback_t callback, void *context);
+
+/**
+ * @brief Reads everything available on the port and decodes it.
+ *
+ * Waits up to `timeoutMs` for data, then reads in non-blocking chunks until the port is
+ * drained. `port->readTimeNs` holds the time of the current chunk while the callback runs.
+ *
+ * @param port Port state.
+ * @param timeoutMs Poll timeout in milliseconds, -1 to wait forever.
+ * @return Number of packets delivered, 0 on timeout, -1 on error (errno is set).
+ */
+int piSerialPoll(PiSerial_t *port, int timeoutMs);
+
+/**
+ * @brief Closes the port.
+ *
+ * @param port Port state.
+ */
+void piSerialClose(PiSerial_t *port);
+
+/**
+ * @brief Source of the packets written by a pty replay.
+ *
+ * @param context User context given to `piPtyReplayStart`.
+ * @param packet Receives the next packet.
+ * @return Number of bytes of `packet` to write, 0 to stop the replay.
+ */
+typedef size_t (*PiPtySource_t)(void *context, PiProt_t *packet);
+
+/**
+ * @struct PiPtyReplay_t
+ * @brief Pseudo-terminal device stand-in.
+ */
+typedef struct {
+    int master;                         // Side written by the replay
+    int slave;                          // Kept open so the pty survives reader restarts
+    char slaveName[64];                 // Path to open as the device
+    uint16_t packetRate;                // Replay rate in Hz
+    PiPtySource_t source;               // Packet source
+    void *context;                      // Source context
+    atomic_int stop;                    // Set to stop the replay thread
+    atomic_ullong sent;                 // Packets written
+    pthread_t thread;                   // Replay thread
+} PiPtyReplay_t;
+
+/**
+ * @brief Opens a pty pair and starts writing packets to it at the given rate.
+ *
+ * @param replay Replay state to initialize.
+ * @param packetRate Packet rate in Hz.
+ * @param source Function producing the packets.
+ * @param context User context passed to the source.
+ * @return 0 on success, -1 on error (errno is set).
+ */
+int piPtyReplayStart(PiPtyReplay_t *replay, uint16_t packetRate, PiPtySource_t source, void *context);
+
+/**
+ * @brief Stops the replay thread and closes the pty pair.
+ *
+ * @param replay Replay state.
+ */
+void piPtyReplayStop(PiPtyReplay_t *replay);
+
+/**
+ * @brief Returns CLOCK_MONOTONIC time in nanoseconds.
+ *
+ * @return Current time.
+ */
+uint64_t piSerialNow(void);
+
+#endif	/* #ifdef piserial_h_included */
@@ -0,0 +1,313 @@
+#define _DEFAULT_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "picrc.h"
+#include "pishm.h"
+#include "pitime.h"
+
+_Static_assert(sizeof(PiShmHeader_t) % 64 == 0, "slots must start on a cache line");
+_Static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "shared stamps must be lock-free");
+
+/**
+ * @brief Returns the size of a ring of `capacity` slots.
+ */
+static size_t piShmSize(uint64_t capacity) {
+    return sizeof(PiShmHeader_t) + (size_t)capacity * sizeof(PiShmSlot_t);
+}
+
+/**
+ * @brief Creates the shared memory ring.
+ *
+ * @param writer Publisher state to initialize.
+ * @param name Name of the object, e.g. "/pistart".
+ * @param capacity History window in samples, rounded up to a power of two.
+ * @param packetRate Packet rate in Hz.
+ * @return 0 on success, -1 on error (errno is set).
+ */
+int piShmCreate(PiShmWriter_t *writer, const char *name, size_t capacity, uint16_t packetRate) {
+    uint64_t slots = 1;
+    struct timespec ts;
+    int saved;
+
+    memset(writer, 0, sizeof(*writer));
+    if (strlen(name) >= sizeof(writer->name) || capacity == 0 || capacity > 0x80000000u) {
+        errno = EINVAL;
+        return -1;
+    }
+    while (slots < capacity) {
+        slots <<= 1;
+    }
+    strcpy(writer->name, name);
+    writer->mask = slots - 1;
+    writer->mapSize = piShmSize(slots);
+
+    // Readers attached to a previous ring keep their mapping of the old object
+    shm_unlink(name);
+    writer->fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (writer->fd < 0) {
+        return -1;
+    }
+    if (ftruncate(writer->fd, (off_t)writer->mapSize) != 0) {
+        goto failed;
+    }
+    void *map = mmap(NULL, writer->mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, writer->fd, 0);
+    if (map == MAP_FAILED) {
+        goto failed;
+    }
+    writer->header = map;
+    writer->slots = (PiShmSlot_t *)(writer->header + 1);
+
+    // The object is zero-filled: every stamp is 0, which matches no ring position
+    clock_gettime(CLOCK_REALTIME, &ts);
+    writer->header->slotSize = sizeof(PiShmSlot_t);
+    writer->header->capacity = (uint32_t)slots;
+    writer->header->packetRate = packetRate;
+    writer->header->startTimeNs = (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+    writer->header->version = PI_SHM_VERSION;
+    atomic_thread_fence(memory_order_release);
+    writer->header->magic = PI_SHM_MAGIC;
+    piMuxInit(&writer->mux, NULL, NULL);
+    return 0;
+
+failed:
+    saved = errno;
+    close(writer->fd);
+    shm_unlink(name);
+    errno = saved;
+    return -1;
+}
+
+/**
+ * @brief Publishes the reassembled mux snapshot under its seqlock.
+ */
+static void piShmPublishMux(PiShmWriter_t *writer, const PiMux_t *snapshot) {
+    PiShmHeader_t *header = writer->header;
+    unsigned stamp = atomic_load_explicit(&header->muxStamp, memory_order_relaxed);
+
+    atomic_store_explicit(&header->muxStamp, stamp + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    memcpy(&header->mux, snapshot, sizeof(PiMux_t));
+    atomic_store_explicit(&header->muxStamp, stamp + 2, memory_order_release);
+}
+
+/**
+ * @brief Publishes one validated packet.
+ *
+ * @param writer Publisher state.
+ * @param packet Validated packet.
+ * @param result `PI_PROT_OK`, or `PI_PROT_CORRECTED` if the packet was repaired.
+ * @param hostTimeNs Host time the packet was read (CLOCK_MONOTONIC).
+ */
+void piShmPublish(PiShmWriter_t *writer, const PiProt_t *packet, PiProtError_t result, uint64_t hostTimeNs) {
+    uint64_t position = writer->position;
+    PiShmSlot_t *slot = &writer->slots[position & writer->mask];
+    uint64_t sample;
+
+    // Same numbering as the timebase: repeated and late packets keep the number they had
+    if (position == 0) {
+        writer->sample = sample = packet->sequence;
+        writer->lastSequence = packet->sequence;
+    } else {
+        piTimeUnwrap(&writer->sample, &writer->lastSequence, packet->sequence, &sample);
+    }
+
+    atomic_store_explicit(&slot->stamp, 2 * position + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    slot->sample.sample = sample;
+    slot->sample.hostTimeNs = hostTimeNs;
+    slot->sample.sequence = packet->sequence;
+    slot->sample.status = (uint16_t)result;
+    slot->sample.mux = packet->mux;
+    slot->sample.data = packet->data;
+    atomic_store_explicit(&slot->stamp, 2 * position + 2, memory_order_release);
+
+    writer->position = position + 1;
+    atomic_store_explicit(&writer->header->published, position + 1, memory_order_release);
+
+    if (piMuxPush(&writer->mux, packet->sequence, packet->mux)) {
+        piShmPublishMux(writer, piMuxSnapshot(&writer->mux));
+    }
+}
+
+/**
+ * @brief Marks the ring closed, unmaps it and removes the object.
+ *
+ * @param writer Publisher state.
+ */
+void piShmDestroy(PiShmWriter_t *writer) {
+    if (writer->header == NULL) {
+        return;
+    }
+    atomic_store_explicit(&writer->header->closed, 1, memory_order_release);
+    munmap(writer->header, writer->mapSize);
+    close(writer->fd);
+    shm_unlink(writer->name);
+    writer->header = NULL;
+    writer->slots = NULL;
+}
+
+/**
+ * @brief Attaches to a shared memory ring.
+ *
+ * @param reader Reader state to initialize.
+ * @param name Name of the object.
+ * @param backfill Samples of history to read first, clamped to what the ring holds.
+ * @return 0 on success, -1 on error (errno is set, EINVAL for an object that is not a ring).
+ */
+int piShmOpen(PiShmReader_t *reader, const char *name, uint64_t backfill) {
+    struct stat st;
+    PiShmHeader_t header;
+    int fd = shm_open(name, O_RDONLY, 0);
+    int saved;
+
+    memset(reader, 0, sizeof(*reader));
+    if (fd < 0) {
+        return -1;
+    }
+    if (fstat(fd, &st) != 0) {
+        goto failed;
+    }
+    if ((size_t)st.st_size < sizeof(PiShmHeader_t) || pread(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header) ||
+        header.magic != PI_SHM_MAGIC || header.version != PI_SHM_VERSION || header.slotSize != sizeof(PiShmSlot_t) ||
+        header.capacity == 0 || (header.capacity & (header.capacity - 1)) != 0 ||
+        (size_t)st.st_size < piShmSize(header.capacity)) {
+        errno = EINVAL;
+        goto failed;
+    }
+    reader->mapSize = piShmSize(header.capacity);
+    void *map = mmap(NULL, reader->mapSize, PROT_READ, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        goto failed;
+    }
+    close(fd);
+
+    reader->header = map;
+    reader->slots = (const PiShmSlot_t *)(reader->header + 1);
+    reader->mask = header.capacity - 1;
+
+    uint64_t published = atomic_load_explicit(&reader->header->published, memory_order_acquire);
+    if (backfill > published) {
+        backfill = published;
+    }
+    if (backfill > reader->mask) {
+        // The oldest slot may be overwritten at any moment
+        backfill = reader->mask;
+    }
+    reader->next = published - backfill;
+    return 0;
+
+failed:
+    saved = errno;
+    close(fd);
+    errno = saved;
+    return -1;
+}
+
+/**
+ * @brief Copies the next available samples.
+ *
+ * @param reader Reader state.
+ * @param samples Destination array.
+ * @param max Capacity of the destination array.
+ * @return Number of samples copied, 0 if no new sample was published.
+ */
+size_t piShmRead(PiShmReader_t *reader, PiShmSample_t *samples, size_t max) {
+    uint64_t published = atomic_load_explicit(&reader->header->published, memory_order_acquire);
+    size_t count = 0;
+
+    while (count < max && reader->next < published) {
+        uint64_t next = reader->next;
+        const PiShmSlot_t *slot = &reader->slots[next & reader->mask];
+        uint64_t expected = 2 * next + 2;
+        uint64_t stamp = atomic_load_explicit(&slot->stamp, memory_order_acquire);
+
+        if (stamp == expected) {
+            memcpy(&samples[count], &slot->sample, sizeof(PiShmSample_t));
+            atomic_thread_fence(memory_order_acquire);
+            if (atomic_load_explicit(&slot->stamp, memory_order_relaxed) == expected) {
+                reader->next = next + 1;
+                count++;
+                continue;
+            }
+        }
+
+        // The publisher lapped the reader: resume with the oldest sample still in the ring
+        published = atomic_load_explicit(&reader->header->published, memory_order_acquire);
+        uint64_t oldest = published - reader->mask;
+        if (oldest <= next) {
+            oldest = next + 1;
+        }
+        reader->overruns += oldest - next;
+        reader->next = oldest;
+    }
+    reader->samples += count;
+    return count;
+}
+
+/**
+ * @brief Copies the last mux snapshot.
+ *
+ * @param reader Reader state.
+ * @param mux Receives the snapshot.
+ * @return 1 if a snapshot was copied, 0 before the first complete mux cycle or if no
+ *         consistent snapshot could be read within `PI_SHM_MUX_ATTEMPTS` attempts.
+ */
+int piShmMux(const PiShmReader_t *reader, PiMux_t *mux) {
+    const PiShmHeader_t *header = reader->header;
+
+    // A publisher that died while writing the snapshot leaves the stamp odd for good
+    for (unsigned attempt = 0; attempt < PI_SHM_MUX_ATTEMPTS; attempt++) {
+        unsigned stamp = atomic_load_explicit(&header->muxStamp, memory_order_acquire);
+        if (stamp == 0) {
+            return 0;
+        }
+        if (stamp & 1) {
+            if (piShmClosed(reader)) {
+                return 0;
+            }
+            sched_yield();
+            continue;
+        }
+        memcpy(mux, &header->mux, sizeof(PiMux_t));
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&header->muxStamp, memory_order_relaxed) == stamp) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Rebuilds the link packet of a sample, CRC included.
+ *
+ * @param sample Published sample.
+ * @param packet Receives the packet.
+ */
+void piShmPacket(const PiShmSample_t *sample, PiProt_t *packet) {
+    packet->header = PI_HEADER;
+    packet->sequence = sample->sequence;
+    packet->data = sample->data;
+    packet->mux = sample->mux;
+    packet->crc32 = piCrc32Fast((const uint8_t *)&packet->sequence, sizeof(PiProt_t) - sizeof(uint32_t) - sizeof(uint16_t));
+}
+
+/**
+ * @brief Detaches from the ring.
+ *
+ * @param reader Reader state.
+ */
+void piShmClose(PiShmReader_t *reader) {
+    if (reader->header != NULL) {
+        munmap((void *)reader->header, reader->mapSize);
+        reader->header = NULL;
+        reader->slots = NULL;
+    }
+}
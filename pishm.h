@@ -0,0 +1,199 @@
+/**
+ * @file pishm.h
+ * @brief Shared-memory fan-out of decoded samples to local processes.
+ *
+ * One publisher, normally the process reading the device, writes every decoded sample into
+ * a ring in a POSIX shared memory object (/dev/shm). Any number of readers map the object
+ * read-only and follow the ring at their own pace; they never write to it, so the publisher
+ * does not know about them and is never slowed down by them.
+ *
+ * Every slot is protected by its own seqlock stamp: odd while the publisher writes the slot,
+ * `2 * (position + 1)` once the sample of that ring position is complete. A reader copies a
+ * slot and checks that the stamp did not change, which detects both torn reads and samples
+ * overwritten before they were read (overruns). The ring keeps the last `capacity` samples,
+ * so a late reader can start with that much history. The reassembled `PiMux_t` snapshot is
+ * published next to the ring under a seqlock of its own, since it changes once per cycle.
+ */
+
+#ifndef pishm_h_included
+#define pishm_h_included
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "pi.h"
+#include "pimux.h"
+
+#define PI_SHM_MAGIC    0x4D485350u     // "PSHM" in memory byte order
+#define PI_SHM_VERSION  1
+#define PI_SHM_MUX_ATTEMPTS 1000        // Reads of the mux snapshot before `piShmMux` gives up
+
+/**
+ * @struct PiShmSample_t
+ * @brief A decoded sample as published.
+ */
+typedef struct {
+    uint64_t sample;            // Absolute sample number (sequence unwrapped past 16 bits)
+    uint64_t hostTimeNs;        // CLOCK_MONOTONIC time the packet was read
+    uint16_t sequence;          // Sequence number of the packet
+    uint16_t status;            // PI_PROT_OK, or PI_PROT_CORRECTED for a repaired packet
+    uint32_t mux;               // Raw mux word of the packet
+    PiMainData_t data;          // Sensor data
+} PiShmSample_t;
+
+/**
+ * @struct PiShmSlot_t
+ * @brief Ring slot, a sample and its seqlock stamp.
+ */
+typedef struct {
+    atomic_ullong stamp;        // Odd while written, 2 * (position + 1) when complete
+    PiShmSample_t sample;
+} PiShmSlot_t;
+
+/**
+ * @struct PiShmHeader_t
+ * @brief Header at the start of the shared memory object, followed by the slots.
+ */
+typedef struct {
+    uint32_t magic;                     // PI_SHM_MAGIC
+    uint16_t version;                   // PI_SHM_VERSION
+    uint16_t slotSize;                  // sizeof(PiShmSlot_t)
+    uint32_t capacity;                  // Slots, a power of two
+    uint16_t packetRate;                // Packet rate in Hz
+    uint16_t reserved;
+    uint64_t startTimeNs;               // CLOCK_REALTIME time the ring was created
+    atomic_int closed;                  // Set when the publisher stopped
+    _Alignas(64) atomic_ullong published;   // Samples published, the next ring position
+    _Alignas(64) atomic_uint muxStamp;  // Seqlock of `mux`: odd while written, 0 before the first cycle
+    PiMux_t mux;                        // Last reassembled mux snapshot
+} PiShmHeader_t;
+
+/**
+ * @struct PiShmWriter_t
+ * @brief Publisher state.
+ */
+typedef struct {
+    int fd;                         // Shared memory object
+    char name[64];                  // Name of the object, unlinked by `piShmDestroy`
+    PiShmHeader_t *header;          // Mapping of the object
+    PiShmSlot_t *slots;             // First slot
+    size_t mapSize;                 // Bytes mapped
+    uint64_t mask;                  // Capacity - 1
+    uint64_t position;              // Samples published
+    uint64_t sample;                // Absolute sample number of the newest sample
+    uint16_t lastSequence;          // Sequence number of the newest sample
+    PiMuxAssembler_t mux;           // Reassembler feeding the mux snapshot
+} PiShmWriter_t;
+
+/**
+ * @struct PiShmReader_t
+ * @brief Reader state.
+ */
+typedef struct {
+    const PiShmHeader_t *header;    // Read-only mapping of the object
+    const PiShmSlot_t *slots;       // First slot
+    size_t mapSize;                 // Bytes mapped
+    uint64_t mask;                  // Capacity - 1
+    uint64_t next;                  // Ring position of the next sample to read
+    uint64_t samples;               // Samples read
+    uint64_t overruns;              // Samples overwritten before they could be read
+} PiShmReader_t;
+
+/**
+ * @brief Creates the shared memory ring.
+ *
+ * An existing object of the same name is replaced.
+ *
+ * @param writer Publisher state to initialize.
+ * @param name Name of the object, e.g. "/pistart".
+ * @param capacity History window in samples, rounded up to a power of two.
+ * @param packetRate Packet rate in Hz.
+ * @return 0 on success, -1 on error (errno is set).
+ */
+int piShmCreate(PiShmWriter_t *writer, const char *name, size_t capacity, uint16_t packetRate);
+
+/**
+ * @brief Publishes one validated packet.
+ *
+ * The mux word is also fed to the reassembler, and the snapshot is republished whenever a
+ * cycle completes.
+ *
+ * @param writer Publisher state.
+ * @param packet Validated packet.
+ * @param result `PI_PROT_OK`, or `PI_PROT_CORRECTED` if the packet was repaired.
+ * @param hostTimeNs Host time the packet was read (CLOCK_MONOTONIC).
+ */
+void piShmPublish(PiShmWriter_t *writer, const PiProt_t *packet, PiProtError_t result, uint64_t hostTimeNs);
+
+/**
+ * @brief Marks the ring closed, unmaps it and removes the object.
+ *
+ * Readers that have it mapped keep their mapping and see `piShmClosed` return 1.
+ *
+ * @param writer Publisher state.
+ */
+void piShmDestroy(PiShmWriter_t *writer);
+
+/**
+ * @brief Attaches to a shared memory ring.
+ *
+ * @param reader Reader state to initialize.
+ * @param name Name of the object.
+ * @param backfill Samples of history to read first, clamped to what the ring holds.
+ * @return 0 on success, -1 on error (errno is set, EINVAL for an object that is not a ring).
+ */
+int piShmOpen(PiShmReader_t *reader, const char *name, uint64_t backfill);
+
+/**
+ * @brief Copies the next available samples.
+ *
+ * Samples overwritten before they could be read are skipped and counted in `overruns`;
+ * reading resumes with the oldest sample still in the ring.
+ *
+ * @param reader Reader state.
+ * @param samples Destination array.
+ * @param max Capacity of the destination array.
+ * @return Number of samples copied, 0 if no new sample was published.
+ */
+size_t piShmRead(PiShmReader_t *reader, PiShmSample_t *samples, size_t max);
+
+/**
+ * @brief Copies the last mux snapshot.
+ *
+ * Gives up when the snapshot stays half written, which happens if the publisher stopped or
+ * died in the middle of an update.
+ *
+ * @param reader Reader state.
+ * @param mux Receives the snapshot.
+ * @return 1 if a snapshot was copied, 0 before the first complete mux cycle or if no
+ *         consistent snapshot could be read within `PI_SHM_MUX_ATTEMPTS` attempts.
+ */
+int piShmMux(const PiShmReader_t *reader, PiMux_t *mux);
+
+/**
+ * @brief Rebuilds the link packet of a sample, CRC included.
+ *
+ * @param sample Published sample.
+ * @param packet Receives the packet.
+ */
+void piShmPacket(const PiShmSample_t *sample, PiProt_t *packet);
+
+/**
+ * @brief Detaches from the ring.
+ *
+ * @param reader Reader state.
+ */
+void piShmClose(PiShmReader_t *reader);
+
+/**
+ * @brief Tells whether the publisher closed the ring.
+ *
+ * @param reader Reader state.
+ * @return 1 once the publisher stopped, 0 otherwise.
+ */
+static inline int piShmClosed(const PiShmReader_t *reader) {
+    return atomic_load_explicit(&reader->header->closed, memory_order_acquire) != 0;
+}
+
+#endif	/* #ifdef pishm_h_included */
@@ -1,8 +1,30 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
 
 #include "pi.h"
+#include "pibatch.h"
+#include "picap.h"
+#include "picrc.h"
+#include "pievent.h"
+#include "pigen.h"
+#include "pihex.h"
+#include "pimux.h"
+#include "piout.h"
+#include "pipack.h"
+#include "piserial.h"
+#include "pishm.h"
+#include "piproto.h"
+#include "pistats.h"
+#include "pitime.h"
 
 /**
  * @brief Converts a hexadecimal string to a byte array.
@@ -40,24 +62,337 @@ void parsePacket(const char * packetHex);
 /**
  * @brief Prints the details of an IMU protocol packet.
  *
- * Validates the packet using `piCheckProtBuffer`, calculates the CRC32 checksum, and prints
- * the packet details including header, sequence, temperature, gyro, and accelerometer values.
+ * Validates the packet using `piCheckProtBufferFast` and writes the packet details including
+ * header, sequence, gyro and accelerometer values to the selected output sink. Packets of an
+ * older format, recognized by their length, are validated by their own descriptor and
+ * printed translated into the current format, with the header and CRCs they had on the wire.
  *
  * @param buffer Pointer to the byte array containing the IMU protocol packet data.
+ * @param size Length of the packet.
+ */
+void printPacket(const uint8_t * buffer, size_t size);
+
+/**
+ * @brief Validates and prints every line of a hex log.
+ *
+ * Reads the log in large blocks with `piHexReadStream` and prints every decoded packet with
+ * `printPacket`. Lines that cannot be decoded or do not hold exactly one packet are reported
+ * with their line number.
+ *
+ * @param path Path of the log, "-" for standard input.
+ * @return 0 on success, -1 if the log could not be read.
+ */
+int parseLog(const char * path);
+
+/**
+ * @brief Reads packets from a serial device and prints them until interrupted.
+ *
+ * @param device Path of the tty.
+ * @param packetRate Packet rate in Hz, selects the baud rate.
+ * @param flags Combination of `PI_SERIAL_*` flags.
+ * @param capture Path of a binary capture receiving every packet, or NULL. Compressed with `-z`.
+ * @param statsInterval Seconds between link-health summaries on standard error, 0 for none.
+ * @param publish Name of a shared memory ring receiving every sample, or NULL.
+ * @param history Samples kept in the shared memory ring.
+ * @return 0 on success, -1 on error.
+ */
+int readDevice(const char * device, uint16_t packetRate, int flags, const char * capture, unsigned statsInterval,
+	const char * publish, size_t history);
+
+/**
+ * @brief Converts a hex log into a binary capture.
+ *
+ * Host times are not known for a log, they are derived from the packet rate. The capture is
+ * compressed with `-z`.
+ *
+ * @param path Path of the hex log, "-" for standard input.
+ * @param capture Path of the capture to create.
+ * @param packetRate Packet rate in Hz stored in the capture.
+ * @return 0 on success, -1 on error.
+ */
+int convertLog(const char * path, const char * capture, uint16_t packetRate);
+
+/**
+ * @brief Replays a binary capture through the framer and prints its packets.
+ *
+ * Compressed captures are recognized by their header and decoded block by block. A block
+ * that cannot be decoded, or records that are neither delivered nor rejected, fail the command.
+ *
+ * @param capture Path of the capture.
+ * @param speed Replay speed relative to real time, 0 for as fast as possible.
+ * @return 0 on success, -1 on error.
+ */
+int printCapture(const char * capture, double speed);
+
+/**
+ * @brief Validates and prints a capture, or a raw recording of the link, with several threads.
+ *
+ * The file is split into chunks decoded in parallel and printed in order, unpaced. The
+ * packet format is the one of `-P`, compressed captures are not supported.
+ *
+ * @param path Path of the capture or recording.
+ * @param threads Worker threads, 0 for one per CPU.
+ * @return 0 on success, -1 on error.
  */
-void printPacket(const uint8_t * buffer);
+int batchDecode(const char * path, unsigned threads);
+
+/**
+ * @brief Prints the state transitions and the fault and overrange edges of a capture.
+ *
+ * The events are kept in the sidecar file `<capture>.evt`; when it matches the capture only
+ * the records appended since it was written are scanned, and it is updated. Rejected records
+ * are skipped. Times are relative to the start of the capture, derived from the nearest
+ * index entry or block header and the sequence numbers. A compressed block that cannot be
+ * decoded fails the command and leaves the sidecar as it was.
+ *
+ * @param capture Path of a binary or compressed capture.
+ * @return 0 on success, -1 on error.
+ */
+int printEvents(const char * capture);
+
+/**
+ * @brief Writes a generated hex log to standard output, one link packet per line.
+ *
+ * @param count Number of packets.
+ * @param packetRate Packet rate in Hz.
+ * @param faultRate Probability per packet of every kind of injected fault.
+ * @return 0 on success, -1 on error.
+ */
+int generateLog(unsigned long count, uint16_t packetRate, double faultRate);
+
+/**
+ * @brief Prints the samples published on a shared memory ring until interrupted.
+ *
+ * Samples overwritten before they could be read are counted and reported on exit.
+ *
+ * @param name Name of the ring.
+ * @param backfill Samples of history to print first.
+ * @return 0 on success, -1 on error.
+ */
+int subscribeRing(const char * name, uint64_t backfill);
+
+/**
+ * @brief Replays the packets of a hex log on a pseudo-terminal until interrupted.
+ *
+ * Prints the path of the pty slave, which can be opened with `readDevice` like a real device.
+ *
+ * @param path Path of the hex log, "-" for standard input.
+ * @param packetRate Replay rate in Hz.
+ * @return 0 on success, -1 on error.
+ */
+int replayLog(const char * path, uint16_t packetRate);
+
+static volatile sig_atomic_t interrupted;
+
+static PiOut_t *output;
+
+static PiStats_t logStats;
+
+static int compressCaptures;
+
+static PiProtoFormat_t deviceFormat = PI_PROTO_MAIN;
+
+static int correctErrors;
+
+static uint16_t logSequence;
+
+static void onInterrupt(int signo) {
+	(void)signo;
+	interrupted = 1;
+}
+
+static void usage(const char * name) {
+	fprintf(stderr,
+		"Usage: %s [options] [log.hex|-]\n"
+		"  (no arguments)  parse the built-in test packets\n"
+		"  log.hex | -     validate a hex log, one packet per line\n"
+		"  -d device       read packets from a serial device\n"
+		"  -s log.hex      replay a hex log on a pseudo-terminal\n"
+		"  -r rate         packet rate: 250, 500 or 1000 Hz (default 1000)\n"
+		"  -l              low-latency serial mode\n"
+		"  -P format       packet format of -d and -j: main, legacy or auto (default main)\n"
+		"  -C              repair packets with a single-bit error instead of rejecting them\n"
+		"  -w capture      with -d or a hex log: write the packets to a binary capture\n"
+		"  -z              with -w: write a compressed capture\n"
+		"  -c capture      print the packets of a binary or compressed capture\n"
+		"  -x speed        replay speed of -c relative to real time (default 0, unpaced)\n"
+		"  -j threads      decode -c, or a raw link recording, in parallel (0 = one per CPU)\n"
+		"  -e capture      print the state, fault and overrange events of a capture\n"
+		"  -g count        write a generated hex log of count packets to standard output\n"
+		"  -f rate         fault probability per packet for -g (default 0)\n"
+		"  -o format       output format: table, csv or binary (default table)\n"
+		"  -S seconds      with -d: print link-health statistics every interval\n"
+		"  -p name         with -d: publish the samples on a shared memory ring\n"
+		"  -H samples      history kept by the -p ring (default 10 s of packets)\n"
+		"  -m name         print the samples of a shared memory ring\n"
+		"  -b samples      samples of history printed first by -m (default 0)\n", name);
+}
 
 /**
- * @brief Converts an ImuProtError_t error code to its string representation.
+ * @brief Prints a diagnostic in order with the packets.
  *
- * @param error The ImuProtError_t error code.
- * @return A string describing the error.
+ * Goes to standard output between the table rows, or to standard error when the output is
+ * CSV or binary so that the data stays machine-readable.
  */
-const char* PiProtErrorToString(PiProtError_t error);
+static void printMessage(const char * format, ...) {
+	FILE *stream = output->format == PI_OUT_TABLE ? stdout : stderr;
+	va_list args;
+
+	piOutFlush(output);
+	va_start(args, format);
+	vfprintf(stream, format, args);
+	va_end(args);
+	fflush(stream);
+}
+
+/**
+ * @brief Flushes and releases the output, returns the exit status.
+ */
+static int finishOutput(int result) {
+	if (piOutClose(output) != 0 && result == 0) {
+		fprintf(stderr, "stdout: %s\n", strerror(output->error));
+		result = -1;
+	}
+	free(output);
+	return result == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int main(int argc, char **argv) {
+	const char * device = NULL;
+	const char * replay = NULL;
+	const char * capture = NULL;
+	const char * readCapture = NULL;
+	const char * events = NULL;
+	double speed = 0;
+	int threads = -1;
+	unsigned long generate = 0;
+	double faultRate = 0;
+	PiOutFormat_t format = PI_OUT_TABLE;
+	uint16_t packetRate = 1000;
+	unsigned statsInterval = 0;
+	const char * publish = NULL;
+	const char * subscribe = NULL;
+	size_t history = 0;
+	uint64_t backfill = 0;
+	int flags = 0;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "d:s:r:lP:Cw:zc:x:j:e:g:f:o:S:p:H:m:b:h")) != -1) {
+		switch (opt) {
+			case 'd':
+				device = optarg;
+				break;
+			case 's':
+				replay = optarg;
+				break;
+			case 'r':
+				packetRate = (uint16_t)atoi(optarg);
+				if (piSerialBaudRate(packetRate) == 0) {
+					fprintf(stderr, "Unsupported packet rate: %s\n", optarg);
+					return EXIT_FAILURE;
+				}
+				break;
+			case 'l':
+				flags |= PI_SERIAL_LOW_LATENCY;
+				break;
+			case 'P':
+				if (piProtoFromName(optarg, &deviceFormat) != 0) {
+					fprintf(stderr, "Unknown packet format: %s\n", optarg);
+					return EXIT_FAILURE;
+				}
+				break;
+			case 'C':
+				correctErrors = 1;
+				break;
+			case 'w':
+				capture = optarg;
+				break;
+			case 'z':
+				compressCaptures = 1;
+				break;
+			case 'c':
+				readCapture = optarg;
+				break;
+			case 'x':
+				speed = atof(optarg);
+				break;
+			case 'j':
+				threads = atoi(optarg);
+				if (threads < 0) {
+					threads = 0;
+				}
+				break;
+			case 'e':
+				events = optarg;
+				break;
+			case 'g':
+				generate = strtoul(optarg, NULL, 10);
+				break;
+			case 'f':
+				faultRate = atof(optarg);
+				break;
+			case 'o':
+				if (piOutFormatFromName(optarg, &format) != 0) {
+					fprintf(stderr, "Unknown output format: %s\n", optarg);
+					return EXIT_FAILURE;
+				}
+				break;
+			case 'S':
+				statsInterval = (unsigned)strtoul(optarg, NULL, 10);
+				break;
+			case 'p':
+				publish = optarg;
+				break;
+			case 'H':
+				history = strtoul(optarg, NULL, 10);
+				break;
+			case 'm':
+				subscribe = optarg;
+				break;
+			case 'b':
+				backfill = strtoull(optarg, NULL, 10);
+				break;
+			default:
+				usage(argv[0]);
+				return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+	}
 
-int main(void) {
-    printf("Size Header Sequencer GyroX      GyroY      GyroZ      AcclX      AcclY"
-	       "      AcclZ    CRC32      Check      Validation result\n");
+	output = malloc(sizeof(PiOut_t));
+	if (output == NULL || piOutInit(output, STDOUT_FILENO, format) != 0) {
+		perror("output");
+		return EXIT_FAILURE;
+	}
+	if (device != NULL) {
+		return finishOutput(readDevice(device, packetRate, flags, capture, statsInterval,
+			publish, history != 0 ? history : 10 * (size_t)packetRate));
+	}
+	if (subscribe != NULL) {
+		return finishOutput(subscribeRing(subscribe, backfill));
+	}
+	if (generate != 0) {
+		return finishOutput(generateLog(generate, packetRate, faultRate));
+	}
+	if (events != NULL) {
+		return finishOutput(printEvents(events));
+	}
+	if (readCapture != NULL && threads >= 0) {
+		return finishOutput(batchDecode(readCapture, (unsigned)threads));
+	}
+	if (readCapture != NULL) {
+		return finishOutput(printCapture(readCapture, speed));
+	}
+	if (replay != NULL) {
+		return finishOutput(replayLog(replay, packetRate));
+	}
+	if (optind < argc && capture != NULL) {
+		return finishOutput(convertLog(argv[optind], capture, packetRate));
+	}
+	if (optind < argc) {
+		return finishOutput(parseLog(argv[optind]));
+	}
+
+	piOutHeader(output);
 	parsePacket("41310b31000000002edbffff65a3ffff127f1300920f0000fcecffffefddffff560efefffed4ffff560e0d006847f50100000000118b05a7");
 	parsePacket("41310c310000000021d7ffffefacffffec911300f8940000a6fbffff4decffff560efefffed4ffff560e0d006847f501000000007d162721");
 	parsePacket("41310d3100000000c3d9ffff70c2ffffec9413006494000020f1ffffea100000560efefffed4ffff560e0d006847f5010000000091f15ddd");
@@ -88,17 +423,17 @@ int main(void) {
 	parsePacket("4131213100100000c6dfffff98abffffac8d1300334700003de9ffffe4f8ffffb0f2fdff35deffff31080d00a845f5010000000074fded60");
 	// Wrong bit ---------------------------------------------------------------------------------------------------------------^
 
-	// parsePacket("74951FE00000000000007F79AFFEFFFFCFF4FFFFEAFBFFFF36F1FFFFC5E3FFFFA8C30900C14BE115");
-	// parsePacket("749520DF3F03000000007F79F2F6FFFFD7EEFFFF13F6FFFF82EFFFFF5AE6FFFF01C90900022D0189");
-	// parsePacket("749522DD0000000000007F7912EFFFFF99F4FFFFFEF9FFFFBFEAFFFFAADCFFFFB5CA0900C8E47F2F");
-	// parsePacket("749422DD0000000000007F7912EFFFFF99F4FFFFFEF9FFFFBFEAFFFFAADCFFFFB5CA0900C8E47F2F");	// Broken packet
-	// // Wrong bit ---^
-	// parsePacket("749522CD0000000000007F7912EFFFFF99F4FFFFFEF9FFFFBFEAFFFFAADCFFFFB5CA0900C8E47F2F");	// Broken packet
-	// // Wrong bit ------^
-	// parsePacket("749522DD0000100000007F7912EFFFFF99F4FFFFFEF9FFFFBFEAFFFFAADCFFFFB5CA0900C8E47F2F");	// Broken packet
-	// // Wrong bit ------------^
+	parsePacket("74951FE00000000000007F79AFFEFFFFCFF4FFFFEAFBFFFF36F1FFFFC5E3FFFFA8C30900C14BE115");
+	parsePacket("749520DF3F03000000007F79F2F6FFFFD7EEFFFF13F6FFFF82EFFFFF5AE6FFFF01C90900022D0189");
+	parsePacket("749522DD0000000000007F7912EFFFFF99F4FFFFFEF9FFFFBFEAFFFFAADCFFFFB5CA0900C8E47F2F");
+	parsePacket("749422DD0000000000007F7912EFFFFF99F4FFFFFEF9FFFFBFEAFFFFAADCFFFFB5CA0900C8E47F2F");	// Broken packet
+	// Wrong bit ---^
+	parsePacket("749522CD0000000000007F7912EFFFFF99F4FFFFFEF9FFFFBFEAFFFFAADCFFFFB5CA0900C8E47F2F");	// Broken packet
+	// Wrong bit ------^
+	parsePacket("749522DD0000100000007F7912EFFFFF99F4FFFFFEF9FFFFBFEAFFFFAADCFFFFB5CA0900C8E47F2F");	// Broken packet
+	// Wrong bit ------------^
 
-	return 0;
+	return finishOutput(0);
 }
 
 /**
@@ -112,27 +447,792 @@ int main(void) {
 void parsePacket(const char * packetHex) {
 	uint8_t buffer[256];
 	size_t size;
-	printPacket(hexStringToByteArray(packetHex, buffer, &size));
+	size_t errorPos = 0;
+	PiHexError_t error = piHexDecode(packetHex, strlen(packetHex), buffer, sizeof(buffer), &size, &errorPos);
+
+	if (error != PI_HEX_OK) {
+		printMessage("%s at character %zu\n", PiHexErrorToString(error), errorPos);
+		return;
+	}
+	if (piProtoDetect(buffer, size) == PI_PROTO_AUTO) {
+		printMessage("Wrong packet size: %zu bytes\n", size);
+		return;
+	}
+	printPacket(buffer, size);
+}
+
+/**
+ * @brief Handles one decoded line of a hex log.
+ */
+static void parseLogLine(void *context, uint64_t line, PiHexError_t error, const uint8_t *bytes, size_t len) {
+	(void)context;
+	if (error != PI_HEX_OK) {
+		printMessage("Line %llu: %s\n", (unsigned long long)line, PiHexErrorToString(error));
+	} else if (piProtoDetect(bytes, len) == PI_PROTO_AUTO) {
+		printMessage("Line %llu: wrong packet size %zu\n", (unsigned long long)line, len);
+	} else {
+		printPacket(bytes, len);
+	}
+}
+
+/**
+ * @brief Validates and prints every line of a hex log.
+ *
+ * @param path Path of the log, "-" for standard input.
+ * @return 0 on success, -1 if the log could not be read.
+ */
+int parseLog(const char * path) {
+	PiHexStats_t stats = { 0 };
+	int fd = strcmp(path, "-") == 0 ? STDIN_FILENO : open(path, O_RDONLY);
+	int result;
+
+	if (fd < 0) {
+		perror(path);
+		return -1;
+	}
+	piOutHeader(output);
+	piStatsInit(&logStats, 0, 0);
+	result = piHexReadStream(fd, parseLogLine, NULL, &stats);
+	if (result != 0) {
+		perror(path);
+	}
+	if (fd != STDIN_FILENO) {
+		close(fd);
+	}
+	fprintf(stderr, "%llu lines decoded, %llu bad lines\n", (unsigned long long)stats.lines, (unsigned long long)stats.badLines);
+	PiStatsSnapshot_t snapshot;
+	piStatsSnapshot(&logStats, &snapshot);
+	piStatsPrint(stderr, &snapshot, NULL);
+	return result;
 }
 
 /**
  * @brief Prints the details of an IMU protocol packet.
  *
- * This function checks the validity of the packet using `checkImuProtBuffer`, calculates the CRC32 checksum
- * of the packet, and prints the packet details including header, sequencer, temperature, gyro, and accelerometer values.
+ * This function checks the validity of the packet using `piProtoCheck` and formats the
+ * packet details including header, sequencer, gyro, and accelerometer values into the output
+ * buffer. The CRC32 checksum is recomputed for display only when the validation failed. With
+ * `-C` a packet with a single-bit error is shown repaired.
  *
  * @param buffer A pointer to the byte array containing the IMU protocol packet data.
  */
-void printPacket(const uint8_t * buffer) {
-	PiProt_t * imuBuffer = (PiProt_t*)buffer;
-	PiProtError_t result = piCheckProtBuffer(buffer);
-	uint32_t crc32 = piCrc32((void*)&(imuBuffer->sequence), sizeof(PiProt_t) - 4 - 2);
+void printPacket(const uint8_t * buffer, size_t size) {
+	PiProtoFormat_t format = piProtoDetect(buffer, size);
+	PiProtError_t result = piProtoCheck(format, buffer);
+	const PiProt_t *packet = (const PiProt_t *)buffer;
+	PiProt_t translated;
+	uint8_t repaired[PI_PROTO_MAX_SIZE];
+
+	if (result != PI_PROT_OK && correctErrors) {
+		memcpy(repaired, buffer, size);
+		if (piProtoCorrect(format, repaired) == PI_PROT_CORRECTED) {
+			buffer = repaired;
+			packet = (const PiProt_t *)repaired;
+			result = PI_PROT_CORRECTED;
+		}
+	}
+	if (format != PI_PROTO_MAIN) {
+		const PiProtoDescriptor_t *descriptor = &piProtoDescriptors[format];
+		uint32_t check;
+
+		if (result == PI_PROT_OK || result == PI_PROT_CORRECTED) {
+			piProtoDecode(format, buffer, &logSequence, &translated);
+			piStatsPacket(&logStats, &translated, 0);
+		} else {
+			// The sequence of a rejected packet is not trusted to extend the next ones, the row
+			// shows its raw sequence number
+			uint16_t raw = 0;
+			piProtoDecode(format, buffer, &raw, &translated);
+		}
+		// Valid or not, the row shows the header, CRCs and length the packet had on the wire
+		translated.header = PI_PROTO_LOAD(uint16_t, buffer, 0);
+		translated.crc32 = PI_PROTO_LOAD(uint32_t, buffer, descriptor->crcOffset);
+		check = piCrc32Fast(buffer + descriptor->crcFirst, descriptor->crcEnd - descriptor->crcFirst);
+		if (result != PI_PROT_OK) {
+			piStatsError(&logStats, result);
+		}
+		piOutTranslatedPacket(output, &translated, result, size, check);
+		return;
+	}
+
+	// Log lines carry no arrival time, only the sequence and validation are accounted
+	if (result == PI_PROT_OK || result == PI_PROT_CORRECTED) {
+		piStatsPacket(&logStats, packet, 0);
+	}
+	if (result != PI_PROT_OK) {
+		piStatsError(&logStats, result);
+	}
+	piOutPacket(output, packet, result);
+}
+
+/**
+ * @brief Capture being written, binary or compressed depending on `-z`.
+ */
+typedef struct {
+	int compressed;
+	PiCapWriter_t cap;
+	PiPackWriter_t pack;
+} CaptureWriter_t;
+
+static int captureCreate(CaptureWriter_t *writer, const char * path, uint16_t packetRate) {
+	writer->compressed = compressCaptures;
+	if (writer->compressed) {
+		return piPackCreate(&writer->pack, path, 0, packetRate);
+	}
+	return piCapCreate(&writer->cap, path, 0, packetRate);
+}
+
+static int captureAppend(CaptureWriter_t *writer, const PiProt_t *packet, uint64_t hostTimeNs) {
+	if (writer->compressed) {
+		return piPackAppend(&writer->pack, packet, hostTimeNs);
+	}
+	return piCapAppend(&writer->cap, packet, hostTimeNs);
+}
 
-	printf("%d   0x%04X %05d % 10.3f % 10.3f % 10.3f % 10.3f % 10.3f % 10.3f  0x%08X 0x%08X (%d) %s\n", 
-		(int)sizeof(PiProt_t), imuBuffer->header, imuBuffer->sequence,
-		fp1_14_17ToFloat(imuBuffer->data.gyro[0]), fp1_14_17ToFloat(imuBuffer->data.gyro[1]), fp1_14_17ToFloat(imuBuffer->data.gyro[2]), 
-		fp1_14_17ToFloat(imuBuffer->data.accl[0]), fp1_14_17ToFloat(imuBuffer->data.accl[1]), fp1_14_17ToFloat(imuBuffer->data.accl[2]),
-		imuBuffer->crc32, crc32, (int)result, PiProtErrorToString(result));
+static int captureFinish(CaptureWriter_t *writer) {
+	return writer->compressed ? piPackFinish(&writer->pack) : piCapFinish(&writer->cap);
+}
+
+static uint64_t captureStartHostNs(const CaptureWriter_t *writer) {
+	return writer->compressed ? writer->pack.header.startHostNs : writer->cap.header->startHostNs;
+}
+
+static uint64_t captureRecords(const CaptureWriter_t *writer) {
+	return writer->compressed ? writer->pack.records : writer->cap.records;
+}
+
+/**
+ * @brief Stores the hardware serial number in the capture header once it is known.
+ */
+static void captureMuxChange(void *context, PiMuxField_t field, const PiMux_t *snapshot) {
+	CaptureWriter_t *writer = context;
+	if (field == PI_MUX_HW_SERIAL) {
+		if (writer->compressed) {
+			writer->pack.header.hwSerial = snapshot->hwSerial;
+		} else {
+			writer->cap.header->hwSerial = snapshot->hwSerial;
+		}
+	}
+}
+
+/**
+ * @brief State of a device being read.
+ */
+typedef struct {
+	PiSerial_t *port;
+	CaptureWriter_t *capture;
+	PiMuxAssembler_t mux;
+	PiStats_t stats;
+	PiTimebase_t time;
+	PiShmWriter_t *ring;
+} ReadDevice_t;
+
+
+/**
+ * @brief Prints one packet received from the serial device and appends it to the capture.
+ */
+static void readDevicePacket(void *context, const PiProt_t *packet) {
+	ReadDevice_t *reader = context;
+	PiTimeStamp_t stamp;
+	PiProtError_t result = reader->port->framer.lastResult;
+	piOutPacket(output, packet, result);
+	piStatsPacket(&reader->stats, packet, reader->port->readTimeNs);
+	piTimePacket(&reader->time, packet, reader->port->readTimeNs, &stamp);
+	if (reader->ring != NULL) {
+		piShmPublish(reader->ring, packet, result, reader->port->readTimeNs);
+	}
+	if (reader->capture != NULL) {
+		if (captureAppend(reader->capture, packet, reader->port->readTimeNs) != 0) {
+			perror("capture");
+			interrupted = 1;
+		}
+		piMuxPush(&reader->mux, packet->sequence, packet->mux);
+	}
+}
+
+/**
+ * @brief Installs the SIGINT/SIGTERM handler that stops the device loops.
+ */
+static void catchInterrupt(void) {
+	struct sigaction action;
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = onInterrupt;
+	sigaction(SIGINT, &action, NULL);
+	sigaction(SIGTERM, &action, NULL);
+}
+
+/**
+ * @brief Reads packets from a serial device and prints them until interrupted.
+ *
+ * @param device Path of the tty.
+ * @param packetRate Packet rate in Hz, selects the baud rate.
+ * @param flags Combination of `PI_SERIAL_*` flags.
+ * @param capture Path of a binary capture receiving every packet, or NULL. Compressed with `-z`.
+ * @param statsInterval Seconds between link-health summaries on standard error, 0 for none.
+ * @param publish Name of a shared memory ring receiving every sample, or NULL.
+ * @param history Samples kept in the shared memory ring.
+ * @return 0 on success, -1 on error.
+ */
+int readDevice(const char * device, uint16_t packetRate, int flags, const char * capture, unsigned statsInterval,
+	const char * publish, size_t history) {
+	PiSerial_t *port = malloc(sizeof(PiSerial_t));
+	CaptureWriter_t writer;
+	PiShmWriter_t ring;
+	ReadDevice_t reader = { .port = port, .capture = NULL, .ring = NULL };
+	PiStatsSnapshot_t snapshot, previous;
+	int result = 0;
+
+	piStatsInit(&reader.stats, 0, packetRate);
+	piTimeInit(&reader.time, packetRate, 0);
+	piStatsSnapshot(&reader.stats, &previous);
+
+	if (capture != NULL) {
+		if (captureCreate(&writer, capture, packetRate) != 0) {
+			perror(capture);
+			free(port);
+			return -1;
+		}
+		reader.capture = &writer;
+		piMuxInit(&reader.mux, captureMuxChange, &writer);
+	}
+	if (publish != NULL) {
+		if (piShmCreate(&ring, publish, history, packetRate) != 0) {
+			perror(publish);
+			result = -1;
+		} else {
+			reader.ring = &ring;
+		}
+	}
+	if (result != 0 || port == NULL || piSerialOpen(port, device, packetRate, flags, readDevicePacket, &reader) != 0) {
+		if (result == 0) {
+			perror(device);
+		}
+		if (reader.capture != NULL) {
+			captureFinish(&writer);
+		}
+		if (reader.ring != NULL) {
+			piShmDestroy(&ring);
+		}
+		free(port);
+		return -1;
+	}
+	piFramerSetFormat(&port->framer, deviceFormat);
+	piFramerSetCorrection(&port->framer, correctErrors);
+	catchInterrupt();
+	piOutHeader(output);
+	while (!interrupted) {
+		if (piSerialPoll(port, 200) < 0) {
+			perror(device);
+			result = -1;
+			break;
+		}
+		piStatsFramer(&reader.stats, &port->framer);
+		piOutFlush(output);
+		if (statsInterval != 0) {
+			piStatsSnapshot(&reader.stats, &snapshot);
+			if (snapshot.timeNs - previous.timeNs >= statsInterval * 1000000000ull) {
+				piStatsPrint(stderr, &snapshot, &previous);
+				previous = snapshot;
+			}
+		}
+	}
+	fprintf(stderr, "%llu packets, %llu corrected, %llu bad CRC, %llu bytes skipped, %llu bytes in %llu reads\n",
+		(unsigned long long)port->framer.packets, (unsigned long long)port->framer.corrected, (unsigned long long)port->framer.badCrc,
+		(unsigned long long)port->framer.skippedBytes, (unsigned long long)port->bytes, (unsigned long long)port->reads);
+	piStatsSnapshot(&reader.stats, &snapshot);
+	piStatsPrint(stderr, &snapshot, &previous);
+	if (reader.time.started) {
+		fprintf(stderr, "device time %.3f s%s, clock drift %+.1f ppm\n",
+			(double)piTimeDeviceNs(&reader.time, reader.time.sample) / 1e9,
+			piTimeAnchored(&reader.time) ? " since boot" : " since the first packet", piTimeDriftPpm(&reader.time));
+	}
+	piSerialClose(port);
+	free(port);
+	if (reader.ring != NULL) {
+		piShmDestroy(&ring);
+	}
+	if (reader.capture != NULL && captureFinish(&writer) != 0) {
+		perror(capture);
+		result = -1;
+	}
+	return result;
+}
+
+/**
+ * @brief Prints the samples published on a shared memory ring until interrupted.
+ *
+ * @param name Name of the ring.
+ * @param backfill Samples of history to print first.
+ * @return 0 on success, -1 on error.
+ */
+int subscribeRing(const char * name, uint64_t backfill) {
+	PiShmReader_t reader;
+	PiShmSample_t samples[256];
+	PiProt_t packet;
+	PiMux_t mux;
+
+	if (piShmOpen(&reader, name, backfill) != 0) {
+		perror(name);
+		return -1;
+	}
+	catchInterrupt();
+	piOutHeader(output);
+	while (!interrupted) {
+		size_t count = piShmRead(&reader, samples, 256);
+		for (size_t i = 0; i < count; i++) {
+			piShmPacket(&samples[i], &packet);
+			piOutPacket(output, &packet, (PiProtError_t)samples[i].status);
+		}
+		if (count < 256) {
+			struct timespec pause = { 0, 10000000 };
+			piOutFlush(output);
+			if (count == 0 && piShmClosed(&reader)) {
+				break;
+			}
+			nanosleep(&pause, NULL);
+		}
+	}
+	if (piShmMux(&reader, &mux)) {
+		fprintf(stderr, "device %u: ", (unsigned)mux.hwSerial);
+	}
+	fprintf(stderr, "%llu samples, %llu overrun\n", (unsigned long long)reader.samples, (unsigned long long)reader.overruns);
+	piShmClose(&reader);
+	return 0;
+}
+
+/**
+ * @brief Capture written from a hex log.
+ */
+typedef struct {
+	CaptureWriter_t writer;
+	PiMuxAssembler_t mux;
+	uint64_t hostTimeNs;
+	uint64_t period;
+	int failed;
+} ConvertLog_t;
+
+static void convertLogLine(void *context, uint64_t line, PiHexError_t error, const uint8_t *bytes, size_t len) {
+	ConvertLog_t *convert = context;
+	(void)line;
+	if (error != PI_HEX_OK || len != sizeof(PiProt_t) || convert->failed) {
+		return;
+	}
+	convert->failed = captureAppend(&convert->writer, (const PiProt_t *)bytes, convert->hostTimeNs) != 0;
+	convert->hostTimeNs += convert->period;
+	if (piCheckProtBuffer(bytes) == PI_PROT_OK) {
+		const PiProt_t *packet = (const PiProt_t *)bytes;
+		piMuxPush(&convert->mux, packet->sequence, packet->mux);
+	}
+}
+
+/**
+ * @brief Converts a hex log into a binary capture.
+ *
+ * @param path Path of the hex log, "-" for standard input.
+ * @param capture Path of the capture to create.
+ * @param packetRate Packet rate in Hz stored in the capture.
+ * @return 0 on success, -1 on error.
+ */
+int convertLog(const char * path, const char * capture, uint16_t packetRate) {
+	ConvertLog_t convert = { .period = 1000000000ull / packetRate };
+	PiHexStats_t stats = { 0 };
+	int fd = strcmp(path, "-") == 0 ? STDIN_FILENO : open(path, O_RDONLY);
+	int result;
+
+	if (fd < 0) {
+		perror(path);
+		return -1;
+	}
+	if (captureCreate(&convert.writer, capture, packetRate) != 0) {
+		perror(capture);
+		if (fd != STDIN_FILENO) {
+			close(fd);
+		}
+		return -1;
+	}
+	convert.hostTimeNs = captureStartHostNs(&convert.writer);
+	piMuxInit(&convert.mux, captureMuxChange, &convert.writer);
+	result = piHexReadStream(fd, convertLogLine, &convert, &stats);
+	if (result != 0) {
+		perror(path);
+	}
+	if (fd != STDIN_FILENO) {
+		close(fd);
+	}
+	if (convert.failed || captureFinish(&convert.writer) != 0) {
+		perror(capture);
+		result = -1;
+	}
+	fprintf(stderr, "%llu packets written to %s, %llu bad lines\n",
+		(unsigned long long)captureRecords(&convert.writer), capture, (unsigned long long)stats.badLines);
+	return result;
+}
+
+static void printCapturePacket(void *context, const PiProt_t *packet) {
+	const PiFramer_t *framer = context;
+	piOutPacket(output, packet, framer->lastResult);
+}
+
+/**
+ * @brief Replays a binary capture through the framer and prints its packets.
+ *
+ * Compressed captures are recognized by their header and decoded block by block. A block
+ * that cannot be decoded, or records that are neither delivered nor rejected, fail the command.
+ *
+ * @param capture Path of the capture.
+ * @param speed Replay speed relative to real time, 0 for as fast as possible.
+ * @return 0 on success, -1 on error.
+ */
+int printCapture(const char * capture, double speed) {
+	PiCapReader_t reader;
+	PiPackReader_t pack;
+	PiFramer_t framer;
+
+	if (piPackOpen(&pack, capture) == 0) {
+		uint64_t replayed, rejected;
+		int result = 0, error;
+
+		piFramerInit(&framer, printCapturePacket, &framer);
+		piFramerSetCorrection(&framer, correctErrors);
+		piOutHeader(output);
+		replayed = piPackReplay(&pack, 0, pack.count, speed, &framer);
+		error = errno;
+		fprintf(stderr, "%llu compressed records of device %08X at %u Hz in %zu bytes, %llu packets, %llu bad CRC\n",
+			(unsigned long long)pack.count, (unsigned)pack.header->hwSerial, (unsigned)pack.header->packetRate,
+			pack.mapSize, (unsigned long long)framer.packets, (unsigned long long)framer.badCrc);
+		// A record with a bad header is skipped by the framer, like a CRC reject it was captured that way
+		rejected = framer.badCrc + framer.skippedBytes / sizeof(PiProt_t);
+		if (replayed < pack.count) {
+			errno = error;
+			if (error == EINVAL) {
+				fprintf(stderr, "%s: block %zu at record %llu is corrupt\n", capture, piPackFindBlock(&pack, replayed),
+					(unsigned long long)replayed);
+			} else {
+				perror(capture);
+			}
+			result = -1;
+		} else if (framer.packets + rejected < pack.count) {
+			fprintf(stderr, "%s: %llu records were not delivered\n", capture,
+				(unsigned long long)(pack.count - framer.packets - rejected));
+			errno = EINVAL;
+			result = -1;
+		}
+		piPackClose(&pack);
+		return result;
+	}
+	if (errno != EINVAL || piCapOpen(&reader, capture) != 0) {
+		perror(capture);
+		return -1;
+	}
+	piFramerInit(&framer, printCapturePacket, &framer);
+	piFramerSetCorrection(&framer, correctErrors);
+	piOutHeader(output);
+	piCapReplay(&reader, 0, reader.count, speed, &framer);
+	fprintf(stderr, "%llu records of device %08X at %u Hz, %llu packets, %llu bad CRC\n",
+		(unsigned long long)reader.count, (unsigned)reader.header->hwSerial, (unsigned)reader.header->packetRate,
+		(unsigned long long)framer.packets, (unsigned long long)framer.badCrc);
+	piCapClose(&reader);
+	return 0;
+}
+
+/**
+ * @brief Validates and prints a capture, or a raw recording of the link, with several threads.
+ *
+ * @param path Path of the capture or recording.
+ * @param threads Worker threads, 0 for one per CPU.
+ * @return 0 on success, -1 on error.
+ */
+int batchDecode(const char * path, unsigned threads) {
+	PiBatchConfig_t config = { .format = deviceFormat, .correct = correctErrors, .threads = threads, .output = output };
+	PiBatchResult_t result;
+	PiStatsSnapshot_t snapshot;
+	PiPackReader_t pack;
+	struct timespec start, end;
+	double seconds;
+
+	if (piPackOpen(&pack, path) == 0) {
+		piPackClose(&pack);
+		fprintf(stderr, "%s: compressed captures are decoded without -j\n", path);
+		return -1;
+	}
+	if (errno != EINVAL) {
+		perror(path);
+		return -1;
+	}
+	piOutHeader(output);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	if (piBatchDecodeFile(path, &config, &result) != 0) {
+		if (errno == EINVAL) {
+			fprintf(stderr, "%s: compressed captures are decoded without -j\n", path);
+		} else {
+			perror(path);
+		}
+		return -1;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	seconds = (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) / 1e9;
+	piOutFlush(output);
+	fprintf(stderr, "%llu bytes of %s packets in %llu chunks decoded by %u threads in %.3f s (%.1f MB/s)\n",
+		(unsigned long long)result.bytes, result.format == PI_PROTO_AUTO ? "no" : piProtoDescriptors[result.format].name,
+		(unsigned long long)result.chunks, result.threads, seconds, seconds > 0 ? (double)result.bytes / seconds / 1e6 : 0.0);
+	piStatsSnapshot(&result.stats, &snapshot);
+	piStatsPrint(stderr, &snapshot, NULL);
+	return 0;
+}
+
+/**
+ * @brief Returns the time of a record since the start of a capture, from an anchor record
+ * before it whose sample number and host time are known.
+ */
+static double eventSeconds(uint64_t anchorSample, uint64_t anchorNs, uint64_t startNs, uint16_t sequence, uint16_t packetRate) {
+	uint16_t samples = (uint16_t)(sequence - (uint16_t)anchorSample);
+
+	return ((double)anchorNs - (double)startNs) / 1e9 + (double)samples / (packetRate != 0 ? packetRate : 1000);
+}
+
+/**
+ * @brief Prints one event as a table row or a CSV line.
+ */
+static void printEvent(const PiEvent_t * event, double seconds) {
+	char detail[48];
+	const char * kind;
+	const char * name;
+
+	if (event->kind == PI_EVENT_STATE) {
+		kind = "state";
+		snprintf(detail, sizeof(detail), "%s -> %s", piEventStateName(piEventPreviousState(event)),
+			piEventStateName(piEventState(event)));
+	} else {
+		kind = event->kind == PI_EVENT_RISE ? "set" : "clear";
+		name = piEventBitName(event->value);
+		if (name != NULL) {
+			snprintf(detail, sizeof(detail), "%s", name);
+		} else {
+			snprintf(detail, sizeof(detail), "bit %u", (unsigned)event->value);
+		}
+	}
+	if (output->format == PI_OUT_CSV) {
+		printf("%.6f,%llu,%u,%s,%s,%u\n", seconds, (unsigned long long)event->record, (unsigned)event->sequence,
+			kind, detail, (unsigned)event->run);
+	} else {
+		printf("%12.6f %10llu %5u  %-5s %-28s %10u\n", seconds, (unsigned long long)event->record,
+			(unsigned)event->sequence, kind, detail, (unsigned)event->run);
+	}
+}
+
+/**
+ * @brief Prints the state transitions and the fault and overrange edges of a capture.
+ *
+ * The events are kept in the sidecar file `<capture>.evt`; when it matches the capture only
+ * the records appended since it was written are scanned, and it is updated. Rejected records
+ * are skipped. Times are relative to the start of the capture, derived from the nearest
+ * index entry or block header and the sequence numbers. A compressed block that cannot be
+ * decoded fails the command and leaves the sidecar as it was.
+ *
+ * @param capture Path of a binary or compressed capture.
+ * @return 0 on success, -1 on error.
+ */
+int printEvents(const char * capture) {
+	PiCapReader_t reader;
+	PiPackReader_t pack;
+	PiEventScanner_t scanner;
+	PiProt_t *packets = NULL;
+	int packed = piPackOpen(&pack, capture) == 0;
+	uint64_t count, startTimeNs, startNs, cached;
+	uint16_t packetRate;
+	uint32_t hwSerial;
+	int result = 0;
+
+	if (!packed && (errno != EINVAL || piCapOpen(&reader, capture) != 0)) {
+		perror(capture);
+		return -1;
+	}
+	count = packed ? pack.count : reader.count;
+	startTimeNs = packed ? pack.header->startTimeNs : reader.header->startTimeNs;
+	startNs = packed ? pack.header->startHostNs : reader.header->startHostNs;
+	packetRate = packed ? pack.header->packetRate : reader.header->packetRate;
+	hwSerial = packed ? pack.header->hwSerial : reader.header->hwSerial;
+
+	if (piEventLoad(&scanner, capture, count, startTimeNs) != 0) {
+		piEventInit(&scanner, 1);
+	}
+	cached = scanner.records;
+	if (packed) {
+		packets = malloc(PI_PACK_BLOCK_PACKETS * sizeof(PiProt_t));
+		if (packets == NULL) {
+			perror(capture);
+			result = -1;
+		}
+		for (size_t b = packets != NULL ? piPackFindBlock(&pack, scanner.records) : pack.blockCount; b < pack.blockCount; b++) {
+			size_t n = piPackDecode(pack.blocks[b].header, packets);
+			size_t skip = (size_t)(scanner.records - pack.blocks[b].record);
+
+			if (n == 0) {
+				// The records of the following blocks would be numbered wrong
+				fprintf(stderr, "%s: block %zu at record %llu is corrupt\n", capture, b,
+					(unsigned long long)pack.blocks[b].record);
+				errno = EINVAL;
+				result = -1;
+				break;
+			}
+			if (skip < n && piEventScan(&scanner, packets + skip, sizeof(PiProt_t), n - skip) != 0) {
+				perror(capture);
+				result = -1;
+			}
+		}
+		free(packets);
+	} else if (piEventScan(&scanner, reader.records + scanner.records, sizeof(PiProt_t), (size_t)(count - scanner.records)) != 0) {
+		perror(capture);
+		result = -1;
+	}
+	if (result == 0 && scanner.records > cached && piEventSave(&scanner, capture, startTimeNs) != 0) {
+		// The events are still printed, the next run scans the capture again
+		fprintf(stderr, "%s.evt: %s\n", capture, strerror(errno));
+	}
+
+	if (output->format == PI_OUT_CSV) {
+		printf("time_s,record,sequence,event,detail,run\n");
+	} else {
+		printf("%12s %10s %5s  %-5s %-28s %10s\n", "time s", "record", "seq", "event", "detail", "run");
+	}
+	for (size_t i = 0; i < scanner.count; i++) {
+		const PiEvent_t *event = &scanner.events[i];
+		double seconds;
+
+		if (packed) {
+			const PiPackBlockHeader_t *block = pack.blocks[piPackFindBlock(&pack, event->record)].header;
+			seconds = eventSeconds(block->sample, block->hostTimeNs, startNs, event->sequence, packetRate);
+		} else if (reader.indexCount != 0 && reader.header->indexInterval != 0) {
+			size_t entry = (size_t)(event->record / reader.header->indexInterval);
+			const PiCapIndexEntry_t *anchor = &reader.index[entry < reader.indexCount ? entry : reader.indexCount - 1];
+			seconds = eventSeconds(anchor->sample, anchor->hostTimeNs, startNs, event->sequence, packetRate);
+		} else {
+			seconds = (double)event->record / (packetRate != 0 ? packetRate : 1000);
+		}
+		printEvent(event, seconds);
+	}
+	fflush(stdout);
+	fprintf(stderr, "%zu events in %llu records of device %08X, %llu scanned, %llu from %s.evt, %llu rejected\n",
+		scanner.count, (unsigned long long)count, (unsigned)hwSerial, (unsigned long long)(scanner.records - cached),
+		(unsigned long long)cached, capture, (unsigned long long)scanner.rejected);
+	piEventFree(&scanner);
+	if (packed) {
+		piPackClose(&pack);
+	} else {
+		piCapClose(&reader);
+	}
+	return result;
+}
+
+/**
+ * @brief Packets of a hex log loaded for replay.
+ */
+typedef struct {
+	PiProt_t *packets;
+	size_t count;
+	size_t capacity;
+	size_t next;
+} ReplayPackets_t;
+
+static void replayLogLine(void *context, uint64_t line, PiHexError_t error, const uint8_t *bytes, size_t len) {
+	ReplayPackets_t *replay = context;
+	(void)line;
+	if (error != PI_HEX_OK || len != sizeof(PiProt_t)) {
+		return;
+	}
+	if (replay->count == replay->capacity) {
+		size_t capacity = replay->capacity ? 2 * replay->capacity : 1024;
+		PiProt_t *packets = realloc(replay->packets, capacity * sizeof(PiProt_t));
+		if (packets == NULL) {
+			return;
+		}
+		replay->packets = packets;
+		replay->capacity = capacity;
+	}
+	memcpy(&replay->packets[replay->count++], bytes, sizeof(PiProt_t));
+}
+
+static size_t replayLogSource(void *context, PiProt_t *packet) {
+	ReplayPackets_t *replay = context;
+	*packet = replay->packets[replay->next];
+	replay->next = (replay->next + 1) % replay->count;
+	return sizeof(PiProt_t);
+}
+
+/**
+ * @brief Replays the packets of a hex log on a pseudo-terminal until interrupted.
+ *
+ * @param path Path of the hex log, "-" for standard input.
+ * @param packetRate Replay rate in Hz.
+ * @return 0 on success, -1 on error.
+ */
+int replayLog(const char * path, uint16_t packetRate) {
+	ReplayPackets_t packets = { 0 };
+	PiPtyReplay_t replay;
+	int fd = strcmp(path, "-") == 0 ? STDIN_FILENO : open(path, O_RDONLY);
+
+	if (fd < 0 || piHexReadStream(fd, replayLogLine, &packets, NULL) != 0) {
+		perror(path);
+		return -1;
+	}
+	if (fd != STDIN_FILENO) {
+		close(fd);
+	}
+	if (packets.count == 0) {
+		fprintf(stderr, "%s: no packets to replay\n", path);
+		return -1;
+	}
+	if (piPtyReplayStart(&replay, packetRate, replayLogSource, &packets) != 0) {
+		perror("openpty");
+		free(packets.packets);
+		return -1;
+	}
+	catchInterrupt();
+	printf("Replaying %zu packets at %u Hz on %s\n", packets.count, (unsigned)packetRate, replay.slaveName);
+	fflush(stdout);
+	while (!interrupted) {
+		pause();
+	}
+	piPtyReplayStop(&replay);
+	fprintf(stderr, "%llu packets sent\n", (unsigned long long)atomic_load(&replay.sent));
+	free(packets.packets);
+	return 0;
+}
+
+/**
+ * @brief Writes a generated hex log to standard output, one link packet per line.
+ *
+ * @param count Number of packets.
+ * @param packetRate Packet rate in Hz.
+ * @param faultRate Probability per packet of every kind of injected fault.
+ * @return 0 on success, -1 on error.
+ */
+int generateLog(unsigned long count, uint16_t packetRate, double faultRate) {
+	static const char digits[] = "0123456789abcdef";
+	PiGenConfig_t config = { .packetRate = packetRate, .hwSerial = 123456,
+		.bitFlipRate = faultRate, .dropByteRate = faultRate, .truncateRate = faultRate,
+		.badHeaderRate = faultRate, .gapRate = faultRate, .maxGap = 8 };
+	PiGen_t gen;
+	uint8_t bytes[sizeof(PiProt_t)];
+	char line[2 * sizeof(PiProt_t) + 2];
+
+	piGenInit(&gen, &config);
+	for (unsigned long i = 0; i < count; i++) {
+		size_t len = piGenNext(&gen, bytes);
+		for (size_t j = 0; j < len; j++) {
+			line[2 * j] = digits[bytes[j] >> 4];
+			line[2 * j + 1] = digits[bytes[j] & 15];
+		}
+		line[2 * len] = '\n';
+		if (fwrite(line, 1, 2 * len + 1, stdout) != 2 * len + 1) {
+			perror("stdout");
+			return -1;
+		}
+	}
+	fprintf(stderr, "%lu packets: %llu bit flips, %llu dropped bytes, %llu truncated, %llu bad headers, %llu gaps\n",
+		count, (unsigned long long)gen.bitFlips, (unsigned long long)gen.droppedBytes,
+		(unsigned long long)gen.truncated, (unsigned long long)gen.badHeaders, (unsigned long long)gen.gaps);
+	return fflush(stdout) == 0 ? 0 : -1;
 }
 
 /**
@@ -140,6 +1240,8 @@ void printPacket(const uint8_t * buffer) {
  *
  * This function takes a string representing hexadecimal values and converts it into a byte array.
  * The length of the resulting byte array is computed and stored in the provided `byteArrayLen` pointer.
+ * Decoding stops at the first non-hexadecimal character. `byteArray` must hold at least half the
+ * string length; use `piHexDecode` when the destination size has to be checked.
  *
  * @param hexString A string containing hexadecimal values, with each pair of characters representing a byte.
  * @param byteArray A pointer to an array where the converted byte values will be stored.
@@ -149,13 +1251,9 @@ void printPacket(const uint8_t * buffer) {
  */
 const uint8_t * hexStringToByteArray(const char* hexString, uint8_t * byteArray, size_t* byteArrayLen) {
     size_t strLen = strlen(hexString);
-    *byteArrayLen = strLen / 2;
-    
-    for (size_t i = 0; i < *byteArrayLen; i++) {
-        char byteStr[3] = { hexString[i * 2], hexString[i * 2 + 1], '\0' };
-        byteArray[i] = (uint8_t )strtol(byteStr, NULL, 16);
-    }
 
+	// The caller guarantees room for strLen / 2 bytes; decoding stops at the first non-hex character
+	piHexDecode(hexString, strLen, byteArray, strLen / 2, byteArrayLen, NULL);
 	return byteArray;
 }
 
@@ -172,21 +1270,3 @@ void printByteArray(const unsigned char* byteArray, size_t byteArrayLen) {
     }
     printf("\n");
 }
-
-/**
- * @brief Converts an ImuProtError_t error code to its corresponding string representation.
- *
- * @param error The ImuProtError_t error code.
- * @return A string that describes the error.
- */
-const char* PiProtErrorToString(PiProtError_t error) {
-    switch (error) {
-        case PI_PROT_OK:
-            return "OK.";
-        case PI_PROT_BAD_HEADER:
-            return "Invalid header!";
-        case PI_PROT_BAD_CRC:
-            return "CRC validation failed!";
-    }
-	return "Unknown error.";
-}
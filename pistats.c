@@ -0,0 +1,290 @@
+#include <string.h>
+#include <time.h>
+
+#include "pistats.h"
+
+/**
+ * @brief Adds to a counter that has a single writer, without a locked instruction.
+ */
+static inline void piStatsAdd(atomic_ullong *counter, uint64_t value) {
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + value, memory_order_relaxed);
+}
+
+/**
+ * @brief Records a value in a histogram.
+ */
+static inline void piStatsRecord(PiStatsHistogram_t *histogram, uint64_t value) {
+    unsigned bucket = value == 0 ? 0 : 64 - (unsigned)__builtin_clzll(value);
+
+    if (bucket >= PI_STATS_BUCKETS) {
+        bucket = PI_STATS_BUCKETS - 1;
+    }
+    piStatsAdd(&histogram->buckets[bucket], 1);
+    piStatsAdd(&histogram->count, 1);
+    piStatsAdd(&histogram->sum, value);
+    if (value > atomic_load_explicit(&histogram->max, memory_order_relaxed)) {
+        atomic_store_explicit(&histogram->max, value, memory_order_relaxed);
+    }
+}
+
+/**
+ * @brief Accounts the step from the last packet to the next one: a duplicate, a packet going
+ * back, or a packet moving forward with the packets lost before it and its arrival time.
+ *
+ * @return 1 if the packet moved forward and becomes the last one, 0 otherwise.
+ */
+static inline int piStatsAdvance(PiStats_t *stats, uint16_t sequence, uint64_t hostTimeNs) {
+    // Distances of more than half the sequence space are packets going backwards
+    uint16_t delta = (uint16_t)(sequence - stats->lastSequence);
+    if (delta == 0) {
+        piStatsAdd(&stats->duplicates, 1);
+        return 0;
+    }
+    if (delta >= 0x8000) {
+        piStatsAdd(&stats->reordered, 1);
+        return 0;
+    }
+    if (delta > 1) {
+        piStatsAdd(&stats->gaps, 1);
+        piStatsAdd(&stats->lost, delta - 1u);
+        piStatsRecord(&stats->gapLength, delta - 1u);
+    }
+
+    uint64_t elapsed = hostTimeNs > stats->lastTimeNs ? hostTimeNs - stats->lastTimeNs : 0;
+    piStatsRecord(&stats->interArrivalNs, elapsed / delta);
+    if (stats->periodNs != 0) {
+        uint64_t expected = stats->periodNs * delta;
+        piStatsRecord(&stats->jitterNs, elapsed > expected ? elapsed - expected : expected - elapsed);
+    }
+    return 1;
+}
+
+/**
+ * @brief Initializes the state of a device.
+ *
+ * @param stats State to initialize.
+ * @param device Device index or serial number shown in the summary.
+ * @param packetRate Nominal packet rate in Hz, 0 disables the jitter histogram.
+ */
+void piStatsInit(PiStats_t *stats, uint32_t device, uint16_t packetRate) {
+    memset(stats, 0, sizeof(*stats));
+    stats->device = device;
+    stats->packetRate = packetRate;
+    stats->periodNs = packetRate ? 1000000000ull / packetRate : 0;
+}
+
+/**
+ * @brief Accounts one valid packet.
+ *
+ * @param stats Device state.
+ * @param packet The packet.
+ * @param hostTimeNs Host time the packet was read (CLOCK_MONOTONIC).
+ */
+void piStatsPacket(PiStats_t *stats, const PiProt_t *packet, uint64_t hostTimeNs) {
+    uint16_t sequence = packet->sequence;
+
+    piStatsAdd(&stats->packets, 1);
+    if (!stats->started) {
+        stats->started = 1;
+        stats->firstSequence = sequence;
+        stats->lastSequence = sequence;
+        stats->firstTimeNs = hostTimeNs;
+        stats->lastTimeNs = hostTimeNs;
+        return;
+    }
+
+    if (piStatsAdvance(stats, sequence, hostTimeNs)) {
+        stats->lastSequence = sequence;
+        stats->lastTimeNs = hostTimeNs;
+    }
+}
+
+/**
+ * @brief Accounts one rejected packet, or the repair of a packet also passed to `piStatsPacket`.
+ *
+ * @param stats Device state.
+ * @param error Validation result of the packet.
+ */
+void piStatsError(PiStats_t *stats, PiProtError_t error) {
+    if (error == PI_PROT_BAD_HEADER) {
+        piStatsAdd(&stats->badHeader, 1);
+    } else if (error == PI_PROT_BAD_CRC || error == PI_PROT_BAD_SEQUENCE) {
+        piStatsAdd(&stats->badCrc, 1);
+    } else if (error == PI_PROT_CORRECTED) {
+        piStatsAdd(&stats->corrected, 1);
+    }
+}
+
+/**
+ * @brief Accounts the CRC errors, corrections and skipped bytes counted by a framer since the last call.
+ *
+ * @param stats Device state.
+ * @param framer Framer decoding the device.
+ */
+void piStatsFramer(PiStats_t *stats, const PiFramer_t *framer) {
+    if (framer->badCrc != stats->framerBadCrc) {
+        piStatsAdd(&stats->badCrc, framer->badCrc - stats->framerBadCrc);
+        stats->framerBadCrc = framer->badCrc;
+    }
+    if (framer->corrected != stats->framerCorrected) {
+        piStatsAdd(&stats->corrected, framer->corrected - stats->framerCorrected);
+        stats->framerCorrected = framer->corrected;
+    }
+    if (framer->skippedBytes != stats->framerSkipped) {
+        piStatsAdd(&stats->skippedBytes, framer->skippedBytes - stats->framerSkipped);
+        stats->framerSkipped = framer->skippedBytes;
+    }
+}
+
+/**
+ * @brief Adds the values of a histogram to another one.
+ */
+static void piStatsAddHistogram(PiStatsHistogram_t *histogram, const PiStatsHistogram_t *part) {
+    uint64_t max = atomic_load_explicit(&part->max, memory_order_relaxed);
+
+    piStatsAdd(&histogram->count, atomic_load_explicit(&part->count, memory_order_relaxed));
+    piStatsAdd(&histogram->sum, atomic_load_explicit(&part->sum, memory_order_relaxed));
+    if (max > atomic_load_explicit(&histogram->max, memory_order_relaxed)) {
+        atomic_store_explicit(&histogram->max, max, memory_order_relaxed);
+    }
+    for (int i = 0; i < PI_STATS_BUCKETS; i++) {
+        piStatsAdd(&histogram->buckets[i], atomic_load_explicit(&part->buckets[i], memory_order_relaxed));
+    }
+}
+
+/**
+ * @brief Appends the state of a later part of the same stream, decoded separately.
+ *
+ * @param stats State of the stream up to the part, receives the sum.
+ * @param part State of the part.
+ */
+void piStatsMerge(PiStats_t *stats, const PiStats_t *part) {
+#define PI_STATS_MERGE(counter) piStatsAdd(&stats->counter, atomic_load_explicit(&part->counter, memory_order_relaxed))
+    PI_STATS_MERGE(packets);
+    PI_STATS_MERGE(lost);
+    PI_STATS_MERGE(gaps);
+    PI_STATS_MERGE(duplicates);
+    PI_STATS_MERGE(reordered);
+    PI_STATS_MERGE(badHeader);
+    PI_STATS_MERGE(badCrc);
+    PI_STATS_MERGE(corrected);
+    PI_STATS_MERGE(skippedBytes);
+#undef PI_STATS_MERGE
+    piStatsAddHistogram(&stats->gapLength, &part->gapLength);
+    piStatsAddHistogram(&stats->interArrivalNs, &part->interArrivalNs);
+    piStatsAddHistogram(&stats->jitterNs, &part->jitterNs);
+    if (!part->started) {
+        return;
+    }
+    if (!stats->started) {
+        stats->started = 1;
+        stats->firstSequence = part->firstSequence;
+        stats->firstTimeNs = part->firstTimeNs;
+        stats->lastSequence = part->lastSequence;
+        stats->lastTimeNs = part->lastTimeNs;
+        return;
+    }
+
+    // The first packet of the part was accounted as the first of a stream, account it now
+    piStatsAdvance(stats, part->firstSequence, part->firstTimeNs);
+    stats->lastSequence = part->lastSequence;
+    stats->lastTimeNs = part->lastTimeNs;
+}
+
+/**
+ * @brief Copies a histogram.
+ */
+static void piStatsCopyHistogram(const PiStatsHistogram_t *histogram, PiStatsHistogramSnapshot_t *snapshot) {
+    snapshot->count = atomic_load_explicit(&histogram->count, memory_order_relaxed);
+    snapshot->sum = atomic_load_explicit(&histogram->sum, memory_order_relaxed);
+    snapshot->max = atomic_load_explicit(&histogram->max, memory_order_relaxed);
+    for (int i = 0; i < PI_STATS_BUCKETS; i++) {
+        snapshot->buckets[i] = atomic_load_explicit(&histogram->buckets[i], memory_order_relaxed);
+    }
+}
+
+/**
+ * @brief Copies the state of a device.
+ *
+ * @param stats Device state, may be updated concurrently.
+ * @param snapshot Receives the copy.
+ */
+void piStatsSnapshot(const PiStats_t *stats, PiStatsSnapshot_t *snapshot) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    snapshot->timeNs = (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+    snapshot->device = stats->device;
+    snapshot->packetRate = stats->packetRate;
+    snapshot->packets = atomic_load_explicit(&stats->packets, memory_order_relaxed);
+    snapshot->lost = atomic_load_explicit(&stats->lost, memory_order_relaxed);
+    snapshot->gaps = atomic_load_explicit(&stats->gaps, memory_order_relaxed);
+    snapshot->duplicates = atomic_load_explicit(&stats->duplicates, memory_order_relaxed);
+    snapshot->reordered = atomic_load_explicit(&stats->reordered, memory_order_relaxed);
+    snapshot->badHeader = atomic_load_explicit(&stats->badHeader, memory_order_relaxed);
+    snapshot->badCrc = atomic_load_explicit(&stats->badCrc, memory_order_relaxed);
+    snapshot->corrected = atomic_load_explicit(&stats->corrected, memory_order_relaxed);
+    snapshot->skippedBytes = atomic_load_explicit(&stats->skippedBytes, memory_order_relaxed);
+    piStatsCopyHistogram(&stats->gapLength, &snapshot->gapLength);
+    piStatsCopyHistogram(&stats->interArrivalNs, &snapshot->interArrivalNs);
+    piStatsCopyHistogram(&stats->jitterNs, &snapshot->jitterNs);
+}
+
+/**
+ * @brief Returns an upper bound of a percentile of a histogram.
+ *
+ * @param histogram Histogram snapshot.
+ * @param percentile Percentile in [0, 100].
+ * @return Upper bound of the bucket holding the percentile, 0 for an empty histogram.
+ */
+uint64_t piStatsPercentile(const PiStatsHistogramSnapshot_t *histogram, double percentile) {
+    uint64_t total = 0, seen = 0, rank;
+
+    for (int i = 0; i < PI_STATS_BUCKETS; i++) {
+        total += histogram->buckets[i];
+    }
+    if (total == 0) {
+        return 0;
+    }
+    rank = (uint64_t)(percentile / 100.0 * (double)total + 0.5);
+    if (rank == 0) {
+        rank = 1;
+    }
+    for (int i = 0; i < PI_STATS_BUCKETS - 1; i++) {
+        seen += histogram->buckets[i];
+        if (seen >= rank) {
+            uint64_t bound = i == 0 ? 0 : (1ull << i) - 1;
+            return bound < histogram->max ? bound : histogram->max;
+        }
+    }
+    return histogram->max;
+}
+
+/**
+ * @brief Prints a one-line summary of a device.
+ *
+ * @param stream Destination stream.
+ * @param snapshot Current snapshot.
+ * @param previous Earlier snapshot of the same device, or NULL.
+ */
+void piStatsPrint(FILE *stream, const PiStatsSnapshot_t *snapshot, const PiStatsSnapshot_t *previous) {
+    uint64_t packets = snapshot->packets, lost = snapshot->lost;
+
+    fprintf(stream, "device %u: %llu packets", (unsigned)snapshot->device, (unsigned long long)packets);
+    if (previous != NULL && snapshot->timeNs > previous->timeNs) {
+        fprintf(stream, " (%.1f/s)", (double)(packets - previous->packets) * 1e9 / (double)(snapshot->timeNs - previous->timeNs));
+    }
+    fprintf(stream, ", lost %llu (%.3f%%) in %llu gaps, %llu duplicated, %llu reordered, %llu bad header, "
+            "%llu bad CRC, %llu corrected, %llu bytes skipped", (unsigned long long)lost,
+            packets + lost ? 100.0 * (double)lost / (double)(packets + lost) : 0.0, (unsigned long long)snapshot->gaps,
+            (unsigned long long)snapshot->duplicates, (unsigned long long)snapshot->reordered,
+            (unsigned long long)snapshot->badHeader, (unsigned long long)snapshot->badCrc,
+            (unsigned long long)snapshot->corrected, (unsigned long long)snapshot->skippedBytes);
+    if (snapshot->packetRate != 0) {
+        fprintf(stream, ", jitter p50 %llu us p99 %llu us max %llu us",
+                (unsigned long long)(piStatsPercentile(&snapshot->jitterNs, 50) / 1000),
+                (unsigned long long)(piStatsPercentile(&snapshot->jitterNs, 99) / 1000),
+                (unsigned long long)(snapshot->jitterNs.max / 1000));
+    }
+    fputc('\n', stream);
+}
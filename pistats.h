@@ -0,0 +1,178 @@
+/**
+ * @file pistats.h
+ * @brief Per-device link-health counters and histograms.
+ *
+ * The decoding thread of a device updates the counters for every packet: packets lost in
+ * gaps of the unwrapped 16-bit sequence, duplicated or reordered packets, packets rejected
+ * with `PI_PROT_BAD_HEADER` or `PI_PROT_BAD_CRC`, packets repaired from a single-bit error,
+ * bytes skipped while resynchronizing, and
+ * log2-bucketed histograms of the gap length, the inter-arrival time and its deviation from
+ * the nominal 1/packetRate period.
+ *
+ * Every counter has a single writer, so an update is a relaxed load and store without any
+ * locked instruction; any other thread can take a consistent-enough snapshot at any time.
+ */
+
+#ifndef pistats_h_included
+#define pistats_h_included
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "pi.h"
+#include "piframer.h"
+
+#define PI_STATS_BUCKETS    40      // Bucket k counts values in [2^(k-1), 2^k), the last one is open
+
+/**
+ * @struct PiStatsHistogram_t
+ * @brief Log2-bucketed histogram updated by one thread.
+ */
+typedef struct {
+    atomic_ullong count;                        // Recorded values
+    atomic_ullong sum;                          // Sum of the recorded values
+    atomic_ullong max;                          // Largest recorded value
+    atomic_ullong buckets[PI_STATS_BUCKETS];    // Values per power of two
+} PiStatsHistogram_t;
+
+/**
+ * @struct PiStats_t
+ * @brief Link-health state of one device.
+ */
+typedef struct {
+    uint32_t device;                    // Device index or serial number, for the summary
+    uint16_t packetRate;                // Nominal packet rate in Hz
+    uint64_t periodNs;                  // Nominal packet period
+    atomic_ullong packets;              // Valid packets, corrected ones included
+    atomic_ullong lost;                 // Sequence numbers missing, rejected packets included
+    atomic_ullong gaps;                 // Sequence gaps
+    atomic_ullong duplicates;           // Packets repeating the previous sequence number
+    atomic_ullong reordered;            // Packets going back in sequence, not counted as loss
+    atomic_ullong badHeader;            // Packets rejected with PI_PROT_BAD_HEADER
+    atomic_ullong badCrc;               // Packets rejected with PI_PROT_BAD_CRC or PI_PROT_BAD_SEQUENCE
+    atomic_ullong corrected;            // Packets valid after repairing a single-bit error
+    atomic_ullong skippedBytes;         // Bytes dropped while resynchronizing
+    PiStatsHistogram_t gapLength;       // Packets lost per gap
+    PiStatsHistogram_t interArrivalNs;  // Host time between consecutive packets, per sample
+    PiStatsHistogram_t jitterNs;        // Absolute deviation of the arrival from the nominal period
+    uint64_t firstTimeNs;               // Host time of the first packet, writer only
+    uint64_t lastTimeNs;                // Host time of the last packet, writer only
+    uint64_t framerBadCrc;              // Framer counters already accounted, writer only
+    uint64_t framerCorrected;
+    uint64_t framerSkipped;
+    uint16_t firstSequence;             // Sequence number of the first packet, writer only
+    uint16_t lastSequence;              // Sequence number of the last packet, writer only
+    uint8_t started;                    // A packet was received, writer only
+} PiStats_t;
+
+/**
+ * @struct PiStatsHistogramSnapshot_t
+ * @brief Plain copy of a histogram.
+ */
+typedef struct {
+    uint64_t count;
+    uint64_t sum;
+    uint64_t max;
+    uint64_t buckets[PI_STATS_BUCKETS];
+} PiStatsHistogramSnapshot_t;
+
+/**
+ * @struct PiStatsSnapshot_t
+ * @brief Plain copy of the link-health state, taken by any thread.
+ */
+typedef struct {
+    uint32_t device;
+    uint16_t packetRate;
+    uint64_t timeNs;                    // CLOCK_MONOTONIC time of the snapshot
+    uint64_t packets;
+    uint64_t lost;
+    uint64_t gaps;
+    uint64_t duplicates;
+    uint64_t reordered;
+    uint64_t badHeader;
+    uint64_t badCrc;
+    uint64_t corrected;
+    uint64_t skippedBytes;
+    PiStatsHistogramSnapshot_t gapLength;
+    PiStatsHistogramSnapshot_t interArrivalNs;
+    PiStatsHistogramSnapshot_t jitterNs;
+} PiStatsSnapshot_t;
+
+/**
+ * @brief Initializes the state of a device.
+ *
+ * @param stats State to initialize.
+ * @param device Device index or serial number shown in the summary.
+ * @param packetRate Nominal packet rate in Hz, 0 disables the jitter histogram.
+ */
+void piStatsInit(PiStats_t *stats, uint32_t device, uint16_t packetRate);
+
+/**
+ * @brief Accounts one valid packet.
+ *
+ * @param stats Device state.
+ * @param packet The packet.
+ * @param hostTimeNs Host time the packet was read (CLOCK_MONOTONIC).
+ */
+void piStatsPacket(PiStats_t *stats, const PiProt_t *packet, uint64_t hostTimeNs);
+
+/**
+ * @brief Accounts one rejected packet, or the repair of a packet also passed to `piStatsPacket`.
+ *
+ * @param stats Device state.
+ * @param error Validation result of the packet.
+ */
+void piStatsError(PiStats_t *stats, PiProtError_t error);
+
+/**
+ * @brief Accounts the CRC errors, corrections and skipped bytes counted by a framer since the last call.
+ *
+ * @param stats Device state.
+ * @param framer Framer decoding the device.
+ */
+void piStatsFramer(PiStats_t *stats, const PiFramer_t *framer);
+
+/**
+ * @brief Appends the state of a later part of the same stream, decoded separately.
+ *
+ * The counters and histograms are added up and the first packet of the part is accounted
+ * against the last packet of `stats`, so merging the parts of a stream in order gives the
+ * state of decoding it in one piece. Neither state may be updated concurrently.
+ *
+ * @param stats State of the stream up to the part, receives the sum.
+ * @param part State of the part.
+ */
+void piStatsMerge(PiStats_t *stats, const PiStats_t *part);
+
+/**
+ * @brief Copies the state of a device.
+ *
+ * @param stats Device state, may be updated concurrently.
+ * @param snapshot Receives the copy.
+ */
+void piStatsSnapshot(const PiStats_t *stats, PiStatsSnapshot_t *snapshot);
+
+/**
+ * @brief Returns an upper bound of a percentile of a histogram.
+ *
+ * @param histogram Histogram snapshot.
+ * @param percentile Percentile in [0, 100].
+ * @return Upper bound of the bucket holding the percentile, 0 for an empty histogram.
+ */
+uint64_t piStatsPercentile(const PiStatsHistogramSnapshot_t *histogram, double percentile);
+
+/**
+ * @brief Prints a one-line summary of a device.
+ *
+ * Counters are totals since `piStatsInit`. When `previous` is given, the packet rate is
+ * computed over the interval between both snapshots; the jitter percentiles are shown only
+ * when the nominal packet rate is known.
+ *
+ * @param stream Destination stream.
+ * @param snapshot Current snapshot.
+ * @param previous Earlier snapshot of the same device, or NULL.
+ */
+void piStatsPrint(FILE *stream, const PiStatsSnapshot_t *snapshot, const PiStatsSnapshot_t *previous);
+
+#endif	/* #ifdef pistats_h_included */
@@ -0,0 +1,384 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pitime.h"
+
+#define PI_TIME_UPTIME_SLOT     (offsetof(PiMux_t, uptime) / sizeof(uint32_t))
+#define PI_TIME_MIN_VARIANCE    (PI_TIME_MIN_SPAN * 1e9 * PI_TIME_MIN_SPAN * 1e9 / 12)  // Of points evenly spread over the span
+
+/**
+ * @brief Initializes the timebase of a device.
+ *
+ * @param timebase Timebase to initialize.
+ * @param packetRate Nominal packet rate in Hz.
+ * @param windowSeconds Seconds the clock fit remembers, `PI_TIME_WINDOW_SECONDS` if 0.
+ */
+void piTimeInit(PiTimebase_t *timebase, uint16_t packetRate, unsigned windowSeconds) {
+    memset(timebase, 0, sizeof(*timebase));
+    timebase->rate = packetRate ? packetRate : 1000;
+    timebase->periodNs = 1000000000ull / timebase->rate;
+    timebase->forget = 1.0 - 1.0 / (windowSeconds ? windowSeconds : PI_TIME_WINDOW_SECONDS);
+}
+
+/**
+ * @brief Narrows the counter value at boot with the uptime carried by a sample.
+ *
+ * The uptime in whole seconds at sample `s` puts the boot in (s - (uptime + 1) * rate, s - uptime * rate].
+ * Bounds disjoint from the previous ones mean the device restarted.
+ */
+static void piTimeAnchor(PiTimebase_t *timebase, uint64_t sample, uint32_t uptime) {
+    int64_t high = (int64_t)sample - (int64_t)uptime * (int64_t)timebase->rate;
+    int64_t low = high - (int64_t)timebase->rate;
+
+    if (timebase->anchors != 0 && (low >= timebase->bootHigh || high <= timebase->bootLow)) {
+        timebase->reboots++;
+        timebase->anchors = 0;
+    }
+    if (timebase->anchors == 0 || low > timebase->bootLow) {
+        timebase->bootLow = low;
+    }
+    if (timebase->anchors == 0 || high < timebase->bootHigh) {
+        timebase->bootHigh = high;
+    }
+    timebase->anchors++;
+}
+
+/**
+ * @brief Adds the least delayed sample of a second to the exponentially weighted fit of the
+ * host time against the device time.
+ */
+static void piTimeFitPoint(PiTimebase_t *timebase) {
+    double x = (double)(timebase->pointSample - timebase->firstSample) * (double)timebase->periodNs;
+    double y = x + (double)timebase->pointDelayNs;
+    double dx = x - timebase->meanX;
+
+    timebase->weight = timebase->forget * timebase->weight + 1.0;
+    timebase->meanX += dx / timebase->weight;
+    timebase->meanY += (y - timebase->meanY) / timebase->weight;
+    timebase->covXX = timebase->forget * timebase->covXX + dx * (x - timebase->meanX);
+    timebase->covXY = timebase->forget * timebase->covXY + dx * (y - timebase->meanY);
+}
+
+/**
+ * @brief Keeps the least delayed sample of every second and fits it once the second is over.
+ */
+static void piTimeFit(PiTimebase_t *timebase, uint64_t sample, uint64_t hostTimeNs) {
+    int64_t delay = (int64_t)(hostTimeNs - timebase->firstHostNs) -
+                    (int64_t)((sample - timebase->firstSample) * timebase->periodNs);
+
+    if (sample >= timebase->pointEnd) {
+        if (timebase->pointDelayNs != INT64_MAX) {
+            piTimeFitPoint(timebase);
+        }
+        timebase->pointEnd = sample - (sample - timebase->firstSample) % timebase->rate + timebase->rate;
+        timebase->pointDelayNs = INT64_MAX;
+    }
+    if (delay < timebase->pointDelayNs) {
+        timebase->pointDelayNs = delay;
+        timebase->pointSample = sample;
+    }
+}
+
+/**
+ * @brief Returns the slope of the fit, 1 until it spans `PI_TIME_MIN_SPAN` seconds.
+ */
+static double piTimeSlope(const PiTimebase_t *timebase) {
+    if (timebase->covXX < timebase->weight * PI_TIME_MIN_VARIANCE) {
+        return 1.0;
+    }
+    return timebase->covXY / timebase->covXX;
+}
+
+/**
+ * @brief Returns the device time of a sample.
+ *
+ * @param timebase Timebase of the device.
+ * @param sample Sample counter.
+ * @return Nanoseconds since boot, or since the first sample until an uptime word was received.
+ */
+int64_t piTimeDeviceNs(const PiTimebase_t *timebase, uint64_t sample) {
+    int64_t origin = (int64_t)timebase->firstSample;
+
+    if (timebase->anchors != 0) {
+        origin = timebase->bootLow + 1 + (timebase->bootHigh - timebase->bootLow - 1) / 2;
+    }
+    return ((int64_t)sample - origin) * (int64_t)timebase->periodNs;
+}
+
+/**
+ * @brief Returns the host time estimated for a sample by the clock fit.
+ *
+ * @param timebase Timebase of the device.
+ * @param sample Sample counter.
+ * @return CLOCK_MONOTONIC nanoseconds.
+ */
+uint64_t piTimeHostNs(const PiTimebase_t *timebase, uint64_t sample) {
+    double x = (double)(int64_t)(sample - timebase->firstSample) * (double)timebase->periodNs;
+    double y;
+
+    // Until the first second is over, the least delay seen so far gives the offset
+    if (timebase->weight == 0) {
+        y = x + (timebase->pointDelayNs != INT64_MAX ? (double)timebase->pointDelayNs : 0);
+    } else {
+        y = timebase->meanY + piTimeSlope(timebase) * (x - timebase->meanX);
+    }
+    return (uint64_t)((int64_t)timebase->firstHostNs + llround(y));
+}
+
+/**
+ * @brief Returns the drift of the device clock relative to the host clock.
+ *
+ * @param timebase Timebase of the device.
+ * @return Parts per million, positive when the device is slower than its nominal rate
+ *         measured by the host, 0 until the fit spans `PI_TIME_MIN_SPAN` seconds.
+ */
+double piTimeDriftPpm(const PiTimebase_t *timebase) {
+    return (piTimeSlope(timebase) - 1.0) * 1e6;
+}
+
+/**
+ * @brief Stamps a packet and updates the timebase.
+ *
+ * @param timebase Timebase of the device.
+ * @param packet The packet.
+ * @param hostTimeNs Host time the packet was read (CLOCK_MONOTONIC).
+ * @param stamp Receives the time of the packet.
+ * @return 1 if the packet was in order and updated the timebase, 0 otherwise.
+ */
+int piTimePacket(PiTimebase_t *timebase, const PiProt_t *packet, uint64_t hostTimeNs, PiTimeStamp_t *stamp) {
+    uint16_t sequence = packet->sequence;
+    uint64_t sample;
+    int inOrder = 1;
+
+    if (!timebase->started) {
+        timebase->started = 1;
+        timebase->sample = timebase->firstSample = sample = sequence;
+        timebase->lastSequence = sequence;
+        timebase->firstHostNs = hostTimeNs;
+        timebase->pointEnd = sample + timebase->rate;
+        timebase->pointDelayNs = INT64_MAX;
+    } else {
+        inOrder = piTimeUnwrap(&timebase->sample, &timebase->lastSequence, sequence, &sample);
+    }
+    if (inOrder) {
+        if (sequence % PI_MUXFACTOR == PI_TIME_UPTIME_SLOT) {
+            piTimeAnchor(timebase, sample, packet->mux);
+        }
+        piTimeFit(timebase, sample, hostTimeNs);
+    }
+
+    stamp->sample = sample;
+    stamp->deviceNs = piTimeDeviceNs(timebase, sample);
+    stamp->hostNs = piTimeHostNs(timebase, sample);
+    if (inOrder) {
+        // A better fit may move the estimate back a little, the samples of a device keep their order
+        if (stamp->hostNs < timebase->lastHostNs) {
+            stamp->hostNs = timebase->lastHostNs;
+        }
+        timebase->lastHostNs = stamp->hostNs;
+    }
+    return inOrder;
+}
+
+/**
+ * @brief Returns the first queued sample of a device.
+ */
+static inline PiTimeSample_t *piTimeMergeHead(const PiTimeMerge_t *merge, uint32_t device) {
+    return &merge->queues[(size_t)device * (merge->mask + 1) + merge->heads[device]];
+}
+
+/**
+ * @brief Orders devices by the time of their first queued sample, then by index.
+ */
+static inline int piTimeMergeBefore(const PiTimeMerge_t *merge, uint32_t a, uint32_t b) {
+    uint64_t ta = piTimeMergeHead(merge, a)->time.hostNs, tb = piTimeMergeHead(merge, b)->time.hostNs;
+    return ta < tb || (ta == tb && a < b);
+}
+
+static void piTimeMergeSiftUp(PiTimeMerge_t *merge, uint32_t i) {
+    uint32_t device = merge->heap[i];
+
+    while (i > 0) {
+        uint32_t parent = (i - 1) / 2;
+        if (!piTimeMergeBefore(merge, device, merge->heap[parent])) {
+            break;
+        }
+        merge->heap[i] = merge->heap[parent];
+        i = parent;
+    }
+    merge->heap[i] = device;
+}
+
+static void piTimeMergeSiftDown(PiTimeMerge_t *merge, uint32_t i) {
+    uint32_t device = merge->heap[i];
+
+    for (;;) {
+        uint32_t child = 2 * i + 1;
+        if (child >= merge->heapCount) {
+            break;
+        }
+        if (child + 1 < merge->heapCount && piTimeMergeBefore(merge, merge->heap[child + 1], merge->heap[child])) {
+            child++;
+        }
+        if (!piTimeMergeBefore(merge, merge->heap[child], device)) {
+            break;
+        }
+        merge->heap[i] = merge->heap[child];
+        i = child;
+    }
+    merge->heap[i] = device;
+}
+
+/**
+ * @brief Releases the earliest queued sample.
+ *
+ * The slot of the sample is only reused by the next push of its device, so it stays valid
+ * while the callback runs.
+ */
+static void piTimeMergeRelease(PiTimeMerge_t *merge) {
+    uint32_t device = merge->heap[0];
+    const PiTimeSample_t *sample = piTimeMergeHead(merge, device);
+
+    merge->heads[device] = (merge->heads[device] + 1) & merge->mask;
+    if (--merge->counts[device] == 0) {
+        merge->heap[0] = merge->heap[--merge->heapCount];
+    }
+    if (merge->heapCount != 0) {
+        piTimeMergeSiftDown(merge, 0);
+    }
+
+    if (sample->time.hostNs < merge->lastNs) {
+        merge->late++;
+    } else {
+        merge->lastNs = sample->time.hostNs;
+    }
+    merge->released++;
+    merge->callback(merge->context, sample);
+}
+
+/**
+ * @brief Releases the samples that no other device can precede any more.
+ */
+static void piTimeMergeDrain(PiTimeMerge_t *merge) {
+    while (merge->heapCount != 0 && (merge->heapCount == merge->devices ||
+           piTimeMergeHead(merge, merge->heap[0])->time.hostNs + merge->latencyNs <= merge->watermarkNs)) {
+        piTimeMergeRelease(merge);
+    }
+}
+
+/**
+ * @brief Allocates the merge of several devices.
+ *
+ * @param merge Merge to initialize.
+ * @param devices Number of devices, samples carry their index in `PiSample_t.device`.
+ * @param packetRate Nominal packet rate of the devices in Hz, see `piTimeInit` to change one.
+ * @param capacity Samples queued per device, rounded up to a power of two.
+ * @param latencyNs Longest time a sample waits for the samples of silent devices.
+ * @param callback Function receiving the samples in order.
+ * @param context User context passed to the callback.
+ * @return 0 on success, -1 if the memory could not be allocated.
+ */
+int piTimeMergeInit(PiTimeMerge_t *merge, uint32_t devices, uint16_t packetRate, size_t capacity, uint64_t latencyNs,
+                    PiTimeMergeCallback_t callback, void *context) {
+    size_t size = 2;
+
+    while (size < capacity) {
+        size <<= 1;
+    }
+    memset(merge, 0, sizeof(*merge));
+    merge->devices = devices;
+    merge->mask = size - 1;
+    merge->latencyNs = latencyNs;
+    merge->callback = callback;
+    merge->context = context;
+    merge->timebases = calloc(devices, sizeof(PiTimebase_t));
+    merge->queues = malloc((size_t)devices * size * sizeof(PiTimeSample_t));
+    merge->heads = calloc(devices, sizeof(size_t));
+    merge->counts = calloc(devices, sizeof(size_t));
+    merge->heap = calloc(devices, sizeof(uint32_t));
+    if (merge->timebases == NULL || merge->queues == NULL || merge->heads == NULL || merge->counts == NULL ||
+        merge->heap == NULL) {
+        piTimeMergeFree(merge);
+        return -1;
+    }
+    for (uint32_t device = 0; device < devices; device++) {
+        piTimeInit(&merge->timebases[device], packetRate, 0);
+    }
+    return 0;
+}
+
+/**
+ * @brief Releases the memory of a merge.
+ *
+ * @param merge Merge state.
+ */
+void piTimeMergeFree(PiTimeMerge_t *merge) {
+    free(merge->timebases);
+    free(merge->queues);
+    free(merge->heads);
+    free(merge->counts);
+    free(merge->heap);
+    merge->timebases = NULL;
+    merge->queues = NULL;
+    merge->heads = NULL;
+    merge->counts = NULL;
+    merge->heap = NULL;
+    merge->heapCount = 0;
+}
+
+/**
+ * @brief Stamps a sample with the timebase of its device, queues it and releases every
+ * sample whose turn has come.
+ *
+ * @param merge Merge state.
+ * @param sample Sample drained from the ring of its device.
+ */
+void piTimeMergePush(PiTimeMerge_t *merge, const PiSample_t *sample) {
+    uint32_t device = sample->device;
+    PiTimeSample_t *slot;
+
+    if (device >= merge->devices) {
+        return;
+    }
+    while (merge->counts[device] == merge->mask + 1) {
+        merge->forced++;
+        piTimeMergeRelease(merge);
+    }
+    slot = &merge->queues[(size_t)device * (merge->mask + 1) + ((merge->heads[device] + merge->counts[device]) & merge->mask)];
+    piTimePacket(&merge->timebases[device], &sample->packet, sample->hostTimeNs, &slot->time);
+    slot->sample = *sample;
+    if (merge->counts[device]++ == 0) {
+        merge->heap[merge->heapCount] = device;
+        piTimeMergeSiftUp(merge, merge->heapCount++);
+    }
+    if (slot->time.hostNs > merge->watermarkNs) {
+        merge->watermarkNs = slot->time.hostNs;
+    }
+    piTimeMergeDrain(merge);
+}
+
+/**
+ * @brief Releases the samples older than the latency at a host time, for when every device
+ * is silent.
+ *
+ * @param merge Merge state.
+ * @param nowNs Current CLOCK_MONOTONIC time.
+ */
+void piTimeMergeAdvance(PiTimeMerge_t *merge, uint64_t nowNs) {
+    if (nowNs > merge->watermarkNs) {
+        merge->watermarkNs = nowNs;
+    }
+    piTimeMergeDrain(merge);
+}
+
+/**
+ * @brief Releases every queued sample.
+ *
+ * @param merge Merge state.
+ */
+void piTimeMergeFlush(PiTimeMerge_t *merge) {
+    while (merge->heapCount != 0) {
+        piTimeMergeRelease(merge);
+    }
+}
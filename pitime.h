@@ -0,0 +1,255 @@
+/**
+ * @file pitime.h
+ * @brief Device time reconstruction and timestamp-ordered merging of several devices.
+ *
+ * A packet only carries a 16-bit sequence number, and the device uptime, in seconds, only
+ * arrives once per `PI_MUXFACTOR` packets as the mux word of slot 0. The timebase of a device
+ * turns every packet into a `PiTimeStamp_t`:
+ *
+ * - the sequence number is unwrapped into a 64-bit sample counter whose low 16 bits are the
+ *   sequence number;
+ * - every uptime word bounds the counter value at which the device booted; the bounds of
+ *   successive words are intersected and narrow down to one mux cycle as soon as the uptime
+ *   ticks over, which gives the device time since boot at the nominal period;
+ * - the host read times are fitted against the device time: every second, the sample read with
+ *   the least delay (the smallest read time minus device time) becomes a point of an
+ *   exponentially weighted linear regression, whose slope is the drift of the device clock
+ *   relative to the host clock and whose intercept is their offset. Keeping only the least
+ *   delayed samples leaves out the read batching jitter and the backlog read when a device
+ *   is opened, so every sample gets a host time estimate close to when it was sent.
+ *
+ * The merge takes the samples of N devices, as drained from their reactor rings, stamps them
+ * with the timebase of their device and keeps one queue per device. A binary heap over the
+ * queue heads releases the samples in global host time order as soon as every device has a
+ * queued sample, or once a sample is older than the reorder latency relative to the newest
+ * time seen, so a silent device delays the output by at most that latency.
+ */
+
+#ifndef pitime_h_included
+#define pitime_h_included
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "pi.h"
+#include "piring.h"
+
+#define PI_TIME_MIN_SPAN        10      // Seconds of points before the drift is fitted
+#define PI_TIME_WINDOW_SECONDS  60      // Default memory of the clock fit, one point per second
+
+/**
+ * @struct PiTimeStamp_t
+ * @brief Time of one sample.
+ */
+typedef struct {
+    uint64_t sample;            // Unwrapped sample counter, low 16 bits are the sequence number
+    int64_t deviceNs;           // Device time since boot, since the first sample until the uptime is known
+    uint64_t hostNs;            // Estimated CLOCK_MONOTONIC time of the sample, non-decreasing
+} PiTimeStamp_t;
+
+/**
+ * @struct PiTimebase_t
+ * @brief Time reconstruction state of one device.
+ */
+typedef struct {
+    uint64_t periodNs;          // Nominal sample period
+    uint64_t rate;              // Nominal packet rate in Hz
+    double forget;              // Weight kept by the fit for every new point
+    uint64_t sample;            // Counter of the newest sample
+    uint64_t firstSample;       // Counter of the first sample, origin of the fit
+    uint64_t firstHostNs;       // Read time of the first sample, origin of the fit
+    int64_t bootLow;            // The counter at boot is in (bootLow, bootHigh]
+    int64_t bootHigh;
+    uint64_t anchors;           // Uptime words accounted
+    uint64_t reboots;           // Uptime words inconsistent with the previous ones
+    int64_t pointDelayNs;       // Least host minus device time of the current second
+    uint64_t pointSample;       // Sample with that delay
+    uint64_t pointEnd;          // First sample of the next second
+    double weight;              // Fit: total weight of the points
+    double meanX;               // Fit: weighted mean of the device time since the first sample
+    double meanY;               // Fit: weighted mean of the host time since the first sample
+    double covXX;               // Fit: weighted sums of the products of the deviations
+    double covXY;
+    uint64_t lastHostNs;        // Last host time given out
+    uint16_t lastSequence;      // Sequence number of the newest sample
+    uint8_t started;            // A packet was received
+} PiTimebase_t;
+
+/**
+ * @struct PiTimeSample_t
+ * @brief Sample released by the merge.
+ */
+typedef struct {
+    PiTimeStamp_t time;         // Time of the sample
+    PiSample_t sample;          // Sample as pushed, read time and device index included
+} PiTimeSample_t;
+
+/**
+ * @brief Callback receiving the samples of all devices in host time order.
+ *
+ * @param context User context given to `piTimeMergeInit`.
+ * @param sample The sample, valid until the callback returns.
+ */
+typedef void (*PiTimeMergeCallback_t)(void *context, const PiTimeSample_t *sample);
+
+/**
+ * @struct PiTimeMerge_t
+ * @brief State of the merge of several devices.
+ */
+typedef struct {
+    uint32_t devices;           // Number of devices
+    uint32_t heapCount;         // Devices with queued samples
+    size_t mask;                // Queue capacity - 1
+    uint64_t latencyNs;         // Reorder latency
+    uint64_t watermarkNs;       // Newest time seen
+    uint64_t lastNs;            // Time of the last sample released
+    uint64_t released;          // Samples released
+    uint64_t late;              // Samples released after a later one of another device
+    uint64_t forced;            // Samples released early because their queue was full
+    PiTimebase_t *timebases;    // Timebase of every device
+    PiTimeSample_t *queues;     // Queue of every device, `mask + 1` samples each
+    size_t *heads;              // First queued sample of every device
+    size_t *counts;             // Queued samples of every device
+    uint32_t *heap;             // Devices with queued samples, min-heap on their first sample
+    PiTimeMergeCallback_t callback;
+    void *context;
+} PiTimeMerge_t;
+
+/**
+ * @brief Unwraps a 16-bit sequence number into a 64-bit sample counter.
+ *
+ * Distances of less than half the sequence space are packets moving forward, they advance
+ * the counter by the sequence step. A repeated packet, or one going back, gets the sample
+ * number it had and leaves the counter as it is, so it does not shift the later samples.
+ * The counter of the first packet is its sequence number.
+ *
+ * @param sample Counter of the newest sample.
+ * @param lastSequence Sequence number of the newest sample.
+ * @param sequence Sequence number of the packet.
+ * @param unwrapped Receives the sample number of the packet.
+ * @return 1 if the packet is the newest one, 0 if it repeats or goes back.
+ */
+static inline int piTimeUnwrap(uint64_t *sample, uint16_t *lastSequence, uint16_t sequence, uint64_t *unwrapped) {
+    uint16_t delta = (uint16_t)(sequence - *lastSequence);
+
+    if (delta == 0 || delta >= 0x8000) {
+        uint16_t back = (uint16_t)(*lastSequence - sequence);
+        *unwrapped = back <= *sample ? *sample - back : 0;
+        return 0;
+    }
+    *sample += delta;
+    *lastSequence = sequence;
+    *unwrapped = *sample;
+    return 1;
+}
+
+/**
+ * @brief Initializes the timebase of a device.
+ *
+ * @param timebase Timebase to initialize.
+ * @param packetRate Nominal packet rate in Hz.
+ * @param windowSeconds Seconds the clock fit remembers, `PI_TIME_WINDOW_SECONDS` if 0.
+ */
+void piTimeInit(PiTimebase_t *timebase, uint16_t packetRate, unsigned windowSeconds);
+
+/**
+ * @brief Stamps a packet and updates the timebase.
+ *
+ * Packets going back in sequence, and repeated ones, are stamped from the current state
+ * without updating it.
+ *
+ * @param timebase Timebase of the device.
+ * @param packet The packet.
+ * @param hostTimeNs Host time the packet was read (CLOCK_MONOTONIC).
+ * @param stamp Receives the time of the packet.
+ * @return 1 if the packet was in order and updated the timebase, 0 otherwise.
+ */
+int piTimePacket(PiTimebase_t *timebase, const PiProt_t *packet, uint64_t hostTimeNs, PiTimeStamp_t *stamp);
+
+/**
+ * @brief Returns the device time of a sample.
+ *
+ * @param timebase Timebase of the device.
+ * @param sample Sample counter.
+ * @return Nanoseconds since boot, or since the first sample until an uptime word was received.
+ */
+int64_t piTimeDeviceNs(const PiTimebase_t *timebase, uint64_t sample);
+
+/**
+ * @brief Returns the host time estimated for a sample by the clock fit.
+ *
+ * @param timebase Timebase of the device.
+ * @param sample Sample counter.
+ * @return CLOCK_MONOTONIC nanoseconds.
+ */
+uint64_t piTimeHostNs(const PiTimebase_t *timebase, uint64_t sample);
+
+/**
+ * @brief Returns the drift of the device clock relative to the host clock.
+ *
+ * @param timebase Timebase of the device.
+ * @return Parts per million, positive when the device is slower than its nominal rate
+ *         measured by the host, 0 until the fit spans `PI_TIME_MIN_SPAN` seconds.
+ */
+double piTimeDriftPpm(const PiTimebase_t *timebase);
+
+/**
+ * @brief Tells whether the device time is anchored to the device uptime.
+ *
+ * @param timebase Timebase of the device.
+ * @return Non-zero once an uptime word was received.
+ */
+static inline int piTimeAnchored(const PiTimebase_t *timebase) {
+    return timebase->anchors != 0;
+}
+
+/**
+ * @brief Allocates the merge of several devices.
+ *
+ * @param merge Merge to initialize.
+ * @param devices Number of devices, samples carry their index in `PiSample_t.device`.
+ * @param packetRate Nominal packet rate of the devices in Hz, see `piTimeInit` to change one.
+ * @param capacity Samples queued per device, rounded up to a power of two.
+ * @param latencyNs Longest time a sample waits for the samples of silent devices.
+ * @param callback Function receiving the samples in order.
+ * @param context User context passed to the callback.
+ * @return 0 on success, -1 if the memory could not be allocated.
+ */
+int piTimeMergeInit(PiTimeMerge_t *merge, uint32_t devices, uint16_t packetRate, size_t capacity, uint64_t latencyNs,
+                    PiTimeMergeCallback_t callback, void *context);
+
+/**
+ * @brief Releases the memory of a merge.
+ *
+ * @param merge Merge state.
+ */
+void piTimeMergeFree(PiTimeMerge_t *merge);
+
+/**
+ * @brief Stamps a sample with the timebase of its device, queues it and releases every
+ * sample whose turn has come.
+ *
+ * The samples of one device must be pushed in the order they were read.
+ *
+ * @param merge Merge state.
+ * @param sample Sample drained from the ring of its device.
+ */
+void piTimeMergePush(PiTimeMerge_t *merge, const PiSample_t *sample);
+
+/**
+ * @brief Releases the samples older than the latency at a host time, for when every device
+ * is silent.
+ *
+ * @param merge Merge state.
+ * @param nowNs Current CLOCK_MONOTONIC time.
+ */
+void piTimeMergeAdvance(PiTimeMerge_t *merge, uint64_t nowNs);
+
+/**
+ * @brief Releases every queued sample.
+ *
+ * @param merge Merge state.
+ */
+void piTimeMergeFlush(PiTimeMerge_t *merge);
+
+#endif	/* #ifdef pitime_h_included */